@@ -1,15 +1,25 @@
 #ifndef _CBENCH_BENCHSUITE_H_
 #define _CBENCH_BENCHSUITE_H_
 
+#include <cbench/plugin.h>
 #include <cbench/version.h>
 
 struct environment;
 struct mod_mgr;
+struct run_settings;
 
 struct plugin_link {
 	const char *name;
 	const char *options;
 	const char **version_rules;
+	enum plugin_role role;
+	/* Result columns driving the convergence check 'COL[/PCT],...' */
+	const char *converge;
+	/* Monitor period and phase offset in ms, 'period=MS' and 'offset=MS' */
+	unsigned int monitor_period;
+	unsigned int monitor_offset;
+	/* Number of concurrent copies of the plugin, 'NAME*N' */
+	int instances;
 };
 
 struct benchsuite_id {
@@ -17,6 +27,9 @@ struct benchsuite_id {
 	const char *description;
 	struct version version;
 	struct plugin_link **plugin_grps;
+
+	/* Run settings of this suite, fields set to -1 keep the default */
+	const struct run_settings *settings;
 };
 
 struct benchsuite {
@@ -27,6 +40,36 @@ struct benchsuite {
 int benchsuite_execute(struct mod_mgr *mm, struct environment *env,
 		struct benchsuite *suite, int *skip);
 
+/* Fetch all downloads of the suite's plugins into the download cache */
+int benchsuite_prefetch(struct mod_mgr *mm, struct environment *env,
+		struct benchsuite *suite, int *skip);
+
+/* Apply the run settings of the suite, if any, to settings */
+void benchsuite_apply_settings(const struct benchsuite_id *suite,
+		struct run_settings *settings);
+
 void benchsuite_id_print(const struct benchsuite_id *suite, int verbose);
 
+/*
+ * Parsers for plugin links 'NAME*N+MODIFIER@VERSION_RULES:OPTIONS' and run
+ * combinations of links seperated by ';'. The instance count and modifiers
+ * are optional, modifiers are the role primary or background,
+ * converge=COL[/PCT],... and the monitor period=MS and offset=MS. They
+ * modify arg and point into it.
+ */
+const char **create_version_rules(char *arg);
+int create_plugin_link(struct plugin_link *plug, char *arg);
+void put_plugin_link(struct plugin_link *plug);
+struct plugin_link *create_run_combo(char *arg);
+
+/*
+ * Create all instances of link with options and add them to the tail of
+ * plugins. Returns the first instance or NULL, instances created before an
+ * error stay in plugins.
+ */
+struct plugin *plugin_link_create(struct mod_mgr *mm,
+		const struct plugin_link *link, const char *options,
+		struct list_head *plugins);
+void put_run_combo(struct plugin_link *c);
+
 #endif  /* _CBENCH_BENCHSUITE_H_ */
@@ -0,0 +1,19 @@
+#ifndef _CBENCH_CORE_DOWNLOAD_H_
+#define _CBENCH_CORE_DOWNLOAD_H_
+
+struct download;
+
+/*
+ * Content addressed download cache. Files are stored as
+ * download_dir/sha256/<digest>, download_dir/<name> is a symlink to the
+ * content. mirrors is a NULL terminated list of URL prefixes, file:// URLs or
+ * local directories that are tried in order before the upstream URL.
+ */
+int download_fetch(const char *download_dir, const char **mirrors,
+		const struct download *dl);
+
+/* Fetch all downloads of a NULL terminated list in parallel */
+int downloads_fetch_parallel(const char *download_dir, const char **mirrors,
+		const struct download **dls);
+
+#endif  /* _CBENCH_CORE_DOWNLOAD_H_ */
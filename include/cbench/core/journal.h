@@ -0,0 +1,103 @@
+#ifndef _CBENCH_CORE_JOURNAL_H_
+#define _CBENCH_CORE_JOURNAL_H_
+
+#include <cbench/stats.h>
+
+struct list_head;
+
+struct journal_plugin {
+	/* The plugin reached its standard error and stopped early */
+	int done;
+	int nr_stats;
+	struct stats *stats;
+};
+
+struct journal_seed {
+	int index;
+	unsigned long seed;
+};
+
+/* A group as recorded by an earlier, interrupted execution */
+struct journal_group {
+	int index;
+	char sha[65];
+	int done;
+	/* Runs belong to points of an adaptive sweep, only done completes it */
+	int adaptive;
+	int runs;
+	double runtime;
+	int nr_plugins;
+	struct journal_plugin *plugins;
+};
+
+/*
+ * Crash safe journal of the executed command in the database directory.
+ * Every record is synced to disk before execution continues, so --continue
+ * can restart the command after the last completed run.
+ */
+struct journal {
+	int fd;
+	char *path;
+
+	struct journal_group *groups;
+	int nr_groups;
+
+	/* Global index of the next resolved group */
+	int next_index;
+	/* Index of the last started group, -1 if none */
+	int cur_index;
+	struct journal_group *resume;
+
+	/* Seeds of interleaved blocks, by the index of their first group */
+	struct journal_seed *seeds;
+	int nr_seeds;
+};
+
+/* Read the command of the journal in db_path, argv[0] is a placeholder */
+int journal_read_command(const char *db_path, int *argc, char ***argv);
+
+/*
+ * Open the journal in db_path. A new journal records argv, with resume the
+ * existing journal is loaded and continued.
+ */
+struct journal *journal_open(const char *db_path, int argc, char **argv,
+		int resume);
+
+void journal_close(struct journal *j, int finished);
+
+/* Assign the next global group index, -1 without journal */
+int journal_group_index(struct journal *j);
+
+/* Whether the group was completed by an earlier execution */
+int journal_group_done(struct journal *j, int index);
+
+int journal_group_start(struct journal *j, int index, const char *sha);
+
+/*
+ * Start the next point of the adaptive sweep of a started group. The runs of
+ * the point are recorded for the group, which is only finished by
+ * journal_group_finish after the last point. Interrupted sweeps start from
+ * scratch.
+ */
+int journal_point_start(struct journal *j, int index, const char *sha);
+
+/* Index of the last started group, -1 without journal */
+int journal_group_current(struct journal *j);
+
+/* State to continue the last started group from, NULL to start from scratch */
+struct journal_group *journal_group_resume(struct journal *j);
+
+/* done holds the early stop state of every plugin, NULL if none stopped */
+int journal_run(struct journal *j, int index, const char *uuid, int runs,
+		double runtime, int stop, struct list_head *plugins,
+		const int *done);
+
+int journal_group_finish(struct journal *j, int index);
+
+/*
+ * Order seed of the interleaved block starting at group index. A seed of an
+ * earlier execution replaces *seed, otherwise *seed is recorded.
+ */
+int journal_block_seed(struct journal *j, int index, unsigned long *seed);
+
+#endif  /* _CBENCH_CORE_JOURNAL_H_ */
@@ -0,0 +1,31 @@
+#ifndef _CBENCH_CORE_MEMORY_H_
+#define _CBENCH_CORE_MEMORY_H_
+
+/*
+ * Measurement mode memory handling. memory_lock locks all current and future
+ * mappings, keeps freed heap memory instead of returning it to the system and
+ * prefaults a heap reserve, so the framework neither page faults nor grows
+ * the heap while a benchmark runs.
+ */
+int memory_lock(void);
+
+/*
+ * Memory locks are not inherited by fork, a child of a process that called
+ * memory_lock locks its memory again with this. The allocator settings and
+ * the heap reserve are inherited.
+ */
+int memory_relock(void);
+
+/*
+ * Allocations of threads marked with memory_count_thread are counted while
+ * counting is enabled. The controller and monitor threads are marked, the
+ * plugin execution threads are not, their allocations belong to the plugin.
+ */
+void memory_count_thread(void);
+void memory_count_start(void);
+unsigned long memory_count_stop(void);
+
+/* Minor page faults of the calling thread so far */
+long memory_thread_faults(void);
+
+#endif  /* _CBENCH_CORE_MEMORY_H_ */
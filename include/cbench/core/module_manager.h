@@ -6,10 +6,15 @@
 struct mod_mgr {
 	char *module_dir;
 	struct list_head modules;
+
+	/* Directory of benchsuite files and the files parsed from it */
+	const char *suite_dir;
+	struct list_head suite_files;
 };
 
 
-int mod_mgr_init(struct mod_mgr *mm, const char *mod_dir);
+int mod_mgr_init(struct mod_mgr *mm, const char *mod_dir,
+		const char *suite_dir);
 
 void mod_mgr_unload_unused(struct mod_mgr *mm);
 
@@ -18,6 +23,10 @@ struct plugin *mod_mgr_plugin_create(struct mod_mgr *mm, const char *fid,
 
 void mod_mgr_plugin_free(struct mod_mgr *mm, struct plugin *plug);
 
+/*
+ * fid is either MODULE.SUITE for suites compiled into modules, the name of a
+ * suite file in the suite directory or the path of a suite file.
+ */
 struct benchsuite *mod_mgr_benchsuite_create(struct mod_mgr *mm,
 		const char *fid, const char **ver_restrictions);
 
@@ -0,0 +1,53 @@
+#ifndef _CBENCH_CORE_SCHEDULER_H_
+#define _CBENCH_CORE_SCHEDULER_H_
+
+#include <cbench/environment.h>
+
+struct list_head;
+
+struct sched_group {
+	int active;
+	/* Seconds per run from the database, 0 if the group never ran */
+	double run_cost;
+	double rel_std_dev;
+	int nr_ind_values;
+	/* Runs estimated to reach the standard error target */
+	int runs_needed;
+	/* Seconds planned for the group including warmup runs */
+	double planned;
+	struct run_settings settings;
+};
+
+struct scheduler {
+	struct sched_group *groups;
+	int nr_groups;
+	/* CLOCK_MONOTONIC seconds by which all groups should be finished */
+	double deadline;
+};
+
+/* Parse durations like 90, 45m, 8h or 1h30m into seconds, -1 on error */
+long sched_parse_duration(const char *str);
+
+double sched_now(void);
+
+int sched_init(struct scheduler *sched, int nr_groups, double deadline);
+void sched_exit(struct scheduler *sched);
+
+/* Look up the history of a group, plugins may be NULL for inactive groups */
+int sched_add_group(struct scheduler *sched, int index,
+		struct environment *env, struct list_head *plugins);
+
+/*
+ * Distribute the time left until the deadline over the active groups from
+ * first on and print the estimated end. Groups that ran before get time in
+ * proportion to the runs they need for the standard error target, groups
+ * without history share the rest.
+ */
+void sched_plan(struct scheduler *sched, const struct run_settings *defaults,
+		int first);
+
+/* Settings planned for a group */
+void sched_apply(struct scheduler *sched, int index,
+		struct run_settings *settings);
+
+#endif  /* _CBENCH_CORE_SCHEDULER_H_ */
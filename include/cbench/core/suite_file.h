@@ -0,0 +1,20 @@
+#ifndef _CBENCH_CORE_SUITE_FILE_H_
+#define _CBENCH_CORE_SUITE_FILE_H_
+
+#include <klib/list.h>
+
+struct benchsuite_id;
+
+/*
+ * Benchsuites defined in text files. Every load parses the file, the parsed
+ * file is added to files and stays valid until suite_files_free.
+ */
+const struct benchsuite_id *suite_file_load(struct list_head *files,
+		const char *path);
+
+void suite_files_free(struct list_head *files);
+
+/* Print all suite files in dir */
+void suite_files_print(const char *dir, int verbose);
+
+#endif  /* _CBENCH_CORE_SUITE_FILE_H_ */
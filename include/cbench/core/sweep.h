@@ -0,0 +1,28 @@
+#ifndef _CBENCH_CORE_SWEEP_H_
+#define _CBENCH_CORE_SWEEP_H_
+
+struct environment;
+struct list_head;
+struct mod_mgr;
+struct plugin_link;
+
+/*
+ * Execute a group with an adaptive sweep 'KEY=adaptive(START..END)'. A coarse
+ * geometric grid is measured first, then intervals are bisected where the
+ * scaling changes most or neighbouring results can't be told apart, until
+ * nothing is left to refine or the time budget in seconds is used up, 0
+ * measures up to a fixed number of points. The grid counts against the
+ * budget as well, it gets coarser if the budget is short.
+ *
+ * exec executes the plugins of every point as a regular group and has to
+ * leave their result summaries set, as plugins_execute does. The curve, knee
+ * and peak are printed, knee and peak are stored with the groups measured
+ * there.
+ */
+int sweep_adaptive_execute(struct mod_mgr *mm, struct environment *env,
+		struct plugin_link *grp, double budget, const char *status_prefix,
+		int (*exec)(void *priv, struct list_head *plugins,
+			const char *status_prefix),
+		void *priv);
+
+#endif  /* _CBENCH_CORE_SWEEP_H_ */
@@ -44,6 +44,15 @@ struct header {
 		enum data_value_cmp data_type;
 		struct value opt_val;
 	};
+
+	/*
+	 * Result columns only. If any column of a result sets converge, only
+	 * those columns are checked for the standard error, each against
+	 * stderr_percent or the configured one if it is 0. Otherwise all
+	 * numeric columns are checked.
+	 */
+	int converge;
+	double stderr_percent;
 };
 
 
@@ -56,6 +65,8 @@ enum data_type {
 struct data {
 	enum data_type type;
 	unsigned int run;
+	/* Plugin instance that added the row, -1 for the aggregate of all */
+	int instance;
 	struct value *data;
 	struct list_head run_data;
 	unsigned int cur_ind;
@@ -213,6 +224,22 @@ static inline size_t value_as_str_len(const struct value *v)
 	}
 }
 
+static inline double value_to_double(const struct value *v)
+{
+	switch (v->type) {
+	case VALUE_INT32:
+		return v->v_int32;
+	case VALUE_INT64:
+		return v->v_int64;
+	case VALUE_FLOAT:
+		return v->v_flt;
+	case VALUE_DOUBLE:
+		return v->v_dbl;
+	default:
+		return 0;
+	}
+}
+
 void value_print(const struct value *v);
 
 int values_nr_items(struct value *val);
@@ -0,0 +1,20 @@
+#ifndef _CBENCH_DOWNLOAD_H_
+#define _CBENCH_DOWNLOAD_H_
+
+/*
+ * A file a plugin version needs in the download directory. The core fetches
+ * and verifies all downloads of a plugin before its install function is
+ * called, so plugins can simply use download_dir/name afterwards.
+ *
+ * sha256 is the expected hex digest of the file. If it is NULL, the digest of
+ * the first successful fetch is recorded in the download cache and all later
+ * reuses are verified against it. Such a first copy of a gzip file is only
+ * accepted if gzip -t finds it complete.
+ */
+struct download {
+	const char *name;
+	const char *url;
+	const char *sha256;
+};
+
+#endif  /* _CBENCH_DOWNLOAD_H_ */
@@ -3,6 +3,8 @@
 
 #include <cbench/storage.h>
 
+struct journal;
+
 struct run_settings {
 	int warmup_runs;
 	int runtime_min;
@@ -16,8 +18,29 @@ struct environment {
 	const char *work_dir;
 	const char *bin_dir;
 	const char *download_dir;
+	const char **mirrors;
+	/* Maximum work directory size in MiB during pre-install, 0 is unlimited */
+	unsigned long disk_budget;
+	/* Time budget of all adaptive sweeps in seconds, 0 is unlimited */
+	unsigned long sweep_budget;
+	/* Time the adaptive sweeps used so far in seconds */
+	double sweep_used;
+	/* CLOCK_MONOTONIC seconds by which the benchsuite should finish, 0 is unlimited */
+	double deadline;
+	/* Groups whose runs are interleaved, 0 or 1 executes them one by one */
+	int interleave;
+	/* Interleave round robin instead of in a random order */
+	int interleave_rr;
+	/* Seed of the random order, 0 picks one */
+	unsigned long interleave_seed;
+	/* Memory is locked, report framework allocations during measurements */
+	int mlock;
+	/* Execute every group in a forked child process */
+	int isolate;
 	struct run_settings settings;
 	struct storage storage;
+	/* Execution journal for --continue, NULL if disabled */
+	struct journal *journal;
 };
 
 #endif  /* _CBENCH_ENVIRONMENT_H_ */
@@ -42,6 +42,38 @@ static inline void option_sha256_add(sha256_context *ctx, struct header *opts)
 
 int option_parse(const struct header *defaults, const char *optstr, struct header **out);
 
+/* Free options returned by option_parse together with their strings */
+void option_free(struct header *opts);
+
+/*
+ * Expand option sweeps into all option strings they describe. Option values
+ * may be a list '{A,B,C}' or a range 'START..END', 'START..END+STEP' or
+ * 'START..END*FACTOR'. List items and range bounds may be relative to the
+ * number of online cpus, 'ncpu' or 'N*ncpu'. The cross product of all
+ * sweeps is stored in out, the last option varies fastest. Returns the
+ * number of option strings, at least 1, or -1 on errors.
+ */
+int option_sweep_expand(const char *optstr, char ***out);
+
+void option_sweep_free(char **opts, int nr_opts);
+
+/* Adaptive sweep 'KEY=adaptive(START..END)' within an option string */
+struct option_adaptive {
+	const char *key;
+	int key_len;
+	long long start;
+	long long end;
+	int val_off;
+	int val_len;
+};
+
+/* Returns 1 if optstr contains an adaptive sweep, 0 if not, -1 on errors */
+int option_adaptive_find(const char *optstr, struct option_adaptive *ad);
+
+/* Returns a copy of optstr with the adaptive sweep replaced by val */
+char *option_adaptive_set(const char *optstr, const struct option_adaptive *ad,
+		long long val);
+
 int option_to_data_csv(const struct header *opts, char **buf, size_t *buf_size,
 		enum value_quote_type quotes);
 
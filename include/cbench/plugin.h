@@ -2,6 +2,8 @@
 #define _CBENCH_PLUGIN_H_
 
 #include <stddef.h>
+#include <stdio.h>
+#include <sys/types.h>
 
 #include <klib/list.h>
 
@@ -10,6 +12,9 @@
 
 struct data;
 struct environment;
+struct plugin_exec_env;
+struct run_order;
+struct stats;
 struct plugin_id;
 struct version;
 
@@ -26,6 +31,18 @@ enum called_func {
 	PLUGIN_CALLED_EXIT_POST,
 };
 
+/*
+ * Primary plugins are the benchmarks of a group, each of them stops when its
+ * own standard error is reached. Background plugins, e.g. monitors or load
+ * generators, run as long as any primary plugin runs. Plugins with results
+ * and neither a monitor nor a stop function are primary by default.
+ */
+enum plugin_role {
+	PLUGIN_ROLE_AUTO = 0,
+	PLUGIN_ROLE_PRIMARY,
+	PLUGIN_ROLE_BACKGROUND,
+};
+
 struct plugin {
 	const struct plugin_id *id;
 	struct module *mod;
@@ -38,6 +55,24 @@ struct plugin {
 	char *work_dir;
 	const char *download_dir;
 
+	/* Installed outside of plugins_execute, which then neither installs
+	 * nor uninstalls this plugin */
+	int preinstalled;
+
+	/* Role from the plugin link, overrides the role of the plugin id */
+	enum plugin_role role;
+	/* Convergence columns from the plugin link, override the header */
+	const char *converge;
+	/*
+	 * Period and phase offset of the monitor function in ms from the plugin
+	 * link. A period of 0 keeps the one of the plugin id.
+	 */
+	unsigned int monitor_period;
+	unsigned int monitor_offset;
+	/* Index of this copy if the link requested several instances */
+	int instance;
+	int nr_instances;
+
 	void *plugin_data;
 	void *version_data;
 	struct header *options;
@@ -47,13 +82,35 @@ struct plugin {
 	/* Do not change this, it's used for execution */
 	void *exec_data;
 
+	/*
+	 * Set while the group executes: the list of all plugins of the group,
+	 * linked by plugin_grp, whether this plugin is a primary one after the
+	 * role was resolved and the thread executing this plugin.
+	 */
+	struct list_head *group;
+	int primary;
+	pid_t tid;
+
 	enum called_func called_fun;
 
+	/* Summary of the first compared result column, set by plugins_execute */
+	struct {
+		const char *name;
+		enum data_value_cmp cmp;
+		int nr_values;
+		double mean;
+		double std_err;
+	} result;
+
 	struct list_head plugins;
 	struct list_head plugin_grp;
 
 	struct list_head run_data;
 	struct list_head check_err_data;
+
+	/* Running statistics of each result column over the measured runs */
+	struct stats *result_stats;
+	int nr_result_stats;
 };
 
 struct plugin_id {
@@ -84,7 +141,11 @@ struct plugin_id {
 	const struct header* (*data_hdr)(struct plugin *plug);
 
 	int (*monitor)(struct plugin *plug);
+	/* Period of the monitor function in ms, 0 for the default of 2s */
+	unsigned int monitor_period;
 	int (*check_stderr)(struct plugin *plug);
+
+	enum plugin_role role;
 };
 
 static inline const struct version *plugin_get_version(struct plugin *plug)
@@ -147,7 +208,30 @@ static inline void plugin_add_results(struct plugin *plug, struct data *data)
 int plugins_execute(struct environment *env, struct list_head *plugins,
 		const char *status_prefix);
 
+/*
+ * plugins_execute in steps, so runs of different groups can be interleaved.
+ * plugins_exec_start installs the plugins and starts their threads,
+ * plugins_exec_run executes one run and returns 1 while the group needs more
+ * runs, plugins_exec_finish stops the threads, uninstalls and frees the group.
+ * The return values of start and finish are those of plugins_execute.
+ */
+struct plugin_exec_env *plugins_exec_start(struct environment *env,
+		struct list_head *plugins, const char *status_prefix);
+int plugins_exec_run(struct plugin_exec_env *exec_env,
+		const struct run_order *order);
+int plugins_exec_finish(struct plugin_exec_env *exec_env);
+
+/* Whether a signal asked to stop the execution */
+int plugins_stopped(void);
+
+/* Install/uninstall plugins in parallel independent of their execution */
+int plugins_preinstall(struct environment *env, struct plugin **plugs,
+		int nr_plugs);
+int plugins_postuninstall(struct environment *env, struct plugin **plugs,
+		int nr_plugs);
+
 void plugin_calc_sha256(struct plugin *plug);
+void plugins_calc_sha256(struct list_head *plugins, char *sha256);
 
 void plugin_id_print(const struct plugin_id *plug, int verbose);
 
@@ -157,4 +241,43 @@ int plugin_version_check_requirements(const struct plugin_id *plug,
 #define plugin_for_each_result(plugin, data) \
 	list_for_each_entry(data, &(plugin)->check_err_data, run_data)
 
+/* Iterate over all plugins of the group plugin is executed in */
+#define plugin_for_each_group_plugin(plugin, iter) \
+	list_for_each_entry(iter, (plugin)->group, plugin_grp)
+
+/*
+ * The thread executing a plugin is named after its tid. Threads inherit the
+ * name of the thread creating them, so the name tells which plugin a thread
+ * of the suite belongs to, unless the thread renamed itself.
+ */
+#define PLUGIN_THREAD_NAME "cbench-%d"
+
+/*
+ * The plugin of the group of plugin that created thread tid of the suite
+ * process, NULL for threads of the core or threads that were renamed.
+ */
+static inline struct plugin *plugin_thread_owner(struct plugin *plug, pid_t tid)
+{
+	struct plugin *p;
+	char path[64];
+	FILE *f;
+	int owner;
+	int ret;
+
+	snprintf(path, sizeof(path), "/proc/self/task/%d/comm", (int)tid);
+	f = fopen(path, "r");
+	if (!f)
+		return NULL;
+	ret = fscanf(f, PLUGIN_THREAD_NAME, &owner);
+	fclose(f);
+	if (ret != 1)
+		return NULL;
+
+	plugin_for_each_group_plugin(plug, p) {
+		if (p->tid == owner)
+			return p;
+	}
+	return NULL;
+}
+
 #endif  /* _CBENCH_PLUGIN_H_ */
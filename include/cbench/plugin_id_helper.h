@@ -14,7 +14,7 @@
 
 #define OPTION_STR(opt_name, desc, unit_str, def_val) \
 	{ .name = opt_name, .description = desc, .unit = unit_str,\
-	  .opt_val = { .type = VALUE_STR, .v_str = def_val } }
+	  .opt_val = { .type = VALUE_STRING, .v_str = def_val } }
 
 #define OPTION_BOOL(opt_name, desc, unit_str, def_val) \
 		OPTION_INT32(opt_name, desc, unit_str, def_val)
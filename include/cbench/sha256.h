@@ -2,6 +2,7 @@
 #define _CBENCH_SHA256_H_
 
 #include <sha256-gpl/sha256.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -9,6 +10,15 @@
 /* buf of size at least 65 */
 void sha256_finish_str(sha256_context *ctx, char *buf);
 
+/*
+ * Same as sha256_update but uses the SHA extensions of the CPU for complete
+ * blocks if available. Use this for large inputs like downloaded files.
+ */
+void sha256_update_fast(sha256_context *ctx, const uint8_t *input, size_t length);
+
+/* Hash a complete file, buf of size at least 65 */
+int sha256_file_str(const char *path, char *buf);
+
 #define sha256_add(ctx, ptr) sha256_update(ctx, (uint8_t *)ptr, sizeof(*ptr))
 
 /* Add string to sha256. strlen() + 1 to get a 0 character into it for
@@ -0,0 +1,36 @@
+#ifndef _CBENCH_STATS_H_
+#define _CBENCH_STATS_H_
+
+#include <math.h>
+
+/* Running mean and sum of squared deviations (Welford) */
+struct stats {
+	unsigned long n;
+	double mean;
+	double m2;
+};
+
+static inline void stats_add(struct stats *s, double val)
+{
+	double delta = val - s->mean;
+
+	++s->n;
+	s->mean += delta / s->n;
+	s->m2 += delta * (val - s->mean);
+}
+
+static inline double stats_variance(const struct stats *s)
+{
+	if (s->n < 2)
+		return 0;
+	return s->m2 / (s->n - 1);
+}
+
+static inline double stats_std_err(const struct stats *s)
+{
+	if (!s->n)
+		return 0;
+	return sqrt(stats_variance(s) / s->n);
+}
+
+#endif  /* _CBENCH_STATS_H_ */
@@ -6,15 +6,96 @@ struct list_head;
 struct plugin;
 struct system;
 
+/* Position of a run in an interleaved execution of several groups */
+struct run_order {
+	/* Seed of the random order, 0 for round robin */
+	unsigned long seed;
+	/* Runs of all interleaved groups before this one */
+	int position;
+};
+
+/* Summary of a finished run */
+struct run_summary {
+	/* Seconds the run took, including the persisting of its data */
+	double duration;
+	/* Largest relative standard deviation of the plugin results so far, <0 if unknown */
+	double rel_std_dev;
+	/* NULL if the groups were executed one after another */
+	const struct run_order *order;
+};
+
+/* Timing of one function slot of a plugin in a run, in seconds */
+struct run_phase {
+	const char *name;
+	/* Wall clock and thread CPU time of the plugin function */
+	double duration;
+	double cpu_time;
+	/* Waiting for the other plugins to finish the slot */
+	double barrier_wait;
+	/* Persisting the data of all plugins after the slot */
+	double persist;
+};
+
+/*
+ * Cost of the monitor function of a plugin in a run. Times in seconds, the
+ * lag is how late a call started after its deadline.
+ */
+struct monitor_overhead {
+	double period;
+	double offset;
+	int calls;
+	/* Deadlines skipped because a call was too late */
+	int missed;
+	/* Wall clock and thread CPU time of all calls */
+	double duration;
+	double cpu_time;
+	double max_duration;
+	double max_lag;
+};
+
+/*
+ * Outcome of an adaptive sweep. Every point was stored as a plugin group of
+ * its own, knee and peak refer to the groups measured there.
+ */
+struct sweep_summary {
+	/* Swept option and the result column the curve was built from */
+	const char *option;
+	const char *metric;
+	/* The metric was inverted, less is better */
+	int inverted;
+	int nr_points;
+	long long knee;
+	const char *knee_group_sha;
+	long long peak;
+	const char *peak_group_sha;
+};
+
+/* Earlier runs of a plugin group on this system */
+struct group_history {
+	int nr_runs;
+	double duration_mean;
+	double duration_std_dev;
+	/* Relative standard deviation at the end of the last execution, <0 if unknown */
+	double rel_std_dev;
+};
+
 struct storage_ops {
 	void *(*init)(const char *path);
 	int (*init_plugin_grp)(void *storage, struct list_head *plugins,
 				const char *sha256);
-	int (*init_run)(void *storage, const char *uuid, int nr_run);
+	int (*init_run)(void *storage, const char *group_sha, const char *uuid,
+				int nr_run);
 	int (*add_sysinfo)(void *storage, struct system *sys);
 	int (*add_data)(void *storage, struct plugin *plug, struct list_head *data_list);
-	int (*exit_run)(void *storage);
+	int (*add_run_phases)(void *storage, struct plugin *plug,
+				const struct run_phase *phases, int nr_phases);
+	int (*add_monitor_overhead)(void *storage, struct plugin *plug,
+				const struct monitor_overhead *overhead);
+	int (*exit_run)(void *storage, const struct run_summary *summary);
+	int (*add_sweep)(void *storage, const struct sweep_summary *sweep);
 	int (*exit_plugin_grp)(void *storage);
+	int (*group_history)(void *storage, const char *sha256,
+				struct group_history *hist);
 	void (*exit)(void *storage);
 };
 
@@ -31,12 +112,12 @@ static inline int storage_init_plg_grp(struct storage *storage,
 		return 0;
 	return storage->ops->init_plugin_grp(storage->data, plugins, sha256);
 }
-static inline int storage_init_run(struct storage *storage, const char *uuid,
-					int nr_run)
+static inline int storage_init_run(struct storage *storage,
+		const char *group_sha, const char *uuid, int nr_run)
 {
 	if (!storage->ops->init_run)
 		return 0;
-	return storage->ops->init_run(storage->data, uuid, nr_run);
+	return storage->ops->init_run(storage->data, group_sha, uuid, nr_run);
 }
 static inline int storage_add_sysinfo(struct storage *storage, struct system *sys)
 {
@@ -51,11 +132,36 @@ static inline int storage_add_data(struct storage *storage, struct plugin *plug,
 		return 0;
 	return storage->ops->add_data(storage->data, plug, data_list);
 }
-static inline int storage_exit_run(struct storage *storage)
+static inline int storage_add_run_phases(struct storage *storage,
+		struct plugin *plug, const struct run_phase *phases,
+		int nr_phases)
+{
+	if (!storage->ops->add_run_phases)
+		return 0;
+	return storage->ops->add_run_phases(storage->data, plug, phases,
+			nr_phases);
+}
+static inline int storage_add_monitor_overhead(struct storage *storage,
+		struct plugin *plug, const struct monitor_overhead *overhead)
+{
+	if (!storage->ops->add_monitor_overhead)
+		return 0;
+	return storage->ops->add_monitor_overhead(storage->data, plug,
+			overhead);
+}
+static inline int storage_exit_run(struct storage *storage,
+		const struct run_summary *summary)
 {
 	if (!storage->ops->exit_run)
 		return 0;
-	return storage->ops->exit_run(storage->data);
+	return storage->ops->exit_run(storage->data, summary);
+}
+static inline int storage_add_sweep(struct storage *storage,
+		const struct sweep_summary *sweep)
+{
+	if (!storage->ops->add_sweep)
+		return 0;
+	return storage->ops->add_sweep(storage->data, sweep);
 }
 static inline void storage_exit_plg_grp(struct storage *storage)
 {
@@ -64,6 +170,19 @@ static inline void storage_exit_plg_grp(struct storage *storage)
 	storage->ops->exit_plugin_grp(storage->data);
 }
 
+/* Without history support, nr_runs is 0 */
+static inline int storage_group_history(struct storage *storage,
+		const char *sha256, struct group_history *hist)
+{
+	hist->nr_runs = 0;
+	hist->duration_mean = 0;
+	hist->duration_std_dev = 0;
+	hist->rel_std_dev = -1;
+	if (!storage->ops->group_history)
+		return 0;
+	return storage->ops->group_history(storage->data, sha256, hist);
+}
+
 static inline int storage_init(struct storage *storage,
 				const struct storage_ops *ops, const char *path)
 {
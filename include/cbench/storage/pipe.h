@@ -0,0 +1,25 @@
+#ifndef _CBENCH_STORAGE_PIPE_H_
+#define _CBENCH_STORAGE_PIPE_H_
+
+#include <cbench/storage.h>
+
+/*
+ * Storage for forked group executions. The child writes all storage calls to
+ * fd, the parent replays them into its own storage with storage_pipe_forward
+ * until the child closes the pipe. Plugins are passed as their index in the
+ * group, the parent passes its own list of the same plugins.
+ */
+int storage_pipe_init(struct storage *storage, int fd);
+
+/*
+ * Send the result summaries of the executed plugins, storage_pipe_forward
+ * sets them for the parent's plugins as plugins_execute does.
+ */
+int storage_pipe_send_results(struct storage *storage,
+		struct list_head *plugins);
+
+/* Returns -1 if the stream was broken or any storage call failed */
+int storage_pipe_forward(int fd, struct storage *target,
+		struct list_head *plugins);
+
+#endif  /* _CBENCH_STORAGE_PIPE_H_ */
@@ -10,6 +10,9 @@ char *file_read_complete(const char *path);
 
 int mem_grow(void **ptr, size_t *len, size_t req_len);
 
+/* Bytes allocated on disk for path and everything below it */
+unsigned long long dir_disk_usage(const char *path);
+
 #define strcmpb(conststr, buf) strncmp(conststr, buf, strlen(conststr))
 
 void str_strip(char *buf);
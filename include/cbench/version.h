@@ -3,6 +3,7 @@
 
 #include <cbench/data.h>
 
+struct download;
 struct requirement;
 
 struct comp_version {
@@ -16,6 +17,7 @@ struct version {
 	void *data;
 
 	struct requirement *requirements;
+	struct download *downloads;
 
 	int nr_independent_values;
 
@@ -217,6 +217,7 @@ static const struct header *p7zip_bench_data_hdr(struct plugin *plug)
 			.description = "Compression speed of p7zip.",
 			.unit = "KB/s",
 			.data_type = DATA_MORE_IS_BETTER,
+			.converge = 1,
 		}, {
 			.name = "decompress_speed",
 			.description = "Decompression speed of p7zip.",
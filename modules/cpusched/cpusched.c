@@ -4,6 +4,7 @@
 extern const struct plugin_id plugin_yield_bench;
 extern const struct plugin_id plugin_fork_bench;
 extern const struct plugin_id plugin_latency_monitor;
+extern const struct plugin_id plugin_wakeup_latency;
 extern const struct benchsuite_id suite_normal;
 extern const struct benchsuite_id suite_medium;
 
@@ -11,6 +12,7 @@ static const struct plugin_id *cpusched_plugins[] = {
 	&plugin_yield_bench,
 	&plugin_fork_bench,
 	&plugin_latency_monitor,
+	&plugin_wakeup_latency,
 	NULL
 };
 
@@ -0,0 +1,448 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <cbench/data.h>
+#include <cbench/option.h>
+#include <cbench/plugin_id_helper.h>
+#include <cbench/plugin.h>
+#include <cbench/version.h>
+
+static struct header plugin_wakeup_latency_options[] = {
+	OPTION_STR("cpus", "CPUs to measure on, a comma separated list of CPUs and ranges like 0,2-3. Empty for all CPUs the suite may use", NULL, ""),
+	OPTION_INT32("interval", "Interval between two wakeups of a measuring thread", "us", 1000),
+	OPTION_INT32("priority", "SCHED_FIFO priority of the measuring threads, 0 keeps SCHED_OTHER", NULL, 0),
+	OPTION_SENTINEL
+};
+
+static struct version plugin_wakeup_latency_versions[] = {
+	{
+		.version = "0.1",
+		.default_options = plugin_wakeup_latency_options,
+	}, {
+		/* Sentinel */
+	}
+};
+
+/* Histogram with 1us buckets, longer latencies only count into the last one */
+#define WAKEUP_LATENCY_BUCKETS 10000
+
+struct wakeup_latency_thread {
+	pthread_t thread;
+	struct wakeup_latency_data *d;
+	int cpu;
+	int err;
+
+	uint64_t samples;
+	int64_t sum_ns;
+	int64_t max_ns;
+	uint64_t *hist;
+};
+
+struct wakeup_latency_data {
+	volatile int stop;
+	int64_t interval_ns;
+	int priority;
+
+	struct wakeup_latency_thread *threads;
+	int nr_threads;
+
+	/* Sum of all threads for the row of all CPUs */
+	uint64_t *hist;
+};
+
+static int wakeup_latency_add_cpu(struct wakeup_latency_data *d, int cpu)
+{
+	struct wakeup_latency_thread *threads;
+	struct wakeup_latency_thread *t;
+
+	threads = realloc(d->threads, sizeof(*threads) * (d->nr_threads + 1));
+	if (!threads)
+		return -1;
+	d->threads = threads;
+
+	t = &threads[d->nr_threads];
+	memset(t, 0, sizeof(*t));
+	t->cpu = cpu;
+	t->hist = malloc(sizeof(*t->hist) * WAKEUP_LATENCY_BUCKETS);
+	if (!t->hist)
+		return -1;
+	++d->nr_threads;
+	return 0;
+}
+
+static int wakeup_latency_parse_cpus(struct wakeup_latency_data *d,
+		const char *cpus)
+{
+	const char *ptr = cpus;
+	cpu_set_t set;
+	int i;
+
+	if (cpus[0] == '\0') {
+		if (sched_getaffinity(0, sizeof(set), &set)) {
+			printf("Error: Could not get the CPU affinity of the suite\n");
+			return -1;
+		}
+		for (i = 0; i != CPU_SETSIZE; ++i)
+			if (CPU_ISSET(i, &set) && wakeup_latency_add_cpu(d, i))
+				return -1;
+		return 0;
+	}
+
+	while (1) {
+		char *end;
+		long first, last;
+
+		first = strtol(ptr, &end, 10);
+		last = first;
+		if (end != ptr && *end == '-') {
+			ptr = end + 1;
+			last = strtol(ptr, &end, 10);
+		}
+		if (end == ptr || first < 0 || last < first
+				|| last >= CPU_SETSIZE
+				|| (*end != ',' && *end != '\0'))
+			goto error;
+		for (i = first; i <= last; ++i)
+			if (wakeup_latency_add_cpu(d, i))
+				return -1;
+		if (*end == '\0')
+			return 0;
+		ptr = end + 1;
+	}
+error:
+	printf("Error: Invalid CPU list %s\n", cpus);
+	return -1;
+}
+
+static int wakeup_latency_uninstall(struct plugin *plug)
+{
+	struct wakeup_latency_data *d = plugin_get_data(plug);
+	int i;
+
+	for (i = 0; i != d->nr_threads; ++i)
+		free(d->threads[i].hist);
+	free(d->threads);
+	free(d->hist);
+	free(d);
+
+	plugin_set_data(plug, NULL);
+	return 0;
+}
+
+static int wakeup_latency_install(struct plugin *plug)
+{
+	const struct header *opts = plugin_get_options(plug);
+	struct wakeup_latency_data *d = malloc(sizeof(*d));
+
+	if (!d)
+		return -1;
+	memset(d, 0, sizeof(*d));
+	plugin_set_data(plug, d);
+
+	d->interval_ns = option_get_int32(opts, "interval") * 1000LL;
+	d->priority = option_get_int32(opts, "priority");
+	if (d->interval_ns <= 0) {
+		printf("Error: The wakeup interval has to be positive\n");
+		goto error;
+	}
+	if (d->priority < 0 || d->priority > sched_get_priority_max(SCHED_FIFO)) {
+		printf("Error: Invalid SCHED_FIFO priority %d\n", d->priority);
+		goto error;
+	}
+
+	d->hist = malloc(sizeof(*d->hist) * WAKEUP_LATENCY_BUCKETS);
+	if (!d->hist)
+		goto error;
+	if (wakeup_latency_parse_cpus(d, option_get_str(opts, "cpus")))
+		goto error;
+	return 0;
+error:
+	wakeup_latency_uninstall(plug);
+	return -1;
+}
+
+static int wakeup_latency_init(struct plugin *plug)
+{
+	struct wakeup_latency_data *d = plugin_get_data(plug);
+
+	d->stop = 0;
+
+	return 0;
+}
+
+static inline int64_t wakeup_latency_diff_ns(const struct timespec *a,
+		const struct timespec *b)
+{
+	return (a->tv_sec - b->tv_sec) * 1000000000LL + a->tv_nsec - b->tv_nsec;
+}
+
+/*
+ * Sleeps until absolute deadlines, so neither the time to record a sample
+ * nor the latency itself delays the following wakeups. Deadlines that passed
+ * during a long latency are skipped instead of firing back to back.
+ */
+static void *wakeup_latency_thread(void *arg)
+{
+	struct wakeup_latency_thread *t = arg;
+	struct wakeup_latency_data *d = t->d;
+	struct timespec next;
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!d->stop) {
+		int64_t lat;
+		int ret;
+
+		next.tv_nsec += d->interval_ns;
+		next.tv_sec += next.tv_nsec / 1000000000;
+		next.tv_nsec %= 1000000000;
+
+		ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		if (ret && ret != EINTR) {
+			t->err = ret;
+			break;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		lat = wakeup_latency_diff_ns(&now, &next);
+		if (lat < 0)
+			continue;
+		++t->samples;
+		t->sum_ns += lat;
+		if (lat > t->max_ns)
+			t->max_ns = lat;
+		if (lat / 1000 < WAKEUP_LATENCY_BUCKETS - 1)
+			++t->hist[lat / 1000];
+		else
+			++t->hist[WAKEUP_LATENCY_BUCKETS - 1];
+
+		if (lat >= d->interval_ns)
+			next = now;
+	}
+	return NULL;
+}
+
+static int wakeup_latency_start_thread(struct wakeup_latency_data *d,
+		struct wakeup_latency_thread *t)
+{
+	pthread_attr_t attr;
+	cpu_set_t set;
+	int ret;
+
+	t->d = d;
+	t->err = 0;
+	t->samples = 0;
+	t->sum_ns = 0;
+	t->max_ns = 0;
+	memset(t->hist, 0, sizeof(*t->hist) * WAKEUP_LATENCY_BUCKETS);
+
+	pthread_attr_init(&attr);
+	CPU_ZERO(&set);
+	CPU_SET(t->cpu, &set);
+	pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+	if (d->priority) {
+		struct sched_param param = {
+			.sched_priority = d->priority,
+		};
+
+		pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+		pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+		pthread_attr_setschedparam(&attr, &param);
+	}
+	ret = pthread_create(&t->thread, &attr, wakeup_latency_thread, t);
+	pthread_attr_destroy(&attr);
+	if (ret) {
+		printf("Error: Could not start the measuring thread on CPU %d: %s\n",
+				t->cpu, strerror(ret));
+		return -1;
+	}
+	return 0;
+}
+
+static int wakeup_latency_run(struct plugin *plug)
+{
+	struct wakeup_latency_data *d = plugin_get_data(plug);
+	int started;
+	int ret = 0;
+	int i;
+
+	for (started = 0; started != d->nr_threads; ++started) {
+		if (wakeup_latency_start_thread(d, &d->threads[started])) {
+			d->stop = 1;
+			ret = -1;
+			break;
+		}
+	}
+
+	for (i = 0; i != started; ++i) {
+		pthread_join(d->threads[i].thread, NULL);
+		if (d->threads[i].err) {
+			printf("Error: Measuring thread on CPU %d failed: %s\n",
+					d->threads[i].cpu,
+					strerror(d->threads[i].err));
+			ret = -1;
+		}
+	}
+	return ret;
+}
+
+static void wakeup_latency_stop(struct plugin *plug)
+{
+	struct wakeup_latency_data *d = plugin_get_data(plug);
+
+	d->stop = 1;
+}
+
+/* Latency in us below which the fraction pct of the samples lies */
+static double wakeup_latency_percentile(const uint64_t *hist, uint64_t samples,
+		int64_t max_ns, double pct)
+{
+	uint64_t limit = samples * pct;
+	uint64_t count = 0;
+	int i;
+
+	for (i = 0; i != WAKEUP_LATENCY_BUCKETS - 1; ++i) {
+		count += hist[i];
+		if (count > limit)
+			return i;
+	}
+	return max_ns / 1000.0;
+}
+
+static int wakeup_latency_add_row(struct plugin *plug, int cpu,
+		const uint64_t *hist, uint64_t samples, int64_t sum_ns,
+		int64_t max_ns)
+{
+	struct data *dat;
+
+	dat = data_alloc(DATA_TYPE_RESULT, 8);
+	if (!dat)
+		return -1;
+
+	data_add_int32(dat, cpu);
+	data_add_int64(dat, samples);
+	data_add_double(dat, samples ? sum_ns / 1000.0 / samples : 0);
+	data_add_double(dat, wakeup_latency_percentile(hist, samples, max_ns, 0.5));
+	data_add_double(dat, wakeup_latency_percentile(hist, samples, max_ns, 0.9));
+	data_add_double(dat, wakeup_latency_percentile(hist, samples, max_ns, 0.99));
+	data_add_double(dat, wakeup_latency_percentile(hist, samples, max_ns, 0.999));
+	data_add_double(dat, max_ns / 1000.0);
+	plugin_add_results(plug, dat);
+	return 0;
+}
+
+static int wakeup_latency_parse_results(struct plugin *plug)
+{
+	struct wakeup_latency_data *d = plugin_get_data(plug);
+	uint64_t samples = 0;
+	int64_t sum_ns = 0;
+	int64_t max_ns = 0;
+	int i, j;
+
+	memset(d->hist, 0, sizeof(*d->hist) * WAKEUP_LATENCY_BUCKETS);
+	for (i = 0; i != d->nr_threads; ++i) {
+		struct wakeup_latency_thread *t = &d->threads[i];
+
+		if (wakeup_latency_add_row(plug, t->cpu, t->hist, t->samples,
+					t->sum_ns, t->max_ns))
+			return -1;
+
+		for (j = 0; j != WAKEUP_LATENCY_BUCKETS; ++j)
+			d->hist[j] += t->hist[j];
+		samples += t->samples;
+		sum_ns += t->sum_ns;
+		if (t->max_ns > max_ns)
+			max_ns = t->max_ns;
+	}
+
+	if (d->nr_threads > 1)
+		return wakeup_latency_add_row(plug, -1, d->hist, samples, sum_ns,
+				max_ns);
+	return 0;
+}
+
+static const struct header *wakeup_latency_data_hdr(struct plugin *plug)
+{
+	static const struct header hdr[] = {
+		{
+			.name = "cpu",
+			.description = "CPU of the measuring thread, -1 for all CPUs together.",
+		}, {
+			.name = "samples",
+			.description = "Number of wakeups in this run.",
+		}, {
+			.name = "mean",
+			.unit = "us",
+			.description = "Mean wakeup latency.",
+			.data_type = DATA_LESS_IS_BETTER,
+		}, {
+			.name = "p50",
+			.unit = "us",
+			.description = "Median wakeup latency.",
+			.data_type = DATA_LESS_IS_BETTER,
+		}, {
+			.name = "p90",
+			.unit = "us",
+			.description = "90th percentile of the wakeup latency.",
+			.data_type = DATA_LESS_IS_BETTER,
+		}, {
+			.name = "p99",
+			.unit = "us",
+			.description = "99th percentile of the wakeup latency.",
+			.data_type = DATA_LESS_IS_BETTER,
+		}, {
+			.name = "p999",
+			.unit = "us",
+			.description = "99.9th percentile of the wakeup latency.",
+			.data_type = DATA_LESS_IS_BETTER,
+		}, {
+			.name = "max",
+			.unit = "us",
+			.description = "Maximum wakeup latency.",
+			.data_type = DATA_LESS_IS_BETTER,
+		}, {
+			/* Sentinel */
+		}
+	};
+
+	return hdr;
+}
+
+const struct plugin_id plugin_wakeup_latency = {
+	.name = "wakeup-latency",
+	.description = "Measures the wakeup latency like cyclictest. One thread per selected CPU, optionally SCHED_FIFO, sleeps until absolute deadlines and records the latency into a histogram. Each run reports percentiles and the maximum per CPU and for all CPUs together.",
+	.versions = plugin_wakeup_latency_versions,
+	.install = wakeup_latency_install,
+	.uninstall = wakeup_latency_uninstall,
+	.init = wakeup_latency_init,
+	.run = wakeup_latency_run,
+	.stop = wakeup_latency_stop,
+	.parse_results = wakeup_latency_parse_results,
+	.data_hdr = wakeup_latency_data_hdr,
+};
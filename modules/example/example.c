@@ -236,7 +236,8 @@ static struct version example_bench_ver[] = {
  *  - monitor: Called once a second when run is executed.
  *  - check_stderr: Custom calculations if the standard error was reached. If
  *  	this function is not implemented, cbench will calculate directly on
- *  	the data measured.
+ *  	the data measured. A group continued with --continue uses the generic
+ *  	check instead, the results of the earlier runs are not available.
  */
 static struct plugin_id example_plugs[] = {
 	{
@@ -262,6 +263,10 @@ static struct plugin_id example_plugs[] = {
 		.data_hdr = plug_data_hdr,
 		.stop = plug_stop,
 		.check_stderr = plug_check_stderr,
+
+		/* Benchmarks with monitor or stop functions are background
+		 * plugins by default */
+		.role = PLUGIN_ROLE_PRIMARY,
 	}, {
 		.name = "mon",
 		.versions = example_bench_ver,
@@ -0,0 +1,118 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "hog.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cbench/option.h>
+#include <cbench/plugin.h>
+#include <cbench/plugin_id_helper.h>
+#include <cbench/version.h>
+
+#define CACHE_LINE 64
+/* Cache lines are visited in steps of a prime to defeat the prefetchers */
+#define CACHE_THRASH_STEP 4099
+/* Used if neither the option nor the system information has a size */
+#define CACHE_THRASH_DEFAULT (8 << 20)
+
+static int cache_thrash_setup(struct hog *hog, struct hog_thread *t)
+{
+	t->buf = malloc(hog->size);
+	if (!t->buf)
+		return -1;
+	memset(t->buf, 0, hog->size);
+	t->off = 0;
+	return 0;
+}
+
+static long cache_thrash_op(struct hog *hog, struct hog_thread *t)
+{
+	size_t nr_lines = hog->size / CACHE_LINE;
+	size_t step = nr_lines % CACHE_THRASH_STEP ? CACHE_THRASH_STEP : 1;
+	char *buf = t->buf;
+	size_t line = t->off;
+	size_t i;
+
+	for (i = 0; i != nr_lines; ++i) {
+		++buf[line * CACHE_LINE];
+		line = (line + step) % nr_lines;
+	}
+	t->off = line;
+	return nr_lines * CACHE_LINE;
+}
+
+static void cache_thrash_cleanup(struct hog *hog, struct hog_thread *t)
+{
+	free(t->buf);
+	t->buf = NULL;
+}
+
+static const struct hog_ops cache_thrash_ops = {
+	.setup = cache_thrash_setup,
+	.op = cache_thrash_op,
+	.cleanup = cache_thrash_cleanup,
+};
+
+static int cache_thrash_init(struct plugin *plug)
+{
+	const struct header *opts = plugin_get_options(plug);
+	int64_t size = option_get_int64(opts, "size");
+
+	if (size < 0) {
+		printf("Error: Invalid cache thrash size %lld\n", (long long)size);
+		return -1;
+	}
+	size <<= 10;
+	if (!size)
+		size = hog_llc_size();
+	if (!size)
+		size = CACHE_THRASH_DEFAULT;
+	if (size < CACHE_LINE)
+		size = CACHE_LINE;
+	return hog_init(plug, &cache_thrash_ops, size, NULL);
+}
+
+static struct header cache_thrash_options[] = {
+	HOG_OPTIONS,
+	OPTION_INT64("size", "Memory each thread touches, 0 for the last level cache size of the system information", "KiB", 0),
+	OPTION_SENTINEL
+};
+
+static struct version cache_thrash_versions[] = {
+	{
+		.version = "0.1",
+		.default_options = cache_thrash_options,
+	}, {
+		/* Sentinel */
+	}
+};
+
+const struct plugin_id plugin_cache_thrash = {
+	.name = "cache-thrash",
+	.description = "Background load that evicts the last level cache by touching every cache line of a buffer of its size.",
+	.versions = cache_thrash_versions,
+	.init = cache_thrash_init,
+	.run = hog_run,
+	.stop = hog_stop,
+	.exit = hog_exit,
+	.data_hdr = hog_data_hdr,
+};
@@ -0,0 +1,72 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "hog.h"
+
+#include <cbench/plugin.h>
+#include <cbench/plugin_id_helper.h>
+#include <cbench/version.h>
+
+/* Spins of one operation, a few microseconds of CPU time */
+#define CPU_HOG_SPINS 4096
+
+static long cpu_hog_op(struct hog *hog, struct hog_thread *t)
+{
+	volatile uint64_t x = t->ops;
+	int i;
+
+	for (i = 0; i != CPU_HOG_SPINS; ++i)
+		x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+	return 0;
+}
+
+static const struct hog_ops cpu_hog_ops = {
+	.op = cpu_hog_op,
+};
+
+static int cpu_hog_init(struct plugin *plug)
+{
+	return hog_init(plug, &cpu_hog_ops, 0, NULL);
+}
+
+static struct header cpu_hog_options[] = {
+	HOG_OPTIONS,
+	OPTION_INT32("duty", "Percent of every 10ms period the threads are busy, 0 keeps them busy", "%", 100),
+	OPTION_SENTINEL
+};
+
+static struct version cpu_hog_versions[] = {
+	{
+		.version = "0.1",
+		.default_options = cpu_hog_options,
+	}, {
+		/* Sentinel */
+	}
+};
+
+const struct plugin_id plugin_cpu_hog = {
+	.name = "cpu-hog",
+	.description = "Background load that keeps CPUs busy for a duty cycle of every period.",
+	.versions = cpu_hog_versions,
+	.init = cpu_hog_init,
+	.run = hog_run,
+	.stop = hog_stop,
+	.exit = hog_exit,
+	.data_hdr = hog_data_hdr,
+};
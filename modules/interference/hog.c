@@ -0,0 +1,351 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "hog.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cbench/data.h>
+#include <cbench/option.h>
+
+/* Period of the duty cycle */
+#define HOG_PERIOD_NS 10000000LL
+
+static inline long long timespec_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static inline void ns_timespec(long long ns, struct timespec *ts)
+{
+	ts->tv_sec = ns / 1000000000LL;
+	ts->tv_nsec = ns % 1000000000LL;
+}
+
+static void hog_sleep_until(long long ns)
+{
+	struct timespec ts;
+
+	ns_timespec(ns, &ts);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+		;
+}
+
+static void *hog_thread(void *data)
+{
+	struct hog_thread *t = data;
+	struct hog *hog = t->hog;
+	double op_ns = 0;
+	long long start;
+	struct timespec now;
+
+	if (hog->rate > 0)
+		op_ns = 1000000000.0 * hog->nr_threads / hog->rate;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	start = timespec_ns(&now);
+
+	while (!hog->stop) {
+		long ret;
+
+		if (hog->duty > 0 && hog->duty < 100) {
+			long long in_period;
+
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			in_period = (timespec_ns(&now) - start) % HOG_PERIOD_NS;
+			if (in_period >= HOG_PERIOD_NS * hog->duty / 100) {
+				hog_sleep_until(timespec_ns(&now) - in_period
+						+ HOG_PERIOD_NS);
+				continue;
+			}
+		}
+
+		ret = hog->ops->op(hog, t);
+		if (ret < 0) {
+			t->err = 1;
+			break;
+		}
+		++t->ops;
+		t->bytes += ret;
+
+		if (op_ns) {
+			long long next = start + (long long)(t->ops * op_ns);
+
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			if (next > timespec_ns(&now))
+				hog_sleep_until(next);
+		}
+	}
+	return NULL;
+}
+
+int hog_init(struct plugin *plug, const struct hog_ops *ops, size_t size,
+		void *priv)
+{
+	const struct header *opts = plugin_get_options(plug);
+	struct hog *hog;
+	int i;
+
+	hog = calloc(1, sizeof(*hog));
+	if (!hog) {
+		free(priv);
+		return -1;
+	}
+
+	hog->ops = ops;
+	hog->plug = plug;
+	hog->size = size;
+	hog->priv = priv;
+	/* A stop may arrive before run, it must not be reset there */
+	hog->stop = 0;
+	hog->nr_threads = option_get_int32(opts, "threads");
+	hog->cpu = option_get_int32(opts, "cpu");
+	hog->rate = option_get_int32(opts, "rate");
+	hog->duty = option_get_int32(opts, "duty");
+	hog->interval_ms = option_get_int32(opts, "interval");
+	if (hog->nr_threads <= 0 || hog->interval_ms <= 0 || hog->rate < 0
+			|| hog->duty < 0 || hog->duty > 100) {
+		printf("Error: Invalid options of %s\n", plug->id->name);
+		free(priv);
+		free(hog);
+		return -1;
+	}
+
+	hog->threads = calloc(hog->nr_threads, sizeof(*hog->threads));
+	if (!hog->threads) {
+		free(priv);
+		free(hog);
+		return -1;
+	}
+
+	plugin_set_data(plug, hog);
+	for (i = 0; i != hog->nr_threads; ++i) {
+		struct hog_thread *t = &hog->threads[i];
+
+		t->hog = hog;
+		t->index = i;
+		t->fd = -1;
+		if (ops->setup && ops->setup(hog, t)) {
+			hog_exit(plug);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int hog_start_thread(struct hog *hog, struct hog_thread *t)
+{
+	pthread_attr_t attr;
+	int ret;
+
+	t->ops = 0;
+	t->bytes = 0;
+	t->err = 0;
+
+	pthread_attr_init(&attr);
+	if (hog->cpu >= 0) {
+		long nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+		cpu_set_t set;
+
+		CPU_ZERO(&set);
+		CPU_SET((hog->cpu + t->index) % nr_cpus, &set);
+		pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+	}
+	ret = pthread_create(&t->thread, &attr, hog_thread, t);
+	pthread_attr_destroy(&attr);
+	if (ret)
+		return -1;
+
+	if (pthread_getcpuclockid(t->thread, &t->clock))
+		t->clock = -1;
+	return 0;
+}
+
+/* Sum of the applied load and CPU time of all threads */
+static void hog_sample(struct hog *hog, uint64_t *ops, uint64_t *bytes,
+		double *cpu)
+{
+	int i;
+
+	*ops = 0;
+	*bytes = 0;
+	*cpu = 0;
+	for (i = 0; i != hog->nr_threads; ++i) {
+		struct hog_thread *t = &hog->threads[i];
+		struct timespec ts;
+
+		*ops += t->ops;
+		*bytes += t->bytes;
+		if (t->clock != -1 && !clock_gettime(t->clock, &ts))
+			*cpu += ts.tv_sec + ts.tv_nsec / 1000000000.0;
+	}
+}
+
+int hog_run(struct plugin *plug)
+{
+	struct hog *hog = plugin_get_data(plug);
+	struct timespec interval;
+	struct timespec now;
+	uint64_t last_ops, last_bytes;
+	double last_cpu;
+	double start, last;
+	int started;
+	int ret = 0;
+	int i;
+
+	for (started = 0; started != hog->nr_threads; ++started) {
+		if (hog_start_thread(hog, &hog->threads[started])) {
+			printf("Error: Failed to start a thread of %s\n",
+					plug->id->name);
+			hog->stop = 1;
+			ret = -1;
+			break;
+		}
+	}
+
+	ns_timespec(hog->interval_ms * 1000000LL, &interval);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	start = now.tv_sec + now.tv_nsec / 1000000000.0;
+	last = start;
+	hog_sample(hog, &last_ops, &last_bytes, &last_cpu);
+
+	while (!hog->stop) {
+		uint64_t ops, bytes;
+		double cpu;
+		double now_s;
+		double elapsed;
+		struct data *dat;
+
+		nanosleep(&interval, NULL);
+		/* The threads may be gone already, their CPU time with them */
+		if (hog->stop)
+			break;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		hog_sample(hog, &ops, &bytes, &cpu);
+		now_s = now.tv_sec + now.tv_nsec / 1000000000.0;
+		elapsed = now_s - last;
+
+		dat = data_alloc(DATA_TYPE_MONITOR, 4);
+		if (!dat) {
+			hog->stop = 1;
+			ret = -1;
+			break;
+		}
+		data_add_double(dat, now_s - start);
+		data_add_double(dat, (ops - last_ops) / elapsed);
+		data_add_double(dat, (bytes - last_bytes) / elapsed / (1 << 20));
+		data_add_double(dat, (cpu - last_cpu) / elapsed * 100);
+		plugin_add_results(plug, dat);
+
+		last = now_s;
+		last_ops = ops;
+		last_bytes = bytes;
+		last_cpu = cpu;
+	}
+
+	for (i = 0; i != started; ++i) {
+		pthread_join(hog->threads[i].thread, NULL);
+		if (hog->threads[i].err) {
+			printf("Error: Load thread of %s failed\n",
+					plug->id->name);
+			ret = -1;
+		}
+	}
+	return ret;
+}
+
+void hog_stop(struct plugin *plug)
+{
+	struct hog *hog = plugin_get_data(plug);
+
+	hog->stop = 1;
+}
+
+int hog_exit(struct plugin *plug)
+{
+	struct hog *hog = plugin_get_data(plug);
+	int i;
+
+	for (i = 0; i != hog->nr_threads; ++i) {
+		if (hog->ops->cleanup)
+			hog->ops->cleanup(hog, &hog->threads[i]);
+	}
+	free(hog->threads);
+	free(hog->priv);
+	free(hog);
+
+	plugin_set_data(plug, NULL);
+	return 0;
+}
+
+const struct header *hog_data_hdr(struct plugin *plug)
+{
+	static const struct header hdr[] = {
+		{
+			.name = "time",
+			.unit = "s",
+			.description = "Time of this measurement since the load started.",
+		}, {
+			.name = "ops",
+			.unit = "1/s",
+			.description = "Operations per second applied in this interval.",
+		}, {
+			.name = "throughput",
+			.unit = "MiB/s",
+			.description = "Memory or I/O bandwidth applied in this interval.",
+		}, {
+			.name = "cpu",
+			.unit = "%",
+			.description = "CPU time of all load threads in percent of this interval.",
+		}, {
+			/* Sentinel */
+		}
+	};
+
+	return hdr;
+}
+
+size_t hog_llc_size(void)
+{
+	FILE *f;
+	char *buf = NULL;
+	size_t buf_len = 0;
+	size_t size = 0;
+
+	f = fopen("/proc/cpuinfo", "r");
+	if (!f)
+		return 0;
+
+	while (0 < getline(&buf, &buf_len, f)) {
+		unsigned long kb;
+
+		if (sscanf(buf, "cache size : %lu KB", &kb) == 1) {
+			size = kb << 10;
+			break;
+		}
+	}
+	free(buf);
+	fclose(f);
+	return size;
+}
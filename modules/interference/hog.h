@@ -0,0 +1,79 @@
+#ifndef _INTERFERENCE_HOG_H_
+#define _INTERFERENCE_HOG_H_
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <cbench/plugin.h>
+#include <cbench/plugin_id_helper.h>
+
+struct hog;
+
+struct hog_thread {
+	pthread_t thread;
+	struct hog *hog;
+	int index;
+	clockid_t clock;
+	int err;
+
+	/* State of the load, owned by the hog_ops */
+	void *buf;
+	int fd;
+	size_t off;
+
+	/* Applied load, only written by the thread itself */
+	uint64_t ops;
+	uint64_t bytes;
+};
+
+struct hog_ops {
+	/* Prepare the state of one thread, optional */
+	int (*setup)(struct hog *hog, struct hog_thread *t);
+	/* One operation of load, returns the bytes it moved or -1 */
+	long (*op)(struct hog *hog, struct hog_thread *t);
+	void (*cleanup)(struct hog *hog, struct hog_thread *t);
+};
+
+struct hog {
+	const struct hog_ops *ops;
+	struct plugin *plug;
+	int nr_threads;
+	/* First CPU of the threads, -1 if they are not pinned */
+	int cpu;
+	/* Operations per second of all threads, 0 for no limit */
+	int rate;
+	/* Percent of each period the threads are busy, 0 for always */
+	int duty;
+	int interval_ms;
+	/* Hog specific size of the load in bytes and private data */
+	size_t size;
+	void *priv;
+	volatile int stop;
+	struct hog_thread *threads;
+};
+
+/* Options every hog understands */
+#define HOG_OPTIONS \
+	OPTION_INT32("threads", "Number of threads generating the load", NULL, 1), \
+	OPTION_INT32("cpu", "CPU of the first thread, the others are placed on the following CPUs. -1 leaves the placement to the scheduler", NULL, -1), \
+	OPTION_INT32("rate", "Operations per second of all threads together, 0 for no limit", "1/s", 0), \
+	OPTION_INT32("interval", "Interval of the monitor output", "ms", 500)
+
+/*
+ * Hogs are background plugins. The load threads start with the run function,
+ * which adds a monitor row describing the applied load every interval until
+ * the plugin is stopped. priv is freed by hog_exit, also if hog_init fails.
+ */
+int hog_init(struct plugin *plug, const struct hog_ops *ops, size_t size,
+		void *priv);
+int hog_run(struct plugin *plug);
+void hog_stop(struct plugin *plug);
+int hog_exit(struct plugin *plug);
+const struct header *hog_data_hdr(struct plugin *plug);
+
+/* Size of the last level cache in bytes from /proc/cpuinfo, 0 if unknown */
+size_t hog_llc_size(void);
+
+#endif  /* _INTERFERENCE_HOG_H_ */
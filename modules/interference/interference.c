@@ -0,0 +1,22 @@
+#include <cbench/module.h>
+#include <cbench/plugin.h>
+
+extern const struct plugin_id plugin_cpu_hog;
+extern const struct plugin_id plugin_membw_hog;
+extern const struct plugin_id plugin_cache_thrash;
+extern const struct plugin_id plugin_syscall_storm;
+extern const struct plugin_id plugin_io_hog;
+
+static const struct plugin_id *interference_plugins[] = {
+	&plugin_cpu_hog,
+	&plugin_membw_hog,
+	&plugin_cache_thrash,
+	&plugin_syscall_storm,
+	&plugin_io_hog,
+	NULL
+};
+
+static const struct module_id interference_mod = {
+	.plugins = interference_plugins,
+};
+MODULE_REGISTER(interference_mod);
@@ -0,0 +1,147 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "hog.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cbench/option.h>
+#include <cbench/plugin.h>
+#include <cbench/plugin_id_helper.h>
+#include <cbench/version.h>
+
+struct io_hog_data {
+	size_t block;
+	int sync;
+};
+
+static void io_hog_path(struct hog *hog, struct hog_thread *t, char *path,
+		size_t len)
+{
+	snprintf(path, len, "%s/io-hog.%d", plugin_get_work_dir(hog->plug),
+			t->index);
+}
+
+static int io_hog_setup(struct hog *hog, struct hog_thread *t)
+{
+	struct io_hog_data *d = hog->priv;
+	char path[4096];
+
+	t->buf = malloc(d->block);
+	if (!t->buf)
+		return -1;
+	memset(t->buf, 0xa5, d->block);
+
+	io_hog_path(hog, t, path, sizeof(path));
+	t->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (t->fd < 0) {
+		printf("Error: Could not open file %s\n", path);
+		return -1;
+	}
+	t->off = 0;
+	return 0;
+}
+
+static long io_hog_op(struct hog *hog, struct hog_thread *t)
+{
+	struct io_hog_data *d = hog->priv;
+	ssize_t written;
+
+	if (t->off + d->block > hog->size)
+		t->off = 0;
+	written = pwrite(t->fd, t->buf, d->block, t->off);
+	if (written < 0)
+		return -1;
+	t->off += written;
+	if (d->sync && fdatasync(t->fd))
+		return -1;
+	return written;
+}
+
+static void io_hog_cleanup(struct hog *hog, struct hog_thread *t)
+{
+	char path[4096];
+
+	if (t->fd >= 0) {
+		close(t->fd);
+		t->fd = -1;
+		io_hog_path(hog, t, path, sizeof(path));
+		unlink(path);
+	}
+	free(t->buf);
+	t->buf = NULL;
+}
+
+static const struct hog_ops io_hog_ops = {
+	.setup = io_hog_setup,
+	.op = io_hog_op,
+	.cleanup = io_hog_cleanup,
+};
+
+static int io_hog_init(struct plugin *plug)
+{
+	const struct header *opts = plugin_get_options(plug);
+	struct io_hog_data *d;
+	int64_t size = option_get_int64(opts, "file_size");
+	int64_t block = option_get_int64(opts, "block_size");
+
+	if (block <= 0 || size < block) {
+		printf("Error: Invalid file size %lld or block size %lld\n",
+				(long long)size, (long long)block);
+		return -1;
+	}
+	d = malloc(sizeof(*d));
+	if (!d)
+		return -1;
+	d->block = block << 10;
+	d->sync = option_get_int32(opts, "sync");
+	return hog_init(plug, &io_hog_ops, size << 10, d);
+}
+
+static struct header io_hog_options[] = {
+	HOG_OPTIONS,
+	OPTION_INT64("file_size", "Size of the file of each thread, writes wrap around at its end", "KiB", 256 << 10),
+	OPTION_INT64("block_size", "Size of every write", "KiB", 1024),
+	OPTION_BOOL("sync", "Write every block through to the device instead of only to the page cache", NULL, 0),
+	OPTION_SENTINEL
+};
+
+static struct version io_hog_versions[] = {
+	{
+		.version = "0.1",
+		.default_options = io_hog_options,
+	}, {
+		/* Sentinel */
+	}
+};
+
+const struct plugin_id plugin_io_hog = {
+	.name = "io-hog",
+	.description = "Background load that dirties the page cache, or with sync the block device, by writing files in its work directory.",
+	.versions = io_hog_versions,
+	.init = io_hog_init,
+	.run = hog_run,
+	.stop = hog_stop,
+	.exit = hog_exit,
+	.data_hdr = hog_data_hdr,
+};
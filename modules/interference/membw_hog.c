@@ -0,0 +1,97 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "hog.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cbench/option.h>
+#include <cbench/plugin.h>
+#include <cbench/plugin_id_helper.h>
+#include <cbench/version.h>
+
+/* Every thread copies the first half of its stream to the second half */
+static int membw_hog_setup(struct hog *hog, struct hog_thread *t)
+{
+	t->buf = malloc(hog->size);
+	if (!t->buf)
+		return -1;
+	memset(t->buf, t->index, hog->size);
+	return 0;
+}
+
+static long membw_hog_op(struct hog *hog, struct hog_thread *t)
+{
+	size_t half = hog->size / 2;
+
+	memcpy((char *)t->buf + half, t->buf, half);
+	return 2 * half;
+}
+
+static void membw_hog_cleanup(struct hog *hog, struct hog_thread *t)
+{
+	free(t->buf);
+	t->buf = NULL;
+}
+
+static const struct hog_ops membw_hog_ops = {
+	.setup = membw_hog_setup,
+	.op = membw_hog_op,
+	.cleanup = membw_hog_cleanup,
+};
+
+static int membw_hog_init(struct plugin *plug)
+{
+	const struct header *opts = plugin_get_options(plug);
+	int64_t size = option_get_int64(opts, "stream_size");
+
+	if (size < 2) {
+		printf("Error: Invalid stream size %lld\n", (long long)size);
+		return -1;
+	}
+	return hog_init(plug, &membw_hog_ops, size << 10, NULL);
+}
+
+static struct header membw_hog_options[] = {
+	HOG_OPTIONS,
+	OPTION_INT64("stream_size", "Memory each thread streams through, read half and written half", "KiB", 64 << 10),
+	OPTION_SENTINEL
+};
+
+static struct version membw_hog_versions[] = {
+	{
+		.version = "0.1",
+		.default_options = membw_hog_options,
+	}, {
+		/* Sentinel */
+	}
+};
+
+const struct plugin_id plugin_membw_hog = {
+	.name = "membw-hog",
+	.description = "Background load that consumes memory bandwidth by copying a stream larger than the caches.",
+	.versions = membw_hog_versions,
+	.init = membw_hog_init,
+	.run = hog_run,
+	.stop = hog_stop,
+	.exit = hog_exit,
+	.data_hdr = hog_data_hdr,
+};
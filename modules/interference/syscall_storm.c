@@ -0,0 +1,68 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "hog.h"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cbench/plugin.h>
+#include <cbench/plugin_id_helper.h>
+#include <cbench/version.h>
+
+/* getppid is never cached by the C library, every call enters the kernel */
+static long syscall_storm_op(struct hog *hog, struct hog_thread *t)
+{
+	syscall(SYS_getppid);
+	return 0;
+}
+
+static const struct hog_ops syscall_storm_ops = {
+	.op = syscall_storm_op,
+};
+
+static int syscall_storm_init(struct plugin *plug)
+{
+	return hog_init(plug, &syscall_storm_ops, 0, NULL);
+}
+
+static struct header syscall_storm_options[] = {
+	HOG_OPTIONS,
+	OPTION_SENTINEL
+};
+
+static struct version syscall_storm_versions[] = {
+	{
+		.version = "0.1",
+		.default_options = syscall_storm_options,
+	}, {
+		/* Sentinel */
+	}
+};
+
+const struct plugin_id plugin_syscall_storm = {
+	.name = "syscall-storm",
+	.description = "Background load that enters the kernel with a trivial system call as often as possible.",
+	.versions = syscall_storm_versions,
+	.init = syscall_storm_init,
+	.run = hog_run,
+	.stop = hog_stop,
+	.exit = hog_exit,
+	.data_hdr = hog_data_hdr,
+};
@@ -142,7 +142,8 @@ static struct header kernel_compile_options[] = {
 	.data = (void*)KERNEL_##maj##_##min,\
 	.nr_independent_values = 1,\
 	.default_options = kernel_compile_options,\
-	.comp_versions = kernel_comp_versions[KERNEL_##maj##_##min]\
+	.comp_versions = kernel_comp_versions[KERNEL_##maj##_##min],\
+	.downloads = kernel_downloads[KERNEL_##maj##_##min]\
 },
 
 static struct version kernel_compile_versions[] = {
@@ -1,4 +1,5 @@
 
+#include <cbench/download.h>
 #include <cbench/version.h>
 
 struct kernel_version {
@@ -33,3 +34,13 @@ __attribute__((unused)) static struct comp_version kernel_comp_versions[][2] = {
 #include "versions.h"
 };
 #undef KERNEL_VERSION
+
+#define KERNEL_VERSION(maj, min) {\
+	{ .name = "linux-" #maj "." #min ".tar.gz",\
+	  .url = CONFIG_KERNEL_MIRROR "/linux-" #maj "." #min ".tar.gz" },\
+	{ }\
+},
+__attribute__((unused)) static struct download kernel_downloads[][2] = {
+#include "versions.h"
+};
+#undef KERNEL_VERSION
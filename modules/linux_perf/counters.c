@@ -0,0 +1,484 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include <cbench/data.h>
+#include <cbench/option.h>
+#include <cbench/plugin_id_helper.h>
+#include <cbench/requirement.h>
+#include <cbench/version.h>
+#include <cbench/plugin.h>
+
+static struct requirement plugin_counters_requirements[] = {
+	{
+		.name = "perf_event_open",
+		.description = "This plugin needs the perf_event_open syscall (CONFIG_PERF_EVENTS) and a perf_event_paranoid setting that allows to count the own process.",
+		.found = 0,
+	},
+	{ }
+};
+
+static struct header plugin_counters_options[] = {
+	OPTION_BOOL("background", "Also count background plugins that are not monitors and the threads they create, e.g. load generators", NULL, 0),
+	OPTION_SENTINEL
+};
+
+static struct version plugin_counters_versions[] = {
+	{
+		.version = "0.1",
+		.requirements = plugin_counters_requirements,
+		.default_options = plugin_counters_options,
+	}, {
+		/* Sentinel */
+	}
+};
+
+static const struct {
+	const char *name;
+	const char *unit;
+	const char *description;
+	uint32_t type;
+	uint64_t config;
+} counters_events[] = {
+	{ "task_clock", "ns", "CPU time of the benchmark tasks", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+	{ "context_switches", NULL, "Context switches of the benchmark tasks", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+	{ "cpu_migrations", NULL, "Migrations of the benchmark tasks to another CPU", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS },
+	{ "page_faults", NULL, "Page faults of the benchmark tasks", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+	{ "cycles", NULL, "CPU cycles of the benchmark tasks", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+	{ "instructions", NULL, "Retired instructions of the benchmark tasks", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+	{ "cache_misses", NULL, "Last level cache misses of the benchmark tasks", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+	{ "branch_misses", NULL, "Mispredicted branches of the benchmark tasks", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+};
+
+#define NR_COUNTERS_EVENTS (sizeof(counters_events) / sizeof(counters_events[0]))
+
+/*
+ * Events that can be opened on this system, probed once by module_init. The
+ * hardware events are missing in most virtual machines. If the kernel may
+ * not be counted, all events count user space only.
+ */
+static int counters_events_avail[NR_COUNTERS_EVENTS];
+static int counters_nr_events;
+static int counters_exclude_kernel;
+static struct header counters_hdr[NR_COUNTERS_EVENTS + 1];
+
+struct counters_data {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int stop;
+
+	int background;
+
+	/* counters_nr_events counters for each counted task */
+	int *fds;
+	int nr_fds;
+	int size_fds;
+
+	/* Tasks to attach to, collected before attaching */
+	pid_t *tasks;
+	int nr_tasks;
+	int size_tasks;
+
+	int64_t vals[NR_COUNTERS_EVENTS];
+};
+
+static int counters_open(int event, pid_t tid, int disabled)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = counters_events[event].type;
+	attr.config = counters_events[event].config;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+			| PERF_FORMAT_TOTAL_TIME_RUNNING;
+	attr.disabled = disabled;
+	attr.inherit = 1;
+	attr.exclude_kernel = counters_exclude_kernel;
+	attr.exclude_hv = 1;
+
+	return syscall(__NR_perf_event_open, &attr, tid, -1, -1, 0);
+}
+
+static int counters_module_init(struct module *mod, const struct plugin_id *plug)
+{
+	int i;
+	int fd;
+
+	fd = counters_open(0, 0, 1);
+	if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+		counters_exclude_kernel = 1;
+		fd = counters_open(0, 0, 1);
+	}
+	if (fd < 0)
+		return 0;
+	close(fd);
+
+	counters_hdr[0].name = counters_events[0].name;
+	counters_hdr[0].unit = counters_events[0].unit;
+	counters_hdr[0].description = counters_events[0].description;
+	counters_events_avail[0] = 1;
+	counters_nr_events = 1;
+
+	for (i = 1; i != NR_COUNTERS_EVENTS; ++i) {
+		fd = counters_open(i, 0, 1);
+		if (fd < 0)
+			continue;
+		close(fd);
+
+		counters_hdr[counters_nr_events].name = counters_events[i].name;
+		counters_hdr[counters_nr_events].unit = counters_events[i].unit;
+		counters_hdr[counters_nr_events].description = counters_events[i].description;
+		counters_events_avail[i] = 1;
+		++counters_nr_events;
+	}
+
+	plugin_counters_requirements[0].found = 1;
+	return 0;
+}
+
+static int counters_install(struct plugin *plug)
+{
+	struct counters_data *d = malloc(sizeof(*d));
+
+	if (!d)
+		return -1;
+
+	memset(d, 0, sizeof(*d));
+	pthread_mutex_init(&d->lock, NULL);
+	pthread_cond_init(&d->cond, NULL);
+	d->background = option_get_int32(plugin_get_options(plug), "background");
+
+	if (counters_exclude_kernel)
+		printf("Note: %s counts user space only, perf_event_paranoid does not allow to count the kernel\n",
+				plug->id->name);
+
+	plugin_set_data(plug, d);
+	return 0;
+}
+
+static int counters_uninstall(struct plugin *plug)
+{
+	struct counters_data *d = plugin_get_data(plug);
+
+	pthread_cond_destroy(&d->cond);
+	pthread_mutex_destroy(&d->lock);
+	free(d->fds);
+	free(d->tasks);
+	free(d);
+
+	plugin_set_data(plug, NULL);
+	return 0;
+}
+
+static void counters_close(struct counters_data *d)
+{
+	int i;
+
+	for (i = 0; i != d->nr_fds; ++i)
+		close(d->fds[i]);
+	d->nr_fds = 0;
+}
+
+/*
+ * Open all counters for one task. The counters are inherited by the threads
+ * and processes the task creates later on. Tasks that exited in the meantime
+ * are skipped.
+ */
+static int counters_attach(struct counters_data *d, pid_t tid)
+{
+	int start = d->nr_fds;
+	int i;
+
+	if (d->nr_fds + counters_nr_events > d->size_fds) {
+		int size = d->size_fds ? d->size_fds * 2 : 64;
+		int *fds;
+
+		while (size < d->nr_fds + counters_nr_events)
+			size *= 2;
+		fds = realloc(d->fds, sizeof(*fds) * size);
+		if (!fds)
+			return -1;
+		d->fds = fds;
+		d->size_fds = size;
+	}
+
+	for (i = 0; i != NR_COUNTERS_EVENTS; ++i) {
+		int fd;
+
+		if (!counters_events_avail[i])
+			continue;
+		fd = counters_open(i, tid, 1);
+		if (fd < 0) {
+			if (errno == ESRCH) {
+				while (d->nr_fds != start)
+					close(d->fds[--d->nr_fds]);
+				return 0;
+			}
+			printf("Error: Could not open the %s counter for task %d: %s\n",
+					counters_events[i].name, (int)tid,
+					strerror(errno));
+			return -1;
+		}
+		d->fds[d->nr_fds++] = fd;
+	}
+	return 0;
+}
+
+/* Remember a task to attach to */
+static int counters_add_task(struct counters_data *d, pid_t tid)
+{
+	if (d->nr_tasks == d->size_tasks) {
+		int size = d->size_tasks ? d->size_tasks * 2 : 64;
+		pid_t *tasks = realloc(d->tasks, sizeof(*tasks) * size);
+
+		if (!tasks)
+			return -1;
+		d->tasks = tasks;
+		d->size_tasks = size;
+	}
+	d->tasks[d->nr_tasks++] = tid;
+	return 0;
+}
+
+static int counters_collect_children(struct counters_data *d, const char *path);
+
+/* All threads of a child process and their children */
+static int counters_collect_process(struct counters_data *d, pid_t pid)
+{
+	char path[96];
+	struct dirent *ent;
+	DIR *dir;
+	int ret = 0;
+
+	snprintf(path, sizeof(path), "/proc/%d/task", (int)pid);
+	dir = opendir(path);
+	if (!dir)
+		return 0;
+	while (!ret && (ent = readdir(dir))) {
+		pid_t tid = atoi(ent->d_name);
+
+		if (tid <= 0)
+			continue;
+		ret = counters_add_task(d, tid);
+		if (ret)
+			break;
+		snprintf(path, sizeof(path), "/proc/%d/task/%d/children",
+				(int)pid, (int)tid);
+		ret = counters_collect_children(d, path);
+	}
+	closedir(dir);
+	return ret;
+}
+
+static int counters_collect_children(struct counters_data *d, const char *path)
+{
+	FILE *f = fopen(path, "r");
+	int pid;
+	int ret = 0;
+
+	if (!f)
+		return 0;
+	while (!ret && fscanf(f, "%d", &pid) == 1)
+		ret = counters_collect_process(d, pid);
+	fclose(f);
+	return ret;
+}
+
+/*
+ * Threads of the suite that are counted: the threads executing the counted
+ * plugins and the threads they created. Threads of the core, of monitors and,
+ * without the background option, of background plugins are not counted.
+ */
+static int counters_tracked(struct plugin *plug, int background, pid_t tid)
+{
+	struct plugin *owner = plugin_thread_owner(plug, tid);
+
+	if (!owner || owner == plug || owner->id->monitor)
+		return 0;
+	return owner->primary || background;
+}
+
+/*
+ * The counters are attached before the benchmarks start their run, so they
+ * include the first instructions and forks of the run function. All tasks
+ * are collected before attaching, a task created by an already counted task
+ * inherits its counters and must not be attached twice.
+ */
+static int counters_run_pre(struct plugin *plug)
+{
+	struct counters_data *d = plugin_get_data(plug);
+	struct dirent *ent;
+	DIR *dir;
+	int ret = 0;
+	int i;
+
+	if (!counters_nr_events) {
+		printf("Error: perf_event_open is not usable, %s can not count anything\n",
+				plug->id->name);
+		return -1;
+	}
+
+	pthread_mutex_lock(&d->lock);
+	d->stop = 0;
+	pthread_mutex_unlock(&d->lock);
+
+	dir = opendir("/proc/self/task");
+	if (!dir) {
+		printf("Error: Could not open /proc/self/task\n");
+		return -1;
+	}
+	d->nr_tasks = 0;
+	while (!ret && (ent = readdir(dir))) {
+		pid_t tid = atoi(ent->d_name);
+		char path[96];
+
+		if (tid <= 0 || !counters_tracked(plug, d->background, tid))
+			continue;
+		ret = counters_add_task(d, tid);
+		if (ret)
+			break;
+		snprintf(path, sizeof(path), "/proc/self/task/%d/children",
+				(int)tid);
+		ret = counters_collect_children(d, path);
+	}
+	closedir(dir);
+
+	for (i = 0; !ret && i != d->nr_tasks; ++i)
+		ret = counters_attach(d, d->tasks[i]);
+	if (ret) {
+		counters_close(d);
+		return -1;
+	}
+
+	for (i = 0; i != d->nr_fds; ++i)
+		ioctl(d->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+	return 0;
+}
+
+static int counters_run(struct plugin *plug)
+{
+	struct counters_data *d = plugin_get_data(plug);
+
+	pthread_mutex_lock(&d->lock);
+	while (!d->stop)
+		pthread_cond_wait(&d->cond, &d->lock);
+	pthread_mutex_unlock(&d->lock);
+	return 0;
+}
+
+static void counters_stop(struct plugin *plug)
+{
+	struct counters_data *d = plugin_get_data(plug);
+
+	pthread_mutex_lock(&d->lock);
+	d->stop = 1;
+	pthread_cond_signal(&d->cond);
+	pthread_mutex_unlock(&d->lock);
+}
+
+static int counters_run_post(struct plugin *plug)
+{
+	struct counters_data *d = plugin_get_data(plug);
+	int ret = 0;
+	int i;
+
+	for (i = 0; i != d->nr_fds; ++i)
+		ioctl(d->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+	memset(d->vals, 0, sizeof(d->vals));
+	for (i = 0; i != d->nr_fds; ++i) {
+		/* value, time enabled, time running */
+		uint64_t buf[3];
+		double val;
+
+		if (read(d->fds[i], buf, sizeof(buf)) != sizeof(buf)) {
+			printf("Error: Could not read a perf counter\n");
+			ret = -1;
+			break;
+		}
+
+		/* Scale counters that were multiplexed with other events */
+		val = buf[0];
+		if (buf[2] && buf[2] < buf[1])
+			val = val * buf[1] / buf[2];
+		d->vals[i % counters_nr_events] += val;
+	}
+
+	counters_close(d);
+	return ret;
+}
+
+static int counters_parse_results(struct plugin *plug)
+{
+	struct counters_data *d = plugin_get_data(plug);
+	struct data *dat;
+	int i;
+
+	dat = data_alloc(DATA_TYPE_RESULT, counters_nr_events);
+	if (!dat)
+		return -1;
+
+	for (i = 0; i != counters_nr_events; ++i)
+		data_add_int64(dat, d->vals[i]);
+	plugin_add_results(plug, dat);
+	return 0;
+}
+
+static int counters_exit(struct plugin *plug)
+{
+	struct counters_data *d = plugin_get_data(plug);
+
+	counters_close(d);
+	return 0;
+}
+
+static const struct header *counters_data_hdr(struct plugin *plug)
+{
+	return counters_hdr;
+}
+
+const struct plugin_id plugin_counters = {
+	.name = "counters",
+	.description = "Counts software and, where available, hardware perf events of the benchmarks in the group for each run. The counters follow the threads and child processes of the benchmarks. Hardware events that can not be opened, e.g. in virtual machines, are left out.",
+	.versions = plugin_counters_versions,
+	.module_init = counters_module_init,
+	.install = counters_install,
+	.uninstall = counters_uninstall,
+	.run_pre = counters_run_pre,
+	.run = counters_run,
+	.stop = counters_stop,
+	.run_post = counters_run_post,
+	.parse_results = counters_parse_results,
+	.exit = counters_exit,
+	.data_hdr = counters_data_hdr,
+	.role = PLUGIN_ROLE_BACKGROUND,
+};
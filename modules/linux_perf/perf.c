@@ -9,10 +9,12 @@
 
 extern const struct plugin_id plugin_hackbench;
 extern const struct plugin_id plugin_sched_pipe;
+extern const struct plugin_id plugin_counters;
 
 static const struct plugin_id *plugins[] = {
 	&plugin_hackbench,
 	&plugin_sched_pipe,
+	&plugin_counters,
 	NULL
 };
 
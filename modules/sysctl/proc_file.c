@@ -0,0 +1,276 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "proc_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PROC_FILE_INITIAL_SIZE 4096
+
+int proc_file_open(struct proc_file *pf, const char *path)
+{
+	pf->path = path;
+	pf->len = 0;
+	pf->size = PROC_FILE_INITIAL_SIZE;
+	pf->buf = malloc(pf->size);
+	if (!pf->buf)
+		return -1;
+
+	pf->fd = open(path, O_RDONLY);
+	if (pf->fd < 0) {
+		printf("Error: Could not open file %s\n", path);
+		free(pf->buf);
+		pf->buf = NULL;
+		return -1;
+	}
+
+	/* Size the buffer for the first read */
+	if (proc_file_read(pf)) {
+		proc_file_close(pf);
+		return -1;
+	}
+	return 0;
+}
+
+int proc_file_read(struct proc_file *pf)
+{
+	ssize_t ret;
+
+	while (1) {
+		char *buf;
+
+		ret = pread(pf->fd, pf->buf, pf->size, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			printf("Error: Could not read file %s\n", pf->path);
+			return -1;
+		}
+		/* One byte is left for the terminator, a full buffer may be cut */
+		if ((size_t)ret < pf->size)
+			break;
+
+		buf = realloc(pf->buf, pf->size * 2);
+		if (!buf)
+			return -1;
+		pf->buf = buf;
+		pf->size *= 2;
+	}
+	pf->len = ret;
+	pf->buf[ret] = '\0';
+	return 0;
+}
+
+int proc_file_read_path(struct proc_file *pf, const char *path)
+{
+	int ret;
+
+	if (!pf->buf) {
+		pf->size = PROC_FILE_INITIAL_SIZE;
+		pf->buf = malloc(pf->size);
+		if (!pf->buf)
+			return -1;
+	}
+
+	pf->path = path;
+	pf->fd = open(path, O_RDONLY);
+	if (pf->fd < 0)
+		return -1;
+
+	ret = proc_file_read(pf);
+	close(pf->fd);
+	pf->fd = -1;
+	return ret;
+}
+
+void proc_file_close(struct proc_file *pf)
+{
+	if (pf->fd >= 0)
+		close(pf->fd);
+	pf->fd = -1;
+	free(pf->buf);
+	pf->buf = NULL;
+}
+
+int proc_names_add(struct proc_names *pn, const char *name, int len)
+{
+	char *copy;
+
+	if (pn->nr == pn->size) {
+		int size = pn->size ? pn->size * 2 : 16;
+		const char **names = realloc(pn->names, sizeof(*names) * size);
+		int *lens;
+
+		if (!names)
+			return -1;
+		pn->names = names;
+		lens = realloc(pn->lens, sizeof(*lens) * size);
+		if (!lens)
+			return -1;
+		pn->lens = lens;
+		pn->size = size;
+	}
+
+	copy = malloc(len + 1);
+	if (!copy)
+		return -1;
+	memcpy(copy, name, len);
+	copy[len] = '\0';
+
+	pn->names[pn->nr] = copy;
+	pn->lens[pn->nr] = len;
+	++pn->nr;
+	return 0;
+}
+
+void proc_names_free(struct proc_names *pn)
+{
+	int i;
+
+	for (i = 0; i != pn->nr; ++i)
+		free((char *)pn->names[i]);
+	free(pn->names);
+	free(pn->lens);
+	memset(pn, 0, sizeof(*pn));
+}
+
+int proc_match_list(const char *list, const char *name, int len)
+{
+	const char *p = list;
+	int has_include = 0;
+	int match = 0;
+
+	while (*p) {
+		const char *end = strchr(p, ',');
+		int exclude = 0;
+		int plen;
+		int m;
+
+		if (!end)
+			end = p + strlen(p);
+		if (*p == '!') {
+			exclude = 1;
+			++p;
+		}
+		plen = end - p;
+
+		if (plen && p[plen - 1] == '*')
+			m = plen - 1 <= len && !strncmp(p, name, plen - 1);
+		else
+			m = plen == len && !strncmp(p, name, len);
+
+		if (exclude && m)
+			return 0;
+		if (!exclude) {
+			has_include = 1;
+			match |= m;
+		}
+
+		p = *end ? end + 1 : end;
+	}
+	return match || !has_include;
+}
+
+static struct proc_filter *proc_filter_create(const struct proc_names *pn,
+		const char *list, const struct header *fields, int nr_fields)
+{
+	struct proc_filter *f = calloc(1, sizeof(*f));
+	int per_name = nr_fields ? nr_fields : 1;
+	int n = 1;
+	int i, j;
+
+	if (!f)
+		return NULL;
+	f->list = strdup(list);
+	f->sel = malloc(sizeof(*f->sel) * (pn->nr + 1));
+	f->hdr = calloc(pn->nr * per_name + 2, sizeof(*f->hdr));
+	if (nr_fields)
+		f->hdr_names = malloc(pn->nr * nr_fields * 64 + 1);
+	if (!f->list || !f->sel || !f->hdr || (nr_fields && !f->hdr_names)) {
+		proc_filter_free(&f);
+		return NULL;
+	}
+
+	f->hdr[0].name = "time";
+	f->hdr[0].unit = "s";
+	f->hdr[0].description = "Time of this measurement.";
+
+	for (i = 0; i != pn->nr; ++i) {
+		if (!proc_match_list(list, pn->names[i], pn->lens[i]))
+			continue;
+		f->sel[f->nr++] = i;
+
+		if (!nr_fields) {
+			f->hdr[n++].name = pn->names[i];
+			continue;
+		}
+		for (j = 0; j != nr_fields; ++j) {
+			char *name = f->hdr_names + (n - 1) * 64;
+
+			snprintf(name, 64, "%s_%s", pn->names[i], fields[j].name);
+			f->hdr[n] = fields[j];
+			f->hdr[n++].name = name;
+		}
+	}
+
+	if (!f->nr)
+		printf("Error: Nothing matches '%s'\n", list);
+
+	return f;
+}
+
+struct proc_filter *proc_filter_get(struct proc_filter **cache,
+		const struct proc_names *pn, const char *list,
+		const struct header *fields, int nr_fields)
+{
+	struct proc_filter *f;
+
+	if (!list)
+		list = "";
+
+	for (f = *cache; f; f = f->next)
+		if (!strcmp(f->list, list))
+			return f;
+
+	f = proc_filter_create(pn, list, fields, nr_fields);
+	if (!f)
+		return NULL;
+	f->next = *cache;
+	*cache = f;
+	return f;
+}
+
+void proc_filter_free(struct proc_filter **cache)
+{
+	while (*cache) {
+		struct proc_filter *f = *cache;
+
+		*cache = f->next;
+		free(f->list);
+		free(f->sel);
+		free(f->hdr);
+		free(f->hdr_names);
+		free(f);
+	}
+}
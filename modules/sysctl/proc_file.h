@@ -0,0 +1,156 @@
+#ifndef _SYSCTL_PROC_FILE_H_
+#define _SYSCTL_PROC_FILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <cbench/data.h>
+
+/*
+ * A /proc file that stays open and is read with pread into a buffer that
+ * only grows, so monitors sampling it do not allocate once the buffer fits.
+ * After proc_file_read, buf holds the NUL terminated content.
+ */
+struct proc_file {
+	const char *path;
+	int fd;
+	char *buf;
+	size_t size;
+	size_t len;
+};
+
+int proc_file_open(struct proc_file *pf, const char *path);
+int proc_file_read(struct proc_file *pf);
+void proc_file_close(struct proc_file *pf);
+
+/*
+ * Read a file that is not kept open, e.g. of a task that may be gone. The
+ * buffer of pf, set up by proc_file_init, is kept for the next one and freed
+ * with proc_file_close. Files that cannot be opened fail silently.
+ */
+int proc_file_read_path(struct proc_file *pf, const char *path);
+
+static inline void proc_file_init(struct proc_file *pf)
+{
+	memset(pf, 0, sizeof(*pf));
+	pf->fd = -1;
+}
+
+static inline int proc_is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+/* Parse the unsigned integer after blanks at p, NULL if there is none */
+static inline const char *proc_scan_u64(const char *p, uint64_t *val)
+{
+	uint64_t v = 0;
+
+	while (*p == ' ' || *p == '\t')
+		++p;
+	if (!proc_is_digit(*p))
+		return NULL;
+	while (proc_is_digit(*p))
+		v = v * 10 + (*p++ - '0');
+	*val = v;
+	return p;
+}
+
+/* Parse the signed integer after blanks at p, NULL if there is none */
+static inline const char *proc_scan_s64(const char *p, int64_t *val)
+{
+	uint64_t v;
+	int neg = 0;
+
+	while (*p == ' ' || *p == '\t')
+		++p;
+	if (*p == '-') {
+		neg = 1;
+		++p;
+	}
+	p = proc_scan_u64(p, &v);
+	if (p)
+		*val = neg ? -(int64_t)v : (int64_t)v;
+	return p;
+}
+
+/* Start of the line after p, NULL at the end of the buffer */
+static inline const char *proc_next_line(const char *p)
+{
+	while (*p && *p != '\n')
+		++p;
+	return *p ? p + 1 : NULL;
+}
+
+/* Start of the word after blanks at p and its length in len */
+static inline const char *proc_scan_word(const char *p, int *len)
+{
+	const char *end;
+
+	while (*p == ' ' || *p == '\t')
+		++p;
+	for (end = p; *end && *end != ' ' && *end != '\t' && *end != '\n'; ++end)
+		;
+	*len = end - p;
+	return p;
+}
+
+/*
+ * Names found in a /proc file when the module is loaded, e.g. the devices
+ * of /proc/diskstats. The kernel prints them in a fixed order, so lookups
+ * start at the name expected next.
+ */
+struct proc_names {
+	int nr;
+	int size;
+	const char **names;
+	int *lens;
+};
+
+int proc_names_add(struct proc_names *pn, const char *name, int len);
+void proc_names_free(struct proc_names *pn);
+
+/* Index of the name, next is the index expected. -1 if it is unknown */
+static inline int proc_names_find(const struct proc_names *pn,
+		const char *name, int len, int next)
+{
+	int i;
+
+	if (next < pn->nr && pn->lens[next] == len
+			&& !memcmp(pn->names[next], name, len))
+		return next;
+	for (i = 0; i != pn->nr; ++i)
+		if (pn->lens[i] == len && !memcmp(pn->names[i], name, len))
+			return i;
+	return -1;
+}
+
+/*
+ * Does the name match the comma separated list of patterns. A trailing '*'
+ * matches a prefix, a leading '!' excludes the names matching the rest. An
+ * empty list or one with only exclusions matches all other names.
+ */
+int proc_match_list(const char *list, const char *name, int len);
+
+/*
+ * The names selected by a filter option and the data header for them. The
+ * header has a time column followed by NAME_FIELD for every field of every
+ * selected name, or by the names themselves if there are no fields. Plugins
+ * with the same option share one, they live until proc_filter_free.
+ */
+struct proc_filter {
+	char *list;
+	int nr;
+	int *sel;
+	struct header *hdr;
+	char *hdr_names;
+	struct proc_filter *next;
+};
+
+struct proc_filter *proc_filter_get(struct proc_filter **cache,
+		const struct proc_names *pn, const char *list,
+		const struct header *fields, int nr_fields);
+void proc_filter_free(struct proc_filter **cache);
+
+#endif  /* _SYSCTL_PROC_FILE_H_ */
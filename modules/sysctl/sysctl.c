@@ -30,6 +30,12 @@ extern const struct plugin_id plugin_swap_reset;
 extern const struct plugin_id plugin_stat;
 extern const struct plugin_id plugin_meminfo;
 extern const struct plugin_id plugin_schedstat;
+extern const struct plugin_id plugin_vmstat;
+extern const struct plugin_id plugin_psi;
+extern const struct plugin_id plugin_diskstats;
+extern const struct plugin_id plugin_netdev;
+extern const struct plugin_id plugin_interrupts;
+extern const struct plugin_id plugin_process;
 
 static const struct plugin_id *plugins[] = {
 	&plugin_drop_caches,
@@ -37,6 +43,12 @@ static const struct plugin_id *plugins[] = {
 	&plugin_stat,
 	&plugin_meminfo,
 	&plugin_schedstat,
+	&plugin_vmstat,
+	&plugin_psi,
+	&plugin_diskstats,
+	&plugin_netdev,
+	&plugin_interrupts,
+	&plugin_process,
 	NULL
 };
 
@@ -0,0 +1,366 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cbench/data.h>
+#include <cbench/option.h>
+#include <cbench/plugin_id_helper.h>
+#include <cbench/requirement.h>
+#include <cbench/version.h>
+#include <cbench/plugin.h>
+
+#include "proc_file.h"
+
+static const char monitor_diskstats_path[] = "/proc/diskstats";
+
+static struct requirement plugin_monitor_diskstats_requirements[] = {
+	{
+		.name = monitor_diskstats_path,
+		.description = "This plugin uses /proc/diskstats to monitor the system.",
+		.found = 0,
+	},
+	{ }
+};
+
+static struct header plugin_monitor_diskstats_options[] = {
+	OPTION_STR("devices", "Comma separated list of the block devices to monitor, a trailing '*' matches all devices with that prefix, a leading '!' excludes devices. Empty monitors all devices", NULL, "!loop*,!ram*"),
+	OPTION_SENTINEL
+};
+
+static struct version plugin_monitor_diskstats_versions[] = {
+	{
+		.version = "0.1",
+		.requirements = plugin_monitor_diskstats_requirements,
+		.default_options = plugin_monitor_diskstats_options,
+	}, {
+		/* Sentinel */
+	}
+};
+
+/* Values of a device line after the name */
+enum monitor_diskstats_line {
+	DISKSTATS_READS,
+	DISKSTATS_READS_MERGED,
+	DISKSTATS_SECTORS_READ,
+	DISKSTATS_READ_TICKS,
+	DISKSTATS_WRITES,
+	DISKSTATS_WRITES_MERGED,
+	DISKSTATS_SECTORS_WRITTEN,
+	DISKSTATS_WRITE_TICKS,
+	DISKSTATS_IN_FLIGHT,
+	DISKSTATS_IO_TICKS,
+	NR_DISKSTATS_LINE,
+};
+
+/* Values stored and exported for every device */
+enum monitor_diskstats_field {
+	DISK_READS,
+	DISK_READ_BYTES,
+	DISK_WRITES,
+	DISK_WRITE_BYTES,
+	DISK_IN_FLIGHT,
+	DISK_IO_TICKS,
+	NR_DISK_FIELDS,
+};
+
+static const struct header monitor_diskstats_fields[NR_DISK_FIELDS] = {
+	{
+		.name = "reads",
+		.description = "Reads completed since the previous measurement.",
+	}, {
+		.name = "read_bytes",
+		.unit = "B",
+		.description = "Bytes read since the previous measurement.",
+	}, {
+		.name = "writes",
+		.description = "Writes completed since the previous measurement.",
+	}, {
+		.name = "write_bytes",
+		.unit = "B",
+		.description = "Bytes written since the previous measurement.",
+	}, {
+		.name = "in_flight",
+		.description = "Number of IOs currently in progress.",
+	}, {
+		.name = "io_ticks",
+		.unit = "ms",
+		.description = "Time this device was busy since the previous measurement.",
+	},
+};
+
+/* Devices found when the module is loaded */
+static struct proc_names monitor_diskstats_devs;
+static struct proc_filter *monitor_diskstats_filters;
+
+static const struct header monitor_diskstats_time_hdr[] = {
+	{
+		.name = "time",
+		.unit = "s",
+		.description = "Time of this measurement.",
+	}, {
+		/* Sentinel */
+	}
+};
+
+struct monitor_diskstats_data {
+	struct proc_file file;
+	int first;
+	const struct proc_filter *filter;
+
+	double start_time;
+	/* NR_DISK_FIELDS values of every device, now and at the previous sample */
+	uint64_t *values;
+	uint64_t *prev;
+};
+
+static const struct proc_filter *monitor_diskstats_get_filter(struct plugin *plug)
+{
+	return proc_filter_get(&monitor_diskstats_filters,
+			&monitor_diskstats_devs,
+			option_get_str(plugin_get_options(plug), "devices"),
+			monitor_diskstats_fields, NR_DISK_FIELDS);
+}
+
+/* Name of the device in a line, after the major and minor number */
+static const char *monitor_diskstats_name(const char *p, int *len)
+{
+	uint64_t discard;
+
+	p = proc_scan_u64(p, &discard);
+	if (p)
+		p = proc_scan_u64(p, &discard);
+	if (!p)
+		return NULL;
+	p = proc_scan_word(p, len);
+	return *len ? p : NULL;
+}
+
+static int monitor_diskstats_read_devs(void)
+{
+	struct proc_file pf;
+	const char *p;
+
+	if (proc_file_open(&pf, monitor_diskstats_path))
+		return -1;
+
+	for (p = pf.buf; p && *p; p = proc_next_line(p)) {
+		int len;
+		const char *name = monitor_diskstats_name(p, &len);
+
+		if (name && proc_names_add(&monitor_diskstats_devs, name, len)) {
+			proc_file_close(&pf);
+			proc_names_free(&monitor_diskstats_devs);
+			return -1;
+		}
+	}
+
+	proc_file_close(&pf);
+	return 0;
+}
+
+static int monitor_diskstats_install(struct plugin *plug)
+{
+	int nr = monitor_diskstats_devs.nr * NR_DISK_FIELDS;
+	struct monitor_diskstats_data *d = calloc(1, sizeof(*d));
+
+	if (!d)
+		return -1;
+
+	d->values = calloc(2 * nr + 1, sizeof(*d->values));
+	if (!d->values || proc_file_open(&d->file, monitor_diskstats_path)) {
+		free(d->values);
+		free(d);
+		return -1;
+	}
+	d->prev = d->values + nr;
+
+	plugin_set_data(plug, d);
+
+	return 0;
+}
+
+static int monitor_diskstats_uninstall(struct plugin *plug)
+{
+	struct monitor_diskstats_data *d = plugin_get_data(plug);
+
+	proc_file_close(&d->file);
+	free(d->values);
+	free(d);
+
+	plugin_set_data(plug, NULL);
+	return 0;
+}
+
+static int monitor_diskstats_init(struct plugin *plug)
+{
+	struct monitor_diskstats_data *d = plugin_get_data(plug);
+
+	d->first = 1;
+	d->filter = monitor_diskstats_get_filter(plug);
+	if (!d->filter)
+		return -1;
+	return 0;
+}
+
+/* One pass over the file, devices that appeared after loading are skipped */
+static int monitor_diskstats_get(struct plugin *plug)
+{
+	struct monitor_diskstats_data *d = plugin_get_data(plug);
+	const char *p;
+	int next = 0;
+
+	if (proc_file_read(&d->file))
+		return -1;
+
+	for (p = d->file.buf; p && *p; p = proc_next_line(p)) {
+		uint64_t line[NR_DISKSTATS_LINE];
+		uint64_t *v;
+		const char *name;
+		const char *q;
+		int len;
+		int dev;
+		int i;
+
+		name = monitor_diskstats_name(p, &len);
+		if (!name)
+			continue;
+		dev = proc_names_find(&monitor_diskstats_devs, name, len, next);
+		if (dev < 0)
+			continue;
+		next = dev + 1;
+
+		q = name + len;
+		for (i = 0; i != NR_DISKSTATS_LINE && q; ++i)
+			q = proc_scan_u64(q, &line[i]);
+		if (!q)
+			continue;
+
+		v = &d->values[dev * NR_DISK_FIELDS];
+		v[DISK_READS] = line[DISKSTATS_READS];
+		v[DISK_READ_BYTES] = line[DISKSTATS_SECTORS_READ] * 512;
+		v[DISK_WRITES] = line[DISKSTATS_WRITES];
+		v[DISK_WRITE_BYTES] = line[DISKSTATS_SECTORS_WRITTEN] * 512;
+		v[DISK_IN_FLIGHT] = line[DISKSTATS_IN_FLIGHT];
+		v[DISK_IO_TICKS] = line[DISKSTATS_IO_TICKS];
+	}
+
+	return 0;
+}
+
+static int monitor_diskstats_mon(struct plugin *plug)
+{
+	struct monitor_diskstats_data *d = plugin_get_data(plug);
+	const struct proc_filter *f = d->filter;
+	struct data *dat;
+	int ret;
+	struct timespec time;
+	double now;
+	int i, j;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	ret = monitor_diskstats_get(plug);
+	if (ret)
+		return ret;
+
+	dat = data_alloc(DATA_TYPE_MONITOR, f->nr * NR_DISK_FIELDS + 1);
+	if (!dat)
+		return -1;
+
+	now = time.tv_sec + time.tv_nsec / 1000000000.0;
+
+	if (d->first) {
+		memcpy(d->prev, d->values, sizeof(*d->values)
+				* monitor_diskstats_devs.nr * NR_DISK_FIELDS);
+		d->start_time = now;
+		d->first = 0;
+	}
+
+	now -= d->start_time;
+
+	data_add_double(dat, now);
+	for (i = 0; i != f->nr; ++i) {
+		uint64_t *v = &d->values[f->sel[i] * NR_DISK_FIELDS];
+		uint64_t *prev = &d->prev[f->sel[i] * NR_DISK_FIELDS];
+
+		for (j = 0; j != NR_DISK_FIELDS; ++j) {
+			if (j == DISK_IN_FLIGHT)
+				data_add_int64(dat, v[j]);
+			else
+				data_add_int64(dat, v[j] - prev[j]);
+		}
+	}
+
+	memcpy(d->prev, d->values, sizeof(*d->values) * monitor_diskstats_devs.nr
+			* NR_DISK_FIELDS);
+
+	plugin_add_results(plug, dat);
+
+	return 0;
+}
+
+static const struct header *monitor_diskstats_data_hdr(struct plugin *plug)
+{
+	const struct proc_filter *f = monitor_diskstats_get_filter(plug);
+
+	if (!f)
+		return monitor_diskstats_time_hdr;
+	return f->hdr;
+}
+
+static int monitor_diskstats_mod_init(struct module *mod,
+				      const struct plugin_id *plug)
+{
+	if (access(monitor_diskstats_path, F_OK | R_OK))
+		return 0;
+
+	plugin_monitor_diskstats_requirements[0].found = 1;
+	if (monitor_diskstats_read_devs())
+		printf("Error: Failed to parse the devices of %s\n",
+				monitor_diskstats_path);
+
+	return 0;
+}
+
+static void monitor_diskstats_mod_exit(struct module *mod,
+				       const struct plugin_id *plug)
+{
+	proc_filter_free(&monitor_diskstats_filters);
+	proc_names_free(&monitor_diskstats_devs);
+}
+
+const struct plugin_id plugin_diskstats = {
+	.name = "monitor-diskstats",
+	.description = "Monitor plugin to keep track of the block device IO shown in /proc/diskstats.",
+	.module_init = monitor_diskstats_mod_init,
+	.module_exit = monitor_diskstats_mod_exit,
+	.install = monitor_diskstats_install,
+	.uninstall = monitor_diskstats_uninstall,
+	.init = monitor_diskstats_init,
+	.monitor = monitor_diskstats_mon,
+	.versions = plugin_monitor_diskstats_versions,
+	.data_hdr = monitor_diskstats_data_hdr,
+};
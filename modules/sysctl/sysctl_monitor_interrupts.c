@@ -0,0 +1,517 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cbench/data.h>
+#include <cbench/option.h>
+#include <cbench/plugin_id_helper.h>
+#include <cbench/requirement.h>
+#include <cbench/version.h>
+#include <cbench/plugin.h>
+
+#include "proc_file.h"
+
+static const char monitor_interrupts_path[] = "/proc/interrupts";
+static const char monitor_softirqs_path[] = "/proc/softirqs";
+
+static struct requirement plugin_monitor_interrupts_requirements[] = {
+	{
+		.name = monitor_interrupts_path,
+		.description = "This plugin uses /proc/interrupts to monitor the system.",
+		.found = 0,
+	}, {
+		.name = monitor_softirqs_path,
+		.description = "This plugin uses /proc/softirqs to monitor the system.",
+		.found = 0,
+	},
+	{ }
+};
+
+static struct header plugin_monitor_interrupts_options[] = {
+	OPTION_INT32("top", "Number of sources with the most interrupts on one CPU that are summarized as results of every run", NULL, 10),
+	OPTION_SENTINEL
+};
+
+static struct version plugin_monitor_interrupts_versions[] = {
+	{
+		.version = "0.1",
+		.requirements = plugin_monitor_interrupts_requirements,
+		.default_options = plugin_monitor_interrupts_options,
+	}, {
+		/* Sentinel */
+	}
+};
+
+/*
+ * One of the files. Sources are added when they are first seen. Each source
+ * has a counter for every possible CPU and one for counters that are not per
+ * CPU, like ERR, reported as CPU -1.
+ */
+struct monitor_irq_file {
+	const char *path;
+	const char *prefix;
+	struct proc_file file;
+
+	struct proc_names keys;
+	char **labels;
+	int size;
+
+	/* Value at the last sample and sum of the changes in this run */
+	uint64_t *prev;
+	uint64_t *total;
+
+	/* CPU of every value column, from the first line, and their values */
+	int *col_cpu;
+	uint64_t *vals;
+	int nr_cols;
+};
+
+#define NR_IRQ_FILES 2
+
+struct monitor_interrupts_data {
+	struct monitor_irq_file files[NR_IRQ_FILES];
+	int first;
+
+	double start_time;
+	double last_time;
+};
+
+/* Every possible CPU, the last counter of every source is for all CPUs */
+static int monitor_interrupts_nr_cpus;
+#define IRQ_SLOTS (monitor_interrupts_nr_cpus + 1)
+
+enum monitor_interrupts_column {
+	IRQ_COL_TIME,
+	IRQ_COL_SOURCE,
+	IRQ_COL_CPU,
+	IRQ_COL_COUNT,
+	NR_IRQ_COLUMNS,
+};
+
+static void monitor_irq_file_free(struct monitor_irq_file *f)
+{
+	int i;
+
+	proc_file_close(&f->file);
+	for (i = 0; i != f->keys.nr; ++i)
+		free(f->labels[i]);
+	proc_names_free(&f->keys);
+	free(f->labels);
+	free(f->prev);
+	free(f->total);
+	free(f->col_cpu);
+	free(f->vals);
+}
+
+static int monitor_irq_file_open(struct monitor_irq_file *f, const char *path,
+		const char *prefix)
+{
+	memset(f, 0, sizeof(*f));
+	f->path = path;
+	f->prefix = prefix;
+	f->file.fd = -1;
+
+	f->col_cpu = malloc(sizeof(*f->col_cpu) * monitor_interrupts_nr_cpus);
+	f->vals = malloc(sizeof(*f->vals) * monitor_interrupts_nr_cpus);
+	if (!f->col_cpu || !f->vals || proc_file_open(&f->file, path)) {
+		monitor_irq_file_free(f);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Label of a new source. Numbered interrupts get the device name at the end
+ * of the line, e.g. irq28/virtio0-config.
+ */
+static char *monitor_irq_label(struct monitor_irq_file *f, const char *key,
+		int len, const char *line)
+{
+	const char *end = line;
+	const char *dev;
+	char *label;
+
+	if (!proc_is_digit(key[0])) {
+		label = malloc(strlen(f->prefix) + len + 1);
+		if (label)
+			sprintf(label, "%s%.*s", f->prefix, len, key);
+		return label;
+	}
+
+	while (*end && *end != '\n')
+		++end;
+	while (end > line && end[-1] == ' ')
+		--end;
+	for (dev = end; dev > line && dev[-1] != ' '; --dev)
+		;
+
+	label = malloc(len + (end - dev) + 5);
+	if (label)
+		sprintf(label, "irq%.*s/%.*s", len, key, (int)(end - dev), dev);
+	return label;
+}
+
+static int monitor_irq_add_source(struct monitor_irq_file *f, const char *key,
+		int len, const char *line)
+{
+	char *label;
+
+	if (f->keys.nr == f->size) {
+		int size = f->size ? f->size * 2 : 32;
+		char **labels = realloc(f->labels, sizeof(*labels) * size);
+		uint64_t *prev;
+		uint64_t *total;
+
+		if (!labels)
+			return -1;
+		f->labels = labels;
+		prev = realloc(f->prev, sizeof(*prev) * size * IRQ_SLOTS);
+		if (!prev)
+			return -1;
+		f->prev = prev;
+		total = realloc(f->total, sizeof(*total) * size * IRQ_SLOTS);
+		if (!total)
+			return -1;
+		f->total = total;
+		f->size = size;
+	}
+
+	label = monitor_irq_label(f, key, len, line);
+	if (!label || proc_names_add(&f->keys, key, len)) {
+		free(label);
+		return -1;
+	}
+	f->labels[f->keys.nr - 1] = label;
+	memset(&f->prev[(f->keys.nr - 1) * IRQ_SLOTS], 0,
+			sizeof(*f->prev) * IRQ_SLOTS);
+	memset(&f->total[(f->keys.nr - 1) * IRQ_SLOTS], 0,
+			sizeof(*f->total) * IRQ_SLOTS);
+	return 0;
+}
+
+/* The CPUn columns of the first line */
+static void monitor_irq_parse_cpus(struct monitor_irq_file *f, const char *p)
+{
+	f->nr_cols = 0;
+	while (f->nr_cols != monitor_interrupts_nr_cpus) {
+		uint64_t cpu;
+		int len;
+
+		p = proc_scan_word(p, &len);
+		if (len < 4 || strncmp(p, "CPU", 3))
+			break;
+		if (!proc_scan_u64(p + 3, &cpu) || cpu >= monitor_interrupts_nr_cpus)
+			break;
+		f->col_cpu[f->nr_cols++] = cpu;
+		p += len;
+	}
+}
+
+static int monitor_irq_add_row(struct plugin *plug, enum data_type type,
+		double time, const char *source, int cpu, uint64_t count)
+{
+	struct data *dat = data_alloc(type, NR_IRQ_COLUMNS);
+
+	if (!dat)
+		return -1;
+
+	data_add_double(dat, time);
+	data_add_str(dat, source);
+	data_add_int32(dat, cpu);
+	data_add_int64(dat, count);
+
+	plugin_add_results(plug, dat);
+	return 0;
+}
+
+/*
+ * One pass over the file. Only counters that changed since the last sample
+ * are added as monitor rows, new sources are only recorded.
+ */
+static int monitor_irq_file_sample(struct plugin *plug,
+		struct monitor_irq_file *f, int first, double now)
+{
+	const char *p;
+	int next = 0;
+
+	if (proc_file_read(&f->file))
+		return -1;
+
+	p = f->file.buf;
+	monitor_irq_parse_cpus(f, p);
+
+	for (p = proc_next_line(p); p && *p; p = proc_next_line(p)) {
+		uint64_t *vals = f->vals;
+		const char *key = p;
+		const char *q;
+		int record = first;
+		int nr = 0;
+		int src;
+		int len;
+		int i;
+
+		while (*key == ' ')
+			++key;
+		for (q = key; *q && *q != ':' && *q != '\n'; ++q)
+			;
+		if (*q != ':' || q == key)
+			continue;
+		len = q - key;
+
+		src = proc_names_find(&f->keys, key, len, next);
+		if (src < 0) {
+			if (monitor_irq_add_source(f, key, len, p))
+				return -1;
+			src = f->keys.nr - 1;
+			record = 1;
+		}
+		next = src + 1;
+
+		for (++q; nr != f->nr_cols; ++nr) {
+			q = proc_scan_u64(q, &vals[nr]);
+			if (!q)
+				break;
+		}
+		if (!nr)
+			continue;
+
+		for (i = 0; i != nr; ++i) {
+			int cpu = nr == f->nr_cols ? f->col_cpu[i] : -1;
+			int slot = cpu < 0 ? monitor_interrupts_nr_cpus : cpu;
+			uint64_t *prev = &f->prev[src * IRQ_SLOTS + slot];
+			uint64_t delta = vals[i] - *prev;
+
+			*prev = vals[i];
+			if (record || !delta)
+				continue;
+			f->total[src * IRQ_SLOTS + slot] += delta;
+			if (monitor_irq_add_row(plug, DATA_TYPE_MONITOR, now,
+					f->labels[src], cpu, delta))
+				return -1;
+			/* Counters that are not per CPU have one value */
+			if (cpu < 0)
+				break;
+		}
+	}
+
+	return 0;
+}
+
+static int monitor_interrupts_install(struct plugin *plug)
+{
+	struct monitor_interrupts_data *d = calloc(1, sizeof(*d));
+
+	if (!d)
+		return -1;
+
+	if (monitor_irq_file_open(&d->files[0], monitor_interrupts_path, "")) {
+		free(d);
+		return -1;
+	}
+	if (monitor_irq_file_open(&d->files[1], monitor_softirqs_path,
+				"softirq_")) {
+		monitor_irq_file_free(&d->files[0]);
+		free(d);
+		return -1;
+	}
+
+	plugin_set_data(plug, d);
+
+	return 0;
+}
+
+static int monitor_interrupts_uninstall(struct plugin *plug)
+{
+	struct monitor_interrupts_data *d = plugin_get_data(plug);
+	int i;
+
+	for (i = 0; i != NR_IRQ_FILES; ++i)
+		monitor_irq_file_free(&d->files[i]);
+	free(d);
+
+	plugin_set_data(plug, NULL);
+	return 0;
+}
+
+static int monitor_interrupts_init(struct plugin *plug)
+{
+	struct monitor_interrupts_data *d = plugin_get_data(plug);
+	int i;
+
+	d->first = 1;
+	d->last_time = 0;
+	for (i = 0; i != NR_IRQ_FILES; ++i) {
+		struct monitor_irq_file *f = &d->files[i];
+
+		if (f->total)
+			memset(f->total, 0, sizeof(*f->total) * f->keys.nr
+					* IRQ_SLOTS);
+	}
+	return 0;
+}
+
+static int monitor_interrupts_mon(struct plugin *plug)
+{
+	struct monitor_interrupts_data *d = plugin_get_data(plug);
+	struct timespec time;
+	double now;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	now = time.tv_sec + time.tv_nsec / 1000000000.0;
+
+	if (d->first)
+		d->start_time = now;
+
+	now -= d->start_time;
+
+	for (i = 0; i != NR_IRQ_FILES; ++i)
+		if (monitor_irq_file_sample(plug, &d->files[i], d->first, now))
+			return -1;
+
+	d->first = 0;
+	d->last_time = now;
+
+	return 0;
+}
+
+struct monitor_irq_top {
+	const char *source;
+	int cpu;
+	uint64_t count;
+};
+
+static int monitor_irq_top_cmp(const void *a, const void *b)
+{
+	const struct monitor_irq_top *ta = a;
+	const struct monitor_irq_top *tb = b;
+
+	if (ta->count == tb->count)
+		return 0;
+	return ta->count < tb->count ? 1 : -1;
+}
+
+/* The sources and CPUs with the most interrupts in this run */
+static int monitor_interrupts_parse_results(struct plugin *plug)
+{
+	struct monitor_interrupts_data *d = plugin_get_data(plug);
+	int top = option_get_int32(plugin_get_options(plug), "top");
+	struct monitor_irq_top *cands;
+	int nr_cands = 0;
+	int ret = 0;
+	int i, j;
+
+	if (top <= 0)
+		return 0;
+
+	for (i = 0; i != NR_IRQ_FILES; ++i)
+		nr_cands += d->files[i].keys.nr * IRQ_SLOTS;
+	if (!nr_cands)
+		return 0;
+
+	cands = malloc(sizeof(*cands) * nr_cands);
+	if (!cands)
+		return -1;
+
+	nr_cands = 0;
+	for (i = 0; i != NR_IRQ_FILES; ++i) {
+		struct monitor_irq_file *f = &d->files[i];
+
+		for (j = 0; j != f->keys.nr * IRQ_SLOTS; ++j) {
+			int slot = j % IRQ_SLOTS;
+
+			if (!f->total[j])
+				continue;
+			cands[nr_cands].source = f->labels[j / IRQ_SLOTS];
+			cands[nr_cands].cpu = slot == monitor_interrupts_nr_cpus
+					? -1 : slot;
+			cands[nr_cands].count = f->total[j];
+			++nr_cands;
+		}
+	}
+
+	qsort(cands, nr_cands, sizeof(*cands), monitor_irq_top_cmp);
+
+	for (i = 0; i != nr_cands && i != top && !ret; ++i)
+		ret = monitor_irq_add_row(plug, DATA_TYPE_RESULT, d->last_time,
+				cands[i].source, cands[i].cpu, cands[i].count);
+
+	free(cands);
+	return ret;
+}
+
+static const struct header *monitor_interrupts_data_hdr(struct plugin *plug)
+{
+	static const struct header hdr[NR_IRQ_COLUMNS + 1] = {
+		{
+			.name = "time",
+			.unit = "s",
+			.description = "Time of this measurement, for results the duration of the run.",
+		}, {
+			.name = "source",
+			.description = "Interrupt or softirq, numbered interrupts with their device.",
+		}, {
+			.name = "cpu",
+			.description = "CPU the interrupts were counted on, -1 for counters that are not per CPU.",
+		}, {
+			.name = "count",
+			.description = "Interrupts since the last measurement, for results the sum of this run.",
+		}, {
+			/* Sentinel */
+		}
+	};
+
+	return hdr;
+}
+
+static int monitor_interrupts_mod_init(struct module *mod,
+				       const struct plugin_id *plug)
+{
+	if (!access(monitor_interrupts_path, F_OK | R_OK))
+		plugin_monitor_interrupts_requirements[0].found = 1;
+	if (!access(monitor_softirqs_path, F_OK | R_OK))
+		plugin_monitor_interrupts_requirements[1].found = 1;
+
+	monitor_interrupts_nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (monitor_interrupts_nr_cpus < 1)
+		monitor_interrupts_nr_cpus = 1;
+
+	return 0;
+}
+
+const struct plugin_id plugin_interrupts = {
+	.name = "monitor-interrupts",
+	.description = "Monitor plugin to keep track of the interrupts and softirqs of every CPU shown in /proc/interrupts and /proc/softirqs. Only changed counters are recorded.",
+	.module_init = monitor_interrupts_mod_init,
+	.install = monitor_interrupts_install,
+	.uninstall = monitor_interrupts_uninstall,
+	.init = monitor_interrupts_init,
+	.monitor = monitor_interrupts_mon,
+	.parse_results = monitor_interrupts_parse_results,
+	.versions = plugin_monitor_interrupts_versions,
+	.data_hdr = monitor_interrupts_data_hdr,
+};
@@ -21,6 +21,8 @@
 #include <stdint.h>
 #include <time.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <cbench/data.h>
@@ -28,6 +30,8 @@
 #include <cbench/version.h>
 #include <cbench/plugin.h>
 
+#include "proc_file.h"
+
 static const char monitor_meminfo_path[] = "/proc/meminfo";
 
 static struct requirement plugin_monitor_meminfo_requirements[] = {
@@ -48,65 +52,234 @@ static struct version plugin_monitor_meminfo_versions[] = {
 	}
 };
 
-struct monitor_meminfo {
-	uint64_t memtotal;
-	uint64_t memfree;
-	uint64_t buffers;
-	uint64_t cached;
-	uint64_t swapcached;
-	uint64_t active;
-	uint64_t inactive;
-	uint64_t active_anon;
-	uint64_t inactive_anon;
-	uint64_t active_file;
-	uint64_t inactive_file;
-	uint64_t unevictable;
-	uint64_t mlocked;
-	uint64_t swaptotal;
-	uint64_t swapfree;
-	uint64_t dirty;
-	uint64_t writeback;
-	uint64_t anonpages;
-	uint64_t mapped;
-	uint64_t shmem;
-	uint64_t slab;
-	uint64_t sreclaimable;
-	uint64_t sunreclaim;
-	uint64_t kernelstack;
-	uint64_t pagetables;
-	uint64_t nfs_unstable;
-	uint64_t bounce;
-	uint64_t writebacktmp;
-	uint64_t commitlimit;
-	uint64_t committed_as;
-	uint64_t vmalloctotal;
-	uint64_t vmallocused;
-	uint64_t vmallocchunk;
-	uint64_t hugepages_total;
-	uint64_t hugepages_free;
-	uint64_t hugepages_rsvd;
-	uint64_t hugepages_surp;
-	uint64_t hugepagesize;
-	uint64_t directmap4k;
-	uint64_t directmap2m;
+/* Descriptions of the fields we know, the others are exported without one */
+static const struct {
+	const char *name;
+	const char *description;
+} monitor_meminfo_descs[] = {
+	{ "MemTotal", "Total usable ram (i.e. physical ram minus a few reserved bits and the kernel binary code)" },
+	{ "MemFree", "The sum of LowFree+HighFree" },
+	{ "MemAvailable", "An estimate of how much memory is available for starting new applications, without swapping" },
+	{ "Buffers", "Relatively temporary storage for raw disk blocks shouldnt get tremendously large (20MB or so)" },
+	{ "Cached", "in-memory cache for files read from the disk (the pagecache).  Doesnt include SwapCached" },
+	{ "SwapCached", "Memory that once was swapped out, is swapped back in but still also is in the swapfile (if memory is needed it doesnt need to be swapped out AGAIN because it is already in the swapfile. This saves I/O)" },
+	{ "Active", "Memory that has been used more recently and usually not reclaimed unless absolutely necessary." },
+	{ "Inactive", "Memory which has been less recently used.  It is more eligible to be reclaimed for other purposes" },
+	{ "SwapTotal", "total amount of swap space available" },
+	{ "SwapFree", "Memory which has been evicted from RAM, and is temporarily on the disk" },
+	{ "Dirty", "Memory which is waiting to get written back to the disk" },
+	{ "Writeback", "Memory which is actively being written back to the disk" },
+	{ "AnonPages", "Non-file backed pages mapped into userspace page tables" },
+	{ "Mapped", "files which have been mmaped, such as libraries" },
+	{ "KReclaimable", "Kernel allocations that the kernel will attempt to reclaim under memory pressure" },
+	{ "Slab", "in-kernel data structures cache" },
+	{ "SReclaimable", "Part of Slab, that might be reclaimed, such as caches" },
+	{ "SUnreclaim", "Part of Slab, that cannot be reclaimed on memory pressure" },
+	{ "PageTables", "amount of memory dedicated to the lowest level of page tables." },
+	{ "NFS_Unstable", "NFS pages sent to the server, but not yet committed to stable storage" },
+	{ "Bounce", "Memory used for block device bounce buffers" },
+	{ "WritebackTmp", "Memory used by FUSE for temporary writeback buffers" },
+	{ "Committed_AS", "The amount of memory presently allocated on the system." },
+	{ "VmallocTotal", "total size of vmalloc memory area" },
+	{ "VmallocUsed", "amount of vmalloc area which is used" },
+	{ "VmallocChunk", "largest contiguous block of vmalloc area which is free" },
+	{ "Percpu", "Memory allocated to the percpu allocator used to back percpu allocations" },
+	{ "AnonHugePages", "Non-file backed huge pages mapped into userspace page tables" },
+	{ }
+};
+
+/*
+ * The fields of the running kernel, found when the module is loaded. They
+ * are looked up by a hash of the key that has no collisions for them, the
+ * seed and table size are searched at that time.
+ */
+struct meminfo_slot {
+	const char *key;
+	int len;
+	int col;
+};
+
+static struct header *monitor_meminfo_hdr;
+static int monitor_meminfo_nr_fields;
+static char *monitor_meminfo_names;
+static struct meminfo_slot *monitor_meminfo_slots;
+static uint32_t monitor_meminfo_mask;
+static uint32_t monitor_meminfo_seed;
+
+static const struct header monitor_meminfo_time_hdr[] = {
+	{
+		.name = "time",
+		.unit = "s",
+		.description = "Time of this measurement.",
+	}, {
+		/* Sentinel */
+	}
 };
 
 struct monitor_meminfo_data {
-	char *buf;
-	size_t buf_len;
+	struct proc_file file;
 	int first;
 
 	double start_time;
+	uint64_t *values;
 };
 
+static inline uint32_t monitor_meminfo_hash(const char *key, int len,
+		uint32_t seed)
+{
+	uint32_t h = 2166136261u ^ seed;
+	int i;
+
+	for (i = 0; i != len; ++i) {
+		h ^= (unsigned char)key[i];
+		h *= 16777619u;
+	}
+	return h ^ (h >> 15);
+}
+
+/* Column of the key, -1 if the kernel did not have it at module load */
+static inline int monitor_meminfo_lookup(const char *key, int len)
+{
+	struct meminfo_slot *s = &monitor_meminfo_slots[
+		monitor_meminfo_hash(key, len, monitor_meminfo_seed)
+			& monitor_meminfo_mask];
+
+	if (s->len != len || memcmp(s->key, key, len))
+		return -1;
+	return s->col;
+}
+
+static int monitor_meminfo_build_hash(void)
+{
+	uint32_t size;
+	int i;
+
+	for (size = 2; size < 2 * monitor_meminfo_nr_fields; size <<= 1)
+		;
+
+	for (; size <= 1 << 16; size <<= 1) {
+		uint32_t seed;
+
+		monitor_meminfo_slots = calloc(size, sizeof(*monitor_meminfo_slots));
+		if (!monitor_meminfo_slots)
+			return -1;
+
+		for (seed = 0; seed != 1024; ++seed) {
+			memset(monitor_meminfo_slots, 0,
+					size * sizeof(*monitor_meminfo_slots));
+			for (i = 0; i != monitor_meminfo_nr_fields; ++i) {
+				const char *key = monitor_meminfo_hdr[i + 1].name;
+				int len = strlen(key);
+				struct meminfo_slot *s = &monitor_meminfo_slots[
+					monitor_meminfo_hash(key, len, seed)
+						& (size - 1)];
+
+				if (s->key)
+					break;
+				s->key = key;
+				s->len = len;
+				s->col = i;
+			}
+			if (i == monitor_meminfo_nr_fields) {
+				monitor_meminfo_mask = size - 1;
+				monitor_meminfo_seed = seed;
+				return 0;
+			}
+		}
+		free(monitor_meminfo_slots);
+		monitor_meminfo_slots = NULL;
+	}
+	return -1;
+}
+
+/* Generate the header from the fields the running kernel provides */
+static int monitor_meminfo_build_hdr(void)
+{
+	struct proc_file pf;
+	const char *p;
+	char *name;
+	int nr = 0;
+	int i;
+
+	if (proc_file_open(&pf, monitor_meminfo_path))
+		return -1;
+
+	for (p = pf.buf; p && *p; p = proc_next_line(p))
+		++nr;
+
+	monitor_meminfo_hdr = calloc(nr + 2, sizeof(*monitor_meminfo_hdr));
+	monitor_meminfo_names = malloc(pf.len + 1);
+	if (!monitor_meminfo_hdr || !monitor_meminfo_names)
+		goto error;
+
+	monitor_meminfo_hdr[0] = monitor_meminfo_time_hdr[0];
+	name = monitor_meminfo_names;
+	nr = 0;
+	for (p = pf.buf; p && *p; p = proc_next_line(p)) {
+		struct header *h = &monitor_meminfo_hdr[nr + 1];
+		const char *colon = p;
+		uint64_t val;
+		const char *end;
+		int len;
+
+		while (*colon && *colon != ':' && *colon != '\n')
+			++colon;
+		if (*colon != ':')
+			continue;
+		len = colon - p;
+		memcpy(name, p, len);
+		name[len] = '\0';
+		h->name = name;
+		name += len + 1;
+
+		end = proc_scan_u64(colon + 1, &val);
+		if (end && !strncmp(end, " kB", 3))
+			h->unit = "kB";
+		for (i = 0; monitor_meminfo_descs[i].name; ++i) {
+			if (!strcmp(monitor_meminfo_descs[i].name, h->name)) {
+				h->description = monitor_meminfo_descs[i].description;
+				break;
+			}
+		}
+		++nr;
+	}
+	monitor_meminfo_nr_fields = nr;
+	proc_file_close(&pf);
+
+	if (monitor_meminfo_build_hash())
+		goto error_hash;
+	return 0;
+
+error:
+	proc_file_close(&pf);
+error_hash:
+	free(monitor_meminfo_hdr);
+	free(monitor_meminfo_names);
+	monitor_meminfo_hdr = NULL;
+	monitor_meminfo_names = NULL;
+	monitor_meminfo_nr_fields = 0;
+	return -1;
+}
+
 static int monitor_meminfo_install(struct plugin *plug)
 {
-	struct monitor_meminfo_data *d = malloc(sizeof(*d));
+	struct monitor_meminfo_data *d;
+
+	if (!monitor_meminfo_hdr) {
+		printf("Error: Fields of %s unknown\n", monitor_meminfo_path);
+		return -1;
+	}
 
+	d = calloc(1, sizeof(*d));
 	if (!d)
 		return -1;
 
-	d->buf = NULL;
+	d->values = calloc(monitor_meminfo_nr_fields, sizeof(*d->values));
+	if (!d->values || proc_file_open(&d->file, monitor_meminfo_path)) {
+		free(d->values);
+		free(d);
+		return -1;
+	}
 
 	plugin_set_data(plug, d);
 
@@ -117,11 +290,8 @@ static int monitor_meminfo_uninstall(struct plugin *plug)
 {
 	struct monitor_meminfo_data *d = plugin_get_data(plug);
 
-	if (d->buf) {
-		free(d->buf);
-		d->buf = NULL;
-	}
-
+	proc_file_close(&d->file);
+	free(d->values);
 	free(d);
 
 	plugin_set_data(plug, NULL);
@@ -136,93 +306,49 @@ static int monitor_meminfo_init(struct plugin *plug)
 	return 0;
 }
 
-#define MEMINFO_PARSE(buf, name, ptr, varname) \
-	ret = sscanf(buf, name ": %" PRIu64 " ", &ptr->varname);\
-	if (ret == 1)\
-		continue;
-
-static int monitor_meminfo_get(struct plugin *plug,
-		struct monitor_meminfo *meminfo)
+/* One pass over the file, every key is hashed while it is scanned */
+static int monitor_meminfo_get(struct plugin *plug)
 {
-	FILE *f;
 	struct monitor_meminfo_data *d = plugin_get_data(plug);
+	const char *p;
 
-	f = fopen(monitor_meminfo_path, "r");
-	if (!f) {
-		printf("Error: Could not open file %s\n", monitor_meminfo_path);
+	if (proc_file_read(&d->file))
 		return -1;
-	}
 
-	memset(meminfo, 0, sizeof(*meminfo));
-
-	while (0 < getline(&d->buf, &d->buf_len, f)) {
-		int ret;
-
-		MEMINFO_PARSE(d->buf, "MemTotal", meminfo, memtotal)
-		MEMINFO_PARSE(d->buf, "MemFree", meminfo, memfree)
-		MEMINFO_PARSE(d->buf, "Buffers", meminfo, buffers)
-		MEMINFO_PARSE(d->buf, "Cached", meminfo, cached)
-		MEMINFO_PARSE(d->buf, "SwapCached", meminfo, swapcached)
-		MEMINFO_PARSE(d->buf, "Active", meminfo, active)
-		MEMINFO_PARSE(d->buf, "Inactive", meminfo, inactive)
-		MEMINFO_PARSE(d->buf, "Active(anon)", meminfo, active_anon)
-		MEMINFO_PARSE(d->buf, "Inactive(anon)", meminfo, inactive_anon)
-		MEMINFO_PARSE(d->buf, "Active(file)", meminfo, active_file)
-		MEMINFO_PARSE(d->buf, "Inactive(file)", meminfo, inactive_file)
-		MEMINFO_PARSE(d->buf, "Unevictable", meminfo, unevictable)
-		MEMINFO_PARSE(d->buf, "Mlocked", meminfo, mlocked)
-		MEMINFO_PARSE(d->buf, "SwapTotal", meminfo, swaptotal)
-		MEMINFO_PARSE(d->buf, "SwapFree", meminfo, swapfree)
-		MEMINFO_PARSE(d->buf, "Dirty", meminfo, dirty)
-		MEMINFO_PARSE(d->buf, "Writeback", meminfo, writeback)
-		MEMINFO_PARSE(d->buf, "AnonPages", meminfo, anonpages)
-		MEMINFO_PARSE(d->buf, "Mapped", meminfo, mapped)
-		MEMINFO_PARSE(d->buf, "Shmem", meminfo, shmem)
-		MEMINFO_PARSE(d->buf, "Slab", meminfo, slab)
-		MEMINFO_PARSE(d->buf, "SReclaimable", meminfo, sreclaimable)
-		MEMINFO_PARSE(d->buf, "SUnreclaim", meminfo, sunreclaim)
-		MEMINFO_PARSE(d->buf, "KernelStack", meminfo, kernelstack)
-		MEMINFO_PARSE(d->buf, "PageTables", meminfo, pagetables)
-		MEMINFO_PARSE(d->buf, "NFS_Unstable", meminfo, nfs_unstable)
-		MEMINFO_PARSE(d->buf, "Bounce", meminfo, bounce)
-		MEMINFO_PARSE(d->buf, "WritebackTmp", meminfo, writebacktmp)
-		MEMINFO_PARSE(d->buf, "CommitLimit", meminfo, commitlimit)
-		MEMINFO_PARSE(d->buf, "Committed_AS", meminfo, committed_as)
-		MEMINFO_PARSE(d->buf, "VmallocTotal", meminfo, vmalloctotal)
-		MEMINFO_PARSE(d->buf, "VmallocUsed", meminfo, vmallocused)
-		MEMINFO_PARSE(d->buf, "VmallocChunk", meminfo, vmallocchunk)
-		MEMINFO_PARSE(d->buf, "HugePages_Total", meminfo, hugepages_total)
-		MEMINFO_PARSE(d->buf, "HugePages_Free", meminfo, hugepages_free)
-		MEMINFO_PARSE(d->buf, "HugePages_Rsvd", meminfo, hugepages_rsvd)
-		MEMINFO_PARSE(d->buf, "HugePages_Surp", meminfo, hugepages_surp)
-		MEMINFO_PARSE(d->buf, "Hugepagesize", meminfo, hugepagesize)
-		MEMINFO_PARSE(d->buf, "DirectMap4k", meminfo, directmap4k)
-		MEMINFO_PARSE(d->buf, "DirectMap2M", meminfo, directmap2m)
-	}
+	memset(d->values, 0, sizeof(*d->values) * monitor_meminfo_nr_fields);
 
-	fclose(f);
+	for (p = d->file.buf; p && *p; p = proc_next_line(p)) {
+		const char *colon = p;
+		int col;
+
+		while (*colon && *colon != ':' && *colon != '\n')
+			++colon;
+		if (*colon != ':')
+			continue;
+		col = monitor_meminfo_lookup(p, colon - p);
+		if (col >= 0)
+			proc_scan_u64(colon + 1, &d->values[col]);
+	}
 
 	return 0;
 }
 
-#undef MEMINFO_PARSE
-
 static int monitor_meminfo_mon(struct plugin *plug)
 {
 	struct monitor_meminfo_data *data = plugin_get_data(plug);
-	struct monitor_meminfo meminfo;
 	struct data *d;
 	int ret;
 	struct timespec time;
 	double now;
+	int i;
 
 	clock_gettime(CLOCK_MONOTONIC, &time);
 
-	ret = monitor_meminfo_get(plug, &meminfo);
+	ret = monitor_meminfo_get(plug);
 	if (ret)
 		return ret;
 
-	d = data_alloc(DATA_TYPE_MONITOR, 41);
+	d = data_alloc(DATA_TYPE_MONITOR, monitor_meminfo_nr_fields + 1);
 	if (!d)
 		return -1;
 
@@ -236,47 +362,8 @@ static int monitor_meminfo_mon(struct plugin *plug)
 	now -= data->start_time;
 
 	data_add_double(d, now);
-
-	data_add_int64(d, meminfo.memtotal);
-	data_add_int64(d, meminfo.memfree);
-	data_add_int64(d, meminfo.buffers);
-	data_add_int64(d, meminfo.cached);
-	data_add_int64(d, meminfo.swapcached);
-	data_add_int64(d, meminfo.active);
-	data_add_int64(d, meminfo.inactive);
-	data_add_int64(d, meminfo.active_anon);
-	data_add_int64(d, meminfo.inactive_anon);
-	data_add_int64(d, meminfo.active_file);
-	data_add_int64(d, meminfo.inactive_file);
-	data_add_int64(d, meminfo.unevictable);
-	data_add_int64(d, meminfo.mlocked);
-	data_add_int64(d, meminfo.swaptotal);
-	data_add_int64(d, meminfo.swapfree);
-	data_add_int64(d, meminfo.dirty);
-	data_add_int64(d, meminfo.writeback);
-	data_add_int64(d, meminfo.anonpages);
-	data_add_int64(d, meminfo.mapped);
-	data_add_int64(d, meminfo.shmem);
-	data_add_int64(d, meminfo.slab);
-	data_add_int64(d, meminfo.sreclaimable);
-	data_add_int64(d, meminfo.sunreclaim);
-	data_add_int64(d, meminfo.kernelstack);
-	data_add_int64(d, meminfo.pagetables);
-	data_add_int64(d, meminfo.nfs_unstable);
-	data_add_int64(d, meminfo.bounce);
-	data_add_int64(d, meminfo.writebacktmp);
-	data_add_int64(d, meminfo.commitlimit);
-	data_add_int64(d, meminfo.committed_as);
-	data_add_int64(d, meminfo.vmalloctotal);
-	data_add_int64(d, meminfo.vmallocused);
-	data_add_int64(d, meminfo.vmallocchunk);
-	data_add_int64(d, meminfo.hugepages_total);
-	data_add_int64(d, meminfo.hugepages_free);
-	data_add_int64(d, meminfo.hugepages_rsvd);
-	data_add_int64(d, meminfo.hugepages_surp);
-	data_add_int64(d, meminfo.hugepagesize);
-	data_add_int64(d, meminfo.directmap4k);
-	data_add_int64(d, meminfo.directmap2m);
+	for (i = 0; i != monitor_meminfo_nr_fields; ++i)
+		data_add_int64(d, data->values[i]);
 
 	plugin_add_results(plug, d);
 
@@ -285,172 +372,41 @@ static int monitor_meminfo_mon(struct plugin *plug)
 
 static const struct header *monitor_meminfo_data_hdr(struct plugin *plug)
 {
-	static const struct header hdr[] = {
-		{
-			.name = "time",
-			.unit = "s",
-			.description = "Time of this measurement.",
-		}, {
-			.name = "MemTotal",
-			.unit = "kB",
-			.description = "Total usable ram (i.e. physical ram minus a few reserved bits and the kernel binary code)",
-		}, {
-			.name = "MemFree",
-			.unit = "kB",
-			.description = "The sum of LowFree+HighFree",
-		}, {
-			.name = "Buffers",
-			.unit = "kB",
-			.description = "Relatively temporary storage for raw disk blocks shouldnt get tremendously large (20MB or so)",
-		}, {
-			.name = "Cached",
-			.unit = "kB",
-			.description = "in-memory cache for files read from the disk (the pagecache).  Doesnt include SwapCached",
-		}, {
-			.name = "SwapCached",
-			.unit = "kB",
-			.description = "Memory that once was swapped out, is swapped back in but still also is in the swapfile (if memory is needed it doesnt need to be swapped out AGAIN because it is already in the swapfile. This saves I/O)",
-		}, {
-			.name = "Active",
-			.unit = "kB",
-			.description = "Memory that has been used more recently and usually not reclaimed unless absolutely necessary.",
-		}, {
-			.name = "Inactive",
-			.unit = "kB",
-			.description = "Memory which has been less recently used.  It is more eligible to be reclaimed for other purposes",
-		}, {
-			.name = "Active(anon)",
-			.unit = "kB",
-		}, {
-			.name = "Inactive(anon)",
-			.unit = "kB",
-		}, {
-			.name = "Active(file)",
-			.unit = "kB",
-		}, {
-			.name = "Inactive(file)",
-			.unit = "kB",
-		}, {
-			.name = "Unevictable",
-			.unit = "kB",
-		}, {
-			.name = "Mlocked",
-			.unit = "kB",
-		}, {
-			.name = "SwapTotal",
-			.unit = "kB",
-			.description = "total amount of swap space available",
-		}, {
-			.name = "SwapFree",
-			.unit = "kB",
-			.description = "Memory which has been evicted from RAM, and is temporarily on the disk",
-		}, {
-			.name = "Dirty",
-			.unit = "kB",
-			.description = "Memory which is waiting to get written back to the disk",
-		}, {
-			.name = "Writeback",
-			.unit = "kB",
-			.description = "Memory which is actively being written back to the disk",
-		}, {
-			.name = "AnonPages",
-			.unit = "kB",
-			.description = "Non-file backed pages mapped into userspace page tables",
-		}, {
-			.name = "Mapped",
-			.unit = "kB",
-			.description = "files which have been mmaped, such as libraries",
-		}, {
-			.name = "Shmem",
-			.unit = "kB",
-		}, {
-			.name = "Slab",
-			.unit = "kB",
-			.description = "in-kernel data structures cache",
-		}, {
-			.name = "SReclaimable",
-			.unit = "kB",
-			.description = "Part of Slab, that might be reclaimed, such as caches",
-		}, {
-			.name = "SUnreclaim",
-			.unit = "kB",
-			.description = "Part of Slab, that cannot be reclaimed on memory pressure",
-		}, {
-			.name = "KernelStack",
-			.unit = "kB",
-		}, {
-			.name = "PageTables",
-			.unit = "kB",
-			.description = "amount of memory dedicated to the lowest level of page tables.",
-		}, {
-			.name = "NFS_Unstable",
-			.unit = "kB",
-			.description = "NFS pages sent to the server, but not yet committed to stable storage",
-		}, {
-			.name = "Bounce",
-			.unit = "kB",
-			.description = "Memory used for block device bounce buffers",
-		}, {
-			.name = "WritebackTmp",
-			.unit = "kB",
-			.description = "Memory used by FUSE for temporary writeback buffers",
-		}, {
-			.name = "CommitLimit",
-			.unit = "kB",
-		}, {
-			.name = "Committed_AS",
-			.unit = "kB",
-			.description = "The amount of memory presently allocated on the system.",
-		}, {
-			.name = "VmallocTotal",
-			.unit = "kB",
-			.description = "total size of vmalloc memory area",
-		}, {
-			.name = "VmallocUsed",
-			.unit = "kB",
-			.description = "amount of vmalloc area which is used",
-		}, {
-			.name = "VmallocChunk",
-			.unit = "kB",
-			.description = "largest contiguous block of vmalloc area which is free",
-		}, {
-			.name = "HugePages_Total",
-		}, {
-			.name = "HugePages_Free",
-		}, {
-			.name = "HugePages_Rsvd",
-		}, {
-			.name = "HugePages_Surp",
-		}, {
-			.name = "Hugepagesize",
-			.unit = "kB",
-		}, {
-			.name = "DirectMap4k",
-			.unit = "kB",
-		}, {
-			.name = "DirectMap2M",
-			.unit = "kB",
-		}, {
-			/* Sentinel */
-		}
-	};
-
-	return hdr;
+	if (!monitor_meminfo_hdr)
+		return monitor_meminfo_time_hdr;
+	return monitor_meminfo_hdr;
 }
 
 static int monitor_meminfo_mod_init(struct module *mod,
 				    const struct plugin_id *plug)
 {
-	if (!access(monitor_meminfo_path, F_OK | R_OK))
+	if (!access(monitor_meminfo_path, F_OK | R_OK)) {
 		plugin_monitor_meminfo_requirements[0].found = 1;
+		if (monitor_meminfo_build_hdr())
+			printf("Error: Failed to parse the fields of %s\n",
+					monitor_meminfo_path);
+	}
 
 	return 0;
 }
 
+static void monitor_meminfo_mod_exit(struct module *mod,
+				     const struct plugin_id *plug)
+{
+	free(monitor_meminfo_slots);
+	free(monitor_meminfo_hdr);
+	free(monitor_meminfo_names);
+	monitor_meminfo_slots = NULL;
+	monitor_meminfo_hdr = NULL;
+	monitor_meminfo_names = NULL;
+	monitor_meminfo_nr_fields = 0;
+}
+
 const struct plugin_id plugin_meminfo = {
 	.name = "monitor-meminfo",
 	.description = "Monitor plugin to keep track of different values shown in /proc/meminfo.",
 	.module_init = monitor_meminfo_mod_init,
+	.module_exit = monitor_meminfo_mod_exit,
 	.install = monitor_meminfo_install,
 	.uninstall = monitor_meminfo_uninstall,
 	.init = monitor_meminfo_init,
@@ -0,0 +1,368 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cbench/data.h>
+#include <cbench/option.h>
+#include <cbench/plugin_id_helper.h>
+#include <cbench/requirement.h>
+#include <cbench/version.h>
+#include <cbench/plugin.h>
+
+#include "proc_file.h"
+
+static const char monitor_netdev_path[] = "/proc/net/dev";
+
+static struct requirement plugin_monitor_netdev_requirements[] = {
+	{
+		.name = monitor_netdev_path,
+		.description = "This plugin uses /proc/net/dev to monitor the system.",
+		.found = 0,
+	},
+	{ }
+};
+
+static struct header plugin_monitor_netdev_options[] = {
+	OPTION_STR("interfaces", "Comma separated list of the network interfaces to monitor, a trailing '*' matches all interfaces with that prefix, a leading '!' excludes interfaces. Empty monitors all interfaces", NULL, "!lo"),
+	OPTION_SENTINEL
+};
+
+static struct version plugin_monitor_netdev_versions[] = {
+	{
+		.version = "0.1",
+		.requirements = plugin_monitor_netdev_requirements,
+		.default_options = plugin_monitor_netdev_options,
+	}, {
+		/* Sentinel */
+	}
+};
+
+/* Values of an interface line after the name */
+enum monitor_netdev_line {
+	NETDEV_RX_BYTES,
+	NETDEV_RX_PACKETS,
+	NETDEV_RX_ERRS,
+	NETDEV_RX_DROP,
+	NETDEV_RX_FIFO,
+	NETDEV_RX_FRAME,
+	NETDEV_RX_COMPRESSED,
+	NETDEV_RX_MULTICAST,
+	NETDEV_TX_BYTES,
+	NETDEV_TX_PACKETS,
+	NETDEV_TX_ERRS,
+	NETDEV_TX_DROP,
+	NR_NETDEV_LINE,
+};
+
+/* Values stored and exported for every interface */
+enum monitor_netdev_field {
+	NET_RX_BYTES,
+	NET_RX_PACKETS,
+	NET_RX_DROP,
+	NET_TX_BYTES,
+	NET_TX_PACKETS,
+	NET_TX_DROP,
+	NR_NET_FIELDS,
+};
+
+static const enum monitor_netdev_line monitor_netdev_field_line[NR_NET_FIELDS] = {
+	NETDEV_RX_BYTES,
+	NETDEV_RX_PACKETS,
+	NETDEV_RX_DROP,
+	NETDEV_TX_BYTES,
+	NETDEV_TX_PACKETS,
+	NETDEV_TX_DROP,
+};
+
+static const struct header monitor_netdev_fields[NR_NET_FIELDS] = {
+	{
+		.name = "rx_bytes",
+		.unit = "B",
+		.description = "Bytes received since the previous measurement.",
+	}, {
+		.name = "rx_packets",
+		.description = "Packets received since the previous measurement.",
+	}, {
+		.name = "rx_drop",
+		.description = "Received packets dropped since the previous measurement.",
+	}, {
+		.name = "tx_bytes",
+		.unit = "B",
+		.description = "Bytes sent since the previous measurement.",
+	}, {
+		.name = "tx_packets",
+		.description = "Packets sent since the previous measurement.",
+	}, {
+		.name = "tx_drop",
+		.description = "Packets dropped while sending since the previous measurement.",
+	},
+};
+
+/* Interfaces found when the module is loaded */
+static struct proc_names monitor_netdev_ifs;
+static struct proc_filter *monitor_netdev_filters;
+
+static const struct header monitor_netdev_time_hdr[] = {
+	{
+		.name = "time",
+		.unit = "s",
+		.description = "Time of this measurement.",
+	}, {
+		/* Sentinel */
+	}
+};
+
+struct monitor_netdev_data {
+	struct proc_file file;
+	int first;
+	const struct proc_filter *filter;
+
+	double start_time;
+	/* NR_NET_FIELDS values of every interface, now and at the previous sample */
+	uint64_t *values;
+	uint64_t *prev;
+};
+
+static const struct proc_filter *monitor_netdev_get_filter(struct plugin *plug)
+{
+	return proc_filter_get(&monitor_netdev_filters, &monitor_netdev_ifs,
+			option_get_str(plugin_get_options(plug), "interfaces"),
+			monitor_netdev_fields, NR_NET_FIELDS);
+}
+
+/* Interface name of a line, the values may follow the ':' without a blank */
+static const char *monitor_netdev_name(const char *p, int *len)
+{
+	const char *end;
+
+	while (*p == ' ')
+		++p;
+	for (end = p; *end && *end != ':' && *end != '\n'; ++end)
+		;
+	if (*end != ':' || end == p)
+		return NULL;
+	*len = end - p;
+	return p;
+}
+
+static int monitor_netdev_read_ifs(void)
+{
+	struct proc_file pf;
+	const char *p;
+
+	if (proc_file_open(&pf, monitor_netdev_path))
+		return -1;
+
+	for (p = pf.buf; p && *p; p = proc_next_line(p)) {
+		int len;
+		const char *name = monitor_netdev_name(p, &len);
+
+		if (name && proc_names_add(&monitor_netdev_ifs, name, len)) {
+			proc_file_close(&pf);
+			proc_names_free(&monitor_netdev_ifs);
+			return -1;
+		}
+	}
+
+	proc_file_close(&pf);
+	return 0;
+}
+
+static int monitor_netdev_install(struct plugin *plug)
+{
+	int nr = monitor_netdev_ifs.nr * NR_NET_FIELDS;
+	struct monitor_netdev_data *d = calloc(1, sizeof(*d));
+
+	if (!d)
+		return -1;
+
+	d->values = calloc(2 * nr + 1, sizeof(*d->values));
+	if (!d->values || proc_file_open(&d->file, monitor_netdev_path)) {
+		free(d->values);
+		free(d);
+		return -1;
+	}
+	d->prev = d->values + nr;
+
+	plugin_set_data(plug, d);
+
+	return 0;
+}
+
+static int monitor_netdev_uninstall(struct plugin *plug)
+{
+	struct monitor_netdev_data *d = plugin_get_data(plug);
+
+	proc_file_close(&d->file);
+	free(d->values);
+	free(d);
+
+	plugin_set_data(plug, NULL);
+	return 0;
+}
+
+static int monitor_netdev_init(struct plugin *plug)
+{
+	struct monitor_netdev_data *d = plugin_get_data(plug);
+
+	d->first = 1;
+	d->filter = monitor_netdev_get_filter(plug);
+	if (!d->filter)
+		return -1;
+	return 0;
+}
+
+/* One pass over the file, interfaces created after loading are skipped */
+static int monitor_netdev_get(struct plugin *plug)
+{
+	struct monitor_netdev_data *d = plugin_get_data(plug);
+	const char *p;
+	int next = 0;
+
+	if (proc_file_read(&d->file))
+		return -1;
+
+	for (p = d->file.buf; p && *p; p = proc_next_line(p)) {
+		uint64_t line[NR_NETDEV_LINE];
+		uint64_t *v;
+		const char *name;
+		const char *q;
+		int len;
+		int dev;
+		int i;
+
+		name = monitor_netdev_name(p, &len);
+		if (!name)
+			continue;
+		dev = proc_names_find(&monitor_netdev_ifs, name, len, next);
+		if (dev < 0)
+			continue;
+		next = dev + 1;
+
+		q = name + len + 1;
+		for (i = 0; i != NR_NETDEV_LINE && q; ++i)
+			q = proc_scan_u64(q, &line[i]);
+		if (!q)
+			continue;
+
+		v = &d->values[dev * NR_NET_FIELDS];
+		for (i = 0; i != NR_NET_FIELDS; ++i)
+			v[i] = line[monitor_netdev_field_line[i]];
+	}
+
+	return 0;
+}
+
+static int monitor_netdev_mon(struct plugin *plug)
+{
+	struct monitor_netdev_data *d = plugin_get_data(plug);
+	const struct proc_filter *f = d->filter;
+	struct data *dat;
+	int ret;
+	struct timespec time;
+	double now;
+	int i, j;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	ret = monitor_netdev_get(plug);
+	if (ret)
+		return ret;
+
+	dat = data_alloc(DATA_TYPE_MONITOR, f->nr * NR_NET_FIELDS + 1);
+	if (!dat)
+		return -1;
+
+	now = time.tv_sec + time.tv_nsec / 1000000000.0;
+
+	if (d->first) {
+		memcpy(d->prev, d->values, sizeof(*d->values)
+				* monitor_netdev_ifs.nr * NR_NET_FIELDS);
+		d->start_time = now;
+		d->first = 0;
+	}
+
+	now -= d->start_time;
+
+	data_add_double(dat, now);
+	for (i = 0; i != f->nr; ++i) {
+		uint64_t *v = &d->values[f->sel[i] * NR_NET_FIELDS];
+		uint64_t *prev = &d->prev[f->sel[i] * NR_NET_FIELDS];
+
+		for (j = 0; j != NR_NET_FIELDS; ++j)
+			data_add_int64(dat, v[j] - prev[j]);
+	}
+
+	memcpy(d->prev, d->values, sizeof(*d->values) * monitor_netdev_ifs.nr
+			* NR_NET_FIELDS);
+
+	plugin_add_results(plug, dat);
+
+	return 0;
+}
+
+static const struct header *monitor_netdev_data_hdr(struct plugin *plug)
+{
+	const struct proc_filter *f = monitor_netdev_get_filter(plug);
+
+	if (!f)
+		return monitor_netdev_time_hdr;
+	return f->hdr;
+}
+
+static int monitor_netdev_mod_init(struct module *mod,
+				   const struct plugin_id *plug)
+{
+	if (access(monitor_netdev_path, F_OK | R_OK))
+		return 0;
+
+	plugin_monitor_netdev_requirements[0].found = 1;
+	if (monitor_netdev_read_ifs())
+		printf("Error: Failed to parse the interfaces of %s\n",
+				monitor_netdev_path);
+
+	return 0;
+}
+
+static void monitor_netdev_mod_exit(struct module *mod,
+				    const struct plugin_id *plug)
+{
+	proc_filter_free(&monitor_netdev_filters);
+	proc_names_free(&monitor_netdev_ifs);
+}
+
+const struct plugin_id plugin_netdev = {
+	.name = "monitor-netdev",
+	.description = "Monitor plugin to keep track of the network interface traffic shown in /proc/net/dev.",
+	.module_init = monitor_netdev_mod_init,
+	.module_exit = monitor_netdev_mod_exit,
+	.install = monitor_netdev_install,
+	.uninstall = monitor_netdev_uninstall,
+	.init = monitor_netdev_init,
+	.monitor = monitor_netdev_mon,
+	.versions = plugin_monitor_netdev_versions,
+	.data_hdr = monitor_netdev_data_hdr,
+};
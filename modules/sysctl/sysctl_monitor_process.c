@@ -0,0 +1,549 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include <cbench/data.h>
+#include <cbench/option.h>
+#include <cbench/plugin_id_helper.h>
+#include <cbench/requirement.h>
+#include <cbench/version.h>
+#include <cbench/plugin.h>
+
+#include "proc_file.h"
+
+static const char monitor_process_children_path[] = "/proc/thread-self/children";
+
+static struct requirement plugin_monitor_process_requirements[] = {
+	{
+		.name = monitor_process_children_path,
+		.description = "This plugin finds the child processes of the benchmarks in /proc/<pid>/task/<tid>/children (CONFIG_PROC_CHILDREN).",
+		.found = 0,
+	},
+	{ }
+};
+
+static struct header plugin_monitor_process_options[] = {
+	OPTION_BOOL("background", "Also track background plugins that are not monitors and the threads they create, e.g. load generators", NULL, 0),
+	OPTION_SENTINEL
+};
+
+static struct version plugin_monitor_process_versions[] = {
+	{
+		.version = "0.1",
+		.requirements = plugin_monitor_process_requirements,
+		.default_options = plugin_monitor_process_options,
+	}, {
+		/* Sentinel */
+	}
+};
+
+/*
+ * Values of /proc/<pid>/stat that include the reaped children. A child that
+ * exits moves its values into those of its parent, so the sum over the
+ * tracked child processes and the suite process itself does not lose them.
+ */
+struct monitor_process_sum {
+	uint64_t ticks;
+	uint64_t minflt;
+	uint64_t majflt;
+};
+
+/*
+ * Counters without values of reaped children and the values of the threads
+ * of the suite, which are gone when a thread exits. They are summed from the
+ * change of every task between samples, tasks are matched by their id.
+ */
+struct monitor_process_task {
+	pid_t pid;
+	unsigned int gen;
+	uint64_t vol;
+	uint64_t invol;
+	uint64_t run_delay;
+	struct monitor_process_sum thread;
+};
+
+struct monitor_process_data {
+	int first;
+	int background;
+	double start_time;
+
+	struct monitor_process_sum initial;
+	struct monitor_process_sum threads;
+	uint64_t vol;
+	uint64_t invol;
+	uint64_t run_delay;
+
+	struct monitor_process_task *tasks;
+	int nr_tasks;
+	int size_tasks;
+	unsigned int gen;
+
+	/* Processes still to visit in this sample */
+	pid_t *queue;
+	int size_queue;
+
+	struct proc_file file;
+};
+
+/* Values of this sample */
+struct monitor_process_sample {
+	struct monitor_process_sum sum;
+	uint64_t rss;
+	int nr_tasks;
+	int nr_queue;
+};
+
+enum monitor_process_stat {
+	STAT_MINFLT,
+	STAT_CMINFLT,
+	STAT_MAJFLT,
+	STAT_CMAJFLT,
+	STAT_UTIME,
+	STAT_STIME,
+	STAT_CUTIME,
+	STAT_CSTIME,
+	STAT_PRIORITY,
+	STAT_NICE,
+	STAT_NUM_THREADS,
+	STAT_ITREALVALUE,
+	STAT_STARTTIME,
+	STAT_VSIZE,
+	STAT_RSS,
+	NR_PROCESS_STAT,
+};
+
+static long monitor_process_clk_tck;
+static long monitor_process_page_size;
+
+/* Fields starting with minflt, the 10th field of /proc/<pid>/stat */
+static int monitor_process_read_stat(struct monitor_process_data *d,
+		const char *path, int64_t *vals)
+{
+	const char *p;
+	int i;
+
+	if (proc_file_read_path(&d->file, path))
+		return -1;
+
+	/* The command may contain anything, it ends with the last ')' */
+	p = strrchr(d->file.buf, ')');
+	if (!p)
+		return -1;
+	/* Skip the state, ppid, pgrp, session, tty_nr, tpgid and flags */
+	p += 2;
+	if (!*p)
+		return -1;
+	++p;
+	for (i = 0; i != 6 && p; ++i)
+		p = proc_scan_s64(p, &vals[0]);
+	for (i = 0; i != NR_PROCESS_STAT && p; ++i)
+		p = proc_scan_s64(p, &vals[i]);
+	return p ? 0 : -1;
+}
+
+static uint64_t monitor_process_status_val(const char *buf, const char *key)
+{
+	const char *p = strstr(buf, key);
+	uint64_t val = 0;
+
+	if (p)
+		proc_scan_u64(p + strlen(key), &val);
+	return val;
+}
+
+static struct monitor_process_task *monitor_process_find_task(
+		struct monitor_process_data *d, pid_t pid)
+{
+	struct monitor_process_task *t;
+	int i;
+
+	for (i = 0; i != d->nr_tasks; ++i)
+		if (d->tasks[i].pid == pid)
+			return &d->tasks[i];
+
+	if (d->nr_tasks == d->size_tasks) {
+		int size = d->size_tasks ? d->size_tasks * 2 : 64;
+
+		t = realloc(d->tasks, sizeof(*t) * size);
+		if (!t)
+			return NULL;
+		d->tasks = t;
+		d->size_tasks = size;
+	}
+	t = &d->tasks[d->nr_tasks++];
+	memset(t, 0, sizeof(*t));
+	t->pid = pid;
+	return t;
+}
+
+/*
+ * Add the change of the counters in status and schedstat of a task and, for
+ * threads of the suite, of the values in thread.
+ */
+static int monitor_process_counters(struct monitor_process_data *d,
+		const char *dir, pid_t pid, const struct monitor_process_sum *thread)
+{
+	struct monitor_process_task *t = monitor_process_find_task(d, pid);
+	uint64_t vol, invol;
+	uint64_t run_delay = 0;
+	char path[96];
+
+	if (!t)
+		return -1;
+
+	snprintf(path, sizeof(path), "%s/status", dir);
+	if (proc_file_read_path(&d->file, path))
+		return 0;
+	vol = monitor_process_status_val(d->file.buf, "\nvoluntary_ctxt_switches:");
+	invol = monitor_process_status_val(d->file.buf, "\nnonvoluntary_ctxt_switches:");
+
+	snprintf(path, sizeof(path), "%s/schedstat", dir);
+	if (!proc_file_read_path(&d->file, path)) {
+		const char *p = proc_scan_u64(d->file.buf, &run_delay);
+
+		if (p)
+			proc_scan_u64(p, &run_delay);
+	}
+
+	if (!d->first) {
+		d->vol += vol - t->vol;
+		d->invol += invol - t->invol;
+		d->run_delay += run_delay - t->run_delay;
+		if (thread) {
+			d->threads.ticks += thread->ticks - t->thread.ticks;
+			d->threads.minflt += thread->minflt - t->thread.minflt;
+			d->threads.majflt += thread->majflt - t->thread.majflt;
+		}
+	}
+	if (thread)
+		t->thread = *thread;
+	t->vol = vol;
+	t->invol = invol;
+	t->run_delay = run_delay;
+	t->gen = d->gen;
+	return 0;
+}
+
+/* Queue the children listed in dir/children */
+static int monitor_process_queue_children(struct monitor_process_data *d,
+		struct monitor_process_sample *s, const char *dir)
+{
+	char path[96];
+	const char *p;
+	uint64_t pid;
+
+	snprintf(path, sizeof(path), "%s/children", dir);
+	if (proc_file_read_path(&d->file, path))
+		return 0;
+
+	for (p = d->file.buf; (p = proc_scan_u64(p, &pid)); ) {
+		if (s->nr_queue == d->size_queue) {
+			int size = d->size_queue ? d->size_queue * 2 : 64;
+			pid_t *queue = realloc(d->queue, sizeof(*queue) * size);
+
+			if (!queue)
+				return -1;
+			d->queue = queue;
+			d->size_queue = size;
+		}
+		d->queue[s->nr_queue++] = pid;
+	}
+	return 0;
+}
+
+/*
+ * A thread of the suite, the reaped children are in the values of the suite.
+ * Its values are summed from their changes, the values of a thread that
+ * exited stay in the sum.
+ */
+static int monitor_process_thread(struct monitor_process_data *d,
+		struct monitor_process_sample *s, pid_t tid)
+{
+	struct monitor_process_sum thread;
+	int64_t vals[NR_PROCESS_STAT];
+	char dir[64];
+	char path[96];
+
+	snprintf(dir, sizeof(dir), "/proc/self/task/%d", (int)tid);
+	snprintf(path, sizeof(path), "%s/stat", dir);
+	if (monitor_process_read_stat(d, path, vals))
+		return 0;
+
+	thread.ticks = vals[STAT_UTIME] + vals[STAT_STIME];
+	thread.minflt = vals[STAT_MINFLT];
+	thread.majflt = vals[STAT_MAJFLT];
+	++s->nr_tasks;
+
+	if (monitor_process_counters(d, dir, tid, &thread))
+		return -1;
+	return monitor_process_queue_children(d, s, dir);
+}
+
+/* A child process with its own threads and reaped children */
+static int monitor_process_child(struct monitor_process_data *d,
+		struct monitor_process_sample *s, pid_t pid)
+{
+	int64_t vals[NR_PROCESS_STAT];
+	char dir[64];
+	char path[96];
+
+	snprintf(dir, sizeof(dir), "/proc/%d", (int)pid);
+	snprintf(path, sizeof(path), "%s/stat", dir);
+	if (monitor_process_read_stat(d, path, vals))
+		return 0;
+
+	s->sum.ticks += vals[STAT_UTIME] + vals[STAT_STIME]
+			+ vals[STAT_CUTIME] + vals[STAT_CSTIME];
+	s->sum.minflt += vals[STAT_MINFLT] + vals[STAT_CMINFLT];
+	s->sum.majflt += vals[STAT_MAJFLT] + vals[STAT_CMAJFLT];
+	s->rss += vals[STAT_RSS] * monitor_process_page_size;
+	++s->nr_tasks;
+
+	if (monitor_process_counters(d, dir, pid, NULL))
+		return -1;
+	snprintf(dir, sizeof(dir), "/proc/%d/task/%d", (int)pid, (int)pid);
+	return monitor_process_queue_children(d, s, dir);
+}
+
+/*
+ * Threads of the suite that are tracked: the threads executing the tracked
+ * plugins and the threads they created. Threads of the core, of monitors and,
+ * without the background option, of background plugins are not tracked.
+ */
+static int monitor_process_tracked(struct plugin *plug, int background,
+		pid_t tid)
+{
+	struct plugin *owner = plugin_thread_owner(plug, tid);
+
+	if (!owner || owner->id->monitor)
+		return 0;
+	return owner->primary || background;
+}
+
+static int monitor_process_get(struct plugin *plug,
+		struct monitor_process_sample *s)
+{
+	struct monitor_process_data *d = plugin_get_data(plug);
+	int64_t vals[NR_PROCESS_STAT];
+	struct dirent *ent;
+	DIR *dir;
+	int i, j;
+
+	memset(s, 0, sizeof(*s));
+	++d->gen;
+
+	/* Children of the plugin threads are reaped by the suite process */
+	if (!monitor_process_read_stat(d, "/proc/self/stat", vals)) {
+		s->sum.ticks = vals[STAT_CUTIME] + vals[STAT_CSTIME];
+		s->sum.minflt = vals[STAT_CMINFLT];
+		s->sum.majflt = vals[STAT_CMAJFLT];
+	}
+
+	dir = opendir("/proc/self/task");
+	if (!dir) {
+		printf("Error: Could not open /proc/self/task\n");
+		return -1;
+	}
+	while ((ent = readdir(dir))) {
+		pid_t tid = atoi(ent->d_name);
+
+		if (tid <= 0 || !monitor_process_tracked(plug, d->background, tid))
+			continue;
+		if (monitor_process_thread(d, s, tid)) {
+			closedir(dir);
+			return -1;
+		}
+	}
+	closedir(dir);
+
+	for (i = 0; i != s->nr_queue; ++i)
+		if (monitor_process_child(d, s, d->queue[i]))
+			return -1;
+
+	/* Forget the tasks that are gone */
+	for (i = 0, j = 0; i != d->nr_tasks; ++i)
+		if (d->tasks[i].gen == d->gen)
+			d->tasks[j++] = d->tasks[i];
+	d->nr_tasks = j;
+
+	return 0;
+}
+
+static int monitor_process_install(struct plugin *plug)
+{
+	struct monitor_process_data *d = calloc(1, sizeof(*d));
+
+	if (!d)
+		return -1;
+
+	proc_file_init(&d->file);
+	plugin_set_data(plug, d);
+
+	return 0;
+}
+
+static int monitor_process_uninstall(struct plugin *plug)
+{
+	struct monitor_process_data *d = plugin_get_data(plug);
+
+	proc_file_close(&d->file);
+	free(d->tasks);
+	free(d->queue);
+	free(d);
+
+	plugin_set_data(plug, NULL);
+	return 0;
+}
+
+static int monitor_process_init(struct plugin *plug)
+{
+	struct monitor_process_data *d = plugin_get_data(plug);
+
+	d->first = 1;
+	d->background = option_get_int32(plugin_get_options(plug), "background");
+	d->vol = 0;
+	d->invol = 0;
+	d->run_delay = 0;
+	memset(&d->threads, 0, sizeof(d->threads));
+	d->nr_tasks = 0;
+	return 0;
+}
+
+static int monitor_process_mon(struct plugin *plug)
+{
+	struct monitor_process_data *d = plugin_get_data(plug);
+	struct monitor_process_sample s;
+	struct data *dat;
+	int ret;
+	struct timespec time;
+	double now;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	ret = monitor_process_get(plug, &s);
+	if (ret)
+		return ret;
+
+	dat = data_alloc(DATA_TYPE_MONITOR, 9);
+	if (!dat)
+		return -1;
+
+	now = time.tv_sec + time.tv_nsec / 1000000000.0;
+
+	if (d->first) {
+		d->initial = s.sum;
+		d->start_time = now;
+		d->first = 0;
+	}
+
+	now -= d->start_time;
+
+	data_add_double(dat, now);
+	data_add_int32(dat, s.nr_tasks);
+	data_add_double(dat, (double)(s.sum.ticks - d->initial.ticks
+			+ d->threads.ticks) / monitor_process_clk_tck);
+	data_add_int64(dat, d->vol);
+	data_add_int64(dat, d->invol);
+	data_add_int64(dat, d->run_delay);
+	data_add_int64(dat, s.sum.minflt - d->initial.minflt
+			+ d->threads.minflt);
+	data_add_int64(dat, s.sum.majflt - d->initial.majflt
+			+ d->threads.majflt);
+	data_add_int64(dat, s.rss);
+
+	plugin_add_results(plug, dat);
+
+	return 0;
+}
+
+static const struct header *monitor_process_data_hdr(struct plugin *plug)
+{
+	static const struct header hdr[] = {
+		{
+			.name = "time",
+			.unit = "s",
+			.description = "Time of this measurement.",
+		}, {
+			.name = "tasks",
+			.description = "Number of benchmark threads, including the threads they created, and their child processes.",
+		}, {
+			.name = "cpu_time",
+			.unit = "s",
+			.description = "User and system time of the benchmarks and their children since the first measurement.",
+		}, {
+			.name = "voluntary_switches",
+			.description = "Voluntary context switches of the benchmark tasks since the first measurement, tasks that ran shorter than a measurement interval are missing.",
+		}, {
+			.name = "involuntary_switches",
+			.description = "Involuntary context switches of the benchmark tasks since the first measurement, tasks that ran shorter than a measurement interval are missing.",
+		}, {
+			.name = "run_delay",
+			.unit = "ns",
+			.description = "Time the benchmark tasks waited on a run queue since the first measurement, tasks that ran shorter than a measurement interval are missing.",
+		}, {
+			.name = "minor_faults",
+			.description = "Minor page faults of the benchmarks and their children since the first measurement.",
+		}, {
+			.name = "major_faults",
+			.description = "Major page faults of the benchmarks and their children since the first measurement.",
+		}, {
+			.name = "rss",
+			.unit = "B",
+			.description = "Resident memory of the child processes, benchmarks running in the suite process share its memory.",
+		}, {
+			/* Sentinel */
+		}
+	};
+
+	return hdr;
+}
+
+static int monitor_process_mod_init(struct module *mod,
+				    const struct plugin_id *plug)
+{
+	if (!access(monitor_process_children_path, F_OK | R_OK))
+		plugin_monitor_process_requirements[0].found = 1;
+
+	monitor_process_clk_tck = sysconf(_SC_CLK_TCK);
+	if (monitor_process_clk_tck < 1)
+		monitor_process_clk_tck = 100;
+	monitor_process_page_size = sysconf(_SC_PAGESIZE);
+
+	return 0;
+}
+
+const struct plugin_id plugin_process = {
+	.name = "monitor-process",
+	.description = "Monitor plugin to keep track of the CPU time, context switches, page faults and memory of the benchmarks in the same group and their child processes.",
+	.module_init = monitor_process_mod_init,
+	.install = monitor_process_install,
+	.uninstall = monitor_process_uninstall,
+	.init = monitor_process_init,
+	.monitor = monitor_process_mon,
+	.versions = plugin_monitor_process_versions,
+	.data_hdr = monitor_process_data_hdr,
+};
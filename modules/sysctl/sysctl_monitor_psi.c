@@ -0,0 +1,299 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cbench/data.h>
+#include <cbench/requirement.h>
+#include <cbench/version.h>
+#include <cbench/plugin.h>
+
+#include "proc_file.h"
+
+static const char *monitor_psi_paths[] = {
+	"/proc/pressure/cpu",
+	"/proc/pressure/memory",
+	"/proc/pressure/io",
+};
+#define NR_PSI_RESOURCES 3
+
+static struct requirement plugin_monitor_psi_requirements[] = {
+	{
+		.name = "/proc/pressure",
+		.description = "This plugin uses the pressure stall information in /proc/pressure to monitor the system.",
+		.found = 0,
+	},
+	{ }
+};
+
+static struct version plugin_monitor_psi_versions[] = {
+	{
+		.version = "0.1",
+		.requirements = plugin_monitor_psi_requirements,
+	}, {
+		/* Sentinel */
+	}
+};
+
+/* Lines of a pressure file, kernels before 5.13 have no full line for cpu */
+enum monitor_psi_line {
+	PSI_SOME,
+	PSI_FULL,
+	NR_PSI_LINES,
+};
+
+struct monitor_psi_line_val {
+	double avg10;
+	uint64_t total;
+};
+
+struct monitor_psi {
+	struct monitor_psi_line_val val[NR_PSI_RESOURCES][NR_PSI_LINES];
+};
+
+#define NR_PSI_COLUMNS (1 + NR_PSI_RESOURCES * NR_PSI_LINES * 2)
+
+struct monitor_psi_data {
+	struct proc_file files[NR_PSI_RESOURCES];
+	int first;
+
+	double start_time;
+	/* Values at the previous measurement */
+	struct monitor_psi prev;
+};
+
+static int monitor_psi_install(struct plugin *plug)
+{
+	struct monitor_psi_data *d = calloc(1, sizeof(*d));
+	int i;
+
+	if (!d)
+		return -1;
+
+	for (i = 0; i != NR_PSI_RESOURCES; ++i) {
+		if (proc_file_open(&d->files[i], monitor_psi_paths[i])) {
+			while (i--)
+				proc_file_close(&d->files[i]);
+			free(d);
+			return -1;
+		}
+	}
+
+	plugin_set_data(plug, d);
+
+	return 0;
+}
+
+static int monitor_psi_uninstall(struct plugin *plug)
+{
+	struct monitor_psi_data *d = plugin_get_data(plug);
+	int i;
+
+	for (i = 0; i != NR_PSI_RESOURCES; ++i)
+		proc_file_close(&d->files[i]);
+	free(d);
+
+	plugin_set_data(plug, NULL);
+	return 0;
+}
+
+static int monitor_psi_init(struct plugin *plug)
+{
+	struct monitor_psi_data *d = plugin_get_data(plug);
+
+	d->first = 1;
+	return 0;
+}
+
+/* Parse the value of "KEY=" in a line, avg values have two decimals */
+static const char *monitor_psi_scan(const char *p, const char *key,
+		uint64_t *val, uint64_t *frac)
+{
+	size_t len = strlen(key);
+	uint64_t f = 0;
+	int digits = 0;
+
+	while (*p == ' ')
+		++p;
+	if (strncmp(p, key, len))
+		return NULL;
+	p = proc_scan_u64(p + len, val);
+	if (!p)
+		return NULL;
+	if (*p == '.') {
+		for (++p; proc_is_digit(*p); ++p, ++digits)
+			if (digits < 2)
+				f = f * 10 + (*p - '0');
+		if (digits == 1)
+			f *= 10;
+	}
+	if (frac)
+		*frac = f;
+	return p;
+}
+
+static void monitor_psi_parse_line(const char *p,
+		struct monitor_psi_line_val *val)
+{
+	uint64_t v, frac;
+
+	p = monitor_psi_scan(p, "avg10=", &v, &frac);
+	if (!p)
+		return;
+	val->avg10 = v + frac / 100.0;
+
+	p = monitor_psi_scan(p, "avg60=", &v, &frac);
+	if (p)
+		p = monitor_psi_scan(p, "avg300=", &v, &frac);
+	if (p)
+		monitor_psi_scan(p, "total=", &val->total, NULL);
+}
+
+static int monitor_psi_get(struct plugin *plug, struct monitor_psi *psi)
+{
+	struct monitor_psi_data *d = plugin_get_data(plug);
+	int i;
+
+	memset(psi, 0, sizeof(*psi));
+
+	for (i = 0; i != NR_PSI_RESOURCES; ++i) {
+		const char *p;
+
+		if (proc_file_read(&d->files[i]))
+			return -1;
+
+		for (p = d->files[i].buf; p && *p; p = proc_next_line(p)) {
+			if (!strncmp(p, "some ", 5))
+				monitor_psi_parse_line(p + 5, &psi->val[i][PSI_SOME]);
+			else if (!strncmp(p, "full ", 5))
+				monitor_psi_parse_line(p + 5, &psi->val[i][PSI_FULL]);
+		}
+	}
+
+	return 0;
+}
+
+static int monitor_psi_mon(struct plugin *plug)
+{
+	struct monitor_psi_data *d = plugin_get_data(plug);
+	struct monitor_psi psi;
+	struct data *dat;
+	int ret;
+	struct timespec time;
+	double now;
+	int i, j;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	ret = monitor_psi_get(plug, &psi);
+	if (ret)
+		return ret;
+
+	dat = data_alloc(DATA_TYPE_MONITOR, NR_PSI_COLUMNS);
+	if (!dat)
+		return -1;
+
+	now = time.tv_sec + time.tv_nsec / 1000000000.0;
+
+	if (d->first) {
+		d->prev = psi;
+		d->start_time = now;
+		d->first = 0;
+	}
+
+	now -= d->start_time;
+
+	data_add_double(dat, now);
+	for (i = 0; i != NR_PSI_RESOURCES; ++i) {
+		for (j = 0; j != NR_PSI_LINES; ++j) {
+			data_add_double(dat, psi.val[i][j].avg10);
+			data_add_int64(dat, psi.val[i][j].total
+					- d->prev.val[i][j].total);
+		}
+	}
+	d->prev = psi;
+
+	plugin_add_results(plug, dat);
+
+	return 0;
+}
+
+#define PSI_HDR(res, line, what)						\
+	{									\
+		.name = res "_" line "_avg10",					\
+		.unit = "%",							\
+		.description = "Share of the last 10 seconds in which " what "."	\
+	}, {									\
+		.name = res "_" line "_stall",					\
+		.unit = "us",							\
+		.description = "Stall time since the previous measurement in which " what "."	\
+	}
+
+static const struct header monitor_psi_hdr[NR_PSI_COLUMNS + 1] = {
+	{
+		.name = "time",
+		.unit = "s",
+		.description = "Time of this measurement.",
+	},
+	PSI_HDR("cpu", "some", "some runnable tasks waited for a CPU"),
+	PSI_HDR("cpu", "full", "all non-idle tasks waited for a CPU"),
+	PSI_HDR("memory", "some", "some tasks stalled on memory"),
+	PSI_HDR("memory", "full", "all non-idle tasks stalled on memory"),
+	PSI_HDR("io", "some", "some tasks stalled on IO"),
+	PSI_HDR("io", "full", "all non-idle tasks stalled on IO"),
+	{
+		/* Sentinel */
+	}
+};
+
+static const struct header *monitor_psi_data_hdr(struct plugin *plug)
+{
+	return monitor_psi_hdr;
+}
+
+static int monitor_psi_mod_init(struct module *mod,
+				const struct plugin_id *plug)
+{
+	int i;
+
+	for (i = 0; i != NR_PSI_RESOURCES; ++i)
+		if (access(monitor_psi_paths[i], F_OK | R_OK))
+			return 0;
+	plugin_monitor_psi_requirements[0].found = 1;
+
+	return 0;
+}
+
+const struct plugin_id plugin_psi = {
+	.name = "monitor-psi",
+	.description = "Monitor plugin to keep track of the CPU, memory and IO pressure shown in /proc/pressure.",
+	.module_init = monitor_psi_mod_init,
+	.install = monitor_psi_install,
+	.uninstall = monitor_psi_uninstall,
+	.init = monitor_psi_init,
+	.monitor = monitor_psi_mon,
+	.versions = plugin_monitor_psi_versions,
+	.data_hdr = monitor_psi_data_hdr,
+};
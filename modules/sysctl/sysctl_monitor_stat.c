@@ -24,10 +24,14 @@
 #include <unistd.h>
 
 #include <cbench/data.h>
+#include <cbench/option.h>
+#include <cbench/plugin_id_helper.h>
 #include <cbench/requirement.h>
 #include <cbench/version.h>
 #include <cbench/plugin.h>
 
+#include "proc_file.h"
+
 static const char monitor_stats_path[] = "/proc/stat";
 
 static struct requirement plugin_monitor_stats_requirements[] = {
@@ -39,26 +43,60 @@ static struct requirement plugin_monitor_stats_requirements[] = {
 	{ }
 };
 
+static struct header plugin_monitor_stats_options[] = {
+	OPTION_BOOL("per_cpu", "Add the user, system, idle, iowait, irq, softirq and steal time of every CPU", NULL, 0),
+	OPTION_SENTINEL
+};
+
 static struct version plugin_monitor_stats_versions[] = {
 	{
 		.version = "0.1",
 		.requirements = plugin_monitor_stats_requirements,
+		.default_options = plugin_monitor_stats_options,
 	}, {
 		/* Sentinel */
 	}
 };
 
+/* Times of a cpu line in the order of /proc/stat */
+enum monitor_stat_cpu {
+	STAT_USER,
+	STAT_NICE,
+	STAT_SYSTEM,
+	STAT_IDLE,
+	STAT_IOWAIT,
+	STAT_IRQ,
+	STAT_SOFTIRQ,
+	STAT_STEAL,
+	STAT_GUEST,
+	STAT_GUEST_NICE,
+	NR_STAT_CPU,
+};
+
+/* Times exported for every CPU and the header names they get */
+static const enum monitor_stat_cpu monitor_stat_per_cpu[] = {
+	STAT_USER,
+	STAT_SYSTEM,
+	STAT_IDLE,
+	STAT_IOWAIT,
+	STAT_IRQ,
+	STAT_SOFTIRQ,
+	STAT_STEAL,
+};
+#define NR_STAT_PER_CPU (sizeof(monitor_stat_per_cpu) / sizeof(*monitor_stat_per_cpu))
+
+static const char *monitor_stat_per_cpu_names[] = {
+	"user",
+	"system",
+	"idle",
+	"iowait",
+	"irq",
+	"softirq",
+	"steal",
+};
+
 struct monitor_stats {
-	uint64_t cpu_user;
-	uint64_t cpu_nice;
-	uint64_t cpu_system;
-	uint64_t cpu_idle;
-	uint64_t cpu_iowait;
-	uint64_t cpu_irq;
-	uint64_t cpu_softirq;
-	uint64_t cpu_steal;
-	uint64_t cpu_guest;
-	uint64_t cpu_guest_nice;
+	uint64_t cpu[NR_STAT_CPU];
 
 	uint64_t intr_total;
 
@@ -68,23 +106,45 @@ struct monitor_stats {
 	uint64_t procs_blocked;
 };
 
+#define NR_STAT_COLUMNS 16
+
 struct monitor_stat_data {
-	char *buf;
-	size_t buf_len;
+	struct proc_file file;
 	int first;
+	int per_cpu;
 
 	double start_time;
 	struct monitor_stats initial;
+	struct monitor_stats stats;
+
+	/* NR_STAT_CPU times of every CPU, now and at the first sample */
+	uint64_t *cpus;
+	uint64_t *cpus_initial;
 };
 
+/* Every possible CPU, the per CPU header is the same for all plugins */
+static int monitor_stat_nr_cpus;
+static struct header *monitor_stat_cpu_hdr;
+
 static int monitor_stat_install(struct plugin *plug)
 {
-	struct monitor_stat_data *d = malloc(sizeof(*d));
+	struct monitor_stat_data *d = calloc(1, sizeof(*d));
 
 	if (!d)
 		return -1;
 
-	d->buf = NULL;
+	if (proc_file_open(&d->file, monitor_stats_path)) {
+		free(d);
+		return -1;
+	}
+
+	d->cpus = calloc(2 * monitor_stat_nr_cpus * NR_STAT_CPU, sizeof(*d->cpus));
+	if (!d->cpus) {
+		proc_file_close(&d->file);
+		free(d);
+		return -1;
+	}
+	d->cpus_initial = d->cpus + monitor_stat_nr_cpus * NR_STAT_CPU;
 
 	plugin_set_data(plug, d);
 
@@ -95,11 +155,8 @@ static int monitor_stat_uninstall(struct plugin *plug)
 {
 	struct monitor_stat_data *d = plugin_get_data(plug);
 
-	if (d->buf) {
-		free(d->buf);
-		d->buf = NULL;
-	}
-
+	proc_file_close(&d->file);
+	free(d->cpus);
 	free(d);
 
 	plugin_set_data(plug, NULL);
@@ -111,74 +168,93 @@ static int monitor_stat_init(struct plugin *plug)
 	struct monitor_stat_data *d = plugin_get_data(plug);
 
 	d->first = 1;
+	d->per_cpu = option_get_int32(plugin_get_options(plug), "per_cpu")
+			&& monitor_stat_cpu_hdr;
 	return 0;
 }
 
-static int monitor_stat_get(struct plugin *plug, struct monitor_stats *stat)
+/* Parse NR_STAT_CPU times, kernels without the guest times leave them 0 */
+static const char *monitor_stat_scan_cpu(const char *p, uint64_t *times)
 {
-	FILE *f;
-	int found = 0;
-	struct monitor_stat_data *d = plugin_get_data(plug);
+	int i;
 
-	f = fopen(monitor_stats_path, "r");
-	if (!f) {
-		printf("Error: Could not open file %s\n", monitor_stats_path);
-		return -1;
-	}
-
-	while (0 < getline(&d->buf, &d->buf_len, f)) {
-		int ret;
-
-		if (!strncmp(d->buf, "cpu ", 4)) {
-			ret = sscanf(d->buf, "cpu %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 "\n",
-					&stat->cpu_user, &stat->cpu_nice, &stat->cpu_system,
-					&stat->cpu_idle, &stat->cpu_iowait,
-					&stat->cpu_irq, &stat->cpu_softirq,
-					&stat->cpu_steal, &stat->cpu_guest,
-					&stat->cpu_guest_nice);
-			if (ret == 10) {
-				found |= 0x1;
-				continue;
-			}
-		}
+	for (i = 0; i != NR_STAT_CPU; ++i) {
+		const char *next = proc_scan_u64(p, &times[i]);
 
-		ret = sscanf(d->buf, "intr %" PRIu64 " ", &stat->intr_total);
-		if (ret == 1) {
-			found |= 0x2;
+		if (!next) {
+			if (i < STAT_GUEST)
+				return NULL;
+			times[i] = 0;
 			continue;
 		}
+		p = next;
+	}
+	return p;
+}
 
-		ret = sscanf(d->buf, "ctxt %" PRIu64 " ", &stat->ctxt);
-		if (ret == 1) {
-			found |= 0x4;
-			continue;
-		}
+/* Value of the line starting with key at p, found is updated on success */
+static int monitor_stat_scan_key(const char *p, const char *key, size_t len,
+		uint64_t *val, int *found, int flag)
+{
+	if (strncmp(p, key, len) || !proc_scan_u64(p + len, val))
+		return 0;
+	*found |= flag;
+	return 1;
+}
 
-		ret = sscanf(d->buf, "processes %" PRIu64 " ", &stat->processes);
-		if (ret == 1) {
-			found |= 0x8;
-			continue;
-		}
+/*
+ * One pass over the buffer. Lines are told apart by their first characters,
+ * so the long intr and softirq lines are only skipped.
+ */
+static int monitor_stat_get(struct plugin *plug, struct monitor_stats *stat)
+{
+	struct monitor_stat_data *d = plugin_get_data(plug);
+	const char *p;
+	int found = 0;
 
-		ret = sscanf(d->buf, "procs_running %" PRIu64 " ", &stat->procs_running);
-		if (ret == 1) {
-			found |= 0x10;
-			continue;
-		}
+	if (proc_file_read(&d->file))
+		return -1;
 
-		ret = sscanf(d->buf, "procs_blocked %" PRIu64 " ", &stat->procs_blocked);
-		if (ret == 1) {
-			found |= 0x20;
-			continue;
+	for (p = d->file.buf; p && *p; p = proc_next_line(p)) {
+		switch (p[0]) {
+		case 'c':
+			if (p[1] == 'p' && p[2] == 'u') {
+				uint64_t cpu;
+				const char *q;
+
+				if (p[3] == ' ') {
+					if (monitor_stat_scan_cpu(p + 3, stat->cpu))
+						found |= 0x1;
+					continue;
+				}
+				if (!d->per_cpu)
+					continue;
+				q = proc_scan_u64(p + 3, &cpu);
+				if (q && cpu < monitor_stat_nr_cpus)
+					monitor_stat_scan_cpu(q, &d->cpus[cpu * NR_STAT_CPU]);
+				continue;
+			}
+			monitor_stat_scan_key(p, "ctxt ", 5, &stat->ctxt, &found, 0x4);
+			break;
+		case 'i':
+			monitor_stat_scan_key(p, "intr ", 5, &stat->intr_total,
+					&found, 0x2);
+			break;
+		case 'p':
+			if (monitor_stat_scan_key(p, "processes ", 10,
+					&stat->processes, &found, 0x8))
+				break;
+			if (monitor_stat_scan_key(p, "procs_running ", 14,
+					&stat->procs_running, &found, 0x10))
+				break;
+			monitor_stat_scan_key(p, "procs_blocked ", 14,
+					&stat->procs_blocked, &found, 0x20);
+			break;
 		}
-
 	}
 
-	fclose(f);
-
 	if (found != 0x3f) {
 		printf("Failed to find some data in %s\n", monitor_stats_path);
-		monitor_stat_uninstall(plug);
 		return -1;
 	}
 
@@ -188,125 +264,156 @@ static int monitor_stat_get(struct plugin *plug, struct monitor_stats *stat)
 static int monitor_stat_mon(struct plugin *plug)
 {
 	struct monitor_stat_data *d = plugin_get_data(plug);
-	struct monitor_stats stats;
+	struct monitor_stats *stats = &d->stats;
 	struct data *dat;
 	int ret;
 	struct timespec time;
 	double now;
+	int nr_cpu_values = d->per_cpu ? monitor_stat_nr_cpus * NR_STAT_PER_CPU : 0;
+	int i, j;
 
 	clock_gettime(CLOCK_MONOTONIC, &time);
 
-	ret = monitor_stat_get(plug, &stats);
+	ret = monitor_stat_get(plug, stats);
 	if (ret)
 		return ret;
 
-	dat = data_alloc(DATA_TYPE_MONITOR, 16);
+	dat = data_alloc(DATA_TYPE_MONITOR, NR_STAT_COLUMNS + nr_cpu_values);
 	if (!dat)
 		return -1;
 
 	now = time.tv_sec + time.tv_nsec / 1000000000.0;
 
 	if (d->first) {
-		d->initial = stats;
+		d->initial = *stats;
+		if (d->per_cpu)
+			memcpy(d->cpus_initial, d->cpus, sizeof(*d->cpus)
+					* monitor_stat_nr_cpus * NR_STAT_CPU);
 		d->start_time = now;
 		d->first = 0;
 	}
 
 	now -= d->start_time;
-	stats.cpu_user -= d->initial.cpu_user;
-	stats.cpu_nice -= d->initial.cpu_nice;
-	stats.cpu_system -= d->initial.cpu_system;
-	stats.cpu_idle -= d->initial.cpu_idle;
-	stats.cpu_iowait -= d->initial.cpu_iowait;
-	stats.cpu_irq -= d->initial.cpu_irq;
-	stats.cpu_softirq -= d->initial.cpu_softirq;
-	stats.cpu_steal -= d->initial.cpu_steal;
-	stats.cpu_guest -= d->initial.cpu_guest;
-	stats.cpu_guest_nice -= d->initial.cpu_guest_nice;
-	stats.ctxt -= d->initial.ctxt;
-	stats.intr_total -= d->initial.intr_total;
-	stats.processes -= d->initial.processes;
 
 	data_add_double(dat, now);
-	data_add_int64(dat, stats.cpu_user);
-	data_add_int64(dat, stats.cpu_nice);
-	data_add_int64(dat, stats.cpu_system);
-	data_add_int64(dat, stats.cpu_idle);
-	data_add_int64(dat, stats.cpu_iowait);
-	data_add_int64(dat, stats.cpu_irq);
-	data_add_int64(dat, stats.cpu_softirq);
-	data_add_int64(dat, stats.cpu_steal);
-	data_add_int64(dat, stats.cpu_guest);
-	data_add_int64(dat, stats.cpu_guest_nice);
-	data_add_int64(dat, stats.intr_total);
-	data_add_int64(dat, stats.ctxt);
-	data_add_int64(dat, stats.processes);
-	data_add_int64(dat, stats.procs_running);
-	data_add_int64(dat, stats.procs_blocked);
+	for (i = 0; i != NR_STAT_CPU; ++i)
+		data_add_int64(dat, stats->cpu[i] - d->initial.cpu[i]);
+	data_add_int64(dat, stats->intr_total - d->initial.intr_total);
+	data_add_int64(dat, stats->ctxt - d->initial.ctxt);
+	data_add_int64(dat, stats->processes - d->initial.processes);
+	data_add_int64(dat, stats->procs_running);
+	data_add_int64(dat, stats->procs_blocked);
+
+	for (i = 0; i != monitor_stat_nr_cpus && d->per_cpu; ++i) {
+		uint64_t *cur = &d->cpus[i * NR_STAT_CPU];
+		uint64_t *initial = &d->cpus_initial[i * NR_STAT_CPU];
+
+		for (j = 0; j != NR_STAT_PER_CPU; ++j) {
+			enum monitor_stat_cpu f = monitor_stat_per_cpu[j];
+
+			data_add_int64(dat, cur[f] - initial[f]);
+		}
+	}
 
 	plugin_add_results(plug, dat);
 
 	return 0;
 }
 
+static const struct header monitor_stat_hdr[NR_STAT_COLUMNS + 1] = {
+	{
+		.name = "time",
+		.unit = "s",
+		.description = "Time of this measurement.",
+	}, {
+		.name = "cpu_user",
+		.description = "Normal processes executing in user mode.",
+	}, {
+		.name = "cpu_nice",
+		.description = "Niced processes executing in user mode.",
+	}, {
+		.name = "cpu_system",
+		.description = "Processes executing in kernel mode.",
+	}, {
+		.name = "cpu_idle",
+		.description = "Twiddling thumbs.",
+	}, {
+		.name = "cpu_iowait",
+		.description = "Waiting for I/O to complete.",
+	}, {
+		.name = "cpu_irq",
+		.description = "Servicing interrupts.",
+	}, {
+		.name = "cpu_softirq",
+		.description = "Servicing softirqs.",
+	}, {
+		.name = "cpu_steal",
+		.description = "Involuntary wait.",
+	}, {
+		.name = "cpu_guest",
+		.description = "Running a normal guest.",
+	}, {
+		.name = "cpu_guest_nice",
+		.description = "Running a niced guest.",
+	}, {
+		.name = "interrupts",
+		.description = "Total number of interrupts.",
+	}, {
+		.name = "contextswitches",
+		.description = "Total number of contextswitches.",
+	}, {
+		.name = "processes",
+		.description = "Total number of processes.",
+	}, {
+		.name = "procs_running",
+		.description = "Number of running processes.",
+	}, {
+		.name = "procs_blocked",
+		.description = "Number of blocked processes.",
+	}, {
+		/* Sentinel */
+	}
+};
+
 static const struct header *monitor_stat_data_hdr(struct plugin *plug)
 {
-	static const struct header hdr[] = {
-		{
-			.name = "time",
-			.unit = "s",
-			.description = "Time of this measurement.",
-		}, {
-			.name = "cpu_user",
-			.description = "Normal processes executing in user mode.",
-		}, {
-			.name = "cpu_nice",
-			.description = "Niced processes executing in user mode.",
-		}, {
-			.name = "cpu_system",
-			.description = "Processes executing in kernel mode.",
-		}, {
-			.name = "cpu_idle",
-			.description = "Twiddling thumbs.",
-		}, {
-			.name = "cpu_iowait",
-			.description = "Waiting for I/O to complete.",
-		}, {
-			.name = "cpu_irq",
-			.description = "Servicing interrupts.",
-		}, {
-			.name = "cpu_softirq",
-			.description = "Servicing softirqs.",
-		}, {
-			.name = "cpu_steal",
-			.description = "Involuntary wait.",
-		}, {
-			.name = "cpu_guest",
-			.description = "Running a normal guest.",
-		}, {
-			.name = "cpu_guest_nice",
-			.description = "Running a niced guest.",
-		}, {
-			.name = "interrupts",
-			.description = "Total number of interrupts.",
-		}, {
-			.name = "contextswitches",
-			.description = "Total number of contextswitches.",
-		}, {
-			.name = "processes",
-			.description = "Total number of processes.",
-		}, {
-			.name = "procs_running",
-			.description = "Number of running processes.",
-		}, {
-			.name = "procs_blocked",
-			.description = "Number of blocked processes.",
-		}, {
-			/* Sentinel */
-		}
-	};
+	if (monitor_stat_cpu_hdr
+			&& option_get_int32(plugin_get_options(plug), "per_cpu"))
+		return monitor_stat_cpu_hdr;
+	return monitor_stat_hdr;
+}
+
+/* The general columns followed by cpuN_TIME for every possible CPU */
+static int monitor_stat_build_cpu_hdr(void)
+{
+	int nr = monitor_stat_nr_cpus * NR_STAT_PER_CPU;
+	struct header *hdr;
+	char *names;
+	int i, j;
+
+	hdr = calloc(NR_STAT_COLUMNS + nr + 1, sizeof(*hdr));
+	names = malloc(nr * 32);
+	if (!hdr || !names) {
+		free(hdr);
+		free(names);
+		return -1;
+	}
 
-	return hdr;
+	memcpy(hdr, monitor_stat_hdr, sizeof(monitor_stat_hdr));
+	for (i = 0; i != monitor_stat_nr_cpus; ++i) {
+		for (j = 0; j != NR_STAT_PER_CPU; ++j) {
+			struct header *h = &hdr[NR_STAT_COLUMNS
+					+ i * NR_STAT_PER_CPU + j];
+			char *name = names + (i * NR_STAT_PER_CPU + j) * 32;
+
+			snprintf(name, 32, "cpu%d_%s", i,
+					monitor_stat_per_cpu_names[j]);
+			h->name = name;
+			h->description = "Time of this CPU since the first measurement.";
+		}
+	}
+	monitor_stat_cpu_hdr = hdr;
+	return 0;
 }
 
 static int monitor_stat_mod_init(struct module *mod,
@@ -315,13 +422,32 @@ static int monitor_stat_mod_init(struct module *mod,
 	if (!access(monitor_stats_path, F_OK | R_OK))
 		plugin_monitor_stats_requirements[0].found = 1;
 
+	monitor_stat_nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (monitor_stat_nr_cpus < 1)
+		monitor_stat_nr_cpus = 1;
+	if (monitor_stat_build_cpu_hdr())
+		printf("Error: Per CPU statistics of %s unavailable\n",
+				monitor_stats_path);
+
 	return 0;
 }
 
+static void monitor_stat_mod_exit(struct module *mod,
+				 const struct plugin_id *plug)
+{
+	if (!monitor_stat_cpu_hdr)
+		return;
+	/* All names are in one allocation starting with the first one */
+	free((char *)monitor_stat_cpu_hdr[NR_STAT_COLUMNS].name);
+	free(monitor_stat_cpu_hdr);
+	monitor_stat_cpu_hdr = NULL;
+}
+
 const struct plugin_id plugin_stat = {
 	.name = "monitor-stat",
 	.description = "Monitor plugin to keep track of different values shown in /proc/stat.",
 	.module_init = monitor_stat_mod_init,
+	.module_exit = monitor_stat_mod_exit,
 	.install = monitor_stat_install,
 	.uninstall = monitor_stat_uninstall,
 	.init = monitor_stat_init,
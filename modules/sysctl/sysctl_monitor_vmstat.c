@@ -0,0 +1,337 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cbench/data.h>
+#include <cbench/option.h>
+#include <cbench/plugin_id_helper.h>
+#include <cbench/requirement.h>
+#include <cbench/version.h>
+#include <cbench/plugin.h>
+
+#include "proc_file.h"
+
+static const char monitor_vmstat_path[] = "/proc/vmstat";
+
+static struct requirement plugin_monitor_vmstat_requirements[] = {
+	{
+		.name = monitor_vmstat_path,
+		.description = "This plugin uses /proc/vmstat to monitor the system.",
+		.found = 0,
+	},
+	{ }
+};
+
+static struct header plugin_monitor_vmstat_options[] = {
+	OPTION_STR("fields", "Comma separated list of the fields to monitor, a trailing '*' matches all fields with that prefix, a leading '!' excludes fields. Empty monitors all fields", NULL, ""),
+	OPTION_SENTINEL
+};
+
+static struct version plugin_monitor_vmstat_versions[] = {
+	{
+		.version = "0.1",
+		.requirements = plugin_monitor_vmstat_requirements,
+		.default_options = plugin_monitor_vmstat_options,
+	}, {
+		/* Sentinel */
+	}
+};
+
+/*
+ * Fields of the running kernel, found when the module is loaded. Event
+ * counters are exported as the change since the previous measurement, the
+ * nr_* gauges as they are.
+ */
+static struct proc_names monitor_vmstat_keys;
+static int *monitor_vmstat_gauge;
+static struct proc_filter *monitor_vmstat_filters;
+
+/* nr_* fields that count events instead of holding a current value */
+static const char *monitor_vmstat_nr_counters[] = {
+	"nr_dirtied",
+	"nr_written",
+	"nr_foll_pin_acquired",
+	"nr_foll_pin_released",
+	NULL
+};
+
+static const struct header monitor_vmstat_time_hdr[] = {
+	{
+		.name = "time",
+		.unit = "s",
+		.description = "Time of this measurement.",
+	}, {
+		/* Sentinel */
+	}
+};
+
+struct monitor_vmstat_data {
+	struct proc_file file;
+	int first;
+	const struct proc_filter *filter;
+
+	double start_time;
+	uint64_t *values;
+	/* Values at the previous measurement */
+	uint64_t *prev;
+};
+
+static const struct proc_filter *monitor_vmstat_get_filter(struct plugin *plug)
+{
+	struct proc_filter *f;
+	int i;
+
+	f = proc_filter_get(&monitor_vmstat_filters, &monitor_vmstat_keys,
+			option_get_str(plugin_get_options(plug), "fields"),
+			NULL, 0);
+	if (!f)
+		return NULL;
+
+	for (i = 0; i != f->nr; ++i) {
+		if (monitor_vmstat_gauge[f->sel[i]])
+			f->hdr[i + 1].description = "Current value.";
+		else
+			f->hdr[i + 1].description = "Change since the previous measurement.";
+	}
+	return f;
+}
+
+static int monitor_vmstat_is_gauge(const char *name)
+{
+	int i;
+
+	if (strncmp(name, "nr_", 3))
+		return 0;
+	for (i = 0; monitor_vmstat_nr_counters[i]; ++i)
+		if (!strcmp(name, monitor_vmstat_nr_counters[i]))
+			return 0;
+	return 1;
+}
+
+static int monitor_vmstat_read_keys(void)
+{
+	struct proc_file pf;
+	const char *p;
+	int i;
+
+	if (proc_file_open(&pf, monitor_vmstat_path))
+		return -1;
+
+	for (p = pf.buf; p && *p; p = proc_next_line(p)) {
+		int len;
+		const char *name = proc_scan_word(p, &len);
+
+		if (len && proc_names_add(&monitor_vmstat_keys, name, len))
+			goto error;
+	}
+	proc_file_close(&pf);
+
+	monitor_vmstat_gauge = calloc(monitor_vmstat_keys.nr + 1,
+			sizeof(*monitor_vmstat_gauge));
+	if (!monitor_vmstat_gauge) {
+		proc_names_free(&monitor_vmstat_keys);
+		return -1;
+	}
+	for (i = 0; i != monitor_vmstat_keys.nr; ++i)
+		monitor_vmstat_gauge[i] = monitor_vmstat_is_gauge(
+				monitor_vmstat_keys.names[i]);
+	return 0;
+
+error:
+	proc_file_close(&pf);
+	proc_names_free(&monitor_vmstat_keys);
+	return -1;
+}
+
+static int monitor_vmstat_install(struct plugin *plug)
+{
+	struct monitor_vmstat_data *d;
+
+	if (!monitor_vmstat_gauge) {
+		printf("Error: Fields of %s unknown\n", monitor_vmstat_path);
+		return -1;
+	}
+
+	d = calloc(1, sizeof(*d));
+	if (!d)
+		return -1;
+
+	d->values = calloc(2 * monitor_vmstat_keys.nr, sizeof(*d->values));
+	if (!d->values || proc_file_open(&d->file, monitor_vmstat_path)) {
+		free(d->values);
+		free(d);
+		return -1;
+	}
+	d->prev = d->values + monitor_vmstat_keys.nr;
+
+	plugin_set_data(plug, d);
+
+	return 0;
+}
+
+static int monitor_vmstat_uninstall(struct plugin *plug)
+{
+	struct monitor_vmstat_data *d = plugin_get_data(plug);
+
+	proc_file_close(&d->file);
+	free(d->values);
+	free(d);
+
+	plugin_set_data(plug, NULL);
+	return 0;
+}
+
+static int monitor_vmstat_init(struct plugin *plug)
+{
+	struct monitor_vmstat_data *d = plugin_get_data(plug);
+
+	d->first = 1;
+	d->filter = monitor_vmstat_get_filter(plug);
+	if (!d->filter)
+		return -1;
+	return 0;
+}
+
+/* One pass over the file */
+static int monitor_vmstat_get(struct plugin *plug)
+{
+	struct monitor_vmstat_data *d = plugin_get_data(plug);
+	const char *p;
+	int next = 0;
+
+	if (proc_file_read(&d->file))
+		return -1;
+
+	for (p = d->file.buf; p && *p; p = proc_next_line(p)) {
+		int len;
+		const char *name = proc_scan_word(p, &len);
+		int i = proc_names_find(&monitor_vmstat_keys, name, len, next);
+
+		if (i < 0)
+			continue;
+		proc_scan_u64(name + len, &d->values[i]);
+		next = i + 1;
+	}
+
+	return 0;
+}
+
+static int monitor_vmstat_mon(struct plugin *plug)
+{
+	struct monitor_vmstat_data *d = plugin_get_data(plug);
+	const struct proc_filter *f = d->filter;
+	struct data *dat;
+	int ret;
+	struct timespec time;
+	double now;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	ret = monitor_vmstat_get(plug);
+	if (ret)
+		return ret;
+
+	dat = data_alloc(DATA_TYPE_MONITOR, f->nr + 1);
+	if (!dat)
+		return -1;
+
+	now = time.tv_sec + time.tv_nsec / 1000000000.0;
+
+	if (d->first) {
+		memcpy(d->prev, d->values,
+				sizeof(*d->values) * monitor_vmstat_keys.nr);
+		d->start_time = now;
+		d->first = 0;
+	}
+
+	now -= d->start_time;
+
+	data_add_double(dat, now);
+	for (i = 0; i != f->nr; ++i) {
+		int k = f->sel[i];
+
+		if (monitor_vmstat_gauge[k])
+			data_add_int64(dat, d->values[k]);
+		else
+			data_add_int64(dat, d->values[k] - d->prev[k]);
+	}
+	memcpy(d->prev, d->values,
+			sizeof(*d->values) * monitor_vmstat_keys.nr);
+
+	plugin_add_results(plug, dat);
+
+	return 0;
+}
+
+static const struct header *monitor_vmstat_data_hdr(struct plugin *plug)
+{
+	const struct proc_filter *f;
+
+	if (!monitor_vmstat_gauge)
+		return monitor_vmstat_time_hdr;
+
+	f = monitor_vmstat_get_filter(plug);
+	if (!f)
+		return monitor_vmstat_time_hdr;
+	return f->hdr;
+}
+
+static int monitor_vmstat_mod_init(struct module *mod,
+				   const struct plugin_id *plug)
+{
+	if (access(monitor_vmstat_path, F_OK | R_OK))
+		return 0;
+
+	plugin_monitor_vmstat_requirements[0].found = 1;
+	if (monitor_vmstat_read_keys())
+		printf("Error: Failed to parse the fields of %s\n",
+				monitor_vmstat_path);
+
+	return 0;
+}
+
+static void monitor_vmstat_mod_exit(struct module *mod,
+				    const struct plugin_id *plug)
+{
+	proc_filter_free(&monitor_vmstat_filters);
+	proc_names_free(&monitor_vmstat_keys);
+	free(monitor_vmstat_gauge);
+	monitor_vmstat_gauge = NULL;
+}
+
+const struct plugin_id plugin_vmstat = {
+	.name = "monitor-vmstat",
+	.description = "Monitor plugin to keep track of paging, reclaim, compaction, THP and NUMA events shown in /proc/vmstat.",
+	.module_init = monitor_vmstat_mod_init,
+	.module_exit = monitor_vmstat_mod_exit,
+	.install = monitor_vmstat_install,
+	.uninstall = monitor_vmstat_uninstall,
+	.init = monitor_vmstat_init,
+	.monitor = monitor_vmstat_mon,
+	.versions = plugin_monitor_vmstat_versions,
+	.data_hdr = monitor_vmstat_data_hdr,
+};
@@ -21,13 +21,19 @@
 #include <stdint.h>
 #include <time.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <cbench/data.h>
+#include <cbench/option.h>
+#include <cbench/plugin_id_helper.h>
 #include <cbench/requirement.h>
 #include <cbench/version.h>
 #include <cbench/plugin.h>
 
+#include "proc_file.h"
+
 static const char monitor_schedstat_path[] = "/proc/schedstat";
 
 static struct requirement plugin_monitor_schedstat_requirements[] = {
@@ -39,10 +45,17 @@ static struct requirement plugin_monitor_schedstat_requirements[] = {
 	{ }
 };
 
+static struct header plugin_monitor_schedstat_options[] = {
+	OPTION_BOOL("per_cpu", "Add the run queue wait time and number of timeslices of every CPU", NULL, 0),
+	OPTION_BOOL("per_domain", "Add the load balancing counters of every scheduling domain level, summed over all CPUs", NULL, 0),
+	OPTION_SENTINEL
+};
+
 static struct version plugin_monitor_schedstat_versions[] = {
 	{
 		.version = "0.1",
 		.requirements = plugin_monitor_schedstat_requirements,
+		.default_options = plugin_monitor_schedstat_options,
 	}, {
 		/* Sentinel */
 	}
@@ -55,23 +68,178 @@ struct monitor_schedstat {
 	uint64_t ttwus;
 };
 
+#define NR_SCHEDSTAT_COLUMNS 5
+
+/* Values of a cpu line after the cpu number, the same for all versions */
+enum monitor_schedstat_cpu {
+	SCHEDSTAT_YLD_COUNT,
+	SCHEDSTAT_LEGACY,
+	SCHEDSTAT_SCHED_COUNT,
+	SCHEDSTAT_SCHED_GOIDLE,
+	SCHEDSTAT_TTWU_COUNT,
+	SCHEDSTAT_TTWU_LOCAL,
+	SCHEDSTAT_RQ_CPU_TIME,
+	SCHEDSTAT_RUN_DELAY,
+	SCHEDSTAT_PCOUNT,
+	NR_SCHEDSTAT_CPU,
+};
+
+/* Values stored and exported for every CPU */
+enum monitor_schedstat_per_cpu {
+	PER_CPU_RUN_DELAY,
+	PER_CPU_PCOUNT,
+	NR_SCHEDSTAT_PER_CPU,
+};
+
+/* Values stored and exported for every domain level */
+enum monitor_schedstat_per_domain {
+	PER_DOMAIN_LB_COUNT,
+	PER_DOMAIN_LB_FAILED,
+	PER_DOMAIN_LB_IMBALANCE,
+	PER_DOMAIN_ALB_PUSHED,
+	PER_DOMAIN_TTWU_WAKE_REMOTE,
+	PER_DOMAIN_TTWU_MOVE_AFFINE,
+	NR_SCHEDSTAT_PER_DOMAIN,
+};
+
+static const struct header monitor_schedstat_per_cpu_hdr[NR_SCHEDSTAT_PER_CPU] = {
+	{
+		.name = "run_delay",
+		.unit = "ns",
+		.description = "Time tasks spent waiting on the run queue of this CPU.",
+	}, {
+		.name = "pcount",
+		.description = "Number of timeslices run on this CPU.",
+	},
+};
+
+static const struct header monitor_schedstat_per_domain_hdr[NR_SCHEDSTAT_PER_DOMAIN] = {
+	{
+		.name = "lb_count",
+		.description = "Number of load_balance() calls in this domain level.",
+	}, {
+		.name = "lb_failed",
+		.description = "Number of load_balance() calls that failed to move tasks although the domain was imbalanced.",
+	}, {
+		.name = "lb_imbalance",
+		.description = "Sum of the imbalances found by load_balance() in this domain level.",
+	}, {
+		.name = "alb_pushed",
+		.description = "Number of tasks moved by active load balancing.",
+	}, {
+		.name = "ttwu_wake_remote",
+		.description = "Number of wakeups of tasks that last ran on another CPU of this domain level.",
+	}, {
+		.name = "ttwu_move_affine",
+		.description = "Number of wakeups that moved the task to the waking CPU (affine wakeup).",
+	},
+};
+
+/*
+ * Layout of the domain lines. Each idle type has lb_fields values starting
+ * with lb_count, lb_balanced, lb_failed followed by lb_imbalance_nr
+ * imbalance values. Version 16 only reordered the idle types, which does not
+ * matter as they are summed up. Version 17 added the domain name and split
+ * lb_imbalance into load, util, task and misfit.
+ */
+struct monitor_schedstat_layout {
+	int version;
+	int has_name;
+	int lb_fields;
+	int lb_imbalance_nr;
+};
+
+static const struct monitor_schedstat_layout monitor_schedstat_layouts[] = {
+	{ .version = 15, .has_name = 0, .lb_fields = 8, .lb_imbalance_nr = 1 },
+	{ .version = 16, .has_name = 0, .lb_fields = 8, .lb_imbalance_nr = 1 },
+	{ .version = 17, .has_name = 1, .lb_fields = 11, .lb_imbalance_nr = 4 },
+	{ }
+};
+
+#define SCHEDSTAT_IDLE_TYPES 3
+#define SCHEDSTAT_MAX_DOMAIN_VALUES 64
+
+/* Selected by the options, indexes monitor_schedstat_hdrs */
+#define SCHEDSTAT_PER_CPU 0x1
+#define SCHEDSTAT_PER_DOMAIN 0x2
+
 struct monitor_schedstat_data {
-	char *buf;
-	size_t buf_len;
+	struct proc_file file;
 	int first;
+	int flags;
+	const struct monitor_schedstat_layout *layout;
 
 	double start_time;
 	struct monitor_schedstat initial;
+
+	/*
+	 * NR_SCHEDSTAT_PER_CPU values of every CPU and NR_SCHEDSTAT_PER_DOMAIN
+	 * values of every domain level, now and at the first sample. All in
+	 * one allocation.
+	 */
+	uint64_t *cpus;
+	uint64_t *cpus_initial;
+	uint64_t *domains;
+	uint64_t *domains_initial;
 };
 
+/*
+ * Every possible CPU and the domain levels found at module load. The headers
+ * for the option combinations are the same for all plugins.
+ */
+static int monitor_schedstat_nr_cpus;
+static int monitor_schedstat_nr_domains;
+static struct header *monitor_schedstat_hdrs[4];
+static char *monitor_schedstat_names;
+
+static const struct monitor_schedstat_layout *monitor_schedstat_find_layout(
+		uint64_t version)
+{
+	const struct monitor_schedstat_layout *l;
+
+	for (l = monitor_schedstat_layouts; l->version; ++l)
+		if (l->version == version)
+			return l;
+	return NULL;
+}
+
+static int monitor_schedstat_flags(struct plugin *plug)
+{
+	const struct header *opts = plugin_get_options(plug);
+	int flags = 0;
+
+	if (option_get_int32(opts, "per_cpu")
+			&& monitor_schedstat_hdrs[SCHEDSTAT_PER_CPU])
+		flags |= SCHEDSTAT_PER_CPU;
+	if (option_get_int32(opts, "per_domain")
+			&& monitor_schedstat_hdrs[SCHEDSTAT_PER_DOMAIN])
+		flags |= SCHEDSTAT_PER_DOMAIN;
+	return flags;
+}
+
 static int monitor_schedstat_install(struct plugin *plug)
 {
-	struct monitor_schedstat_data *d = malloc(sizeof(*d));
+	struct monitor_schedstat_data *d = calloc(1, sizeof(*d));
+	int nr_cpu = monitor_schedstat_nr_cpus * NR_SCHEDSTAT_PER_CPU;
+	int nr_domain = monitor_schedstat_nr_domains * NR_SCHEDSTAT_PER_DOMAIN;
 
 	if (!d)
 		return -1;
 
-	d->buf = NULL;
+	if (proc_file_open(&d->file, monitor_schedstat_path)) {
+		free(d);
+		return -1;
+	}
+
+	d->cpus = calloc(2 * (nr_cpu + nr_domain), sizeof(*d->cpus));
+	if (!d->cpus) {
+		proc_file_close(&d->file);
+		free(d);
+		return -1;
+	}
+	d->cpus_initial = d->cpus + nr_cpu;
+	d->domains = d->cpus_initial + nr_cpu;
+	d->domains_initial = d->domains + nr_domain;
 
 	plugin_set_data(plug, d);
 
@@ -82,11 +250,8 @@ static int monitor_schedstat_uninstall(struct plugin *plug)
 {
 	struct monitor_schedstat_data *d = plugin_get_data(plug);
 
-	if (d->buf) {
-		free(d->buf);
-		d->buf = NULL;
-	}
-
+	proc_file_close(&d->file);
+	free(d->cpus);
 	free(d);
 
 	plugin_set_data(plug, NULL);
@@ -98,48 +263,135 @@ static int monitor_schedstat_init(struct plugin *plug)
 	struct monitor_schedstat_data *d = plugin_get_data(plug);
 
 	d->first = 1;
+	d->flags = monitor_schedstat_flags(plug);
 	return 0;
 }
 
+/* Skip blanks and the following word */
+static const char *monitor_schedstat_skip_word(const char *p)
+{
+	while (*p == ' ' || *p == '\t')
+		++p;
+	while (*p && *p != ' ' && *p != '\t' && *p != '\n')
+		++p;
+	return p;
+}
+
+/* Parse up to max values, returns how many were found */
+static int monitor_schedstat_scan(const char *p, uint64_t *vals, int max)
+{
+	int i;
+
+	for (i = 0; i != max; ++i) {
+		p = proc_scan_u64(p, &vals[i]);
+		if (!p)
+			break;
+	}
+	return i;
+}
+
+static void monitor_schedstat_add_cpu(struct monitor_schedstat_data *d,
+		struct monitor_schedstat *stat, const char *p)
+{
+	uint64_t vals[NR_SCHEDSTAT_CPU];
+	uint64_t cpu;
+	int nr;
+
+	p = proc_scan_u64(p, &cpu);
+	if (!p)
+		return;
+	nr = monitor_schedstat_scan(p, vals, NR_SCHEDSTAT_CPU);
+	if (nr <= SCHEDSTAT_TTWU_COUNT)
+		return;
+
+	stat->yields += vals[SCHEDSTAT_YLD_COUNT];
+	stat->schedules += vals[SCHEDSTAT_SCHED_COUNT];
+	stat->schedules_idle += vals[SCHEDSTAT_SCHED_GOIDLE];
+	stat->ttwus += vals[SCHEDSTAT_TTWU_COUNT];
+
+	if ((d->flags & SCHEDSTAT_PER_CPU) && nr == NR_SCHEDSTAT_CPU
+			&& cpu < monitor_schedstat_nr_cpus) {
+		uint64_t *c = &d->cpus[cpu * NR_SCHEDSTAT_PER_CPU];
+
+		c[PER_CPU_RUN_DELAY] = vals[SCHEDSTAT_RUN_DELAY];
+		c[PER_CPU_PCOUNT] = vals[SCHEDSTAT_PCOUNT];
+	}
+}
+
+/* Domain lines belong to the last cpu line, levels are summed over CPUs */
+static void monitor_schedstat_add_domain(struct monitor_schedstat_data *d,
+		const char *p)
+{
+	const struct monitor_schedstat_layout *l = d->layout;
+	uint64_t vals[SCHEDSTAT_MAX_DOMAIN_VALUES];
+	int nr_lb = SCHEDSTAT_IDLE_TYPES * l->lb_fields;
+	uint64_t level;
+	uint64_t *dom;
+	int nr;
+	int i, j;
+
+	p = proc_scan_u64(p, &level);
+	if (!p || level >= monitor_schedstat_nr_domains)
+		return;
+	if (l->has_name)
+		p = monitor_schedstat_skip_word(p);
+	p = monitor_schedstat_skip_word(p);
+
+	/* alb, sbe, sbf and ttwu values follow the load balancing values */
+	nr = monitor_schedstat_scan(p, vals, SCHEDSTAT_MAX_DOMAIN_VALUES);
+	if (nr < nr_lb + 12)
+		return;
+
+	dom = &d->domains[level * NR_SCHEDSTAT_PER_DOMAIN];
+	for (i = 0; i != SCHEDSTAT_IDLE_TYPES; ++i) {
+		uint64_t *lb = &vals[i * l->lb_fields];
+
+		dom[PER_DOMAIN_LB_COUNT] += lb[0];
+		dom[PER_DOMAIN_LB_FAILED] += lb[2];
+		for (j = 0; j != l->lb_imbalance_nr; ++j)
+			dom[PER_DOMAIN_LB_IMBALANCE] += lb[3 + j];
+	}
+	dom[PER_DOMAIN_ALB_PUSHED] += vals[nr_lb + 2];
+	dom[PER_DOMAIN_TTWU_WAKE_REMOTE] += vals[nr_lb + 9];
+	dom[PER_DOMAIN_TTWU_MOVE_AFFINE] += vals[nr_lb + 10];
+}
+
+/*
+ * One pass over the buffer. The version line comes first and selects the
+ * layout of the domain lines, they are skipped for unknown versions.
+ */
 static int monitor_schedstat_get(struct plugin *plug, struct monitor_schedstat *stat)
 {
-	FILE *f;
-	int found = 0;
 	struct monitor_schedstat_data *d = plugin_get_data(plug);
-	struct monitor_schedstat stat_rd;
+	const char *p;
+	int found = 0;
 
 	memset(stat, 0, sizeof(*stat));
+	if (d->flags & SCHEDSTAT_PER_DOMAIN)
+		memset(d->domains, 0, sizeof(*d->domains)
+				* monitor_schedstat_nr_domains
+				* NR_SCHEDSTAT_PER_DOMAIN);
 
-	f = fopen(monitor_schedstat_path, "r");
-	if (!f) {
-		printf("Error: Could not open file %s\n", monitor_schedstat_path);
+	if (proc_file_read(&d->file))
 		return -1;
-	}
-
-	while (0 < getline(&d->buf, &d->buf_len, f)) {
-		int ret;
-		uint64_t discard;
 
-		ret = sscanf(d->buf, "cpu%" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " ",
-				&discard,
-				&stat_rd.yields, &discard, &stat_rd.schedules,
-				&stat_rd.schedules_idle, &stat_rd.ttwus);
-		if (ret != 6) {
-			continue;
+	for (p = d->file.buf; p && *p; p = proc_next_line(p)) {
+		if (!strncmp(p, "cpu", 3)) {
+			monitor_schedstat_add_cpu(d, stat, p + 3);
+			found = 1;
+		} else if (!strncmp(p, "domain", 6)) {
+			if ((d->flags & SCHEDSTAT_PER_DOMAIN) && d->layout)
+				monitor_schedstat_add_domain(d, p + 6);
+		} else if (!strncmp(p, "version ", 8)) {
+			uint64_t version;
+
+			if (proc_scan_u64(p + 8, &version))
+				d->layout = monitor_schedstat_find_layout(version);
 		}
-
-		found = 1;
-		stat->yields += stat_rd.yields;
-		stat->schedules += stat_rd.schedules;
-		stat->schedules_idle += stat_rd.schedules_idle;
-		stat->ttwus += stat_rd.ttwus;
 	}
 
-	fclose(f);
-
 	if (!found) {
 		printf("Failed to find some data in %s\n", monitor_schedstat_path);
-		monitor_schedstat_uninstall(plug);
 		return -1;
 	}
 
@@ -154,6 +406,9 @@ static int monitor_schedstat_mon(struct plugin *plug)
 	int ret;
 	struct timespec time;
 	double now;
+	int nr_cpu = 0;
+	int nr_domain = 0;
+	int i;
 
 	clock_gettime(CLOCK_MONOTONIC, &time);
 
@@ -161,7 +416,13 @@ static int monitor_schedstat_mon(struct plugin *plug)
 	if (ret)
 		return ret;
 
-	dat = data_alloc(DATA_TYPE_MONITOR, 5);
+	if (d->flags & SCHEDSTAT_PER_CPU)
+		nr_cpu = monitor_schedstat_nr_cpus * NR_SCHEDSTAT_PER_CPU;
+	if (d->flags & SCHEDSTAT_PER_DOMAIN)
+		nr_domain = monitor_schedstat_nr_domains * NR_SCHEDSTAT_PER_DOMAIN;
+
+	dat = data_alloc(DATA_TYPE_MONITOR, NR_SCHEDSTAT_COLUMNS + nr_cpu
+			+ nr_domain);
 	if (!dat)
 		return -1;
 
@@ -169,6 +430,9 @@ static int monitor_schedstat_mon(struct plugin *plug)
 
 	if (d->first) {
 		d->initial = schedstat;
+		memcpy(d->cpus_initial, d->cpus, sizeof(*d->cpus) * nr_cpu);
+		memcpy(d->domains_initial, d->domains,
+				sizeof(*d->domains) * nr_domain);
 		d->start_time = now;
 		d->first = 0;
 	}
@@ -185,51 +449,168 @@ static int monitor_schedstat_mon(struct plugin *plug)
 	data_add_int64(dat, schedstat.schedules_idle);
 	data_add_int64(dat, schedstat.ttwus);
 
+	for (i = 0; i != nr_cpu; ++i)
+		data_add_int64(dat, d->cpus[i] - d->cpus_initial[i]);
+	for (i = 0; i != nr_domain; ++i)
+		data_add_int64(dat, d->domains[i] - d->domains_initial[i]);
+
 	plugin_add_results(plug, dat);
 
 	return 0;
 }
 
+static const struct header monitor_schedstat_hdr[NR_SCHEDSTAT_COLUMNS + 1] = {
+	{
+		.name = "time",
+		.unit = "s",
+		.description = "Time of this measurement.",
+	}, {
+		.name = "sched_yield calls",
+		.description = "Number of sched_yield{} calls",
+	}, {
+		.name = "schedule calls",
+		.description = "Number of schedule() calls",
+	}, {
+		.name = "schedule idle calls",
+		.description = "Number of schedule() calls that left the processor idle.",
+	}, {
+		.name = "try_to_wake_up calls",
+		.description = "Number of try_to_wake_up() calls",
+	}, {
+		/* Sentinel */
+	}
+};
+
 static const struct header *monitor_schedstat_data_hdr(struct plugin *plug)
 {
-	static const struct header hdr[] = {
-		{
-			.name = "time",
-			.unit = "s",
-			.description = "Time of this measurement.",
-		}, {
-			.name = "sched_yield calls",
-			.description = "Number of sched_yield{} calls",
-		}, {
-			.name = "schedule calls",
-			.description = "Number of schedule() calls",
-		}, {
-			.name = "schedule idle calls",
-			.description = "Number of schedule() calls that left the processor idle.",
-		}, {
-			.name = "try_to_wake_up calls",
-			.description = "Number of try_to_wake_up() calls",
-		}, {
-			/* Sentinel */
+	int flags = monitor_schedstat_flags(plug);
+
+	if (flags)
+		return monitor_schedstat_hdrs[flags];
+	return monitor_schedstat_hdr;
+}
+
+/* Number of domain levels, the highest domain index of any CPU plus one */
+static int monitor_schedstat_count_domains(void)
+{
+	struct proc_file pf;
+	const char *p;
+	int nr = 0;
+
+	if (proc_file_open(&pf, monitor_schedstat_path))
+		return 0;
+
+	for (p = pf.buf; p && *p; p = proc_next_line(p)) {
+		uint64_t level;
+
+		if (strncmp(p, "domain", 6) || !proc_scan_u64(p + 6, &level))
+			continue;
+		if (level + 1 > nr)
+			nr = level + 1;
+	}
+
+	proc_file_close(&pf);
+	return nr;
+}
+
+/*
+ * The general columns followed by cpuN_FIELD for every possible CPU and/or
+ * domainN_FIELD for every domain level. All names are in one allocation.
+ */
+static int monitor_schedstat_build_hdrs(void)
+{
+	int nr_cpu = monitor_schedstat_nr_cpus * NR_SCHEDSTAT_PER_CPU;
+	int nr_domain = monitor_schedstat_nr_domains * NR_SCHEDSTAT_PER_DOMAIN;
+	int flags;
+	int i, j;
+
+	monitor_schedstat_names = malloc((nr_cpu + nr_domain) * 32);
+	if (!monitor_schedstat_names)
+		return -1;
+
+	for (flags = 1; flags != 4; ++flags) {
+		struct header *hdr;
+		int n = NR_SCHEDSTAT_COLUMNS;
+		char *name = monitor_schedstat_names;
+
+		if ((flags & SCHEDSTAT_PER_DOMAIN) && !nr_domain)
+			continue;
+
+		hdr = calloc(NR_SCHEDSTAT_COLUMNS + nr_cpu + nr_domain + 1,
+				sizeof(*hdr));
+		if (!hdr)
+			return -1;
+		memcpy(hdr, monitor_schedstat_hdr, sizeof(monitor_schedstat_hdr));
+		monitor_schedstat_hdrs[flags] = hdr;
+
+		for (i = 0; i != monitor_schedstat_nr_cpus; ++i) {
+			for (j = 0; j != NR_SCHEDSTAT_PER_CPU; ++j, name += 32) {
+				if (!(flags & SCHEDSTAT_PER_CPU))
+					continue;
+				snprintf(name, 32, "cpu%d_%s", i,
+					monitor_schedstat_per_cpu_hdr[j].name);
+				hdr[n] = monitor_schedstat_per_cpu_hdr[j];
+				hdr[n++].name = name;
+			}
+		}
+		for (i = 0; i != monitor_schedstat_nr_domains; ++i) {
+			for (j = 0; j != NR_SCHEDSTAT_PER_DOMAIN; ++j, name += 32) {
+				if (!(flags & SCHEDSTAT_PER_DOMAIN))
+					continue;
+				snprintf(name, 32, "domain%d_%s", i,
+					monitor_schedstat_per_domain_hdr[j].name);
+				hdr[n] = monitor_schedstat_per_domain_hdr[j];
+				hdr[n++].name = name;
+			}
 		}
-	};
+	}
+	return 0;
+}
 
-	return hdr;
+static void monitor_schedstat_free_hdrs(void)
+{
+	int i;
+
+	for (i = 0; i != 4; ++i) {
+		free(monitor_schedstat_hdrs[i]);
+		monitor_schedstat_hdrs[i] = NULL;
+	}
+	free(monitor_schedstat_names);
+	monitor_schedstat_names = NULL;
 }
 
 static int monitor_schedstat_mod_init(struct module *mod,
 				      const struct plugin_id *plug)
 {
-	if (!access(monitor_schedstat_path, F_OK | R_OK))
-		plugin_monitor_schedstat_requirements[0].found = 1;
+	if (access(monitor_schedstat_path, F_OK | R_OK))
+		return 0;
+
+	plugin_monitor_schedstat_requirements[0].found = 1;
+
+	monitor_schedstat_nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (monitor_schedstat_nr_cpus < 1)
+		monitor_schedstat_nr_cpus = 1;
+	monitor_schedstat_nr_domains = monitor_schedstat_count_domains();
+	if (monitor_schedstat_build_hdrs()) {
+		printf("Error: Per CPU and domain statistics of %s unavailable\n",
+				monitor_schedstat_path);
+		monitor_schedstat_free_hdrs();
+	}
 
 	return 0;
 }
 
+static void monitor_schedstat_mod_exit(struct module *mod,
+				       const struct plugin_id *plug)
+{
+	monitor_schedstat_free_hdrs();
+}
+
 const struct plugin_id plugin_schedstat = {
 	.name = "monitor-schedstat",
 	.description = "Monitor plugin to keep track of different values shown in /proc/schedstat.",
 	.module_init = monitor_schedstat_mod_init,
+	.module_exit = monitor_schedstat_mod_exit,
 	.install = monitor_schedstat_install,
 	.uninstall = monitor_schedstat_uninstall,
 	.init = monitor_schedstat_init,
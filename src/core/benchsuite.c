@@ -19,70 +19,1480 @@
 
 #include <cbench/benchsuite.h>
 
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <klib/list.h>
 #include <klib/printk.h>
+#include <klib/types.h>
 
+#include <cbench/core/download.h>
+#include <cbench/core/journal.h>
+#include <cbench/core/memory.h>
 #include <cbench/core/module_manager.h>
+#include <cbench/core/scheduler.h>
+#include <cbench/core/sweep.h>
+#include <cbench/download.h>
+#include <cbench/environment.h>
+#include <cbench/option.h>
 #include <cbench/plugin.h>
+#include <cbench/storage/pipe.h>
+#include <cbench/util.h>
 
+struct suite_install {
+	struct plugin *owner;
+	int last_group;
+};
+
+struct suite_group {
+	struct list_head plugins;
+	/*
+	 * Adaptive sweep, the plugins are placeholders at the start value that
+	 * own the installs. They are replaced by each point while it executes.
+	 */
+	struct plugin_link *adaptive;
+	/* Index in the execution journal, -1 without journal */
+	int index;
+};
+
+static struct suite_install *suite_find_install(struct suite_install *installs,
+		int nr_installs, struct plugin *plug)
+{
+	int i;
+
+	for (i = 0; i != nr_installs; ++i) {
+		struct plugin *owner = installs[i].owner;
+
+		if (owner->id != plug->id || owner->version != plug->version
+				|| owner->instance != plug->instance)
+			continue;
+		if (strcmp(owner->sha256, plug->sha256)
+				|| strcmp(owner->opt_sha256, plug->opt_sha256)
+				|| strcmp(owner->ver_sha256, plug->ver_sha256))
+			continue;
+		return &installs[i];
+	}
+	return NULL;
+}
+
+/*
+ * Plugins of grp that can't use the installation of their owner, as its
+ * install function set up user_data, need one of their own.
+ */
+static int suite_install_dups(struct environment *env, struct list_head *grp,
+		struct suite_install *installs, int nr_installs)
+{
+	struct plugin **dups;
+	struct plugin *plg;
+	int nr_dups = 0;
+	int nr = 0;
+	int ret;
+
+	list_for_each_entry(plg, grp, plugin_grp)
+		++nr;
+	dups = malloc(sizeof(*dups) * (nr + 1));
+	if (!dups)
+		return -1;
+
+	list_for_each_entry(plg, grp, plugin_grp) {
+		struct suite_install *inst = suite_find_install(installs,
+				nr_installs, plg);
+
+		if (!inst || inst->owner == plg || plg->preinstalled)
+			continue;
+		if (inst->owner->preinstalled && inst->owner->user_data)
+			dups[nr_dups++] = plg;
+	}
+
+	ret = plugins_preinstall(env, dups, nr_dups);
+	free(dups);
+	return ret;
+}
+
+/*
+ * Install everything group grp needs that is not installed yet, with dups
+ * including the plugins that can't share. The placeholders of adaptive
+ * sweeps are never executed and don't need their own installation.
+ */
+static int suite_install_group(struct environment *env, struct list_head *grp,
+		struct suite_install *installs, int nr_installs, int dups)
+{
+	struct plugin **owners;
+	struct plugin *plg;
+	int nr_owners = 0;
+	int ret;
+
+	owners = malloc(sizeof(*owners) * nr_installs);
+	if (!owners)
+		return -1;
+
+	list_for_each_entry(plg, grp, plugin_grp) {
+		struct suite_install *inst = suite_find_install(installs,
+				nr_installs, plg);
+		int i;
+
+		/* Points of adaptive sweeps may install with their group */
+		if (!inst || inst->owner->preinstalled)
+			continue;
+		for (i = 0; i != nr_owners && owners[i] != inst->owner; ++i);
+		if (i == nr_owners)
+			owners[nr_owners++] = inst->owner;
+	}
+
+	ret = plugins_preinstall(env, owners, nr_owners);
+	free(owners);
+	if (!ret && dups)
+		ret = suite_install_dups(env, grp, installs, nr_installs);
+	return ret;
+}
+
+static int suite_preinstall(struct environment *env, struct suite_group *groups,
+		int nr_groups, struct suite_install *installs, int nr_installs)
+{
+	struct plugin **owners;
+	int i;
+	int ret;
+
+	if (env->disk_budget) {
+		for (i = 0; i != nr_groups; ++i) {
+			unsigned long long usage = dir_disk_usage(env->work_dir);
+
+			if (usage > (unsigned long long)env->disk_budget << 20) {
+				printk(KERN_INFO "Disk budget of %luMiB reached, installing the remaining plugins before their groups\n",
+						env->disk_budget);
+				return 0;
+			}
+
+			ret = suite_install_group(env, &groups[i].plugins,
+					installs, nr_installs,
+					!groups[i].adaptive);
+			if (ret)
+				return ret;
+		}
+		return 0;
+	}
+
+	owners = malloc(sizeof(*owners) * nr_installs);
+	if (!owners)
+		return -1;
+
+	for (i = 0; i != nr_installs; ++i)
+		owners[i] = installs[i].owner;
+
+	ret = plugins_preinstall(env, owners, nr_installs);
+	free(owners);
+
+	for (i = 0; !ret && i != nr_groups; ++i) {
+		if (!groups[i].adaptive)
+			ret = suite_install_dups(env, &groups[i].plugins,
+					installs, nr_installs);
+	}
+	return ret;
+}
+
+/*
+ * Uninstall everything last used by group or a group before it, or
+ * everything if group is -1. Dups are last used by their own group.
+ */
+static int suite_uninstall(struct environment *env, struct suite_group *groups,
+		int nr_groups, struct suite_install *installs, int nr_installs,
+		int group)
+{
+	struct plugin **owners;
+	struct plugin *plg;
+	int nr_owners = 0;
+	int nr = nr_installs;
+	int i;
+	int ret;
+
+	for (i = 0; i != nr_groups; ++i) {
+		list_for_each_entry(plg, &groups[i].plugins, plugin_grp)
+			++nr;
+	}
+	owners = malloc(sizeof(*owners) * (nr + 1));
+	if (!owners)
+		return -1;
+
+	for (i = 0; i != nr_installs; ++i) {
+		if (!installs[i].owner->preinstalled)
+			continue;
+		if (group != -1 && installs[i].last_group > group)
+			continue;
+		owners[nr_owners++] = installs[i].owner;
+	}
+
+	for (i = 0; i != nr_groups; ++i) {
+		if (groups[i].adaptive || (group != -1 && i > group))
+			continue;
+		list_for_each_entry(plg, &groups[i].plugins, plugin_grp) {
+			struct suite_install *inst = suite_find_install(installs,
+					nr_installs, plg);
+
+			if (!inst || inst->owner == plg || !plg->preinstalled)
+				continue;
+			if (plg->work_dir != inst->owner->work_dir)
+				owners[nr_owners++] = plg;
+		}
+	}
+
+	ret = plugins_postuninstall(env, owners, nr_owners);
+	free(owners);
+	return ret;
+}
+
+/*
+ * Let plugins of grp use the installation of an identical plugin. Only the
+ * work directory is shared, user_data belongs to each plugin instance. If
+ * the install function of the owner set up user_data, the plugin can't run
+ * without its own and was installed as a dup by suite_install_group.
+ */
+static void suite_share_installs(struct list_head *grp,
+		struct suite_install *installs, int nr_installs, int share)
+{
+	struct plugin *plg;
+
+	list_for_each_entry(plg, grp, plugin_grp) {
+		struct suite_install *inst = suite_find_install(installs,
+				nr_installs, plg);
+		struct plugin *owner;
+
+		if (!inst || inst->owner == plg)
+			continue;
+		owner = inst->owner;
+
+		if (share) {
+			if (!owner->preinstalled || owner->user_data)
+				continue;
+			plg->work_dir = owner->work_dir;
+			plg->download_dir = owner->download_dir;
+			plg->preinstalled = 1;
+		} else if (plg->preinstalled && plg->work_dir == owner->work_dir) {
+			plg->work_dir = NULL;
+			plg->preinstalled = 0;
+		}
+	}
+}
+
+struct suite_sweep {
+	int nr_links;
+	char ***opts;
+	int *nr_opts;
+};
+
+static void suite_sweep_free(struct suite_sweep *sw)
+{
+	int i;
+
+	for (i = 0; i != sw->nr_links; ++i)
+		option_sweep_free(sw->opts[i], sw->nr_opts[i]);
+	free(sw->opts);
+	free(sw->nr_opts);
+}
+
+/* Expand the option sweeps of grp, returns the number of resulting groups */
+static int suite_sweep_expand(struct suite_sweep *sw, struct plugin_link *grp)
+{
+	int nr_combos = 1;
+	int i;
+
+	for (i = 0; grp[i].name != NULL; ++i);
+	sw->nr_links = 0;
+	sw->opts = calloc(i, sizeof(*sw->opts));
+	sw->nr_opts = calloc(i, sizeof(*sw->nr_opts));
+	if (!sw->opts || !sw->nr_opts)
+		goto error;
+
+	for (i = 0; grp[i].name != NULL; ++i) {
+		sw->nr_opts[i] = option_sweep_expand(grp[i].options,
+				&sw->opts[i]);
+		if (sw->nr_opts[i] < 0) {
+			printk(KERN_ERR "Failed to expand options of plugin %s\n",
+					grp[i].name);
+			goto error;
+		}
+		++sw->nr_links;
+		nr_combos *= sw->nr_opts[i];
+	}
+	return nr_combos;
+error:
+	suite_sweep_free(sw);
+	return -1;
+}
+
+static void suite_free_groups(struct mod_mgr *mm, struct suite_group *groups,
+		int nr_groups)
+{
+	struct plugin *plg, *nplg;
+	int i;
+
+	for (i = 0; i != nr_groups; ++i) {
+		list_for_each_entry_safe(plg, nplg, &groups[i].plugins, plugin_grp) {
+			list_del(&plg->plugin_grp);
+			mod_mgr_plugin_free(mm, plg);
+		}
+	}
+	free(groups);
+}
+
+/*
+ * Returns the index of the plugin with an adaptive sweep in grp, -1 if there
+ * is none or -2 on errors. Adaptive sweeps can't be mixed with other sweeps.
+ */
+static int suite_adaptive_link(struct plugin_link *grp)
+{
+	struct option_adaptive ad;
+	int link = -1;
+	int i;
+
+	for (i = 0; grp[i].name != NULL; ++i) {
+		int ret = option_adaptive_find(grp[i].options, &ad);
+
+		if (ret < 0)
+			return -2;
+		if (!ret)
+			continue;
+		if (link != -1) {
+			printk(KERN_ERR "Only one adaptive sweep per group is supported\n");
+			return -2;
+		}
+		link = i;
+	}
+
+	for (i = 0; link != -1 && grp[i].name != NULL; ++i) {
+		if (i != link && grp[i].options
+				&& (strstr(grp[i].options, "..")
+					|| strchr(grp[i].options, '{'))) {
+			printk(KERN_ERR "Adaptive sweeps can't be combined with other sweeps\n");
+			return -2;
+		}
+	}
+	return link;
+}
+
+/* Create placeholder plugins for an adaptive group at its start value */
+static int suite_resolve_adaptive(struct mod_mgr *mm, struct plugin_link *grp,
+		int link, struct suite_group *group)
+{
+	struct option_adaptive ad;
+	int i;
+
+	option_adaptive_find(grp[link].options, &ad);
+	group->adaptive = grp;
+
+	for (i = 0; grp[i].name != NULL; ++i) {
+		struct plugin *plg;
+		char *opts = NULL;
+
+		if (i == link) {
+			opts = option_adaptive_set(grp[i].options, &ad, ad.start);
+			if (!opts)
+				return -1;
+		}
+		plg = plugin_link_create(mm, &grp[i],
+				opts ? opts : grp[i].options, &group->plugins);
+		free(opts);
+		if (!plg)
+			return -1;
+	}
+	return 0;
+}
+
+/*
+ * Create the plugins of all groups. Groups with option sweeps are expanded
+ * into one group for each combination of option values, the last plugin
+ * varies fastest. Skipped groups are counted after expansion and left empty,
+ * as are groups the journal of an interrupted execution marks as finished.
+ * Adaptive sweeps stay one group, their points are chosen while executing.
+ */
+static int suite_resolve(struct mod_mgr *mm, struct environment *env,
+		struct benchsuite *suite, int *skip,
+		struct suite_group **groups_out, int *nr_groups_out)
+{
+	struct plugin_link **grps = suite->id->plugin_grps;
+	struct suite_group *groups;
+	int nr_groups = 0;
+	int g = 0;
+	int i;
+
+	for (i = 0; grps[i] != NULL && grps[i]->name != NULL; ++i) {
+		struct suite_sweep sw;
+		int link = suite_adaptive_link(grps[i]);
+		int nr;
+
+		if (link == -2)
+			return -1;
+		if (link >= 0) {
+			++nr_groups;
+			continue;
+		}
+
+		nr = suite_sweep_expand(&sw, grps[i]);
+		if (nr < 0)
+			return -1;
+		suite_sweep_free(&sw);
+		nr_groups += nr;
+	}
+
+	groups = malloc(sizeof(*groups) * (nr_groups + 1));
+	if (!groups)
+		return -1;
+	for (i = 0; i != nr_groups; ++i) {
+		INIT_LIST_HEAD(&groups[i].plugins);
+		groups[i].adaptive = NULL;
+		groups[i].index = journal_group_index(env->journal);
+	}
+
+	for (i = 0; grps[i] != NULL && grps[i]->name != NULL; ++i) {
+		struct suite_sweep sw;
+		int link = suite_adaptive_link(grps[i]);
+		int nr_combos;
+		int *idx;
+		int c, j;
+
+		if (link >= 0) {
+			if (*skip) {
+				--*skip;
+				printk(KERN_INFO "Skipping group %d/%d\n", g + 1,
+						nr_groups);
+			} else if (journal_group_done(env->journal,
+						groups[g].index)) {
+				printk(KERN_INFO "Skipping finished group %d/%d\n",
+						g + 1, nr_groups);
+			} else if (suite_resolve_adaptive(mm, grps[i], link,
+						&groups[g])) {
+				goto error;
+			}
+			++g;
+			continue;
+		}
+
+		nr_combos = suite_sweep_expand(&sw, grps[i]);
+		if (nr_combos < 0)
+			goto error;
+		idx = calloc(sw.nr_links, sizeof(*idx));
+		if (!idx) {
+			suite_sweep_free(&sw);
+			goto error;
+		}
+
+		for (c = 0; c != nr_combos; ++c, ++g) {
+			if (c) {
+				for (j = sw.nr_links - 1; j >= 0; --j) {
+					if (++idx[j] != sw.nr_opts[j])
+						break;
+					idx[j] = 0;
+				}
+			}
+
+			if (*skip) {
+				--*skip;
+				printk(KERN_INFO "Skipping group %d/%d\n", g + 1,
+						nr_groups);
+				continue;
+			}
+			if (journal_group_done(env->journal, groups[g].index)) {
+				printk(KERN_INFO "Skipping finished group %d/%d\n",
+						g + 1, nr_groups);
+				continue;
+			}
+
+			for (j = 0; j != sw.nr_links; ++j) {
+				if (!plugin_link_create(mm, &grps[i][j],
+						sw.opts[j][idx[j]],
+						&groups[g].plugins)) {
+					free(idx);
+					suite_sweep_free(&sw);
+					goto error;
+				}
+			}
+		}
+		free(idx);
+		suite_sweep_free(&sw);
+	}
+
+	*groups_out = groups;
+	*nr_groups_out = nr_groups;
+	return 0;
+error:
+	suite_free_groups(mm, groups, nr_groups);
+	return -1;
+}
+
+struct suite_exec {
+	struct environment *env;
+	struct suite_group *groups;
+	int nr_groups;
+	struct suite_install *installs;
+	int nr_installs;
+	struct scheduler *sched;
+	/* An isolated group crashed, the following groups were executed */
+	int failed;
+};
+
+/* Install and journal a group or the current point of an adaptive sweep */
+static int suite_group_prepare(struct suite_exec *se, int i)
+{
+	struct environment *env = se->env;
+	struct suite_group *grp = &se->groups[i];
+	char sha256[65];
+	int ret;
+
+	ret = suite_install_group(env, &grp->plugins, se->installs,
+			se->nr_installs, !grp->adaptive);
+	if (ret) {
+		printk(KERN_ERR "Failed installing plugins\n");
+		return ret;
+	}
+
+	suite_share_installs(&grp->plugins, se->installs, se->nr_installs, 1);
+
+	plugins_calc_sha256(&grp->plugins, sha256);
+	if (grp->adaptive)
+		ret = journal_point_start(env->journal, grp->index, sha256);
+	else
+		ret = journal_group_start(env->journal, grp->index, sha256);
+	if (ret)
+		suite_share_installs(&grp->plugins, se->installs,
+				se->nr_installs, 0);
+	return ret;
+}
+
+/*
+ * Journal the end of a group and release its installations. An adaptive
+ * sweep is finished after its last point.
+ */
+static int suite_group_done(struct suite_exec *se, int i, int ret)
+{
+	struct suite_group *grp = &se->groups[i];
+
+	if (!ret && !grp->adaptive)
+		ret = journal_group_finish(se->env->journal, grp->index);
+
+	suite_share_installs(&grp->plugins, se->installs, se->nr_installs, 0);
+	return ret;
+}
+
+/* Start a prepared group with its scheduled settings */
+static struct plugin_exec_env *suite_group_exec_start(struct suite_exec *se,
+		int i, const char *status_prefix)
+{
+	struct environment *env = se->env;
+	struct plugin_exec_env *exec_env;
+	struct run_settings settings;
+
+	settings = env->settings;
+	if (se->sched)
+		sched_apply(se->sched, i, &env->settings);
+	exec_env = plugins_exec_start(env, &se->groups[i].plugins,
+			status_prefix);
+	env->settings = settings;
+	return exec_env;
+}
+
+static struct plugin_exec_env *suite_group_start(struct suite_exec *se, int i,
+		const char *status_prefix)
+{
+	struct plugin_exec_env *exec_env;
+
+	if (suite_group_prepare(se, i))
+		return NULL;
+
+	exec_env = suite_group_exec_start(se, i, status_prefix);
+	if (!exec_env)
+		suite_group_done(se, i, -1);
+	return exec_env;
+}
+
+static int suite_group_finish(struct suite_exec *se, int i,
+		struct plugin_exec_env *exec_env)
+{
+	return suite_group_done(se, i, plugins_exec_finish(exec_env));
+}
+
+/* Executes a prepared group in the forked child, returns its exit status */
+static int suite_group_child(struct suite_exec *se, int i,
+		const char *status_prefix, int fd)
+{
+	struct environment *env = se->env;
+	struct plugin_exec_env *exec_env;
+	int ret;
+
+	if (env->mlock && memory_relock())
+		return 1;
+
+	/* The database connection belongs to the parent */
+	if (storage_pipe_init(&env->storage, fd))
+		return 1;
+
+	exec_env = suite_group_exec_start(se, i, status_prefix);
+	if (!exec_env) {
+		ret = 1;
+	} else {
+		while (plugins_exec_run(exec_env, NULL))
+			;
+		ret = plugins_exec_finish(exec_env);
+		ret |= storage_pipe_send_results(&env->storage,
+				&se->groups[i].plugins);
+	}
+	storage_exit(&env->storage);
+	return ret ? 1 : 0;
+}
+
+static pid_t isolated_child;
+
+/* The child has its own process group, so it gets signals only from here */
+static void suite_forward_signal(int sig)
+{
+	if (isolated_child > 0)
+		kill(isolated_child, sig);
+}
+
+/*
+ * Execute a group in a forked child, so heap fragmentation and state leaked
+ * by plugins end with the group. Installation and the journal stay in the
+ * parent, which stores everything the child sends through a pipe. A child
+ * killed by a signal only fails its own group.
+ */
+static int suite_group_execute_isolated(struct suite_exec *se, int i,
+		const char *status_prefix)
+{
+	struct environment *env = se->env;
+	void (*old_sigint)(int);
+	void (*old_sigterm)(int);
+	int fds[2];
+	pid_t pid;
+	int status;
+	int ret;
+
+	ret = suite_group_prepare(se, i);
+	if (ret)
+		return ret;
+
+	if (pipe(fds)) {
+		printk(KERN_ERR "Failed to create storage pipe: %s\n",
+				strerror(errno));
+		return suite_group_done(se, i, -1);
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+
+	pid = fork();
+	if (pid == 0) {
+		setpgid(0, 0);
+		close(fds[0]);
+		ret = suite_group_child(se, i, status_prefix, fds[1]);
+		fflush(stdout);
+		fflush(stderr);
+		_exit(ret);
+	}
+	close(fds[1]);
+	if (pid < 0) {
+		printk(KERN_ERR "Failed to fork group execution: %s\n",
+				strerror(errno));
+		close(fds[0]);
+		return suite_group_done(se, i, -1);
+	}
+
+	/* The child stops after its current run on a signal, then we stop */
+	isolated_child = pid;
+	old_sigint = signal(SIGINT, suite_forward_signal);
+	old_sigterm = signal(SIGTERM, suite_forward_signal);
+
+	/*
+	 * The data of the child is stored for the plugins of the parent. Of
+	 * those only the fields set before the fork are valid: id, mod,
+	 * version, options and the sha256 checksums. data_hdr is called on
+	 * them as well, so it must not depend on state the plugin sets up in
+	 * its install or init functions.
+	 */
+	ret = storage_pipe_forward(fds[0], &env->storage,
+			&se->groups[i].plugins);
+	close(fds[0]);
+	while (waitpid(pid, &status, 0) < 0) {
+		if (errno != EINTR) {
+			status = 0;
+			ret = -1;
+			break;
+		}
+	}
+
+	if (WIFSIGNALED(status)) {
+		printk(KERN_ERR "Group %d was killed by signal %d (%s), continuing with the next group\n",
+				i + 1, WTERMSIG(status),
+				strsignal(WTERMSIG(status)));
+		se->failed = 1;
+		suite_group_done(se, i, -1);
+		ret = 0;
+		goto out;
+	}
+	if (WIFEXITED(status) && WEXITSTATUS(status))
+		ret = -1;
+	ret = suite_group_done(se, i, ret);
+out:
+	signal(SIGINT, old_sigint);
+	signal(SIGTERM, old_sigterm);
+	isolated_child = 0;
+	return ret;
+}
+
+/* Execute group i on its own */
+static int suite_group_execute(struct suite_exec *se, int i,
+		const char *status_prefix)
+{
+	struct plugin_exec_env *exec_env;
+
+	if (se->env->isolate)
+		return suite_group_execute_isolated(se, i, status_prefix);
+
+	exec_env = suite_group_start(se, i, status_prefix);
+	if (!exec_env)
+		return 1;
+	while (plugins_exec_run(exec_env, NULL))
+		;
+	return suite_group_finish(se, i, exec_env);
+}
+
+struct suite_point {
+	struct suite_exec *se;
+	int group;
+};
+
+/*
+ * Let the plugins of a point use the installations of the placeholders. Both
+ * are created from the same links in the same order and only differ in the
+ * swept option, which must not change what a plugin installs. Plugins that
+ * can't share, as the install function of the owner set up user_data, are
+ * installed before the point is measured and uninstalled afterwards.
+ */
+static int suite_point_installs(struct suite_exec *se,
+		struct list_head *plugins, struct list_head *placeholders,
+		int share)
+{
+	struct plugin **own;
+	struct plugin *plg;
+	struct plugin *ph;
+	int nr_own = 0;
+	int nr = 0;
+	int ret;
+
+	list_for_each_entry(plg, plugins, plugin_grp)
+		++nr;
+	own = malloc(sizeof(*own) * (nr + 1));
+	if (!own)
+		return -1;
+
+	ph = list_entry(placeholders->next, struct plugin, plugin_grp);
+	list_for_each_entry(plg, plugins, plugin_grp) {
+		struct suite_install *inst = NULL;
+
+		if (&ph->plugin_grp != placeholders) {
+			inst = suite_find_install(se->installs, se->nr_installs,
+					ph);
+			ph = list_entry(ph->plugin_grp.next, struct plugin,
+					plugin_grp);
+		}
+
+		if (share) {
+			if (!inst || !inst->owner->preinstalled
+					|| inst->owner->user_data) {
+				own[nr_own++] = plg;
+				continue;
+			}
+			plg->work_dir = inst->owner->work_dir;
+			plg->download_dir = inst->owner->download_dir;
+			plg->preinstalled = 1;
+		} else if (plg->preinstalled) {
+			if (!inst || plg->work_dir != inst->owner->work_dir) {
+				own[nr_own++] = plg;
+				continue;
+			}
+			plg->work_dir = NULL;
+			plg->preinstalled = 0;
+		}
+	}
+
+	if (share)
+		ret = plugins_preinstall(se->env, own, nr_own);
+	else
+		ret = plugins_postuninstall(se->env, own, nr_own);
+	free(own);
+	return ret;
+}
+
+/*
+ * Execute a point of an adaptive sweep as its group. The plugins of the point
+ * take the place of the placeholders meanwhile, so the point is journaled and
+ * isolated like any other group.
+ */
+static int suite_adaptive_point(void *priv, struct list_head *plugins,
+		const char *status_prefix)
+{
+	struct suite_point *pt = priv;
+	struct suite_group *grp = &pt->se->groups[pt->group];
+	struct list_head placeholders;
+	int ret;
+
+	ret = suite_point_installs(pt->se, plugins, &grp->plugins, 1);
+	if (ret) {
+		printk(KERN_ERR "Failed installing plugins\n");
+		suite_point_installs(pt->se, plugins, &grp->plugins, 0);
+		return ret;
+	}
+
+	INIT_LIST_HEAD(&placeholders);
+	list_splice_init(&grp->plugins, &placeholders);
+	list_splice_init(plugins, &grp->plugins);
+
+	ret = suite_group_execute(pt->se, pt->group, status_prefix);
+
+	list_splice_init(&grp->plugins, plugins);
+	list_splice_init(&placeholders, &grp->plugins);
+
+	ret |= suite_point_installs(pt->se, plugins, &grp->plugins, 0);
+	return ret;
+}
+
+static unsigned long suite_rand(unsigned long *state)
+{
+	/* xorshift64* */
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 2685821657736338717ULL;
+}
+
+/*
+ * Time budget of the adaptive sweep of group i. The time left of
+ * --sweep-budget is shared by the sweeps of the benchsuite that still have
+ * to be executed, every sweep measures at least its start value.
+ */
+static double suite_sweep_budget(struct suite_exec *se, int i)
+{
+	double left;
+	int nr = 0;
+	int j;
+
+	if (!se->env->sweep_budget)
+		return 0;
+
+	for (j = i; j != se->nr_groups; ++j) {
+		if (se->groups[j].adaptive)
+			++nr;
+	}
+	left = se->env->sweep_budget - se->env->sweep_used;
+	if (left < nr)
+		return 1;
+	return left / nr;
+}
+
+/* Groups first..last-1 that take part in an interleaved block */
+static int suite_block_end(struct suite_exec *se, int first)
+{
+	int nr = 0;
+	int i;
+
+	for (i = first; i != se->nr_groups; ++i) {
+		if (se->groups[i].adaptive)
+			break;
+		if (list_empty(&se->groups[i].plugins))
+			continue;
+		if (nr == se->env->interleave)
+			break;
+		++nr;
+	}
+	return i;
+}
+
+/*
+ * Execute the groups first..last-1 together. All of them are installed and
+ * started, then every round executes one run of each group that still needs
+ * runs, in a new random order per round or round robin. Each group keeps its
+ * own stopping state, so slow drift of the system affects all groups alike.
+ */
+static int suite_execute_block(struct suite_exec *se, int first, int last)
+{
+	struct environment *env = se->env;
+	struct plugin_exec_env **execs;
+	char (*prefixes)[128];
+	int *active;
+	int nr_active = 0;
+	struct run_order order = {
+		.seed = 0,
+		.position = 0,
+	};
+	unsigned long state;
+	int ret = 0;
+	int i, k;
+
+	execs = calloc(last - first, sizeof(*execs));
+	prefixes = calloc(last - first, sizeof(*prefixes));
+	active = calloc(last - first, sizeof(*active));
+	if (!execs || !prefixes || !active) {
+		printk(KERN_ERR "Out of memory\n");
+		ret = 1;
+		goto out;
+	}
+
+	if (!env->interleave_rr) {
+		order.seed = env->interleave_seed;
+		if (!order.seed)
+			order.seed = (time(NULL) * 2654435761UL) ^ getpid() ^ 1;
+		ret = journal_block_seed(env->journal, se->groups[first].index,
+				&order.seed);
+		if (ret)
+			goto out;
+	}
+	state = order.seed;
+
+	for (i = first; i != last; ++i) {
+		if (list_empty(&se->groups[i].plugins))
+			continue;
+		active[nr_active++] = i;
+	}
+	if (order.seed)
+		printk(KERN_INFO "Interleaving %d groups in random order, seed %lu\n",
+				nr_active, order.seed);
+	else
+		printk(KERN_INFO "Interleaving %d groups round robin\n", nr_active);
+
+	for (k = 0; k != nr_active; ++k) {
+		i = active[k];
+		printk(KERN_INFO "Group %d/%d\n", i + 1, se->nr_groups);
+		sprintf(prefixes[i - first], "--------------------------------------------------------------------------------\nGroup %2d/%d", i + 1, se->nr_groups);
+		execs[i - first] = suite_group_start(se, i, prefixes[i - first]);
+		if (!execs[i - first]) {
+			ret = 1;
+			goto stop;
+		}
+	}
+
+	while (nr_active && !plugins_stopped()) {
+		int nr_round = nr_active;
+
+		if (order.seed) {
+			for (k = nr_round - 1; k > 0; --k) {
+				int j = suite_rand(&state) % (k + 1);
+				int tmp = active[k];
+
+				active[k] = active[j];
+				active[j] = tmp;
+			}
+		}
+
+		for (k = 0; k != nr_round && !plugins_stopped(); ++k) {
+			struct plugin_exec_env *exec_env;
+
+			i = active[k];
+			exec_env = execs[i - first];
+			printk(KERN_INFO "Group %d/%d\n", i + 1, se->nr_groups);
+			if (plugins_exec_run(exec_env, &order)) {
+				++order.position;
+				continue;
+			}
+			++order.position;
+
+			execs[i - first] = NULL;
+			ret = suite_group_finish(se, i, exec_env);
+			if (ret)
+				goto stop;
+		}
+
+		/* Keep the groups that need more runs */
+		nr_active = 0;
+		for (k = 0; k != nr_round; ++k) {
+			if (execs[active[k] - first])
+				active[nr_active++] = active[k];
+		}
+	}
+
+stop:
+	for (i = first; i != last; ++i) {
+		if (execs[i - first])
+			ret |= suite_group_finish(se, i, execs[i - first]);
+	}
+out:
+	free(execs);
+	free(prefixes);
+	free(active);
+	return ret;
+}
+
+/*
+ * Benchsuites are executed in two passes. All groups are resolved first and
+ * identical plugins share one installation, only the instances of one link
+ * get one each. Plugins whose install function sets up user_data can't share
+ * it and get their own. Everything is installed before the first
+ * measurement, so installing never happens between groups unless a disk
+ * budget is set and exceeded, or for the points of adaptive sweeps that
+ * can't share.
+ */
 int benchsuite_execute(struct mod_mgr *mm, struct environment *env,
 		struct benchsuite *suite, int *skip)
 {
 	int i;
+	int next;
 	int ret = 0;
 	int nr_groups;
-	for (i = 0; suite->id->plugin_grps[i] != NULL
-			&& suite->id->plugin_grps[i]->name != NULL; ++i);
-	nr_groups = i;
-	for (i = 0; suite->id->plugin_grps[i] != NULL
-			&& suite->id->plugin_grps[i]->name != NULL; ++i) {
-		struct plugin_link *grp = suite->id->plugin_grps[i];
-		int j;
-		struct list_head pgrp;
-		struct plugin *plg, *nplg;
-		char buf[128];
+	int nr_installs = 0;
+	struct suite_group *groups;
+	struct suite_install *installs = NULL;
+	struct plugin *plg;
+	struct scheduler sched;
+	struct suite_exec se = {
+		.env = env,
+	};
 
-		if (*skip) {
-			--*skip;
-			printk(KERN_INFO "Skipping group %d/%d\n", i + 1, nr_groups);
-			continue;
-		}
+	if (suite_resolve(mm, env, suite, skip, &groups, &nr_groups))
+		return 1;
 
-		INIT_LIST_HEAD(&pgrp);
+	for (i = 0; i != nr_groups; ++i) {
+		list_for_each_entry(plg, &groups[i].plugins, plugin_grp) {
+			struct suite_install *inst;
 
-		for (j = 0; grp[j].name != NULL; ++j) {
-			plg = mod_mgr_plugin_create(mm,
-					grp[j].name,
-					grp[j].options,
-					grp[j].version_rules);
-			if (!plg) {
-				printk(KERN_ERR "Didn't find plugin %s\n",
-						grp[j].name);
-				ret = 1;
-				goto error_populating_group;
+			inst = suite_find_install(installs, nr_installs, plg);
+			if (!inst) {
+				inst = realloc(installs,
+					sizeof(*installs) * (nr_installs + 1));
+				if (!inst) {
+					ret = 1;
+					goto error_populating_groups;
+				}
+				installs = inst;
+				inst = &installs[nr_installs++];
+				inst->owner = plg;
 			}
-			list_add_tail(&plg->plugin_grp, &pgrp);
+			inst->last_group = i;
 		}
+	}
+
+	se.groups = groups;
+	se.nr_groups = nr_groups;
+	se.installs = installs;
+	se.nr_installs = nr_installs;
+
+	mod_mgr_unload_unused(mm);
+
+	printk(KERN_INFO "Installing %d plugins for %d groups\n", nr_installs,
+			nr_groups);
+	ret = suite_preinstall(env, groups, nr_groups, installs, nr_installs);
+	if (ret) {
+		printk(KERN_ERR "Failed installing plugins\n");
+		goto uninstall;
+	}
+
+	if (env->deadline) {
+		ret = sched_init(&sched, nr_groups, env->deadline);
+		if (ret)
+			goto uninstall;
+		se.sched = &sched;
+		for (i = 0; i != nr_groups; ++i) {
+			ret = sched_add_group(&sched, i, env,
+					groups[i].adaptive ? NULL : &groups[i].plugins);
+			if (ret)
+				goto uninstall;
+		}
+	}
+
+	for (i = 0; i != nr_groups; i = next) {
+		char buf[128];
+
+		next = i + 1;
+		if (list_empty(&groups[i].plugins))
+			continue;
 
-		mod_mgr_unload_unused(mm);
+		/* Re-plan with the time actually left before every group */
+		if (se.sched)
+			sched_plan(&sched, &env->settings, i);
+
+		if (env->interleave > 1 && !groups[i].adaptive) {
+			next = suite_block_end(&se, i);
+			ret = suite_execute_block(&se, i, next);
+			if (env->disk_budget)
+				ret |= suite_uninstall(env, groups, nr_groups,
+						installs, nr_installs, next - 1);
+			if (ret)
+				break;
+			continue;
+		}
 
 		printk(KERN_INFO "Group %d/%d\n", i+1, nr_groups);
 		sprintf(buf, "--------------------------------------------------------------------------------\nGroup %2d/%d", i + 1, nr_groups);
-		ret = plugins_execute(env, &pgrp, buf);
 
-error_populating_group:
-		list_for_each_entry_safe(plg, nplg, &pgrp, plugin_grp) {
-			list_del(&plg->plugin_grp);
-			mod_mgr_plugin_free(mm, plg);
+		if (groups[i].adaptive) {
+			struct suite_point pt = {
+				.se = &se,
+				.group = i,
+			};
+
+			double budget = suite_sweep_budget(&se, i);
+			double started = sched_now();
+
+			/* The points share the installs of the placeholders */
+			ret = suite_install_group(env, &groups[i].plugins,
+					installs, nr_installs, 0);
+			if (!ret)
+				ret = journal_group_start(env->journal,
+						groups[i].index, "adaptive");
+			if (!ret)
+				ret = sweep_adaptive_execute(mm, env,
+						groups[i].adaptive, budget, buf,
+						suite_adaptive_point, &pt);
+			if (!ret)
+				ret = journal_group_finish(env->journal,
+						groups[i].index);
+			env->sweep_used += sched_now() - started;
+		} else {
+			ret = suite_group_execute(&se, i, buf);
 		}
+
+		if (env->disk_budget)
+			ret |= suite_uninstall(env, groups, nr_groups,
+					installs, nr_installs, i);
 		if (ret)
 			break;
 	}
+
+uninstall:
+	if (se.sched)
+		sched_exit(&sched);
+	printk(KERN_INFO "Uninstalling plugins\n");
+	ret |= suite_uninstall(env, groups, nr_groups, installs, nr_installs,
+			-1);
+	ret |= se.failed;
+
+error_populating_groups:
+	suite_free_groups(mm, groups, nr_groups);
+	free(installs);
+	return ret;
+}
+
+static int benchsuite_add_downloads(const struct download ***dls, int *nr_dls,
+		const struct download *new)
+{
+	int i;
+	int j;
+
+	for (i = 0; new && new[i].name; ++i) {
+		const struct download **tmp;
+
+		for (j = 0; j != *nr_dls; ++j) {
+			if (!strcmp((*dls)[j]->name, new[i].name))
+				break;
+		}
+		if (j != *nr_dls)
+			continue;
+
+		tmp = realloc(*dls, sizeof(**dls) * (*nr_dls + 2));
+		if (!tmp)
+			return -1;
+		*dls = tmp;
+		(*dls)[(*nr_dls)++] = &new[i];
+		(*dls)[*nr_dls] = NULL;
+	}
+	return 0;
+}
+
+int benchsuite_prefetch(struct mod_mgr *mm, struct environment *env,
+		struct benchsuite *suite, int *skip)
+{
+	const struct download **dls = NULL;
+	struct suite_group *groups;
+	struct plugin *plg;
+	int nr_groups;
+	int nr_dls = 0;
+	int i;
+	int ret = 0;
+
+	if (suite_resolve(mm, env, suite, skip, &groups, &nr_groups))
+		return -1;
+
+	for (i = 0; i != nr_groups; ++i) {
+		list_for_each_entry(plg, &groups[i].plugins, plugin_grp) {
+			ret = benchsuite_add_downloads(&dls, &nr_dls,
+					plg->version->downloads);
+			if (ret) {
+				printk(KERN_ERR "Out of memory\n");
+				goto out;
+			}
+		}
+	}
+
+	if (!nr_dls) {
+		printk(KERN_INFO "Nothing to prefetch for %s\n", suite->id->name);
+		goto out;
+	}
+
+	printk(KERN_INFO "Prefetching %d files for %s\n", nr_dls,
+			suite->id->name);
+	ret = downloads_fetch_parallel(env->download_dir, env->mirrors, dls);
+	if (ret)
+		printk(KERN_ERR "Failed to prefetch all files\n");
+
+out:
+	suite_free_groups(mm, groups, nr_groups);
+	free(dls);
 	return ret;
 }
 
+const char **create_version_rules(char *arg) {
+	int nr_rules = 1;
+	int i;
+	char *vs;
+	char *vs_next;
+	const char **rules;
+
+	for (vs = arg; vs && (u64)vs != 1 && vs[0]; vs = strchr(vs, '@') + 1)
+		++nr_rules;
+
+	rules = malloc(sizeof(*rules) * nr_rules + 1);
+	if (!rules) {
+		return NULL;
+	}
+	memset(&rules[nr_rules], 0, sizeof(*rules));
+
+	for (vs = arg, i = 0; vs && vs[0]; vs = vs_next, ++i) {
+		vs_next = strchr(vs, '@');
+		if (vs_next && *vs_next == '@') {
+			*vs_next = '\0';
+			++vs_next;
+		}
+
+		rules[i] = vs;
+	}
+	return rules;
+}
+
+/* Non-negative number of milliseconds, the whole string */
+static int plugin_link_ms(const char *str, unsigned int *ms)
+{
+	char *end;
+	long val;
+
+	val = strtol(str, &end, 10);
+	if (end == str || *end || val < 0 || val > INT_MAX)
+		return -1;
+	*ms = val;
+	return 0;
+}
+
+int create_plugin_link(struct plugin_link *plug, char *arg)
+{
+	char *vers_start;
+	char *opt_start = NULL;
+	char *mod_start;
+	char *inst_start;
+	plug->name = arg;
+
+	vers_start = strchr(arg, '@');
+	if (!vers_start) {
+		plug->version_rules = NULL;
+		opt_start = strchr(arg, ':');
+		if (opt_start) {
+			*opt_start = '\0';
+			++opt_start;
+		}
+	} else {
+		char *vers_end = strchr(vers_start, ':');
+		*vers_start = '\0';
+		++vers_start;
+		if (vers_end) {
+			*vers_end = '\0';
+			opt_start = vers_end + 1;
+		}
+		if (vers_start[0]) {
+			plug->version_rules = create_version_rules(vers_start);
+			if (!plug->version_rules) {
+				printk("Failed to construct version rules for %s\n",
+						plug->name);
+				return -1;
+			}
+		} else {
+			plug->version_rules = NULL;
+		}
+	}
+
+	if (opt_start && opt_start[0]) {
+		plug->options = opt_start;
+	}
+
+	plug->role = PLUGIN_ROLE_AUTO;
+	plug->converge = NULL;
+	plug->monitor_period = 0;
+	plug->monitor_offset = 0;
+	mod_start = strchr(plug->name, '+');
+	if (mod_start) {
+		*mod_start = '\0';
+		++mod_start;
+	}
+	while (mod_start) {
+		char *mod_next = strchr(mod_start, '+');
+
+		if (mod_next) {
+			*mod_next = '\0';
+			++mod_next;
+		}
+		if (!strcmp(mod_start, "primary")) {
+			plug->role = PLUGIN_ROLE_PRIMARY;
+		} else if (!strcmp(mod_start, "background")) {
+			plug->role = PLUGIN_ROLE_BACKGROUND;
+		} else if (!strncmp(mod_start, "converge=", 9) && mod_start[9]) {
+			plug->converge = mod_start + 9;
+		} else if (!strncmp(mod_start, "period=", 7)) {
+			if (plugin_link_ms(mod_start + 7, &plug->monitor_period)
+					|| !plug->monitor_period) {
+				printk(KERN_ERR "Invalid monitor period %s of plugin %s\n",
+						mod_start + 7, plug->name);
+				put_plugin_link(plug);
+				return -1;
+			}
+		} else if (!strncmp(mod_start, "offset=", 7)) {
+			if (plugin_link_ms(mod_start + 7, &plug->monitor_offset)) {
+				printk(KERN_ERR "Invalid monitor offset %s of plugin %s\n",
+						mod_start + 7, plug->name);
+				put_plugin_link(plug);
+				return -1;
+			}
+		} else {
+			printk(KERN_ERR "Unknown modifier %s of plugin %s\n",
+					mod_start, plug->name);
+			put_plugin_link(plug);
+			return -1;
+		}
+		mod_start = mod_next;
+	}
+
+	plug->instances = 1;
+	inst_start = strchr(plug->name, '*');
+	if (inst_start) {
+		char *end;
+
+		*inst_start = '\0';
+		plug->instances = strtol(inst_start + 1, &end, 10);
+		if (end == inst_start + 1 || *end || plug->instances < 1) {
+			printk(KERN_ERR "Invalid number of instances of plugin %s\n",
+					plug->name);
+			put_plugin_link(plug);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+struct plugin *plugin_link_create(struct mod_mgr *mm,
+		const struct plugin_link *link, const char *options,
+		struct list_head *plugins)
+{
+	struct plugin *first = NULL;
+	int nr_instances = link->instances > 1 ? link->instances : 1;
+	int i;
+
+	for (i = 0; i != nr_instances; ++i) {
+		struct plugin *plg = mod_mgr_plugin_create(mm, link->name,
+				options, link->version_rules);
+
+		if (!plg) {
+			printk(KERN_ERR "Didn't find plugin %s\n", link->name);
+			return NULL;
+		}
+		plg->role = link->role;
+		plg->converge = link->converge;
+		plg->monitor_period = link->monitor_period;
+		plg->monitor_offset = link->monitor_offset;
+		plg->instance = i;
+		plg->nr_instances = nr_instances;
+		list_add_tail(&plg->plugin_grp, plugins);
+		if (!first)
+			first = plg;
+	}
+	return first;
+}
+
+void put_plugin_link(struct plugin_link *plug)
+{
+	if (plug->version_rules)
+		free(plug->version_rules);
+}
+
+struct plugin_link *create_run_combo(char *arg)
+{
+	char *rc;
+	char *rc_next;
+	int nr_plugs = 1;
+	int i;
+	int ret;
+	struct plugin_link *plugs;
+
+	for (rc = arg; rc && (u64)rc != 1 && rc[0]; rc = strchr(rc, ';') + 1)
+		++nr_plugs;
+
+	plugs = malloc(sizeof(*plugs) * (nr_plugs + 1));
+	if (!plugs)
+		return NULL;
+	memset(plugs, 0, sizeof(*plugs) * (nr_plugs + 1));
+
+	for (rc = arg, i = 0; rc && rc[0]; rc = rc_next, ++i) {
+		rc_next = strchr(rc, ';');
+		if (rc_next && *rc_next == ';') {
+			rc_next[0] = '\0';
+			++rc_next;
+		}
+
+		ret = create_plugin_link(&plugs[i], rc);
+		if (ret) {
+			printk(KERN_ERR "Failed to create plugin link\n");
+			goto error;
+		}
+	}
+
+	return plugs;
+
+error:
+	if (i) {
+		while (i--) {
+			put_plugin_link(&plugs[i]);
+		}
+	}
+	free(plugs);
+	return NULL;
+}
+
+void put_run_combo(struct plugin_link *c)
+{
+	int i;
+	for (i = 0; c[i].name != NULL; ++i)
+		put_plugin_link(&c[i]);
+	free(c);
+}
+
+void benchsuite_apply_settings(const struct benchsuite_id *suite,
+		struct run_settings *settings)
+{
+	const struct run_settings *over = suite->settings;
+
+	if (!over)
+		return;
+	if (over->warmup_runs != -1)
+		settings->warmup_runs = over->warmup_runs;
+	if (over->runtime_min != -1)
+		settings->runtime_min = over->runtime_min;
+	if (over->runtime_max != -1)
+		settings->runtime_max = over->runtime_max;
+	if (over->runs_min != -1)
+		settings->runs_min = over->runs_min;
+	if (over->runs_max != -1)
+		settings->runs_max = over->runs_max;
+	if (over->percent_stderr >= 0)
+		settings->percent_stderr = over->percent_stderr;
+}
+
 void benchsuite_id_print(const struct benchsuite_id *suite, int verbose)
 {
 	printf("      %s (Version %s)\n", suite->name,
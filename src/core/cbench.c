@@ -17,13 +17,17 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
 #include <klib/printk.h>
 
+#include <cbench/core/journal.h>
+#include <cbench/core/memory.h>
 #include <cbench/core/module_manager.h>
+#include <cbench/core/scheduler.h>
 
 #include <cbench/benchsuite.h>
 #include <cbench/environment.h>
@@ -42,6 +46,7 @@ struct arguments {
 	const char *storage;
 	const char *db_path;
 	const char *module_dir;
+	const char *suite_dir;
 	const char *work_dir;
 	const char *download_dir;
 	const char *custom_sysinfo;
@@ -53,14 +58,32 @@ struct arguments {
 	const char *max_runtime;
 	const char *std_err;
 	const char *skip;
+	const char *disk_budget;
+	const char *sweep_budget;
+	const char *time_budget;
+	const char *interleave;
+	const char *seed;
+	int interleave_rr;
+	int mlock;
+	int isolate;
+	const char *mirrors[17];
+	int nr_mirrors;
+
+	/* Unparsed command line, recorded in the execution journal */
+	int nr_args;
+	char **args;
 
 	int cmd_list;
 	int cmd_plugins;
 	int cmd_help;
 	int cmd_continue;
+	int cmd_prefetch;
 	int verbose;
 };
 
+typedef int (*suite_action)(struct mod_mgr *mm, struct environment *env,
+		struct benchsuite *suite, int *skip);
+
 void print_help()
 {
 	fputs(
@@ -84,8 +107,15 @@ Commands:\n\
 				doc/identifier_specifications for more\n\
 				information.\n\
 	--continue,-c		Continue the last command on the given database.\n\
-				This will use the log file to start the command\n\
-				again and skip all finished executions.\n\
+				Every execution records its command line and\n\
+				each completed run in the journal of the\n\
+				database directory. The command is started\n\
+				again, finished groups are skipped and an\n\
+				interrupted group continues after its last\n\
+				completed run.\n\
+	--prefetch,-f		Fetch all files needed by the given benchsuites\n\
+				(or plugins with -p) into the download cache in\n\
+				parallel without executing anything.\n\
 	--help,-h		Displays this help and exits.\n\
 \n\
 Options:\n\
@@ -96,12 +126,21 @@ Options:\n\
 	--verbose,-v		Verbose output. (more information, but not the\n\
 				same as log-level)\n\
 	--module-dir,-m PATH	Module directory. Default: " CONFIG_MODULE_DIR "\n\
+	--suite-dir PATH	Directory of benchsuite files. A benchsuite NAME\n\
+				without module is loaded from PATH/NAME.suite.\n\
+				Default: " CONFIG_SUITE_DIR "\n\
 	--work-dir,-w PATH	Working directory. IMPORTANT! Depending on the\n\
 				location of this work directory, the benchmark\n\
 				results could vary. Default: " CONFIG_WORK_DIR "\n\
 	--download-dir,-d PATH	Download directory. This is one central download\n\
 				directory for all modules and plugins.\n\
 				Default: " CONFIG_DOWNLOAD_DIR "\n\
+	--mirror,-M URL		Download mirror that is tried before the upstream\n\
+				location. May be a URL prefix, a file:// URL or a\n\
+				local directory, e.g. the download directory of\n\
+				another machine. Can be given multiple times.\n\
+				Downloads are verified by their sha256 on fetch\n\
+				and on every reuse.\n\
 	--sysinfo,-i INFO	Additional system information. This will\n\
 				seperate the results of the executed benchmarks\n\
 				from others. For example you can use any code\n\
@@ -116,6 +155,47 @@ Options:\n\
 	--stderr N		Percent of the standard error that need to be\n\
 				reached within the other runtime bounds. (float)\n\
 	--skip N 		Skip N groups of the execution.\n\
+	--disk-budget MIB	All plugins of a benchsuite are installed before\n\
+				the first measurement. With a disk budget, the\n\
+				pre-installation stops when the work directory\n\
+				exceeds MIB megabytes. Remaining plugins are then\n\
+				installed right before their group and all\n\
+				installations are removed after their last group.\n\
+	--sweep-budget SEC	Time budget of all adaptive sweeps together,\n\
+				e.g. threads=adaptive(1..64). The time left is\n\
+				split between the sweeps of a benchsuite still\n\
+				to execute. Without a budget, at most 32 points\n\
+				are measured per sweep.\n\
+	--time-budget TIME	Finish the execution within TIME, e.g. 8h, 90m\n\
+				or 1h30m. Run and runtime limits of each group\n\
+				are planned from the durations and deviations of\n\
+				earlier runs in the database, an ETA is printed\n\
+				and the plan is updated after every group.\n\
+				Multiple benchsuites share the remaining time\n\
+				equally.\n\
+	--interleave N		Install and start N consecutive groups at once\n\
+				and alternate their runs, every round in a new\n\
+				random order. 0 interleaves all groups of a\n\
+				benchsuite. Each group keeps its own stopping\n\
+				criteria. Slow drift of the system then affects\n\
+				all groups alike instead of biasing later ones.\n\
+	--interleave-rr		Alternate interleaved runs round robin.\n\
+	--seed N		Seed of the random interleave order. By default\n\
+				a new seed is chosen. It is printed and stored\n\
+				with every run.\n\
+	--mlock			Lock all memory and prefault a heap reserve, so\n\
+				cbenchsuite itself causes no page faults during\n\
+				measurements. Allocations and page faults of the\n\
+				controller and monitor threads during the run\n\
+				function are reported. Needs a sufficient\n\
+				RLIMIT_MEMLOCK.\n\
+	--isolate		Execute every group in a forked child process.\n\
+				Its results are stored by cbenchsuite through a\n\
+				pipe. Memory fragmentation and state leaked by\n\
+				plugins end with the group and a crashing group\n\
+				does not stop the following ones. Interleaved\n\
+				groups are not isolated, every point of an\n\
+				adaptive sweep is isolated on its own.\n\
 ", stdout);
 }
 
@@ -144,16 +224,26 @@ int args_parse(struct arguments *pargs, int argc, char **argv)
 			++pargs->verbose;
 		} else if (arg_match(arg, "--module-dir", "-m")) {
 			parse_arg_tgt = &pargs->module_dir;
+		} else if (!strcmp(arg, "--suite-dir")) {
+			parse_arg_tgt = &pargs->suite_dir;
 		} else if (arg_match(arg, "--work-dir", "-w")) {
 			parse_arg_tgt = &pargs->work_dir;
 		} else if (arg_match(arg, "--download-dir", "-d")) {
 			parse_arg_tgt = &pargs->download_dir;
+		} else if (arg_match(arg, "--mirror", "-M")) {
+			if (pargs->nr_mirrors == 16) {
+				printk(KERN_ERR "Too many mirrors\n");
+				return -1;
+			}
+			parse_arg_tgt = &pargs->mirrors[pargs->nr_mirrors++];
 		} else if (arg_match(arg, "--plugins", "-p")) {
 			pargs->cmd_plugins = 1;
 		} else if (arg_match(arg, "--help", "-h")) {
 			pargs->cmd_help = 1;
 		} else if (arg_match(arg, "--continue", "-c")) {
 			pargs->cmd_continue = 1;
+		} else if (arg_match(arg, "--prefetch", "-f")) {
+			pargs->cmd_prefetch = 1;
 		} else if (arg_match(arg, "--sysinfo", "-i")) {
 			parse_arg_tgt = &pargs->custom_sysinfo;
 		} else if (!strcmp(arg, "--warmup-runs")) {
@@ -170,6 +260,22 @@ int args_parse(struct arguments *pargs, int argc, char **argv)
 			parse_arg_tgt = &pargs->std_err;
 		} else if (!strcmp(arg, "--skip")) {
 			parse_arg_tgt = &pargs->skip;
+		} else if (!strcmp(arg, "--disk-budget")) {
+			parse_arg_tgt = &pargs->disk_budget;
+		} else if (!strcmp(arg, "--sweep-budget")) {
+			parse_arg_tgt = &pargs->sweep_budget;
+		} else if (!strcmp(arg, "--time-budget")) {
+			parse_arg_tgt = &pargs->time_budget;
+		} else if (!strcmp(arg, "--interleave")) {
+			parse_arg_tgt = &pargs->interleave;
+		} else if (!strcmp(arg, "--interleave-rr")) {
+			pargs->interleave_rr = 1;
+		} else if (!strcmp(arg, "--mlock")) {
+			pargs->mlock = 1;
+		} else if (!strcmp(arg, "--isolate")) {
+			pargs->isolate = 1;
+		} else if (!strcmp(arg, "--seed")) {
+			parse_arg_tgt = &pargs->seed;
 		} else if (*arg == '-') {
 			printk(KERN_ERR "Unknown option '%s'\n", arg);
 			return -1;
@@ -188,143 +294,53 @@ int args_parse(struct arguments *pargs, int argc, char **argv)
 
 #undef arg_match
 
-const char **create_version_rules(char *arg) {
-	int nr_rules = 1;
-	int i;
-	char *vs;
-	char *vs_next;
-	const char **rules;
-
-	for (vs = arg; vs && (u64)vs != 1 && vs[0]; vs = strchr(vs, '@') + 1)
-		++nr_rules;
-
-	rules = malloc(sizeof(*rules) * nr_rules + 1);
-	if (!rules) {
-		return NULL;
-	}
-	memset(&rules[nr_rules], 0, sizeof(*rules));
-
-	for (vs = arg, i = 0; vs && vs[0]; vs = vs_next, ++i) {
-		vs_next = strchr(vs, '@');
-		if (vs_next && *vs_next == '@') {
-			*vs_next = '\0';
-			++vs_next;
-		}
-
-		rules[i] = vs;
-	}
-	return rules;
-}
-
-int create_plugin_link(struct plugin_link *plug, char *arg)
-{
-	char *vers_start;
-	char *opt_start = NULL;
-	plug->name = arg;
-
-	vers_start = strchr(arg, '@');
-	if (!vers_start) {
-		plug->version_rules = NULL;
-		opt_start = strchr(arg, ':');
-		if (opt_start) {
-			*opt_start = '\0';
-			++opt_start;
-		}
-	} else {
-		char *vers_end = strchr(vers_start, ':');
-		*vers_start = '\0';
-		++vers_start;
-		if (vers_end) {
-			*vers_end = '\0';
-			opt_start = vers_end + 1;
-		}
-		if (vers_start[0]) {
-			plug->version_rules = create_version_rules(vers_start);
-			if (!plug->version_rules) {
-				printk("Failed to construct version rules for %s\n",
-						plug->name);
-				return -1;
-			}
-		} else {
-			plug->version_rules = NULL;
-		}
-	}
-
-	if (opt_start && opt_start[0]) {
-		plug->options = opt_start;
-	}
-	return 0;
-}
-
-void put_plugin_link(struct plugin_link *plug)
+/* Run settings given on the command line take precedence over suite files */
+static void args_apply_settings(struct arguments *pargs,
+		struct run_settings *settings)
 {
-	if (plug->version_rules)
-		free(plug->version_rules);
+	if (pargs->std_err)
+		settings->percent_stderr = atof(pargs->std_err);
+	if (pargs->min_runs)
+		settings->runs_min = atoi(pargs->min_runs);
+	if (pargs->max_runs)
+		settings->runs_max = atoi(pargs->max_runs);
+	if (pargs->min_runtime)
+		settings->runtime_min = atoi(pargs->min_runtime);
+	if (pargs->max_runtime)
+		settings->runtime_max = atoi(pargs->max_runtime);
+	if (pargs->warmup_runs)
+		settings->warmup_runs = atoi(pargs->warmup_runs);
 }
 
-struct plugin_link *create_run_combo(char *arg)
+int execute_benchsuite_args(struct mod_mgr *mm, struct environment *env, int skip,
+		struct arguments *pargs, int argc, char **argv,
+		suite_action action)
 {
-	char *rc;
-	char *rc_next;
-	int nr_plugs = 1;
 	int i;
 	int ret;
-	struct plugin_link *plugs;
+	int nr_suites = 0;
+	double deadline = env->deadline;
 
-	for (rc = arg; rc && (u64)rc != 1 && rc[0]; rc = strchr(rc, ';') + 1)
-		++nr_plugs;
-
-	plugs = malloc(sizeof(*plugs) * (nr_plugs + 1));
-	if (!plugs)
-		return NULL;
-	memset(plugs, 0, sizeof(*plugs) * (nr_plugs + 1));
-
-	for (rc = arg, i = 0; rc && rc[0]; rc = rc_next, ++i) {
-		rc_next = strchr(rc, ';');
-		if (rc_next && *rc_next == ';') {
-			rc_next[0] = '\0';
-			++rc_next;
-		}
-
-		ret = create_plugin_link(&plugs[i], rc);
-		if (ret) {
-			printk(KERN_ERR "Failed to create plugin link\n");
-			goto error;
-		}
-	}
-
-	return plugs;
-
-error:
-	if (i) {
-		while (i--) {
-			put_plugin_link(&plugs[i]);
-		}
+	for (i = 1; i != argc; ++i) {
+		if (argv[i])
+			++nr_suites;
 	}
-	free(plugs);
-	return NULL;
-}
-
-void put_run_combo(struct plugin_link *c)
-{
-	int i;
-	for (i = 0; c[i].name != NULL; ++i)
-		put_plugin_link(&c[i]);
-	free(c);
-}
-int execute_benchsuite_args(struct mod_mgr *mm, struct environment *env, int skip,
-		struct arguments *pargs, int argc, char **argv)
-{
-	int i;
-	int ret;
 
 	for (i = 1; i != argc; ++i) {
 		const char **vers;
 		char *ver_string;
 		struct benchsuite *suite;
+		struct run_settings settings;
 		if (!argv[i])
 			continue;
 
+		/* Every remaining benchsuite gets the same part of the time left */
+		if (deadline) {
+			double now = sched_now();
+
+			env->deadline = now + (deadline - now) / nr_suites--;
+		}
+
 		ver_string = strchr(argv[i], '@');
 		if (ver_string) {
 			*ver_string = '\0';
@@ -343,8 +359,14 @@ int execute_benchsuite_args(struct mod_mgr *mm, struct environment *env, int ski
 			return -1;
 		}
 
-		ret = benchsuite_execute(mm, env, suite, &skip);
+		settings = env->settings;
+		benchsuite_apply_settings(suite->id, &env->settings);
+		args_apply_settings(pargs, &env->settings);
 
+		ret = action(mm, env, suite, &skip);
+
+		env->settings = settings;
+		mod_mgr_benchsuite_free(mm, suite);
 		if (vers)
 			free(vers);
 
@@ -357,7 +379,8 @@ int execute_benchsuite_args(struct mod_mgr *mm, struct environment *env, int ski
 }
 
 int execute_cmd_args(struct mod_mgr *mm, struct environment *env, int skip,
-		struct arguments *pargs, int argc, char **argv)
+		struct arguments *pargs, int argc, char **argv,
+		suite_action action)
 {
 	int ret = 0;
 	int i;
@@ -419,7 +442,7 @@ int execute_cmd_args(struct mod_mgr *mm, struct environment *env, int skip,
 	suite->mod = NULL;
 	suite->id = suite_id;
 
-	ret = benchsuite_execute(mm, env, suite, &skip);
+	ret = action(mm, env, suite, &skip);
 
 error_combo_loop:
 	if (ct) {
@@ -445,6 +468,7 @@ int cmd_execute(struct arguments *pargs, int argc, char **argv, int as_benchsuit
 		.work_dir = pargs->work_dir,
 		.bin_dir = pargs->module_dir,
 		.download_dir = pargs->download_dir,
+		.mirrors = pargs->mirrors,
 		.settings = {
 			.warmup_runs = CONFIG_WARMUP_RUNS,
 			.runs_min = CONFIG_MIN_RUNS,
@@ -453,19 +477,33 @@ int cmd_execute(struct arguments *pargs, int argc, char **argv, int as_benchsuit
 			.runtime_max = CONFIG_MAX_RUNTIME,
 		},
 	};
-	env.settings.percent_stderr = atof(pargs->std_err);
-	if (pargs->min_runs)
-		env.settings.runs_min = atoi(pargs->min_runs);
-	if (pargs->max_runs)
-		env.settings.runs_max = atoi(pargs->max_runs);
-	if (pargs->min_runtime)
-		env.settings.runtime_min = atoi(pargs->min_runtime);
-	if (pargs->max_runtime)
-		env.settings.runtime_max = atoi(pargs->max_runtime);
-	if (pargs->warmup_runs)
-		env.settings.warmup_runs = atoi(pargs->warmup_runs);
+	env.settings.percent_stderr = atof(CONFIG_STDERR_PERCENT);
+	args_apply_settings(pargs, &env.settings);
 	if (pargs->skip)
 		skip = atoi(pargs->skip);
+	if (pargs->disk_budget)
+		env.disk_budget = strtoul(pargs->disk_budget, NULL, 10);
+	if (pargs->sweep_budget)
+		env.sweep_budget = strtoul(pargs->sweep_budget, NULL, 10);
+	if (pargs->interleave) {
+		env.interleave = atoi(pargs->interleave);
+		if (!env.interleave)
+			env.interleave = INT_MAX;
+	}
+	env.interleave_rr = pargs->interleave_rr;
+	env.isolate = pargs->isolate;
+	if (pargs->seed)
+		env.interleave_seed = strtoul(pargs->seed, NULL, 10);
+	if (pargs->time_budget) {
+		long budget = sched_parse_duration(pargs->time_budget);
+
+		if (budget <= 0) {
+			printk(KERN_ERR "Invalid time budget %s\n",
+					pargs->time_budget);
+			return -1;
+		}
+		env.deadline = sched_now() + budget;
+	}
 
 	ret = system_info_init(&sys, pargs->custom_sysinfo);
 	if (ret) {
@@ -494,21 +532,37 @@ int cmd_execute(struct arguments *pargs, int argc, char **argv, int as_benchsuit
 		goto error_storage_sysinfo;
 	}
 
-	ret = mod_mgr_init(&mm, env.bin_dir);
+	ret = mod_mgr_init(&mm, env.bin_dir, pargs->suite_dir);
 	if (ret) {
 		printk(KERN_ERR "Failed to initialize module manager\n");
 		goto error_storage_sysinfo;
 	}
 
+	if (pargs->mlock) {
+		ret = memory_lock();
+		if (ret)
+			goto error_modmgr;
+		memory_count_thread();
+		env.mlock = 1;
+	}
+
+	env.journal = journal_open(pargs->db_path, pargs->nr_args, pargs->args,
+			pargs->cmd_continue);
+	if (!env.journal) {
+		ret = -1;
+		goto error_modmgr;
+	}
+
 	if (as_benchsuite)
-		ret = execute_benchsuite_args(&mm, &env, skip, pargs, argc, argv);
+		ret = execute_benchsuite_args(&mm, &env, skip, pargs, argc, argv,
+				benchsuite_execute);
 	else
-		ret = execute_cmd_args(&mm, &env, skip, pargs, argc, argv);
-	if (ret) {
+		ret = execute_cmd_args(&mm, &env, skip, pargs, argc, argv,
+				benchsuite_execute);
+	if (ret)
 		printk(KERN_ERR "Failed executing all commandline arguments\n");
-		goto error_modmgr;
-	}
 
+	journal_close(env.journal, !ret);
 error_modmgr:
 	mod_mgr_exit(&mm);
 error_storage_sysinfo:
@@ -519,13 +573,47 @@ error_storage_init:
 	return ret;
 }
 
+int cmd_prefetch(struct arguments *pargs, int argc, char **argv, int as_benchsuite)
+{
+	struct mod_mgr mm;
+	int ret;
+	int skip = 0;
+	struct environment env = {
+		.work_dir = pargs->work_dir,
+		.bin_dir = pargs->module_dir,
+		.download_dir = pargs->download_dir,
+		.mirrors = pargs->mirrors,
+	};
+
+	if (pargs->skip)
+		skip = atoi(pargs->skip);
+
+	ret = mod_mgr_init(&mm, env.bin_dir, pargs->suite_dir);
+	if (ret) {
+		printk(KERN_ERR "Failed to initialize module manager\n");
+		return -1;
+	}
+
+	if (as_benchsuite)
+		ret = execute_benchsuite_args(&mm, &env, skip, pargs, argc, argv,
+				benchsuite_prefetch);
+	else
+		ret = execute_cmd_args(&mm, &env, skip, pargs, argc, argv,
+				benchsuite_prefetch);
+	if (ret)
+		printk(KERN_ERR "Failed prefetching all commandline arguments\n");
+
+	mod_mgr_exit(&mm);
+	return ret;
+}
+
 int cmd_list(struct arguments *pargs, int argc, char **argv) {
 	struct mod_mgr mm;
 	int arg_found = 0;
 	int i;
 	int ret;
 
-	ret = mod_mgr_init(&mm, pargs->module_dir);
+	ret = mod_mgr_init(&mm, pargs->module_dir, pargs->suite_dir);
 	if (ret) {
 		printk(KERN_ERR "Failed to initialize module manager\n");
 		return -1;
@@ -570,13 +658,22 @@ static const char *expand_home(const char *rel_path)
 
 static int expand_pathes(struct arguments *args)
 {
+	int i;
+
+	for (i = 0; i != args->nr_mirrors; ++i) {
+		args->mirrors[i] = expand_home(args->mirrors[i]);
+		if (!args->mirrors[i])
+			return -1;
+	}
+
 	args->work_dir = expand_home(args->work_dir);
 	args->download_dir = expand_home(args->download_dir);
 	args->module_dir = expand_home(args->module_dir);
+	args->suite_dir = expand_home(args->suite_dir);
 	args->db_path = expand_home(args->db_path);
 
 	if (!args->work_dir || !args->download_dir || !args->module_dir
-			|| !args->db_path)
+			|| !args->suite_dir || !args->db_path)
 		return -1;
 	return 0;
 }
@@ -596,26 +693,75 @@ static int create_dirs(struct arguments *args)
 	return ret;
 }
 
+static const struct arguments default_args = {
+	.storage = "sqlite3",
+	.db_path = CONFIG_DB_DIR,
+	.work_dir = CONFIG_WORK_DIR,
+	.module_dir = CONFIG_MODULE_DIR,
+	.suite_dir = CONFIG_SUITE_DIR,
+	.download_dir = CONFIG_DOWNLOAD_DIR,
+	.custom_sysinfo = "",
+	.verbose = 0,
+};
+
+/* args_parse removes the options from argv, keep a copy for the journal */
+static int args_parse_saved(struct arguments *pargs, int argc, char **argv)
+{
+	pargs->args = malloc(sizeof(*pargs->args) * (argc + 1));
+	if (!pargs->args)
+		return -1;
+	memcpy(pargs->args, argv, sizeof(*pargs->args) * (argc + 1));
+	pargs->nr_args = argc;
+
+	return args_parse(pargs, argc, argv);
+}
+
+/* Replace the arguments with the command of the journal in the database */
+static int args_continue(struct arguments *pargs, int *argc, char ***argv)
+{
+	const char *db_path = expand_home(pargs->db_path);
+	int ret;
+
+	if (!db_path)
+		return -1;
+
+	ret = journal_read_command(db_path, argc, argv);
+	if (ret)
+		return -1;
+
+	free(pargs->args);
+	*pargs = default_args;
+	ret = args_parse_saved(pargs, *argc, *argv);
+	if (ret)
+		return -1;
+	if (pargs->cmd_continue) {
+		printk(KERN_ERR "The journal command contains --continue\n");
+		return -1;
+	}
+	pargs->cmd_continue = 1;
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
-	struct arguments pargs = {
-		.storage = "sqlite3",
-		.db_path = CONFIG_DB_DIR,
-		.work_dir = CONFIG_WORK_DIR,
-		.module_dir = CONFIG_MODULE_DIR,
-		.download_dir = CONFIG_DOWNLOAD_DIR,
-		.custom_sysinfo = "",
-		.std_err = CONFIG_STDERR_PERCENT,
-		.verbose = 0,
-	};
+	struct arguments pargs = default_args;
 	int ret = 0;
 	printk_set_log_level(CONFIG_PRINT_LOG_LEVEL);
 
-	ret = args_parse(&pargs, argc, argv);
+	ret = args_parse_saved(&pargs, argc, argv);
 	if (ret) {
 		return -1;
 	}
 
+	if (pargs.cmd_continue) {
+		ret = args_continue(&pargs, &argc, &argv);
+		if (ret)
+			return -1;
+	}
+
+	if (!pargs.nr_mirrors && CONFIG_DOWNLOAD_MIRROR[0])
+		pargs.mirrors[pargs.nr_mirrors++] = CONFIG_DOWNLOAD_MIRROR;
+
 	ret = expand_pathes(&pargs);
 	if (ret) {
 		return -1;
@@ -634,6 +780,8 @@ int main(int argc, char **argv)
 
 		if (pargs.cmd_list) {
 			ret = cmd_list(&pargs, argc, argv);
+		} else if (pargs.cmd_prefetch) {
+			ret = cmd_prefetch(&pargs, argc, argv, !pargs.cmd_plugins);
 		} else if (pargs.cmd_plugins) {
 			ret = cmd_execute(&pargs, argc, argv, 0);
 		} else {
@@ -0,0 +1,425 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cbench/core/download.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <klib/printk.h>
+
+#include <cbench/download.h>
+#include <cbench/sha256.h>
+
+static const char *download_store = "sha256";
+static unsigned int download_seq = 0;
+
+struct download_job {
+	pthread_t thread;
+	const char *download_dir;
+	const char **mirrors;
+	const struct download *dl;
+	int ret;
+};
+
+static int download_verify(const char *path, const char *sha256)
+{
+	char digest[65];
+
+	if (sha256_file_str(path, digest))
+		return -1;
+
+	if (strcasecmp(digest, sha256)) {
+		printk(KERN_WARNING "Checksum mismatch for %s: expected %s, got %s\n",
+				path, sha256, digest);
+		return -1;
+	}
+	return 0;
+}
+
+/* Atomically point download_dir/name to the store object of digest */
+static int download_link(const char *dir, const char *name, const char *digest)
+{
+	char target[PATH_MAX];
+	char path[PATH_MAX];
+	char tmp[PATH_MAX];
+
+	snprintf(target, sizeof(target), "%s/%s", download_store, digest);
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	snprintf(tmp, sizeof(tmp), "%s/.%s.link.%d.%u", dir, name, getpid(),
+			__sync_fetch_and_add(&download_seq, 1));
+
+	unlink(tmp);
+	if (symlink(target, tmp)) {
+		printk(KERN_ERR "Failed to create symlink %s: %s\n", tmp,
+				strerror(errno));
+		return -1;
+	}
+	if (rename(tmp, path)) {
+		printk(KERN_ERR "Failed to rename %s to %s: %s\n", tmp, path,
+				strerror(errno));
+		unlink(tmp);
+		return -1;
+	}
+	return 0;
+}
+
+/* Whether the gzip stream of path is complete and its CRC matches */
+static int download_gzip_test(const char *path)
+{
+	char *argv[] = {"gzip", "-t", "-q", (char *)path, NULL};
+	int status;
+	pid_t pid;
+
+	pid = fork();
+	if (pid == -1)
+		return -1;
+	if (pid == 0) {
+		execvp("gzip", argv);
+		_exit(-1);
+	}
+
+	if (pid != waitpid(pid, &status, 0))
+		return -1;
+	if (!WIFEXITED(status) || WEXITSTATUS(status))
+		return -1;
+	return 0;
+}
+
+static int download_is_gzip(const char *name)
+{
+	size_t len = strlen(name);
+
+	return (len > 3 && !strcmp(name + len - 3, ".gz"))
+		|| (len > 4 && !strcmp(name + len - 4, ".tgz"));
+}
+
+/*
+ * Move the file src into the store. It is verified against the expected
+ * digest of dl if there is one. Without a digest the first copy is trusted,
+ * so a gzip file has to be complete at least. The digest is returned in
+ * digest.
+ */
+static int download_adopt(const char *dir, const char *src,
+		const struct download *dl, char *digest)
+{
+	char obj[PATH_MAX];
+
+	if (!dl->sha256 && download_is_gzip(dl->name)
+			&& download_gzip_test(src)) {
+		printk(KERN_WARNING "%s is truncated or corrupt, not using it\n",
+				src);
+		unlink(src);
+		return -1;
+	}
+
+	if (sha256_file_str(src, digest)) {
+		printk(KERN_ERR "Failed to hash %s\n", src);
+		unlink(src);
+		return -1;
+	}
+
+	if (dl->sha256 && strcasecmp(digest, dl->sha256)) {
+		printk(KERN_WARNING "Checksum mismatch for %s: expected %s, got %s\n",
+				dl->name, dl->sha256, digest);
+		unlink(src);
+		return -1;
+	}
+
+	snprintf(obj, sizeof(obj), "%s/%s/%s", dir, download_store, digest);
+	if (rename(src, obj)) {
+		printk(KERN_ERR "Failed to move %s into the download cache: %s\n",
+				src, strerror(errno));
+		unlink(src);
+		return -1;
+	}
+
+	return download_link(dir, dl->name, digest);
+}
+
+/*
+ * Look for a valid cached copy of dl. Every reuse is verified against the
+ * digest, corrupt objects are removed so they are fetched again.
+ */
+static int download_lookup(const char *dir, const struct download *dl,
+		char *digest)
+{
+	char path[PATH_MAX];
+	char obj[PATH_MAX];
+	char link[PATH_MAX];
+	const char *base;
+	struct stat st;
+	ssize_t len;
+
+	if (dl->sha256) {
+		snprintf(obj, sizeof(obj), "%s/%s/%s", dir, download_store,
+				dl->sha256);
+		if (!access(obj, R_OK)) {
+			if (!download_verify(obj, dl->sha256)) {
+				strcpy(digest, dl->sha256);
+				return download_link(dir, dl->name, digest);
+			}
+			printk(KERN_WARNING "Removing corrupt cache object %s\n",
+					obj);
+			unlink(obj);
+		}
+	}
+
+	snprintf(path, sizeof(path), "%s/%s", dir, dl->name);
+	if (lstat(path, &st))
+		return -1;
+
+	if (S_ISREG(st.st_mode)) {
+		/* Plain file of an older download directory, move it into
+		 * the store after the same checks as a fresh download */
+		return download_adopt(dir, path, dl, digest);
+	}
+
+	if (!S_ISLNK(st.st_mode))
+		return -1;
+
+	len = readlink(path, link, sizeof(link) - 1);
+	if (len < 0)
+		return -1;
+	link[len] = '\0';
+
+	base = strrchr(link, '/');
+	base = base ? base + 1 : link;
+	if (strlen(base) != 64)
+		return -1;
+
+	/* The expected digest changed, the link is stale */
+	if (dl->sha256 && strcasecmp(base, dl->sha256))
+		return -1;
+
+	snprintf(obj, sizeof(obj), "%s/%s/%.64s", dir, download_store, base);
+	if (download_verify(obj, base)) {
+		printk(KERN_WARNING "Removing corrupt cache object %s\n", obj);
+		unlink(obj);
+		unlink(path);
+		return -1;
+	}
+
+	strcpy(digest, base);
+	return 0;
+}
+
+static int download_copy(const char *src, const char *dst)
+{
+	char *buf;
+	size_t buf_len = 1 << 20;
+	ssize_t len;
+	int in;
+	int out;
+	int ret = 0;
+
+	in = open(src, O_RDONLY);
+	if (in < 0)
+		return -1;
+
+	out = open(dst, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (out < 0) {
+		close(in);
+		return -1;
+	}
+
+	buf = malloc(buf_len);
+	if (!buf) {
+		ret = -1;
+		goto out;
+	}
+
+	while ((len = read(in, buf, buf_len))) {
+		char *pos = buf;
+
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			ret = -1;
+			break;
+		}
+
+		while (len) {
+			ssize_t written = write(out, pos, len);
+			if (written < 0) {
+				if (errno == EINTR)
+					continue;
+				ret = -1;
+				goto out;
+			}
+			pos += written;
+			len -= written;
+		}
+	}
+
+out:
+	free(buf);
+	if (close(out))
+		ret = -1;
+	close(in);
+	return ret;
+}
+
+static int download_wget(const char *url, const char *dst)
+{
+	char *argv[] = {"wget", "-q", "-O", (char *)dst, (char *)url, NULL};
+	int status;
+	pid_t pid;
+
+	pid = fork();
+	if (pid == -1)
+		return -1;
+	if (pid == 0) {
+		execvp("wget", argv);
+		_exit(-1);
+	}
+
+	if (pid != waitpid(pid, &status, 0))
+		return -1;
+	if (!WIFEXITED(status) || WEXITSTATUS(status))
+		return -1;
+	return 0;
+}
+
+static int download_try(const char *dir, const char *src, const char *part,
+		const struct download *dl, char *digest)
+{
+	int ret;
+
+	printk(KERN_INFO "Fetching %s from %s\n", dl->name, src);
+
+	if (!strncmp(src, "file://", 7))
+		ret = download_copy(src + 7, part);
+	else if (src[0] == '/')
+		ret = download_copy(src, part);
+	else
+		ret = download_wget(src, part);
+
+	if (ret) {
+		printk(KERN_WARNING "Fetching %s from %s failed\n", dl->name,
+				src);
+		unlink(part);
+		return -1;
+	}
+
+	ret = download_adopt(dir, part, dl, digest);
+	if (ret)
+		return -1;
+
+	printk(KERN_INFO "Stored %s in download cache, sha256 %s\n", dl->name,
+			digest);
+	return 0;
+}
+
+int download_fetch(const char *download_dir, const char **mirrors,
+		const struct download *dl)
+{
+	char store[PATH_MAX];
+	char part[PATH_MAX];
+	char src[PATH_MAX];
+	char digest[65];
+	int i;
+
+	snprintf(store, sizeof(store), "%s/%s", download_dir, download_store);
+	if (mkdir(store, 0755) && errno != EEXIST) {
+		printk(KERN_ERR "Failed to create download cache %s: %s\n",
+				store, strerror(errno));
+		return -1;
+	}
+
+	if (!download_lookup(download_dir, dl, digest)) {
+		printk(KERN_DEBUG "Using cached %s, sha256 %s\n", dl->name,
+				digest);
+		return 0;
+	}
+
+	snprintf(part, sizeof(part), "%s/.%s.part.%d.%u", download_dir,
+			dl->name, getpid(), __sync_fetch_and_add(&download_seq, 1));
+
+	for (i = 0; mirrors && mirrors[i]; ++i) {
+		snprintf(src, sizeof(src), "%s/%s", mirrors[i], dl->name);
+		if (!download_try(download_dir, src, part, dl, digest))
+			return 0;
+	}
+
+	if (dl->url && !download_try(download_dir, dl->url, part, dl, digest))
+		return 0;
+
+	printk(KERN_ERR "Failed to fetch %s\n", dl->name);
+	return -1;
+}
+
+static void *download_thread(void *data)
+{
+	struct download_job *job = data;
+
+	job->ret = download_fetch(job->download_dir, job->mirrors, job->dl);
+	return NULL;
+}
+
+int downloads_fetch_parallel(const char *download_dir, const char **mirrors,
+		const struct download **dls)
+{
+	struct download_job *jobs;
+	int nr_jobs;
+	int started;
+	int i;
+	int ret = 0;
+
+	for (nr_jobs = 0; dls[nr_jobs]; ++nr_jobs);
+	if (!nr_jobs)
+		return 0;
+
+	jobs = malloc(sizeof(*jobs) * nr_jobs);
+	if (!jobs)
+		return -1;
+	memset(jobs, 0, sizeof(*jobs) * nr_jobs);
+
+	for (started = 0; started != nr_jobs; ++started) {
+		jobs[started].download_dir = download_dir;
+		jobs[started].mirrors = mirrors;
+		jobs[started].dl = dls[started];
+		if (pthread_create(&jobs[started].thread, NULL,
+					download_thread, &jobs[started]))
+			break;
+	}
+
+	/* Fetch the rest serially if we ran out of threads */
+	for (i = started; i != nr_jobs; ++i)
+		download_thread(&jobs[i]);
+
+	for (i = 0; i != nr_jobs; ++i) {
+		if (i < started)
+			pthread_join(jobs[i].thread, NULL);
+		ret |= jobs[i].ret;
+	}
+
+	free(jobs);
+	return ret;
+}
@@ -0,0 +1,606 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cbench/core/journal.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <klib/list.h>
+#include <klib/printk.h>
+
+#include <cbench/plugin.h>
+#include <cbench/util.h>
+
+static const char *journal_name = "journal";
+
+/*
+ * Records, one per line:
+ *	cmd ARG...			tab separated, escaped arguments
+ *	group INDEX SHA
+ *	point INDEX SHA			next point of an adaptive sweep
+ *	run INDEX UUID RUNS RUNTIME STOP NR_PLUGINS {DONE NR_STATS {N MEAN M2}...}...
+ *	done INDEX
+ *	seed INDEX SEED
+ *	finished
+ */
+
+static char *journal_path(const char *db_path)
+{
+	char *path = malloc(strlen(db_path) + strlen(journal_name) + 2);
+
+	if (path)
+		sprintf(path, "%s/%s", db_path, journal_name);
+	return path;
+}
+
+static int journal_write(struct journal *j, const char *rec, size_t len)
+{
+	while (len) {
+		ssize_t written = write(j->fd, rec, len);
+
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			printk(KERN_ERR "Failed writing journal %s: %s\n",
+					j->path, strerror(errno));
+			return -1;
+		}
+		rec += written;
+		len -= written;
+	}
+
+	if (fsync(j->fd)) {
+		printk(KERN_ERR "Failed syncing journal %s: %s\n", j->path,
+				strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+static int journal_printf(struct journal *j, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+static int journal_printf(struct journal *j, const char *fmt, ...)
+{
+	char buf[256];
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+	if (len >= sizeof(buf))
+		return -1;
+	return journal_write(j, buf, len);
+}
+
+static char *journal_read(const char *path)
+{
+	char *buf = NULL;
+	size_t len = 0;
+	size_t size = 0;
+	ssize_t ret;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	do {
+		if (size - len < 4097) {
+			char *tmp = realloc(buf, size + 4096 * 4);
+
+			if (!tmp)
+				goto error;
+			buf = tmp;
+			size += 4096 * 4;
+		}
+		ret = read(fd, buf + len, size - len - 1);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			goto error;
+		}
+		len += ret;
+	} while (ret);
+
+	buf[len] = '\0';
+	close(fd);
+	return buf;
+error:
+	free(buf);
+	close(fd);
+	return NULL;
+}
+
+static void journal_unescape(char *str)
+{
+	char *out = str;
+
+	for (; *str; ++str) {
+		if (*str == '\\' && str[1]) {
+			++str;
+			*out++ = *str == 't' ? '\t' : *str == 'n' ? '\n' : *str;
+		} else {
+			*out++ = *str;
+		}
+	}
+	*out = '\0';
+}
+
+static struct journal_group *journal_find_group(struct journal *j, int index)
+{
+	int i;
+
+	for (i = 0; i != j->nr_groups; ++i) {
+		if (j->groups[i].index == index)
+			return &j->groups[i];
+	}
+	return NULL;
+}
+
+static void journal_group_clear(struct journal_group *grp)
+{
+	int i;
+
+	for (i = 0; i != grp->nr_plugins; ++i)
+		free(grp->plugins[i].stats);
+	free(grp->plugins);
+	grp->plugins = NULL;
+	grp->nr_plugins = 0;
+	grp->runs = 0;
+	grp->runtime = 0;
+	grp->done = 0;
+}
+
+static int journal_parse_run(struct journal *j, char *args)
+{
+	struct journal_group *grp;
+	char *save;
+	char *tok;
+	int index;
+	int stop;
+	int i, k;
+
+#define next_tok() ((tok = strtok_r(NULL, " ", &save)) ? tok : "")
+
+	tok = strtok_r(args, " ", &save);
+	if (!tok)
+		return -1;
+	index = atoi(tok);
+	grp = journal_find_group(j, index);
+	if (!grp)
+		return -1;
+	journal_group_clear(grp);
+
+	next_tok();	/* uuid */
+	grp->runs = atoi(next_tok());
+	grp->runtime = strtod(next_tok(), NULL);
+	stop = atoi(next_tok());
+	grp->nr_plugins = atoi(next_tok());
+	if (grp->nr_plugins < 0)
+		return -1;
+
+	grp->plugins = calloc(grp->nr_plugins, sizeof(*grp->plugins));
+	if (!grp->plugins && grp->nr_plugins)
+		return -1;
+
+	for (i = 0; i != grp->nr_plugins; ++i) {
+		struct journal_plugin *p = &grp->plugins[i];
+
+		p->done = atoi(next_tok());
+		p->nr_stats = atoi(next_tok());
+		if (p->nr_stats <= 0) {
+			p->nr_stats = 0;
+			continue;
+		}
+		p->stats = calloc(p->nr_stats, sizeof(*p->stats));
+		if (!p->stats)
+			return -1;
+		for (k = 0; k != p->nr_stats; ++k) {
+			p->stats[k].n = strtoul(next_tok(), NULL, 10);
+			p->stats[k].mean = strtod(next_tok(), NULL);
+			p->stats[k].m2 = strtod(next_tok(), NULL);
+		}
+	}
+#undef next_tok
+
+	/*
+	 * The group stopped after this run, only the done record is missing.
+	 * An adaptive sweep continues with its next point.
+	 */
+	if (stop && !grp->adaptive)
+		grp->done = 1;
+	return 0;
+}
+
+static int journal_load(struct journal *j)
+{
+	char *content = journal_read(j->path);
+	char *line, *next;
+
+	if (!content) {
+		printk(KERN_ERR "Failed reading journal %s\n", j->path);
+		return -1;
+	}
+
+	for (line = content; line && *line; line = next) {
+		char *args;
+
+		next = strchr(line, '\n');
+		if (!next) {
+			/* Incomplete last record of a crash */
+			break;
+		}
+		*next++ = '\0';
+
+		args = strchr(line, ' ');
+		if (args)
+			*args++ = '\0';
+		else
+			args = line + strlen(line);
+
+		if (!strcmp(line, "group")) {
+			struct journal_group *grp;
+			char sha[65];
+			int index;
+
+			if (sscanf(args, "%d %64s", &index, sha) != 2)
+				continue;
+			grp = journal_find_group(j, index);
+			if (grp && !strcmp(grp->sha, sha))
+				continue;
+			if (!grp) {
+				grp = realloc(j->groups, sizeof(*grp) * (j->nr_groups + 1));
+				if (!grp)
+					goto error;
+				j->groups = grp;
+				grp = &j->groups[j->nr_groups++];
+				memset(grp, 0, sizeof(*grp));
+				grp->index = index;
+			}
+			journal_group_clear(grp);
+			grp->adaptive = 0;
+			strcpy(grp->sha, sha);
+		} else if (!strcmp(line, "point")) {
+			struct journal_group *grp = journal_find_group(j,
+					atoi(args));
+
+			if (grp) {
+				journal_group_clear(grp);
+				grp->adaptive = 1;
+			}
+		} else if (!strcmp(line, "run")) {
+			if (journal_parse_run(j, args))
+				printk(KERN_WARNING "Ignoring broken journal record\n");
+		} else if (!strcmp(line, "seed")) {
+			struct journal_seed *seeds;
+			unsigned long seed;
+			int index;
+
+			if (sscanf(args, "%d %lu", &index, &seed) != 2)
+				continue;
+			seeds = realloc(j->seeds, sizeof(*seeds) * (j->nr_seeds + 1));
+			if (!seeds)
+				goto error;
+			j->seeds = seeds;
+			seeds[j->nr_seeds].index = index;
+			seeds[j->nr_seeds++].seed = seed;
+		} else if (!strcmp(line, "done")) {
+			struct journal_group *grp = journal_find_group(j, atoi(args));
+
+			if (grp)
+				grp->done = 1;
+		}
+	}
+
+	free(content);
+	return 0;
+error:
+	free(content);
+	return -1;
+}
+
+int journal_read_command(const char *db_path, int *argc, char ***argv)
+{
+	char *path = journal_path(db_path);
+	char *content;
+	char *end;
+	char *arg, *next;
+	char **args = NULL;
+	int nr_args = 1;
+
+	if (!path)
+		return -1;
+	content = journal_read(path);
+	if (!content) {
+		printk(KERN_ERR "No journal to continue in %s\n", db_path);
+		free(path);
+		return -1;
+	}
+	free(path);
+
+	if (strncmp(content, "cmd\t", 4) || !(end = strchr(content, '\n'))) {
+		printk(KERN_ERR "Journal in %s does not start with a command\n",
+				db_path);
+		goto error;
+	}
+	*end = '\0';
+	if (strstr(end + 1, "\nfinished\n") || !strncmp(end + 1, "finished\n", 9)) {
+		printk(KERN_ERR "The last command in %s already finished\n",
+				db_path);
+		goto error;
+	}
+
+	args = malloc(sizeof(*args) * 2);
+	if (!args)
+		goto error;
+	args[0] = "cbenchsuite";
+	for (arg = content + 4; arg; arg = next) {
+		char **tmp;
+
+		next = strchr(arg, '\t');
+		if (next)
+			*next++ = '\0';
+		journal_unescape(arg);
+
+		tmp = realloc(args, sizeof(*args) * (nr_args + 2));
+		if (!tmp)
+			goto error;
+		args = tmp;
+		args[nr_args++] = arg;
+	}
+	args[nr_args] = NULL;
+
+	/* content stays allocated, the arguments point into it */
+	*argc = nr_args;
+	*argv = args;
+	return 0;
+error:
+	free(args);
+	free(content);
+	return -1;
+}
+
+static int journal_write_command(struct journal *j, int argc, char **argv)
+{
+	size_t len = 4;
+	char *buf, *ptr;
+	int ret;
+	int i;
+
+	for (i = 1; i < argc; ++i)
+		len += 2 * strlen(argv[i]) + 1;
+
+	buf = malloc(len + 2);
+	if (!buf)
+		return -1;
+
+	ptr = buf + sprintf(buf, "cmd");
+	for (i = 1; i < argc; ++i) {
+		const char *c;
+
+		*ptr++ = '\t';
+		for (c = argv[i]; *c; ++c) {
+			if (*c == '\t' || *c == '\n' || *c == '\\') {
+				*ptr++ = '\\';
+				*ptr++ = *c == '\t' ? 't' : *c == '\n' ? 'n' : '\\';
+			} else {
+				*ptr++ = *c;
+			}
+		}
+	}
+	*ptr++ = '\n';
+
+	ret = journal_write(j, buf, ptr - buf);
+	free(buf);
+	return ret;
+}
+
+struct journal *journal_open(const char *db_path, int argc, char **argv,
+		int resume)
+{
+	struct journal *j = calloc(1, sizeof(*j));
+
+	if (!j)
+		return NULL;
+	j->fd = -1;
+	j->cur_index = -1;
+
+	j->path = journal_path(db_path);
+	if (!j->path)
+		goto error;
+
+	if (resume && journal_load(j))
+		goto error;
+
+	j->fd = open(j->path, O_WRONLY | O_CREAT | O_APPEND
+			| (resume ? 0 : O_TRUNC), 0644);
+	if (j->fd < 0) {
+		printk(KERN_ERR "Failed to open journal %s: %s\n", j->path,
+				strerror(errno));
+		goto error;
+	}
+
+	if (!resume && journal_write_command(j, argc, argv))
+		goto error;
+	return j;
+error:
+	journal_close(j, 0);
+	return NULL;
+}
+
+void journal_close(struct journal *j, int finished)
+{
+	int i;
+
+	if (!j)
+		return;
+	if (finished && j->fd >= 0)
+		journal_printf(j, "finished\n");
+	if (j->fd >= 0)
+		close(j->fd);
+	for (i = 0; i != j->nr_groups; ++i)
+		journal_group_clear(&j->groups[i]);
+	free(j->groups);
+	free(j->seeds);
+	free(j->path);
+	free(j);
+}
+
+int journal_group_index(struct journal *j)
+{
+	if (!j)
+		return -1;
+	return j->next_index++;
+}
+
+int journal_group_done(struct journal *j, int index)
+{
+	struct journal_group *grp;
+
+	if (!j)
+		return 0;
+	grp = journal_find_group(j, index);
+	return grp && grp->done;
+}
+
+int journal_group_start(struct journal *j, int index, const char *sha)
+{
+	struct journal_group *grp;
+
+	if (!j)
+		return 0;
+
+	j->cur_index = index;
+	j->resume = NULL;
+	grp = journal_find_group(j, index);
+	if (grp && grp->runs && !grp->adaptive) {
+		if (!strcmp(grp->sha, sha))
+			j->resume = grp;
+		else
+			printk(KERN_WARNING "Group %d changed since the journal was written, starting it from scratch\n",
+					index + 1);
+	}
+
+	return journal_printf(j, "group %d %s\n", index, sha);
+}
+
+int journal_point_start(struct journal *j, int index, const char *sha)
+{
+	if (!j)
+		return 0;
+
+	j->cur_index = index;
+	j->resume = NULL;
+	return journal_printf(j, "point %d %s\n", index, sha);
+}
+
+int journal_group_current(struct journal *j)
+{
+	if (!j)
+		return -1;
+	return j->cur_index;
+}
+
+struct journal_group *journal_group_resume(struct journal *j)
+{
+	if (!j)
+		return NULL;
+	return j->resume;
+}
+
+int journal_run(struct journal *j, int index, const char *uuid, int runs,
+		double runtime, int stop, struct list_head *plugins,
+		const int *done)
+{
+	struct plugin *plg;
+	char *buf = NULL;
+	size_t len = 0;
+	FILE *f;
+	int nr_plugins = 0;
+	int ret;
+	int i;
+
+	if (!j || index == -1)
+		return 0;
+
+	f = open_memstream(&buf, &len);
+	if (!f)
+		return -1;
+
+	list_for_each_entry(plg, plugins, plugin_grp)
+		++nr_plugins;
+
+	fprintf(f, "run %d %s %d %.17g %d %d", index, uuid, runs,
+			runtime, stop, nr_plugins);
+	nr_plugins = 0;
+	list_for_each_entry(plg, plugins, plugin_grp) {
+		fprintf(f, " %d %d", done ? done[nr_plugins] : 0,
+				plg->nr_result_stats);
+		++nr_plugins;
+		for (i = 0; i != plg->nr_result_stats; ++i) {
+			struct stats *st = &plg->result_stats[i];
+
+			fprintf(f, " %lu %.17g %.17g", st->n, st->mean, st->m2);
+		}
+	}
+	fprintf(f, "\n");
+	if (fclose(f)) {
+		free(buf);
+		return -1;
+	}
+
+	ret = journal_write(j, buf, len);
+	free(buf);
+	return ret;
+}
+
+int journal_group_finish(struct journal *j, int index)
+{
+	if (!j || index == -1)
+		return 0;
+	if (j->cur_index == index) {
+		j->cur_index = -1;
+		j->resume = NULL;
+	}
+	return journal_printf(j, "done %d\n", index);
+}
+
+int journal_block_seed(struct journal *j, int index, unsigned long *seed)
+{
+	int i;
+
+	if (!j)
+		return 0;
+
+	for (i = 0; i != j->nr_seeds; ++i) {
+		if (j->seeds[i].index == index) {
+			*seed = j->seeds[i].seed;
+			return 0;
+		}
+	}
+	return journal_printf(j, "seed %d %lu\n", index, *seed);
+}
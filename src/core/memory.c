@@ -0,0 +1,152 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cbench/core/memory.h>
+
+#include <errno.h>
+#include <malloc.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <klib/printk.h>
+
+/* Heap prefaulted by memory_lock for samples and storage buffers */
+#define MEMORY_HEAP_RESERVE (64 << 20)
+
+/*
+ * cbenchsuite replaces the allocator functions to count allocations. They
+ * call the glibc implementations, which are exported for this purpose.
+ * Counting is only ever enabled with --mlock, otherwise the wrappers only
+ * test one global flag and pass straight through.
+ */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static __thread int count_thread;
+static int counting;
+static unsigned long nr_allocs;
+
+static inline void memory_count(void)
+{
+	if (counting && count_thread)
+		__sync_add_and_fetch(&nr_allocs, 1);
+}
+
+void *malloc(size_t size)
+{
+	memory_count();
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	memory_count();
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	memory_count();
+	return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+	__libc_free(ptr);
+}
+
+int memory_lock(void)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+	char *reserve;
+	size_t i;
+
+	/*
+	 * No mmap'ed chunks and no trimming, so memory freed once is reused
+	 * instead of mapped again. The number of arenas is left alone, a
+	 * single arena would serialize allocations of threaded benchmarks.
+	 */
+	mallopt(M_MMAP_MAX, 0);
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_TOP_PAD, MEMORY_HEAP_RESERVE);
+
+	if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+		printk(KERN_ERR "Failed to lock memory, check RLIMIT_MEMLOCK: %s\n",
+				strerror(errno));
+		return -1;
+	}
+
+	/* Not malloc/free, the compiler may drop the unused allocation */
+	reserve = __libc_malloc(MEMORY_HEAP_RESERVE);
+	if (!reserve) {
+		printk(KERN_ERR "Failed to allocate the heap reserve\n");
+		return -1;
+	}
+	for (i = 0; i < MEMORY_HEAP_RESERVE; i += page_size)
+		((volatile char *)reserve)[i] = 0;
+	__libc_free(reserve);
+
+	printk(KERN_INFO "Locked memory, heap reserve of %d MiB\n",
+			MEMORY_HEAP_RESERVE >> 20);
+	return 0;
+}
+
+int memory_relock(void)
+{
+	/* Populates all private writable pages, which breaks their sharing */
+	if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+		printk(KERN_ERR "Failed to lock memory, check RLIMIT_MEMLOCK: %s\n",
+				strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+void memory_count_thread(void)
+{
+	count_thread = 1;
+}
+
+void memory_count_start(void)
+{
+	nr_allocs = 0;
+	__sync_synchronize();
+	counting = 1;
+}
+
+unsigned long memory_count_stop(void)
+{
+	counting = 0;
+	__sync_synchronize();
+	return nr_allocs;
+}
+
+long memory_thread_faults(void)
+{
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_THREAD, &usage))
+		return 0;
+	return usage.ru_minflt;
+}
@@ -33,6 +33,7 @@
 #include <klib/printk.h>
 
 #include <cbench/benchsuite.h>
+#include <cbench/core/suite_file.h>
 #include <cbench/module.h>
 #include <cbench/option.h>
 #include <cbench/plugin.h>
@@ -173,7 +174,8 @@ void module_free(struct module *mod)
 	free(mod);
 }
 
-int mod_mgr_init(struct mod_mgr *mm, const char *mod_dir)
+int mod_mgr_init(struct mod_mgr *mm, const char *mod_dir,
+		const char *suite_dir)
 {
 	DIR *md;
 	struct dirent *de;
@@ -182,6 +184,8 @@ int mod_mgr_init(struct mod_mgr *mm, const char *mod_dir)
 	int i;
 
 	INIT_LIST_HEAD(&mm->modules);
+	INIT_LIST_HEAD(&mm->suite_files);
+	mm->suite_dir = suite_dir;
 
 	md = opendir(mod_dir);
 
@@ -291,6 +295,8 @@ int mod_mgr_list_module(struct mod_mgr *mm, const char *fid, int verbose)
 		list_for_each_entry(mod, &mm->modules, modules) {
 			mod_mgr_print_module(mod, verbose);
 		}
+		if (mm->suite_dir)
+			suite_files_print(mm->suite_dir, verbose);
 	} else {
 		mod = mod_mgr_find_module(mm, fid);
 		if (!mod) {
@@ -377,8 +383,7 @@ void mod_mgr_module_put_plugin(struct mod_mgr *mm, struct module *mod,
 
 void mod_mgr_plugin_free(struct mod_mgr *mm, struct plugin *plg)
 {
-	if (plg->options)
-		free(plg->options);
+	option_free(plg->options);
 	if (plg->mod->id->plugin_free) {
 		int ret = plg->mod->id->plugin_free(plg);
 		if (ret) {
@@ -488,18 +493,60 @@ found_matching_benchsuite:
 
 void mod_mgr_module_put_benchsuite(struct mod_mgr *mm, struct benchsuite *suite)
 {
-	--suite->mod->benchsuites_in_use;
+	if (suite->mod)
+		--suite->mod->benchsuites_in_use;
 	free(suite);
 }
 
+static struct benchsuite *mod_mgr_file_get_benchsuite(struct mod_mgr *mm,
+		const char *path, const char **ver_restrictions)
+{
+	const struct benchsuite_id *id;
+	struct benchsuite *suite;
+
+	id = suite_file_load(&mm->suite_files, path);
+	if (!id)
+		return NULL;
+
+	if (!version_matching(&id->version, ver_restrictions)) {
+		printk(KERN_ERR "Did not find matching benchsuite\n");
+		return NULL;
+	}
+
+	suite = malloc(sizeof(*suite));
+	if (!suite) {
+		printk(KERN_ERR "Out of memory\n");
+		return NULL;
+	}
+	memset(suite, 0, sizeof(*suite));
+	suite->id = id;
+	return suite;
+}
+
 
 struct benchsuite *mod_mgr_benchsuite_create(struct mod_mgr *mm,
 		const char *fid, const char **ver_restrictions)
 {
 	const char *suite_start;
-	struct module *mod = mod_mgr_find_module(mm, fid);
+	struct module *mod;
 	struct benchsuite *suite;
+	size_t len = strlen(fid);
+
+	if (strchr(fid, '/') || (len > 6 && !strcmp(fid + len - 6, ".suite")))
+		return mod_mgr_file_get_benchsuite(mm, fid, ver_restrictions);
+
+	if (!strchr(fid, '.')) {
+		char path[PATH_MAX];
+
+		if (!mm->suite_dir) {
+			printk(KERN_ERR "No suite directory for suite %s\n", fid);
+			return NULL;
+		}
+		snprintf(path, sizeof(path), "%s/%s.suite", mm->suite_dir, fid);
+		return mod_mgr_file_get_benchsuite(mm, path, ver_restrictions);
+	}
 
+	mod = mod_mgr_find_module(mm, fid);
 	if (!mod) {
 		printk(KERN_ERR "Failed to get module %s\n", fid);
 		return NULL;
@@ -541,5 +588,6 @@ void mod_mgr_exit(struct mod_mgr *mm)
 		list_del(&mod->modules);
 		module_free(mod);
 	}
+	suite_files_free(&mm->suite_files);
 }
 
@@ -23,6 +23,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+
+#include <klib/printk.h>
 
 #include <cbench/data.h>
 #include <cbench/util.h>
@@ -78,22 +81,26 @@ int option_key_cmp(struct option_iterator *iter, const char *key)
 	return strncmp(iter->k_start, key, iter->k_end - iter->k_start);
 }
 
-long long option_parse_int_base(struct option_iterator *iter, int base)
+long long option_parse_int_base(struct option_iterator *iter, int base,
+		int *err)
 {
 	char buf[128];
+	char *end;
 	long long val;
 	int size = iter->v_end - iter->v_start;
 	if (size >= 126)
 		size = 126;
 	memcpy(buf, iter->v_start, size);
 	buf[size] = '\0';
-	val = strtoll(buf, NULL, base);
+	val = strtoll(buf, &end, base);
+	if (end == buf || *end != '\0')
+		*err = 1;
 	return val;
 }
 
-long long option_parse_int(struct option_iterator *iter)
+long long option_parse_int(struct option_iterator *iter, int *err)
 {
-	return option_parse_int_base(iter, 10);
+	return option_parse_int_base(iter, 10, err);
 }
 
 int option_parse_bool(struct option_iterator *iter)
@@ -130,6 +137,17 @@ int option_parse(const struct header *defaults, const char *optstr,
 	}
 	memcpy(opts, defaults, sizeof(*opts) * (nr_items + 1));
 
+	/* All strings are owned by opts, so option_free can free them */
+	for (i = 0; i != nr_items; ++i) {
+		if (opts[i].opt_val.type != VALUE_STRING || !opts[i].opt_val.v_str)
+			continue;
+		opts[i].opt_val.v_str = strdup(opts[i].opt_val.v_str);
+		if (!opts[i].opt_val.v_str) {
+			option_free(opts);
+			return -1;
+		}
+	}
+
 	if (!optstr) {
 		*out = opts;
 		return 0;
@@ -138,27 +156,43 @@ int option_parse(const struct header *defaults, const char *optstr,
 	options_for_each_entry(&itr, optstr) {
 		for (i = 0; i != nr_items; ++i) {
 			if (!option_key_cmp(&itr, opts[i].name)) {
+				int err = 0;
+
 				switch (opts[i].opt_val.type) {
 				case VALUE_STRING:
+					free(opts[i].opt_val.v_str);
 					opts[i].opt_val.v_str = malloc(option_value_strlen(&itr) + 1);
+					if (!opts[i].opt_val.v_str) {
+						option_free(opts);
+						return -1;
+					}
 					option_value_copy(&itr, opts[i].opt_val.v_str);
 					break;
 				case VALUE_INT32:
-					opts[i].opt_val.v_int32 = option_parse_int(&itr);
+					opts[i].opt_val.v_int32 = option_parse_int(&itr, &err);
 					break;
 				case VALUE_INT64:
-					opts[i].opt_val.v_int64 = option_parse_int(&itr);
+					opts[i].opt_val.v_int64 = option_parse_int(&itr, &err);
 					break;
 				default:
 					printf("ERROR: Option values may not be something else than string or int (%s)\n",
 							opts[i].name);
 					break;
 				}
+				if (err) {
+					printf("ERROR: Option %s needs an integer value, got '%.*s'\n",
+							opts[i].name,
+							option_value_strlen(&itr),
+							itr.v_start);
+					option_free(opts);
+					return -1;
+				}
 				goto found;
 			}
 		}
 		printf("ERROR: Could not find header starting at %s\n",
 				itr.k_start);
+		option_free(opts);
 		return -1;
 found:
 		continue;
@@ -167,6 +201,19 @@ found:
 	return 0;
 }
 
+void option_free(struct header *opts)
+{
+	int i;
+
+	if (!opts)
+		return;
+	for (i = 0; opts[i].name != NULL; ++i) {
+		if (opts[i].opt_val.type == VALUE_STRING)
+			free(opts[i].opt_val.v_str);
+	}
+	free(opts);
+}
+
 int option_to_hdr_csv(const struct header *opts, char **buf, size_t *buf_size,
 		enum value_quote_type quotes)
 {
@@ -262,3 +309,330 @@ int option_to_data_csv(const struct header *opts, char **buf, size_t *buf_size,
 	}
 	return 0;
 }
+
+/* Upper limit of option strings a single sweep may expand to */
+#define OPTION_SWEEP_MAX 4096
+
+struct option_sweep {
+	const char *key;
+	int key_len;
+	char **vals;
+	int nr_vals;
+};
+
+static long long option_sweep_ncpu(void)
+{
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return ncpu < 1 ? 1 : ncpu;
+}
+
+/* Parses a range bound of the form INT, 'ncpu' or INT '*ncpu' */
+static const char *option_sweep_bound(const char *str, long long *val)
+{
+	char *end;
+
+	if (!strncmp(str, "ncpu", 4)) {
+		*val = option_sweep_ncpu();
+		return str + 4;
+	}
+
+	*val = strtoll(str, &end, 10);
+	if (end == str)
+		return NULL;
+	if (!strncmp(end, "*ncpu", 5)) {
+		*val *= option_sweep_ncpu();
+		end += 5;
+	}
+	return end;
+}
+
+static int option_sweep_add(struct option_sweep *sw, const char *val, int len)
+{
+	char **tmp;
+
+	if (sw->nr_vals == OPTION_SWEEP_MAX) {
+		printk(KERN_ERR "Option %.*s expands to more than %d values\n",
+				sw->key_len, sw->key, OPTION_SWEEP_MAX);
+		return -1;
+	}
+
+	tmp = realloc(sw->vals, sizeof(*sw->vals) * (sw->nr_vals + 1));
+	if (!tmp)
+		return -1;
+	sw->vals = tmp;
+
+	sw->vals[sw->nr_vals] = malloc(len + 1);
+	if (!sw->vals[sw->nr_vals])
+		return -1;
+	memcpy(sw->vals[sw->nr_vals], val, len);
+	sw->vals[sw->nr_vals][len] = '\0';
+	++sw->nr_vals;
+	return 0;
+}
+
+/* List items relative to the number of cpus are evaluated, others copied */
+static int option_sweep_list_item(struct option_sweep *sw, const char *item,
+		int len)
+{
+	char buf[32];
+	const char *end;
+	long long val;
+
+	if (len >= sizeof(buf) || !memmem(item, len, "ncpu", 4))
+		return option_sweep_add(sw, item, len);
+
+	memcpy(buf, item, len);
+	buf[len] = '\0';
+	end = option_sweep_bound(buf, &val);
+	if (!end || *end != '\0')
+		return option_sweep_add(sw, item, len);
+
+	len = snprintf(buf, sizeof(buf), "%lld", val);
+	return option_sweep_add(sw, buf, len);
+}
+
+/*
+ * Only integer bounds on both sides of '..' make a range, other values
+ * containing it, e.g. relative paths like ../data, are plain values.
+ */
+static int option_sweep_is_range(const char *str)
+{
+	const char *ptr;
+	long long val;
+
+	ptr = option_sweep_bound(str, &val);
+	if (!ptr || strncmp(ptr, "..", 2))
+		return 0;
+	return option_sweep_bound(ptr + 2, &val) != NULL;
+}
+
+static int option_sweep_range(struct option_sweep *sw, const char *str)
+{
+	long long start, end, step = 1, v;
+	char op = '+';
+	char buf[32];
+	const char *ptr;
+	char *step_end;
+
+	ptr = option_sweep_bound(str, &start);
+	if (!ptr || strncmp(ptr, "..", 2))
+		goto error;
+	ptr = option_sweep_bound(ptr + 2, &end);
+	if (!ptr)
+		goto error;
+
+	if (*ptr == '*' || *ptr == '+') {
+		op = *ptr;
+		step = strtoll(ptr + 1, &step_end, 10);
+		if (step_end == ptr + 1)
+			goto error;
+		ptr = step_end;
+	}
+	if (*ptr != '\0')
+		goto error;
+
+	if (op == '+' && step < 1)
+		goto error;
+	if (op == '*' && (step < 2 || start < 1))
+		goto error;
+
+	for (v = start; v <= end; v = (op == '*' ? v * step : v + step)) {
+		int len = snprintf(buf, sizeof(buf), "%lld", v);
+
+		if (option_sweep_add(sw, buf, len))
+			return -1;
+	}
+	if (!sw->nr_vals)
+		goto error;
+	return 0;
+error:
+	printk(KERN_ERR "Invalid option range %.*s=%s\n", sw->key_len, sw->key,
+			str);
+	return -1;
+}
+
+static int option_sweep_parse(struct option_sweep *sw, struct option_iterator *itr)
+{
+	int len = option_value_strlen(itr);
+	const char *val = itr->v_start;
+	char *buf;
+	int ret;
+
+	sw->key = itr->k_start;
+	sw->key_len = itr->k_end - itr->k_start;
+
+	if (len >= 2 && val[0] == '{' && val[len - 1] == '}') {
+		const char *end = val + len - 1;
+		const char *ptr = val + 1;
+
+		while (1) {
+			const char *sep = memchr(ptr, ',', end - ptr);
+
+			if (!sep)
+				sep = end;
+			if (option_sweep_list_item(sw, ptr, sep - ptr))
+				return -1;
+			if (sep == end)
+				return 0;
+			ptr = sep + 1;
+		}
+	}
+
+	if (!memmem(val, len, "..", 2))
+		return option_sweep_add(sw, val, len);
+
+	buf = malloc(len + 1);
+	if (!buf)
+		return -1;
+	option_value_copy(itr, buf);
+	if (option_sweep_is_range(buf))
+		ret = option_sweep_range(sw, buf);
+	else
+		ret = option_sweep_add(sw, val, len);
+	free(buf);
+	return ret;
+}
+
+void option_sweep_free(char **opts, int nr_opts)
+{
+	int i;
+
+	if (!opts)
+		return;
+	for (i = 0; i != nr_opts; ++i)
+		free(opts[i]);
+	free(opts);
+}
+
+int option_sweep_expand(const char *optstr, char ***out)
+{
+	struct option_iterator itr;
+	struct option_sweep *sws = NULL;
+	int nr_sws = 0;
+	int nr_opts = 1;
+	int *idx = NULL;
+	char **opts = NULL;
+	int i, j;
+	int ret = -1;
+
+	if (!optstr || (!strstr(optstr, "..") && !strchr(optstr, '{'))) {
+		opts = malloc(sizeof(*opts));
+		if (!opts)
+			return -1;
+		opts[0] = optstr ? strdup(optstr) : NULL;
+		if (optstr && !opts[0]) {
+			free(opts);
+			return -1;
+		}
+		*out = opts;
+		return 1;
+	}
+
+	options_for_each_entry(&itr, optstr) {
+		struct option_sweep *tmp = realloc(sws, sizeof(*sws) * (nr_sws + 1));
+
+		if (!tmp)
+			goto out;
+		sws = tmp;
+		memset(&sws[nr_sws], 0, sizeof(*sws));
+		if (option_sweep_parse(&sws[nr_sws++], &itr))
+			goto out;
+		nr_opts *= sws[nr_sws - 1].nr_vals;
+		if (nr_opts > OPTION_SWEEP_MAX) {
+			printk(KERN_ERR "Options %s expand to more than %d combinations\n",
+					optstr, OPTION_SWEEP_MAX);
+			goto out;
+		}
+	}
+
+	idx = calloc(nr_sws, sizeof(*idx));
+	opts = calloc(nr_opts, sizeof(*opts));
+	if (!idx || !opts)
+		goto out;
+
+	/* Cross product, the last option varies fastest */
+	for (i = 0; i != nr_opts; ++i) {
+		size_t len = 1;
+		char *ptr;
+
+		for (j = 0; j != nr_sws; ++j)
+			len += sws[j].key_len + strlen(sws[j].vals[idx[j]]) + 2;
+		opts[i] = malloc(len);
+		if (!opts[i])
+			goto out;
+
+		ptr = opts[i];
+		for (j = 0; j != nr_sws; ++j) {
+			ptr += sprintf(ptr, "%s%.*s=%s", j ? ":" : "",
+					sws[j].key_len, sws[j].key,
+					sws[j].vals[idx[j]]);
+		}
+
+		for (j = nr_sws - 1; j >= 0; --j) {
+			if (++idx[j] != sws[j].nr_vals)
+				break;
+			idx[j] = 0;
+		}
+	}
+
+	*out = opts;
+	opts = NULL;
+	ret = nr_opts;
+out:
+	option_sweep_free(opts, nr_opts);
+	for (i = 0; i != nr_sws; ++i)
+		option_sweep_free(sws[i].vals, sws[i].nr_vals);
+	free(sws);
+	free(idx);
+	return ret;
+}
+
+int option_adaptive_find(const char *optstr, struct option_adaptive *ad)
+{
+	struct option_iterator itr;
+	const char *ptr;
+	int len;
+
+	if (!optstr || !strstr(optstr, "adaptive("))
+		return 0;
+
+	options_for_each_entry(&itr, optstr) {
+		len = option_value_strlen(&itr);
+		if (len < 10 || strncmp(itr.v_start, "adaptive(", 9)
+				|| itr.v_end[-1] != ')')
+			continue;
+
+		ptr = option_sweep_bound(itr.v_start + 9, &ad->start);
+		if (!ptr || strncmp(ptr, "..", 2))
+			goto error;
+		ptr = option_sweep_bound(ptr + 2, &ad->end);
+		if (!ptr || ptr != itr.v_end - 1 || ad->start < 1
+				|| ad->end <= ad->start)
+			goto error;
+
+		ad->key = itr.k_start;
+		ad->key_len = itr.k_end - itr.k_start;
+		ad->val_off = itr.v_start - optstr;
+		ad->val_len = len;
+		return 1;
+error:
+		printk(KERN_ERR "Invalid adaptive sweep %.*s\n",
+				(int)(itr.v_end - itr.k_start), itr.k_start);
+		return -1;
+	}
+	return 0;
+}
+
+char *option_adaptive_set(const char *optstr, const struct option_adaptive *ad,
+		long long val)
+{
+	size_t len = strlen(optstr) + 32;
+	char *buf = malloc(len);
+
+	if (!buf)
+		return NULL;
+	snprintf(buf, len, "%.*s%lld%s", ad->val_off, optstr, val,
+			optstr + ad->val_off + ad->val_len);
+	return buf;
+}
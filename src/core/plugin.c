@@ -26,18 +26,26 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
 #include <uuid/uuid.h>
 
 #include <klib/list.h>
 #include <klib/printk.h>
 
+#include <cbench/core/download.h>
+#include <cbench/core/journal.h>
+#include <cbench/core/memory.h>
 #include <cbench/util.h>
 #include <cbench/data.h>
+#include <cbench/download.h>
 #include <cbench/environment.h>
 #include <cbench/module.h>
 #include <cbench/option.h>
 #include <cbench/requirement.h>
 #include <cbench/sha256.h>
+#include <cbench/stats.h>
 #include <cbench/storage.h>
 #include <cbench/version.h>
 
@@ -64,26 +72,68 @@ enum plugin_exec_state {
 	EXEC_FORCE_CONTINUE,
 };
 
+#define NR_FUNCTION_SLOTS_SEQ 10
+
 struct plugin_exec_env {
 	int error_shutdown;
 	enum plugin_exec_state state;
 	int run;
-	struct run_settings *settings;
+	struct run_settings settings;
 	struct environment *env;
+	struct list_head *plugins;
 	struct plugin_exec *execs;
+	/* Heap of the monitor thread, one entry per plugin */
+	struct plugin_exec **monitors;
 	int nr_plugins;
+	int nr_threads;
+	int nr_to_install;
 	u64 max_runtime;
 	u64 min_runtime;
 	const char *status_prefix;
-	const char *status_running;
+	char status_running[1024];
+	char sha256[65];
+
+	int journal_index;
+	struct journal_group *resume;
 
+	int barrier_initialized;
 	pthread_barrier_t barrier;
-	struct timespec time_started;
+	/* Seconds spent in measured runs of this group */
+	double runtime;
+	/* Time the controller persisted after each slot of the current run */
+	double persist[NR_FUNCTION_SLOTS_SEQ];
+
+	int nr_primaries;
+	/* Primaries still executing their run function in the current run */
+	int nr_primaries_running;
 };
 
 struct plugin_exec {
 	pthread_t thread;
 	int local_error;
+	struct run_phase phases[NR_FUNCTION_SLOTS_SEQ];
+
+	int primary;
+	/* A primary plugin that reached its standard error, not executed anymore */
+	int done;
+	/* Standard error reached in this run, the controller decides on done */
+	int converged;
+	/*
+	 * Continued from the journal. Only the statistics of the earlier runs
+	 * are restored, not their result rows in check_err_data.
+	 */
+	int resumed;
+	/*
+	 * Standard error in percent for each result column, 0 for the
+	 * configured one, <0 if the column is ignored. NULL checks all columns.
+	 */
+	double *stderr_percent;
+	int nr_stderr_percent;
+
+	/* Schedule of the monitor function in ns of CLOCK_MONOTONIC */
+	long long mon_period;
+	long long mon_next;
+	struct monitor_overhead overhead;
 
 	struct plugin *plug;
 	struct plugin_exec_env *exec_env;
@@ -93,6 +143,11 @@ struct mon_data {
 	pthread_t thread;
 	int err;
 	int stop;
+	/* Wakes the monitor thread up for stop, cond uses CLOCK_MONOTONIC */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	/* Minor page faults of the monitor thread */
+	long faults;
 	struct plugin_exec_env *exec_env;
 };
 
@@ -100,23 +155,20 @@ static void update_status(struct plugin_exec_env *exec_env, const char *action)
 {
 	int max_hours = exec_env->max_runtime / 3600;
 	int max_minutes = exec_env->max_runtime / 60 % 60;
-	int max_runs = exec_env->settings->runs_max;
+	int max_runs = exec_env->settings.runs_max;
 	if (exec_env->state == EXEC_WARMUP) {
 		printk(KERN_STATUS "%s\nGroup Warmup %2d/%02d              Max remaining: Runs %3d   Time %2d:%02d\n%s\n%s",
 				exec_env->status_prefix,
-				exec_env->run + 1, exec_env->settings->warmup_runs,
+				exec_env->run + 1, exec_env->settings.warmup_runs,
 				max_runs, max_hours, max_minutes,
 				exec_env->status_running, action);
 	} else {
-		struct timespec now;
 		int runtime_hours;
 		int runtime_minutes;
 		int rem_hours;
 		int rem_minutes;
-		u64 runtime;
+		u64 runtime = exec_env->runtime;
 
-		clock_gettime(CLOCK_MONOTONIC, &now);
-		runtime = now.tv_sec - exec_env->time_started.tv_sec;
 		runtime_hours = runtime / 3600;
 		runtime_minutes = runtime / 60 % 60;
 		rem_hours = max_hours - runtime_hours;
@@ -248,6 +300,13 @@ void plugins_calc_sha256(struct list_head *plugins, char *sha256)
 	sha256_finish_str(&ctx, sha256);
 }
 
+static inline double timespec_elapsed(const struct timespec *start,
+		const struct timespec *end)
+{
+	return end->tv_sec - start->tv_sec
+		+ (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
 static inline void plugin_execenv_barrier(struct plugin_exec_env *env)
 {
 	int ret = pthread_barrier_wait(&env->barrier);
@@ -262,14 +321,20 @@ static inline void plugin_exec_barrier(struct plugin_exec *exec)
 	plugin_execenv_barrier(exec->exec_env);
 }
 
+/* Stop the background plugins after the last primary finished its run */
 static inline void plugin_exec_stop_bg(struct plugin_exec *exec)
 {
 	struct plugin_exec *all = exec->exec_env->execs;
 	int nr_plugins = exec->exec_env->nr_plugins;
 	int i;
 
+	if (!exec->primary)
+		return;
+	if (__sync_sub_and_fetch(&exec->exec_env->nr_primaries_running, 1))
+		return;
+
 	for (i = 0; i != nr_plugins; ++i) {
-		if (&all[i] == exec)
+		if (all[i].primary)
 			continue;
 		if (all[i].plug->id->stop)
 			all[i].plug->id->stop(all[i].plug);
@@ -278,11 +343,23 @@ static inline void plugin_exec_stop_bg(struct plugin_exec *exec)
 
 static const int EXEC_FUNC_NOTIFY_BG = 1;
 
+/*
+ * Functions are timed on the wall clock and on the CPU time of the thread,
+ * barrier_wait is the time until the slowest plugin finished the slot.
+ */
 static inline void plugin_exec_function(int (*func)(struct plugin *plug),
 		struct plugin_exec *exec, int nr_func, int notify_bg_procs)
 {
+	struct run_phase *phase = &exec->phases[nr_func];
+	struct timespec start, end;
+	struct timespec cpu_start, cpu_end;
 	int ret;
-	if (func == NULL)
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+	cpu_end = cpu_start;
+
+	if (func == NULL || exec->done)
 		goto barrier_only_no_notify;
 	if (exec->local_error)
 		goto barrier_only;
@@ -290,6 +367,7 @@ static inline void plugin_exec_function(int (*func)(struct plugin *plug),
 	exec->plug->called_fun = nr_func;
 
 	ret = func(exec->plug);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
 	if (ret) {
 		exec->exec_env->error_shutdown = 1;
 		exec->local_error = 1;
@@ -297,12 +375,18 @@ static inline void plugin_exec_function(int (*func)(struct plugin *plug),
 	}
 
 barrier_only:
-	if (notify_bg_procs && exec->plug->id->data_hdr)
+	if (notify_bg_procs)
 		plugin_exec_stop_bg(exec);
 barrier_only_no_notify:
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+	phase->duration = timespec_elapsed(&start, &end);
+	phase->cpu_time = timespec_elapsed(&cpu_start, &cpu_end);
 
 	plugin_exec_barrier(exec);
 
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+	phase->barrier_wait = timespec_elapsed(&end, &start);
+
 	ret = thread_set_priority(CONFIG_EXECUTION_PRIO);
 	if (ret)
 		printk(KERN_NOTICE "Execution thread failed to set priority %d."
@@ -313,94 +397,143 @@ barrier_only_no_notify:
 	plugin_exec_barrier(exec);
 }
 
-static int plugin_generic_stderr_check(struct plugin *plug, double std_err_percent)
+static void plugin_stats_add(struct plugin *plug, struct data *d)
 {
-	struct data *d;
-	int i = 0;
-	while (1) {
-		int nr_values = 0;
-		double sum = 0;
-		double variance = 0;
-		double mean;
-		double std_err;
-		double std_dev;
-		double std_err_thresh;
+	int nr = data_nr_items(d);
+	int i;
 
-		plugin_for_each_result(plug, d) {
-			switch (d->data[i].type) {
-			case VALUE_SENTINEL:
-				goto finished;
-			case VALUE_STRING:
-				goto not_parsable;
-			case VALUE_INT32:
-				sum += d->data[i].v_int32;
-				break;
-			case VALUE_INT64:
-				sum += d->data[i].v_int64;
-				break;
-			case VALUE_FLOAT:
-				sum += d->data[i].v_flt;
-				break;
-			case VALUE_DOUBLE:
-				sum += d->data[i].v_dbl;
-				break;
-			default:
-				break;
-			}
-			++nr_values;
-		}
+	if (!plug->result_stats) {
+		plug->result_stats = calloc(nr, sizeof(*plug->result_stats));
+		if (!plug->result_stats)
+			return;
+		plug->nr_result_stats = nr;
+	}
 
-		if (nr_values <= 0)
-			return 1;
+	for (i = 0; i != nr && i != plug->nr_result_stats; ++i) {
+		if (d->data[i].type == VALUE_STRING)
+			continue;
+		stats_add(&plug->result_stats[i], value_to_double(&d->data[i]));
+	}
+}
 
-		if (nr_values == 1)
-			return 0;
+static void plugin_stats_reset(struct plugin *plug)
+{
+	free(plug->result_stats);
+	plug->result_stats = NULL;
+	plug->nr_result_stats = 0;
+}
 
-		mean = sum / nr_values;
+static int plugin_generic_stderr_check(struct plugin_exec *exec)
+{
+	struct plugin *plug = exec->plug;
+	int i;
 
-		plugin_for_each_result(plug, d) {
-			double dev = 0;
-			switch (d->data[i].type) {
-			case VALUE_INT32:
-				dev = d->data[i].v_int32;
-				break;
-			case VALUE_INT64:
-				dev = d->data[i].v_int64;
-				break;
-			case VALUE_FLOAT:
-				dev = d->data[i].v_flt;
-				break;
-			case VALUE_DOUBLE:
-				dev = d->data[i].v_dbl;
-				break;
-			default:
-				break;
-			}
-			dev -= mean;
-			variance += dev * dev;
+	for (i = 0; i != plug->nr_result_stats; ++i) {
+		struct stats *st = &plug->result_stats[i];
+		double std_err_percent = exec->exec_env->settings.percent_stderr;
+		double variance;
+		double std_dev;
+		double std_err;
+		double std_err_thresh;
+
+		if (!st->n)
+			continue;
+		if (exec->stderr_percent && i < exec->nr_stderr_percent) {
+			if (exec->stderr_percent[i] < 0)
+				continue;
+			if (exec->stderr_percent[i] > 0)
+				std_err_percent = exec->stderr_percent[i];
 		}
 
-		//variance /= nr_values;
+		if (st->n == 1)
+			return 0;
+
+		variance = stats_variance(st);
 		std_dev = sqrt(variance);
-		std_err = std_dev / sqrt(nr_values);
-		std_err_thresh = mean / 100.0 * std_err_percent;
+		std_err = stats_std_err(st);
+		std_err_thresh = st->mean / 100.0 * std_err_percent;
 
-		printk(KERN_INFO "check_stderr: nr_values: %d mean: %f variance: %f std_dev: %f std_err: %f std_err_thresh: %f\n",
-				nr_values, mean, variance, std_dev, std_err,
+		printk(KERN_INFO "check_stderr: nr_values: %lu mean: %f variance: %f std_dev: %f std_err: %f std_err_thresh: %f\n",
+				st->n, st->mean, variance, std_dev, std_err,
 				std_err_thresh);
 
 		if (std_err > std_err_thresh)
 			return 0;
+	}
+	return 1;
+}
 
-not_parsable:
-		++i;
+/*
+ * The first result column marked for convergence, else the first one that
+ * has a comparison direction, or the first numeric column if none has one.
+ * -1 without results.
+ */
+static int plugin_result_column(struct plugin *plug, const struct header *hdr)
+{
+	int col = -1;
+	int i;
+
+	for (i = 0; hdr[i].name && i != plug->nr_result_stats; ++i) {
+		if (hdr[i].converge && plug->result_stats[i].n)
+			return i;
+	}
+	for (i = 0; hdr[i].name && i != plug->nr_result_stats; ++i) {
+		if (!plug->result_stats[i].n)
+			continue;
+		if (col == -1)
+			col = i;
+		if (hdr[i].data_type != DATA_UNDEFINED)
+			return i;
 	}
+	return col;
+}
 
-finished:
-	return 1;
+static void plugin_summarise_results(struct plugin *plug)
+{
+	const struct header *hdr = plugin_data_hdr(plug);
+	int col;
+
+	memset(&plug->result, 0, sizeof(plug->result));
+	if (!hdr)
+		return;
+
+	col = plugin_result_column(plug, hdr);
+	if (col == -1)
+		return;
+
+	plug->result.name = hdr[col].name;
+	plug->result.cmp = hdr[col].data_type;
+	plug->result.nr_values = plug->result_stats[col].n;
+	plug->result.mean = plug->result_stats[col].mean;
+	plug->result.std_err = stats_std_err(&plug->result_stats[col]);
+}
+
+/* Largest relative standard deviation of the summarised results, <0 if unknown */
+static double plugins_rel_std_dev(struct plugin_exec_env *exec_env)
+{
+	double rel_std_dev = -1;
+	int i;
+
+	for (i = 0; i != exec_env->nr_plugins; ++i) {
+		struct plugin *plug = exec_env->execs[i].plug;
+		const struct header *hdr = plugin_data_hdr(plug);
+		struct stats *st;
+		int col;
+
+		if (!hdr)
+			continue;
+		col = plugin_result_column(plug, hdr);
+		if (col == -1)
+			continue;
+		st = &plug->result_stats[col];
+		if (st->n < 2 || st->mean == 0)
+			continue;
+		if (sqrt(stats_variance(st)) / fabs(st->mean) > rel_std_dev)
+			rel_std_dev = sqrt(stats_variance(st)) / fabs(st->mean);
+	}
+	return rel_std_dev;
 }
 
-#define NR_FUNCTION_SLOTS_SEQ 10
 static const char *function_slot_names[] = {
 	"init_pre",
 	"init",
@@ -414,6 +547,83 @@ static const char *function_slot_names[] = {
 	"exit_post",
 };
 
+/*
+ * Set up the columns checked for the standard error, from the plugin link
+ * 'COL[/PCT],...' or else from the columns the header marks.
+ */
+static int plugin_exec_converge(struct plugin_exec *exec)
+{
+	struct plugin *plug = exec->plug;
+	const struct header *hdr = plugin_data_hdr(plug);
+	const char *spec = plug->converge;
+	int nr_cols;
+	int marked = 0;
+	int i;
+
+	if (!hdr)
+		return 0;
+	for (nr_cols = 0; hdr[nr_cols].name; ++nr_cols)
+		marked |= hdr[nr_cols].converge;
+	if (!spec && !marked)
+		return 0;
+
+	exec->stderr_percent = malloc(sizeof(*exec->stderr_percent) * nr_cols);
+	if (!exec->stderr_percent)
+		return -1;
+	exec->nr_stderr_percent = nr_cols;
+
+	for (i = 0; i != nr_cols; ++i) {
+		if (spec || !hdr[i].converge)
+			exec->stderr_percent[i] = -1;
+		else
+			exec->stderr_percent[i] = hdr[i].stderr_percent;
+	}
+
+	while (spec && *spec) {
+		const char *end = strchrnul(spec, ',');
+		const char *pct = memchr(spec, '/', end - spec);
+		int name_len = (pct ? pct : end) - spec;
+		double percent = 0;
+
+		for (i = 0; i != nr_cols; ++i) {
+			if (!strncmp(hdr[i].name, spec, name_len)
+					&& !hdr[i].name[name_len])
+				break;
+		}
+		if (i == nr_cols) {
+			printk(KERN_ERR "Plugin %s has no result column %.*s\n",
+					plug->id->name, name_len, spec);
+			return -1;
+		}
+		if (pct) {
+			char *pct_end;
+
+			percent = strtod(pct + 1, &pct_end);
+			if (pct_end != end || percent <= 0) {
+				printk(KERN_ERR "Invalid standard error %.*s for %s\n",
+						(int)(end - pct - 1), pct + 1,
+						hdr[i].name);
+				return -1;
+			}
+		}
+		exec->stderr_percent[i] = percent;
+		spec = *end ? end + 1 : end;
+	}
+	return 0;
+}
+
+static int plugin_is_primary(struct plugin *plug)
+{
+	const struct plugin_id *id = plug->id;
+	enum plugin_role role = plug->role;
+
+	if (role == PLUGIN_ROLE_AUTO)
+		role = id->role;
+	if (role == PLUGIN_ROLE_AUTO)
+		return id->data_hdr && !id->monitor && !id->stop;
+	return role == PLUGIN_ROLE_PRIMARY;
+}
+
 static const int exec_funcs_before_run = 4;
 static const int exec_funcs_after_run = 5;
 
@@ -422,6 +632,7 @@ static void *plugins_thread_execute(void *data)
 	struct plugin_exec *exec = (struct plugin_exec *)data;
 	struct plugin *plug = exec->plug;
 	const struct plugin_id *id = exec->plug->id;
+	char name[16];
 	int ret;
 
 	ret = thread_set_priority(CONFIG_EXECUTION_PRIO);
@@ -431,10 +642,15 @@ static void *plugins_thread_execute(void *data)
 				CONFIG_EXECUTION_PRIO);
 
 	exec->local_error = 0;
+	plug->tid = syscall(SYS_gettid);
+	snprintf(name, sizeof(name), PLUGIN_THREAD_NAME, (int)plug->tid);
+	prctl(PR_SET_NAME, name);
 
-	do {
+	while (1) {
 		printk(KERN_DEBUG "thread plugin %s\n", id->name);
 		plugin_exec_barrier(exec);
+		if (exec->exec_env->state == EXEC_STOP)
+			break;
 		plugin_exec_function(id->init_pre, exec, PLUGIN_CALLED_INIT_PRE, 0);
 		plugin_exec_function(id->init, exec, PLUGIN_CALLED_INIT, 0);
 		plugin_exec_function(id->init_post, exec, PLUGIN_CALLED_INIT_POST, 0);
@@ -450,28 +666,50 @@ static void *plugins_thread_execute(void *data)
 		plugin_exec_function(id->exit_post, exec, PLUGIN_CALLED_EXIT_POST, 0);
 
 		plugin_exec_barrier(exec);
-		if (exec->exec_env->state == EXEC_UNDECIDED) {
-			if (id->check_stderr) {
+		/* Other primaries may already have set EXEC_STDERR_NOT_REACHED */
+		if ((exec->exec_env->state == EXEC_UNDECIDED
+				|| exec->exec_env->state == EXEC_STDERR_NOT_REACHED)
+				&& exec->primary && !exec->done) {
+			/* A custom check would miss the rows of resumed runs */
+			if (id->check_stderr && !exec->resumed) {
 				ret = id->check_stderr(plug);
 			} else {
-				ret = plugin_generic_stderr_check(plug,
-						exec->exec_env->settings->percent_stderr);
+				ret = plugin_generic_stderr_check(exec);
 			}
 			if (!ret)
 				exec->exec_env->state = EXEC_STDERR_NOT_REACHED;
+			exec->converged = ret;
 		}
 		plugin_exec_barrier(exec);
 		plugin_exec_barrier(exec);
-	} while (exec->exec_env->state != EXEC_STOP && !received_sigstop);
+	}
+	plug->tid = 0;
 	return NULL;
 }
 
 void *plugins_thread_install(void *data)
 {
 	struct plugin_exec *exec = data;
+	struct environment *env = exec->exec_env->env;
 	const struct plugin_id *id = exec->plug->id;
+	struct download *dls = exec->plug->version->downloads;
+	int i;
 	int ret;
 
+	if (exec->plug->preinstalled)
+		return NULL;
+
+	for (i = 0; dls && dls[i].name; ++i) {
+		ret = download_fetch(env->download_dir, env->mirrors, &dls[i]);
+		if (ret) {
+			printk(KERN_ERR "Failed to fetch %s for plugin %s\n",
+					dls[i].name, id->name);
+			exec->exec_env->error_shutdown = 1;
+			exec->local_error = 1;
+			return NULL;
+		}
+	}
+
 	if (!id->install)
 		return NULL;
 
@@ -491,7 +729,7 @@ void *plugins_thread_uninstall(void *data)
 	const struct plugin_id *id = exec->plug->id;
 	int ret;
 
-	if (!id->uninstall || !exec->plug->work_dir)
+	if (!id->uninstall || !exec->plug->work_dir || exec->plug->preinstalled)
 		return NULL;
 
 	ret = id->uninstall(exec->plug);
@@ -559,6 +797,9 @@ static void plugin_exec_persist(struct plugin_exec *exec, int persist_types)
 		if (!persist)
 			continue;
 
+		/* Plugins may add data without the core knowing the run */
+		data->run = exec->exec_env->run;
+		data->instance = plug->instance;
 		list_del(&data->run_data);
 		list_add_tail(&data->run_data, &data_to_persist);
 	}
@@ -574,6 +815,7 @@ static void plugin_exec_persist(struct plugin_exec *exec, int persist_types)
 	list_for_each_entry_safe(data, ndata, &data_to_persist, run_data) {
 		list_del(&data->run_data);
 		if (DATA_TYPE_RESULT & persist_types & data->type) {
+			plugin_stats_add(plug, data);
 			list_add_tail(&data->run_data, &plug->check_err_data);
 		} else {
 			plugin_free_data(plug, data);
@@ -588,12 +830,14 @@ static void plugins_exec_controller(struct plugin_exec_env *exec_env,
 	int nr_plugins = exec_env->nr_plugins;
 	int i;
 	char buf[64];
+	struct timespec start, end;
 	for (i = 0; i != nr_funcs; ++i) {
 		int j;
 		sprintf(buf, "Executing  function slot %d/%d:  %s\n", i+1,
 				NR_FUNCTION_SLOTS_SEQ, function_slot_names[off + i]);
 		update_status(exec_env, buf);
 		plugin_execenv_barrier(exec_env);
+		clock_gettime(CLOCK_MONOTONIC_RAW, &start);
 		sprintf(buf, "Persisting function slot %d/%d:  %s\n", i+1,
 				NR_FUNCTION_SLOTS_SEQ, function_slot_names[off + i]);
 		update_status(exec_env, buf);
@@ -603,6 +847,8 @@ static void plugins_exec_controller(struct plugin_exec_env *exec_env,
 			else
 				plugin_exec_persist(&execs[j], DATA_TYPE_MONITOR | DATA_TYPE_RESULT);
 		}
+		clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+		exec_env->persist[off + i] = timespec_elapsed(&start, &end);
 		plugin_execenv_barrier(exec_env);
 	}
 }
@@ -630,20 +876,29 @@ static void plugins_exec_parallel(struct plugin_exec_env *exec_env,
 	}
 }
 
+/* Work directories are numbered over the whole process lifetime, so plugins
+ * installed ahead of their group never share one. */
+static int plugin_work_dir_seq = 0;
+
 static void plugins_install(struct plugin_exec_env *exec_env)
 {
 	int i;
 	int ret;
 	for (i = 0; i != exec_env->nr_plugins; ++i) {
 		struct plugin *plug = exec_env->execs[i].plug;
-		char *buf = malloc(strlen(exec_env->env->work_dir) + 128);
+		char *buf;
+
+		if (plug->preinstalled)
+			continue;
 
+		buf = malloc(strlen(exec_env->env->work_dir) + 128);
 		plug->work_dir = NULL;
 		plug->download_dir = exec_env->env->download_dir;
 		if (!buf) {
 			goto error;
 		}
-		sprintf(buf, "mkdir -p %s/%d", exec_env->env->work_dir, i);
+		sprintf(buf, "mkdir -p %s/%d", exec_env->env->work_dir,
+				plugin_work_dir_seq);
 		ret = system(buf);
 		if (ret) {
 			printk(KERN_ERR "Failed to create dir with command '%s'\n",
@@ -652,7 +907,8 @@ static void plugins_install(struct plugin_exec_env *exec_env)
 			goto error;
 		}
 
-		sprintf(buf, "%s/%d", exec_env->env->work_dir, i);
+		sprintf(buf, "%s/%d", exec_env->env->work_dir,
+				plugin_work_dir_seq++);
 		plug->work_dir = buf;
 	}
 	plugins_exec_parallel(exec_env, plugins_thread_install);
@@ -660,7 +916,7 @@ static void plugins_install(struct plugin_exec_env *exec_env)
 error:
 	while (i--) {
 		struct plugin *plug = exec_env->execs[i].plug;
-		if (plug->work_dir) {
+		if (plug->work_dir && !plug->preinstalled) {
 			free(plug->work_dir);
 			plug->work_dir = NULL;
 		}
@@ -683,11 +939,13 @@ static void plugins_uninstall(struct plugin_exec_env *exec_env)
 	for (i = 0; i != exec_env->nr_plugins; ++i) {
 		struct plugin *plug = exec_env->execs[i].plug;
 
-		if (plug->work_dir) {
-			free(plug->work_dir);
-		}
+		if (plug->preinstalled || !plug->work_dir)
+			continue;
+
+		sprintf(tmp_cmd, "rm -Rf %s", plug->work_dir);
+		free(plug->work_dir);
+		plug->work_dir = NULL;
 
-		sprintf(tmp_cmd, "rm -Rf %s/%d", exec_env->env->work_dir, i);
 		ret = system(tmp_cmd);
 		if (ret) {
 			printk(KERN_ERR "Failed to remove dir with command '%s'\n",
@@ -700,101 +958,298 @@ static void plugins_uninstall(struct plugin_exec_env *exec_env)
 	free(tmp_cmd);
 }
 
-static void timespec_sub(struct timespec *tgt, struct timespec *src)
+static int plugins_install_state(struct environment *env,
+		struct plugin **plugs, int nr_plugs, int install)
 {
-	tgt->tv_sec -= src->tv_sec;
-	if (tgt->tv_nsec < src->tv_nsec) {
-		--tgt->tv_sec;
-		tgt->tv_nsec = 1000000000 + tgt->tv_nsec - src->tv_nsec;
-	} else {
-		tgt->tv_nsec -= src->tv_nsec;
+	struct plugin_exec_env exec_env = {
+		.env = env,
+		.nr_plugins = nr_plugs,
+	};
+	int i;
+
+	if (!nr_plugs)
+		return 0;
+
+	exec_env.execs = malloc(sizeof(*exec_env.execs) * nr_plugs);
+	if (!exec_env.execs)
+		return -1;
+	memset(exec_env.execs, 0, sizeof(*exec_env.execs) * nr_plugs);
+
+	for (i = 0; i != nr_plugs; ++i) {
+		exec_env.execs[i].plug = plugs[i];
+		exec_env.execs[i].exec_env = &exec_env;
+		plugs[i]->preinstalled = 0;
+	}
+
+	if (install)
+		plugins_install(&exec_env);
+	else
+		plugins_uninstall(&exec_env);
+
+	for (i = 0; i != nr_plugs; ++i) {
+		if (install && plugs[i]->work_dir)
+			plugs[i]->preinstalled = 1;
 	}
+
+	free(exec_env.execs);
+	return exec_env.error_shutdown;
+}
+
+int plugins_preinstall(struct environment *env, struct plugin **plugs,
+		int nr_plugs)
+{
+	return plugins_install_state(env, plugs, nr_plugs, 1);
+}
+
+int plugins_postuninstall(struct environment *env, struct plugin **plugs,
+		int nr_plugs)
+{
+	return plugins_install_state(env, plugs, nr_plugs, 0);
+}
+
+/* Period of monitors that neither the plugin id nor the link sets */
+#define MONITOR_PERIOD_DEFAULT_MS 2000
+
+static inline long long monitor_clock_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
 }
 
+static inline void monitor_heap_swap(struct plugin_exec **heap, int a, int b)
+{
+	struct plugin_exec *tmp = heap[a];
+
+	heap[a] = heap[b];
+	heap[b] = tmp;
+}
+
+/* The monitors form a min-heap ordered by their next deadline */
+static void monitor_heap_up(struct plugin_exec **heap, int i)
+{
+	while (i) {
+		int parent = (i - 1) / 2;
+
+		if (heap[parent]->mon_next <= heap[i]->mon_next)
+			return;
+		monitor_heap_swap(heap, parent, i);
+		i = parent;
+	}
+}
+
+static void monitor_heap_down(struct plugin_exec **heap, int nr, int i)
+{
+	while (1) {
+		int min = i;
+		int child = 2 * i + 1;
+
+		if (child < nr && heap[child]->mon_next < heap[min]->mon_next)
+			min = child;
+		if (child + 1 < nr && heap[child + 1]->mon_next < heap[min]->mon_next)
+			min = child + 1;
+		if (min == i)
+			return;
+		monitor_heap_swap(heap, min, i);
+		i = min;
+	}
+}
+
+/*
+ * Calls the monitor function and schedules the next call one period after
+ * the deadline of this one, so the phase of a monitor does not drift.
+ * Deadlines that passed meanwhile are skipped and counted as missed.
+ */
+static void plugin_monitor_call(struct plugin_exec *exec)
+{
+	struct monitor_overhead *o = &exec->overhead;
+	struct timespec cpu_start, cpu_end;
+	long long start, end;
+	double duration;
+	double lag;
+
+	start = monitor_clock_ns();
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+	cpu_end = cpu_start;
+	if (!exec->done) {
+		exec->plug->id->monitor(exec->plug);
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+	}
+	end = monitor_clock_ns();
+
+	if (!exec->done) {
+		duration = (end - start) / 1e9;
+		lag = (start - exec->mon_next) / 1e9;
+		++o->calls;
+		o->duration += duration;
+		o->cpu_time += timespec_elapsed(&cpu_start, &cpu_end);
+		if (duration > o->max_duration)
+			o->max_duration = duration;
+		if (lag > o->max_lag)
+			o->max_lag = lag;
+	}
+
+	exec->mon_next += exec->mon_period;
+	if (exec->mon_next <= end) {
+		long long skip = (end - exec->mon_next) / exec->mon_period + 1;
+
+		o->missed += skip;
+		exec->mon_next += skip * exec->mon_period;
+	}
+}
+
+/*
+ * Every monitor is called with its own period and phase offset from the
+ * start of the run function. The thread sleeps until the earliest deadline
+ * of all monitors, a slow monitor only delays the monitors due meanwhile.
+ */
 void *plugin_thread_monitor(void *data)
 {
 	struct mon_data *mon = (struct mon_data*)data;
 	struct plugin_exec *execs = mon->exec_env->execs;
+	struct plugin_exec **heap = mon->exec_env->monitors;
 	int nr_plugins = mon->exec_env->nr_plugins;
+	int nr_monitors = 0;
+	long long start;
 	int i;
 	int ret;
-	struct timespec now;
-	struct timespec last;
-	struct timespec delta;
-	struct timespec to_sleep;
-	struct timespec two_second = {
-		.tv_sec = 2,
-		.tv_nsec = 0,
-	};
+
 	ret = thread_set_priority(CONFIG_MONITOR_PRIO);
 	if (ret)
 		printk(KERN_NOTICE "Monitor thread failed to set priority %d."
 				" Operating with unchanged priority.\n",
 				CONFIG_MONITOR_PRIO);
-	clock_gettime(CLOCK_MONOTONIC_RAW, &last);
-	last.tv_sec -= 1;
-	while (!mon->stop) {
-		ret = 0;
-		for (i = 0; i != nr_plugins; ++i) {
-			if (!execs[i].plug->id->monitor)
-				continue;
-			ret |= execs[i].plug->id->monitor(execs[i].plug);
-		}
-		clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+	memory_count_thread();
+	mon->faults = memory_thread_faults();
+
+	start = monitor_clock_ns();
+	for (i = 0; i != nr_plugins; ++i) {
+		struct plugin *plug = execs[i].plug;
+		unsigned int period = plug->monitor_period;
+
+		if (!plug->id->monitor)
+			continue;
+		if (!period)
+			period = plug->id->monitor_period;
+		if (!period)
+			period = MONITOR_PERIOD_DEFAULT_MS;
+
+		memset(&execs[i].overhead, 0, sizeof(execs[i].overhead));
+		execs[i].overhead.period = period / 1000.0;
+		execs[i].overhead.offset = plug->monitor_offset / 1000.0;
+		execs[i].mon_period = period * 1000000LL;
+		execs[i].mon_next = start + plug->monitor_offset * 1000000LL;
+		heap[nr_monitors] = &execs[i];
+		monitor_heap_up(heap, nr_monitors);
+		++nr_monitors;
+	}
+
+	pthread_mutex_lock(&mon->lock);
+	while (!mon->stop && nr_monitors) {
+		long long next = heap[0]->mon_next;
 
-		delta = now;
-		timespec_sub(&delta, &last);
-		to_sleep = two_second;
-		timespec_sub(&to_sleep, &delta);
+		if (monitor_clock_ns() < next) {
+			struct timespec deadline = {
+				.tv_sec = next / 1000000000,
+				.tv_nsec = next % 1000000000,
+			};
 
-		if (to_sleep.tv_sec < two_second.tv_sec) {
-			nanosleep(&to_sleep, NULL);
+			pthread_cond_timedwait(&mon->cond, &mon->lock, &deadline);
+			continue;
 		}
-		last = now;
+		pthread_mutex_unlock(&mon->lock);
+		plugin_monitor_call(heap[0]);
+		monitor_heap_down(heap, nr_monitors, 0);
+		pthread_mutex_lock(&mon->lock);
 	}
+	pthread_mutex_unlock(&mon->lock);
+
+	mon->faults = memory_thread_faults() - mon->faults;
 	return NULL;
 }
 
-int plugins_execute(struct environment *env, struct list_head *plugins,
-		const char *status_prefix)
+static void plugin_monitor_stop(struct mon_data *mon)
+{
+	pthread_mutex_lock(&mon->lock);
+	mon->stop = 1;
+	pthread_cond_signal(&mon->cond);
+	pthread_mutex_unlock(&mon->lock);
+}
+
+/*
+ * Continue a group interrupted after resume->runs completed runs. Restores
+ * the run counter, the elapsed runtime, the running result statistics and
+ * which primaries already stopped, so the stopping criteria pick up where
+ * they were. The result rows of the earlier runs are not restored, plugins
+ * with their own check_stderr use the generic check for the rest of the
+ * group instead.
+ */
+static void plugins_resume(struct plugin_exec_env *exec_env,
+		struct journal_group *resume)
+{
+	int i;
+
+	printk(KERN_INFO "\tContinuing after %d completed runs\n", resume->runs);
+	exec_env->run = resume->runs;
+	exec_env->runtime = resume->runtime;
+
+	for (i = 0; i != exec_env->nr_plugins; ++i) {
+		struct plugin *plug = exec_env->execs[i].plug;
+		struct journal_plugin *jp = &resume->plugins[i];
+
+		exec_env->execs[i].done = jp->done;
+		exec_env->execs[i].resumed = 1;
+		plugin_stats_reset(plug);
+		if (!jp->nr_stats)
+			continue;
+		plug->result_stats = malloc(sizeof(*plug->result_stats) * jp->nr_stats);
+		if (!plug->result_stats)
+			continue;
+		memcpy(plug->result_stats, jp->stats,
+				sizeof(*plug->result_stats) * jp->nr_stats);
+		plug->nr_result_stats = jp->nr_stats;
+	}
+}
+
+/* Signal handlers are replaced while any group is started */
+static int nr_groups_started = 0;
+static sighandler_t sigterm_handler;
+static sighandler_t sigint_handler;
+
+struct plugin_exec_env *plugins_exec_start(struct environment *env,
+		struct list_head *plugins, const char *status_prefix)
 {
 	int i;
 	int nr_plugins;
 	int ret;
 	struct plugin *plg;
 	struct plugin_exec *execs;
-	struct plugin_exec_env exec_env = {
-		.error_shutdown = 0,
-		.state = EXEC_WARMUP,
-		.run = 0,
-		.settings = &env->settings,
-		.env = env,
-		.execs = NULL,
-		.nr_plugins = 0,
-	};
-	struct mon_data monitor = {
-		.err = 0,
-		.stop = 0,
-		.exec_env = &exec_env,
-	};
-	struct run_settings *settings = exec_env.settings;
-	struct timespec time_now;
-	u64 time_diff;
+	struct plugin_exec_env *exec_env;
 	int max_ind_values = 1;
-	char sha256[65];
-	char status_running[1024];
-	sighandler_t sigterm_handler;
-	sighandler_t sigint_handler;
 	int status_line_length;
 
-	exec_env.status_prefix = status_prefix;
-	exec_env.status_running = status_running;
+	exec_env = calloc(1, sizeof(*exec_env));
+	if (!exec_env) {
+		printk(KERN_ERR "Out of memory\n");
+		return NULL;
+	}
+	exec_env->state = EXEC_WARMUP;
+	exec_env->settings = env->settings;
+	exec_env->env = env;
+	exec_env->plugins = plugins;
+	exec_env->status_prefix = status_prefix;
+
+	if (!nr_groups_started++) {
+		sigterm_handler = signal(SIGTERM, plugins_sighandler);
+		sigint_handler = signal(SIGINT, plugins_sighandler);
+	}
 
-	sigterm_handler = signal(SIGTERM, plugins_sighandler);
-	sigint_handler = signal(SIGINT, plugins_sighandler);
+	plugins_calc_sha256(plugins, exec_env->sha256);
+	storage_init_plg_grp(&env->storage, plugins, exec_env->sha256);
 
-	plugins_calc_sha256(plugins, sha256);
-	storage_init_plg_grp(&env->storage, plugins, sha256);
+	exec_env->journal_index = journal_group_current(env->journal);
+	exec_env->resume = journal_group_resume(env->journal);
 
 	ret = thread_set_priority(CONFIG_CONTROLLER_PRIO);
 	if (ret)
@@ -804,66 +1259,107 @@ int plugins_execute(struct environment *env, struct list_head *plugins,
 
 	i = 0;
 	list_for_each_entry(plg, plugins, plugin_grp) ++i;
-	nr_plugins = exec_env.nr_plugins = i;
+	nr_plugins = exec_env->nr_plugins = i;
 	printk(KERN_DEBUG "nr_plugins: %d\n", nr_plugins);
 
-	ret = pthread_barrier_init(&exec_env.barrier, NULL, nr_plugins + 1);
+	if (exec_env->resume && exec_env->resume->nr_plugins != nr_plugins)
+		exec_env->resume = NULL;
+
+	ret = pthread_barrier_init(&exec_env->barrier, NULL, nr_plugins + 1);
 	if (ret) {
 		printk(KERN_ERR "Failed barrier init for %d clients\n", nr_plugins);
-		exec_env.error_shutdown = 1;
-		goto failed_barrier_init;
+		exec_env->error_shutdown = 1;
+		exec_env->state = EXEC_STOP;
+		return exec_env;
 	}
+	exec_env->barrier_initialized = 1;
 
-	execs = exec_env.execs = malloc(sizeof(*execs) * exec_env.nr_plugins);
+	execs = exec_env->execs = malloc(sizeof(*execs) * exec_env->nr_plugins);
 	if (!execs) {
 		printk(KERN_ERR "Out of memory\n");
-		exec_env.error_shutdown = 1;
-		goto failed_exec_alloc;
+		exec_env->error_shutdown = 1;
+		exec_env->state = EXEC_STOP;
+		return exec_env;
 	}
 	memset(execs, 0, sizeof(*execs) * nr_plugins);
 
+	exec_env->monitors = malloc(sizeof(*exec_env->monitors) * nr_plugins);
+	if (!exec_env->monitors) {
+		printk(KERN_ERR "Out of memory\n");
+		exec_env->error_shutdown = 1;
+		exec_env->state = EXEC_STOP;
+		return exec_env;
+	}
 
 	/*
 	 * INSTALLATION
 	 */
 
 	i = 0;
-	strcpy(status_running, "    ");
+	strcpy(exec_env->status_running, "    ");
 	status_line_length = 0;
 	list_for_each_entry(plg, plugins, plugin_grp) {
 		int str_len = strlen(plg->mod->name) + strlen(plg->id->name) + 2;
 		if (str_len + status_line_length > 75) {
-			strcat(status_running, "\n    ");
+			strcat(exec_env->status_running, "\n    ");
 			status_line_length = 0;
 		}
 		status_line_length += str_len;
-		strcat(status_running, plg->mod->name);
-		strcat(status_running, ".");
-		strcat(status_running, plg->id->name);
-		strcat(status_running, " ");
+		strcat(exec_env->status_running, plg->mod->name);
+		strcat(exec_env->status_running, ".");
+		strcat(exec_env->status_running, plg->id->name);
+		strcat(exec_env->status_running, " ");
 		execs[i].plug = plg;
-		execs[i].exec_env = &exec_env;
-		plg->exec_data = &exec_env;
+		execs[i].exec_env = exec_env;
+		plg->exec_data = exec_env;
+		plg->group = plugins;
 		if (plg->version->nr_independent_values > max_ind_values)
 			max_ind_values = plg->version->nr_independent_values;
+		if (!plg->preinstalled)
+			++exec_env->nr_to_install;
 
 		++i;
 	}
-	printk(KERN_INFO "\t%s\n", status_running);
+	printk(KERN_INFO "\t%s\n", exec_env->status_running);
+
+	for (i = 0; i != nr_plugins; ++i) {
+		execs[i].primary = plugin_is_primary(execs[i].plug);
+		exec_env->nr_primaries += execs[i].primary;
+		if (plugin_exec_converge(&execs[i])) {
+			printk(KERN_ERR "Failed to set up the convergence check of %s\n",
+					execs[i].plug->id->name);
+			exec_env->error_shutdown = 1;
+		}
+	}
+	/* Without any benchmark the group runs as a whole, as before roles */
+	if (!exec_env->nr_primaries) {
+		for (i = 0; i != nr_plugins; ++i)
+			execs[i].primary = 1;
+		exec_env->nr_primaries = nr_plugins;
+	}
+	for (i = 0; i != nr_plugins; ++i)
+		execs[i].plug->primary = execs[i].primary;
+	if (exec_env->error_shutdown) {
+		exec_env->state = EXEC_STOP;
+		return exec_env;
+	}
 
-	exec_env.min_runtime = exec_env.env->settings.runtime_min * max_ind_values;
-	exec_env.max_runtime = exec_env.env->settings.runtime_max * max_ind_values;
+	exec_env->min_runtime = exec_env->settings.runtime_min * max_ind_values;
+	exec_env->max_runtime = exec_env->settings.runtime_max * max_ind_values;
 	printk(KERN_INFO "\tRuntime without warmup between %02u:%02u and %02u:%02u\n",
-			exec_env.min_runtime / 3600, exec_env.min_runtime / 60,
-			exec_env.max_runtime / 3600, exec_env.max_runtime / 60);
+			exec_env->min_runtime / 3600, exec_env->min_runtime / 60,
+			exec_env->max_runtime / 3600, exec_env->max_runtime / 60);
 
-	printk(KERN_INFO "\tInstalling plugins\n");
-	update_status(&exec_env, "Installing plugins");
-	plugins_install(&exec_env);
+	if (exec_env->nr_to_install) {
+		printk(KERN_INFO "\tInstalling plugins\n");
+		update_status(exec_env, "Installing plugins");
+		plugins_install(exec_env);
+	}
 
-	if (exec_env.error_shutdown) {
+	if (exec_env->error_shutdown) {
 		printk(KERN_ERR "Failed installing plugins\n");
-		goto uninstall;
+		exec_env->state = EXEC_STOP;
+		return exec_env;
 	}
 
 
@@ -874,143 +1370,401 @@ int plugins_execute(struct environment *env, struct list_head *plugins,
 		ret = pthread_create(&execs[i].thread, NULL,
 				plugins_thread_execute, &execs[i]);
 		if (ret) {
-			exec_env.error_shutdown = 1;
+			exec_env->error_shutdown = 1;
+			break;
 		}
+		++exec_env->nr_threads;
 	}
 
-	while (exec_env.state != EXEC_STOP && !received_sigstop) {
-		char uuid[37];
-		char buf[64];
-		uuid_t uuid_raw;
-		uuid_generate(uuid_raw);
-		uuid_unparse_lower(uuid_raw, uuid);
+	/* The threads wait for the first run, a broken group is stopped by finish */
+	if (exec_env->error_shutdown)
+		exec_env->state = EXEC_STOP;
+	return exec_env;
+}
 
-		update_status(&exec_env, "Starting new run\n");
+/* Number of instances of the link starting at exec i */
+static int plugins_exec_nr_instances(struct plugin_exec_env *exec_env, int i)
+{
+	int nr = exec_env->execs[i].plug->nr_instances;
 
-		if (exec_env.state == EXEC_WARMUP) {
-			if (exec_env.run >= settings->warmup_runs) {
-				exec_env.state = EXEC_RUN;
-				exec_env.run = 0;
-				clock_gettime(CLOCK_MONOTONIC_RAW,
-						&exec_env.time_started);
-			}
-		} else {
-			exec_env.state = EXEC_RUN;
-		}
+	if (nr < 1 || i + nr > exec_env->nr_plugins)
+		return 1;
+	return nr;
+}
 
-		if (exec_env.state == EXEC_RUN) {
-			printk(KERN_INFO "Execution:%3d uuid:'%s'\n",
-					exec_env.run + 1, uuid);
-			storage_init_run(&env->storage, uuid,
-					exec_env.run + settings->warmup_runs);
-		} else {
-			printk(KERN_INFO "Execution:%3d\n", exec_env.run + 1);
+/*
+ * Primaries that reached their standard error are not executed anymore while
+ * the others continue. Instances of one link only stop together, so they stay
+ * co-located until all of them converged.
+ */
+static void plugins_exec_stop_converged(struct plugin_exec_env *exec_env)
+{
+	struct plugin_exec *execs = exec_env->execs;
+	int i, j;
+	int nr;
+
+	for (i = 0; i < exec_env->nr_plugins; i += nr) {
+		int converged = 1;
+
+		nr = plugins_exec_nr_instances(exec_env, i);
+		for (j = i; j != i + nr; ++j) {
+			converged &= execs[j].converged;
+			execs[j].converged = 0;
 		}
-		printk(KERN_DEBUG "Loop run %d state %d\n", exec_env.run,
-				exec_env.state);
-		plugin_execenv_barrier(&exec_env);
+		if (!converged || execs[i].done || exec_env->nr_primaries <= 1)
+			continue;
+		printk(KERN_INFO "\t\tNecessary standard error of %s reached, stopping it\n",
+				execs[i].plug->id->name);
+		for (j = i; j != i + nr; ++j)
+			execs[j].done = 1;
+	}
+}
 
+/* The n-th result row plug added in run, NULL if there is none */
+static struct data *plugin_run_result(struct plugin *plug, unsigned int run,
+		int n)
+{
+	struct data *data;
 
+	list_for_each_entry(data, &plug->check_err_data, run_data) {
+		if (data->run == run && data->type == DATA_TYPE_RESULT && !n--)
+			return data;
+	}
+	return NULL;
+}
 
-		plugins_exec_controller(&exec_env, exec_funcs_before_run, 0);
+/*
+ * Store the aggregate of the instances of each link with instance -1. The
+ * n-th result rows of all instances in this run are combined, columns where
+ * more is better are summed up, like the throughput of all instances
+ * together, other numeric columns are averaged. Strings are taken from the
+ * first instance.
+ */
+static void plugins_exec_aggregate(struct plugin_exec_env *exec_env)
+{
+	struct plugin_exec *execs = exec_env->execs;
+	struct list_head aggs;
+	struct data *agg, *nagg;
+	int i, j, n, c;
+	int nr;
+
+	INIT_LIST_HEAD(&aggs);
+	for (i = 0; i < exec_env->nr_plugins; i += nr) {
+		const struct header *hdr;
+		int nr_hdr;
+
+		nr = plugins_exec_nr_instances(exec_env, i);
+		hdr = plugin_data_hdr(execs[i].plug);
+		if (nr == 1 || !hdr)
+			continue;
+		nr_hdr = header_count_items(hdr);
 
+		for (n = 0; ; ++n) {
+			struct data *first = plugin_run_result(execs[i].plug,
+					exec_env->run, n);
+			int nr_values;
 
+			if (!first)
+				break;
+			nr_values = data_nr_items(first);
+			agg = data_alloc(DATA_TYPE_RESULT, nr_values);
+			if (!agg)
+				break;
+			agg->run = exec_env->run;
+			agg->instance = -1;
+			list_add_tail(&agg->run_data, &aggs);
+
+			for (c = 0; c != nr_values; ++c) {
+				double sum = 0;
+
+				if (first->data[c].type == VALUE_STRING) {
+					data_set_str(agg, c, first->data[c].v_str);
+					continue;
+				}
+				for (j = i; j != i + nr; ++j) {
+					struct data *d = plugin_run_result(
+						execs[j].plug, exec_env->run, n);
+
+					if (!d || data_nr_items(d) != nr_values)
+						break;
+					sum += value_to_double(&d->data[c]);
+				}
+				/* Not all instances produced this row */
+				if (j != i + nr)
+					break;
+				if (c < nr_hdr && hdr[c].data_type == DATA_MORE_IS_BETTER)
+					data_set_double(agg, c, sum);
+				else
+					data_set_double(agg, c, sum / nr);
+			}
+			if (c != nr_values) {
+				list_del(&agg->run_data);
+				data_put(agg);
+				break;
+			}
+		}
 
-		/*
-		 * RUN
-		 */
-		plugin_execenv_barrier(&exec_env);
-		ret = pthread_create(&monitor.thread, NULL, plugin_thread_monitor,
-				&monitor);
-		if (ret) {
-			printk(KERN_ERR "Failed starting monitor thread\n");
-			exec_env.error_shutdown = 1;
+		if (!list_empty(&aggs) && storage_add_data(&exec_env->env->storage,
+					execs[i].plug, &aggs)) {
+			printk(KERN_ERR "Failed persisting the aggregate of %s\n",
+					execs[i].plug->id->name);
+			exec_env->error_shutdown = 1;
+		}
+		list_for_each_entry_safe(agg, nagg, &aggs, run_data) {
+			list_del(&agg->run_data);
+			data_put(agg);
 		}
+	}
+}
+
+int plugins_exec_run(struct plugin_exec_env *exec_env,
+		const struct run_order *order)
+{
+	struct environment *env = exec_env->env;
+	struct plugin_exec *execs = exec_env->execs;
+	int nr_plugins = exec_env->nr_plugins;
+	struct run_settings *settings = &exec_env->settings;
+	struct mon_data monitor = {
+		.err = 0,
+		.stop = 0,
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.exec_env = exec_env,
+	};
+	pthread_condattr_t cond_attr;
+	unsigned long nr_allocs = 0;
+	long faults = 0;
+	struct timespec run_started;
+	struct timespec persist_started;
+	struct timespec time_now;
+	double run_duration;
+	char uuid[37];
+	char buf[64];
+	uuid_t uuid_raw;
+	int measured;
+	int i;
+	int ret;
 
-		sprintf(buf, "Executing  function slot %d/%d:  %s\n", 5,
-				NR_FUNCTION_SLOTS_SEQ, function_slot_names[4]);
-		update_status(&exec_env, buf);
+	if (exec_env->state == EXEC_STOP)
+		return 0;
 
-		plugin_execenv_barrier(&exec_env);
-		// Waiting for execution to finish
-		plugin_execenv_barrier(&exec_env);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &run_started);
+	uuid_generate(uuid_raw);
+	uuid_unparse_lower(uuid_raw, uuid);
 
-		sprintf(buf, "Persisting function slot %d/%d:  %s\n", 5,
-				NR_FUNCTION_SLOTS_SEQ, function_slot_names[4]);
-		update_status(&exec_env, buf);
+	update_status(exec_env, "Starting new run\n");
 
-		monitor.stop = 1;
-		ret = pthread_join(monitor.thread, NULL);
-		monitor.stop = 0;
-		if (ret) {
-			printk(KERN_ERR "Failed monitor thread join\n");
-			exec_env.error_shutdown = 1;
-		}
-		for (i = 0; i != nr_plugins; ++i) {
-			if (exec_env.state == EXEC_WARMUP)
-				plugin_exec_drop_data(&execs[i]);
-			else
-				plugin_exec_persist(&execs[i], DATA_TYPE_MONITOR | DATA_TYPE_RESULT);
+	if (exec_env->state == EXEC_WARMUP) {
+		if (exec_env->run >= settings->warmup_runs) {
+			exec_env->state = EXEC_RUN;
+			exec_env->run = 0;
+			exec_env->runtime = 0;
+			if (exec_env->resume)
+				plugins_resume(exec_env, exec_env->resume);
 		}
-		plugin_execenv_barrier(&exec_env);
-		/*
-		 * END RUN
-		 */
+	} else {
+		exec_env->state = EXEC_RUN;
+	}
 
+	measured = exec_env->state == EXEC_RUN;
+	if (measured) {
+		printk(KERN_INFO "Execution:%3d uuid:'%s'\n",
+				exec_env->run + 1, uuid);
+		storage_init_run(&env->storage, exec_env->sha256, uuid,
+				exec_env->run + settings->warmup_runs);
+	} else {
+		printk(KERN_INFO "Execution:%3d\n", exec_env->run + 1);
+	}
+	printk(KERN_DEBUG "Loop run %d state %d\n", exec_env->run,
+			exec_env->state);
+	plugin_execenv_barrier(exec_env);
 
 
-		plugins_exec_controller(&exec_env, exec_funcs_after_run, exec_funcs_before_run + 1);
+
+	plugins_exec_controller(exec_env, exec_funcs_before_run, 0);
+
+
+
+	/*
+	 * RUN
+	 */
+	/* Only primaries that call run stop the background plugins */
+	exec_env->nr_primaries_running = 0;
+	for (i = 0; i != nr_plugins; ++i)
+		if (execs[i].primary && !execs[i].done
+				&& execs[i].plug->id->run)
+			++exec_env->nr_primaries_running;
+	plugin_execenv_barrier(exec_env);
+	pthread_condattr_init(&cond_attr);
+	pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&monitor.cond, &cond_attr);
+	pthread_condattr_destroy(&cond_attr);
+	ret = pthread_create(&monitor.thread, NULL, plugin_thread_monitor,
+			&monitor);
+	if (ret) {
+		printk(KERN_ERR "Failed starting monitor thread\n");
+		exec_env->error_shutdown = 1;
+	}
+	if (env->mlock) {
+		faults = memory_thread_faults();
+		memory_count_start();
+	}
+
+	sprintf(buf, "Executing  function slot %d/%d:  %s\n", 5,
+			NR_FUNCTION_SLOTS_SEQ, function_slot_names[4]);
+	update_status(exec_env, buf);
+
+	plugin_execenv_barrier(exec_env);
+	// Waiting for execution to finish
+	plugin_execenv_barrier(exec_env);
+	if (env->mlock) {
+		nr_allocs = memory_count_stop();
+		faults = memory_thread_faults() - faults;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &persist_started);
+	sprintf(buf, "Persisting function slot %d/%d:  %s\n", 5,
+			NR_FUNCTION_SLOTS_SEQ, function_slot_names[4]);
+	update_status(exec_env, buf);
+
+	plugin_monitor_stop(&monitor);
+	ret = pthread_join(monitor.thread, NULL);
+	monitor.stop = 0;
+	if (ret) {
+		printk(KERN_ERR "Failed monitor thread join\n");
+		exec_env->error_shutdown = 1;
+	}
+	pthread_cond_destroy(&monitor.cond);
+	if (env->mlock && measured && (nr_allocs || faults || monitor.faults))
+		printk(KERN_WARNING "During the run function cbenchsuite allocated %lu times, page faults: controller %ld, monitor %ld\n",
+				nr_allocs, faults, monitor.faults);
+	for (i = 0; i != nr_plugins; ++i) {
+		if (exec_env->state == EXEC_WARMUP)
+			plugin_exec_drop_data(&execs[i]);
+		else
+			plugin_exec_persist(&execs[i], DATA_TYPE_MONITOR | DATA_TYPE_RESULT);
+	}
+	clock_gettime(CLOCK_MONOTONIC_RAW, &time_now);
+	exec_env->persist[exec_funcs_before_run] =
+		timespec_elapsed(&persist_started, &time_now);
+	plugin_execenv_barrier(exec_env);
+	/*
+	 * END RUN
+	 */
 
 
-		if (exec_env.state == EXEC_RUN) {
-			storage_exit_run(&env->storage);
-		}
 
-		++exec_env.run;
-		if (exec_env.error_shutdown) {
-			printk(KERN_ERR "Some plugin failed to run, aborting"
-					" plugin group execution\n");
-			exec_env.state = EXEC_STOP;
-		} else if (exec_env.state != EXEC_WARMUP) {
-			exec_env.state = EXEC_UNDECIDED;
-			clock_gettime(CLOCK_MONOTONIC_RAW, &time_now);
-			time_diff = time_now.tv_sec - exec_env.time_started.tv_sec;
-			if (time_diff < exec_env.min_runtime) {
-				printk(KERN_INFO "\t\tMinimum runtime not reached, continuing\n");
-				exec_env.state = EXEC_FORCE_CONTINUE;
-			} else if (time_diff > exec_env.max_runtime) {
-				printk(KERN_INFO "\t\tMaximum runtime reached, stopping\n");
-				exec_env.state = EXEC_STOP;
-			} else if (settings->runs_min > exec_env.run) {
-				printk(KERN_INFO "\t\tMinimum number of runs (%d) not reached, continuing\n",
-						settings->runs_min);
-				exec_env.state = EXEC_FORCE_CONTINUE;
-			} else if (settings->runs_max <= exec_env.run) {
-				printk(KERN_INFO "\t\tMaximum number of runs not reached, stopping\n");
-				exec_env.state = EXEC_STOP;
+	plugins_exec_controller(exec_env, exec_funcs_after_run, exec_funcs_before_run + 1);
+
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &time_now);
+	run_duration = timespec_elapsed(&run_started, &time_now);
+
+	if (exec_env->state == EXEC_RUN) {
+		struct run_summary summary;
+
+		plugins_exec_aggregate(exec_env);
+		for (i = 0; i != nr_plugins; ++i) {
+			int k;
+
+			for (k = 0; k != NR_FUNCTION_SLOTS_SEQ; ++k) {
+				execs[i].phases[k].name = function_slot_names[k];
+				execs[i].phases[k].persist = exec_env->persist[k];
 			}
+			storage_add_run_phases(&env->storage, execs[i].plug,
+					execs[i].phases, NR_FUNCTION_SLOTS_SEQ);
+			if (execs[i].plug->id->monitor)
+				storage_add_monitor_overhead(&env->storage,
+						execs[i].plug, &execs[i].overhead);
 		}
-		plugin_execenv_barrier(&exec_env);
-		plugin_execenv_barrier(&exec_env);
-		if (exec_env.state == EXEC_UNDECIDED) { // No plugin needs to continue running
-			exec_env.state = EXEC_STOP;
-			printk(KERN_INFO "\t\tNecessary standard error reached, stopping\n");
-		} else if (exec_env.state == EXEC_STDERR_NOT_REACHED) {
-			printk(KERN_INFO "\t\tNecessary standard error not reached, continuing\n");
+
+		summary.duration = run_duration;
+		summary.rel_std_dev = plugins_rel_std_dev(exec_env);
+		summary.order = order;
+		storage_exit_run(&env->storage, &summary);
+
+		/* Only the group's own runs count, other groups may run in between */
+		exec_env->runtime += run_duration;
+	}
+
+	++exec_env->run;
+	if (exec_env->error_shutdown) {
+		printk(KERN_ERR "Some plugin failed to run, aborting"
+				" plugin group execution\n");
+		exec_env->state = EXEC_STOP;
+	} else if (exec_env->state != EXEC_WARMUP) {
+		exec_env->state = EXEC_UNDECIDED;
+		if (exec_env->runtime < exec_env->min_runtime) {
+			printk(KERN_INFO "\t\tMinimum runtime not reached, continuing\n");
+			exec_env->state = EXEC_FORCE_CONTINUE;
+		} else if (exec_env->runtime > exec_env->max_runtime) {
+			printk(KERN_INFO "\t\tMaximum runtime reached, stopping\n");
+			exec_env->state = EXEC_STOP;
+		} else if (settings->runs_min > exec_env->run) {
+			printk(KERN_INFO "\t\tMinimum number of runs (%d) not reached, continuing\n",
+					settings->runs_min);
+			exec_env->state = EXEC_FORCE_CONTINUE;
+		} else if (settings->runs_max <= exec_env->run) {
+			printk(KERN_INFO "\t\tMaximum number of runs not reached, stopping\n");
+			exec_env->state = EXEC_STOP;
 		}
-		plugin_execenv_barrier(&exec_env);
 	}
+	plugin_execenv_barrier(exec_env);
+	plugin_execenv_barrier(exec_env);
+	if (exec_env->state == EXEC_UNDECIDED) { // No plugin needs to continue running
+		exec_env->state = EXEC_STOP;
+		printk(KERN_INFO "\t\tNecessary standard error reached, stopping\n");
+	} else if (exec_env->state == EXEC_STDERR_NOT_REACHED) {
+		printk(KERN_INFO "\t\tNecessary standard error not reached, continuing\n");
+		plugins_exec_stop_converged(exec_env);
+	}
+	if (measured && !exec_env->error_shutdown) {
+		int done[nr_plugins];
+
+		for (i = 0; i != nr_plugins; ++i)
+			done[i] = execs[i].done;
+		journal_run(env->journal, exec_env->journal_index, uuid,
+				exec_env->run, exec_env->runtime,
+				exec_env->state == EXEC_STOP, exec_env->plugins,
+				done);
+	}
+	if (received_sigstop)
+		exec_env->state = EXEC_STOP;
+	plugin_execenv_barrier(exec_env);
 
-	for (i = 0; i != nr_plugins; ++i) {
-		ret = pthread_join(execs[i].thread, NULL);
-		if (ret) {
-			printk(KERN_ERR "Failed to join runner thread %d\n", i);
-			exec_env.error_shutdown = 1;
+	return exec_env->state != EXEC_STOP;
+}
+
+int plugins_exec_finish(struct plugin_exec_env *exec_env)
+{
+	struct environment *env = exec_env->env;
+	struct plugin_exec *execs = exec_env->execs;
+	int nr_plugins = exec_env->nr_plugins;
+	int error_shutdown;
+	int i;
+	int ret;
+
+	if (exec_env->nr_threads == nr_plugins) {
+		/* The threads wait for the next run, let them leave instead */
+		exec_env->state = EXEC_STOP;
+		plugin_execenv_barrier(exec_env);
+		for (i = 0; i != nr_plugins; ++i) {
+			ret = pthread_join(execs[i].thread, NULL);
+			if (ret) {
+				printk(KERN_ERR "Failed to join runner thread %d\n", i);
+				exec_env->error_shutdown = 1;
+			}
 		}
+	} else {
+		/* Incomplete groups never pass the first barrier */
+		for (i = 0; i != exec_env->nr_threads; ++i)
+			pthread_detach(execs[i].thread);
 	}
 
-	for (i = 0; i != nr_plugins; ++i) {
+	for (i = 0; execs && i != nr_plugins && execs[i].plug; ++i) {
+		plugin_summarise_results(execs[i].plug);
+		plugin_stats_reset(execs[i].plug);
 		plugin_exec_drop_data(&execs[i]);
+		free(execs[i].stderr_percent);
 	}
 
 
@@ -1018,24 +1772,50 @@ int plugins_execute(struct environment *env, struct list_head *plugins,
 	 * UNINSTALL
 	 */
 
-uninstall:
-	printk(KERN_INFO "\tUninstalling plugins\n");
-	update_status(&exec_env, "Uninstalling plugins");
-	plugins_uninstall(&exec_env);
+	if (exec_env->nr_to_install) {
+		printk(KERN_INFO "\tUninstalling plugins\n");
+		update_status(exec_env, "Uninstalling plugins");
+		plugins_uninstall(exec_env);
+	}
 
-	update_status(&exec_env, "DONE");
+	update_status(exec_env, "DONE");
 
 	storage_exit_plg_grp(&env->storage);
 
 	free(execs);
-failed_exec_alloc:
-failed_barrier_init:
-	pthread_barrier_destroy(&exec_env.barrier);
-	signal(SIGTERM, sigterm_handler);
-	signal(SIGINT, sigint_handler);
+	free(exec_env->monitors);
+	if (exec_env->barrier_initialized)
+		pthread_barrier_destroy(&exec_env->barrier);
+	if (!--nr_groups_started) {
+		signal(SIGTERM, sigterm_handler);
+		signal(SIGINT, sigint_handler);
+	}
+
+	error_shutdown = exec_env->error_shutdown;
+	free(exec_env);
 	if (received_sigstop)
 		return -1;
-	return exec_env.error_shutdown;
+	return error_shutdown;
+}
+
+int plugins_execute(struct environment *env, struct list_head *plugins,
+		const char *status_prefix)
+{
+	struct plugin_exec_env *exec_env;
+
+	exec_env = plugins_exec_start(env, plugins, status_prefix);
+	if (!exec_env)
+		return -1;
+
+	while (plugins_exec_run(exec_env, NULL))
+		;
+
+	return plugins_exec_finish(exec_env);
+}
+
+int plugins_stopped(void)
+{
+	return received_sigstop;
 }
 
 int plugin_version_check_requirements(const struct plugin_id *plug,
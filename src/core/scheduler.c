@@ -0,0 +1,280 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cbench/core/scheduler.h>
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <klib/list.h>
+#include <klib/printk.h>
+
+#include <cbench/plugin.h>
+#include <cbench/storage.h>
+#include <cbench/version.h>
+
+long sched_parse_duration(const char *str)
+{
+	long total = 0;
+
+	if (!*str)
+		return -1;
+
+	while (*str) {
+		char *end;
+		long val = strtol(str, &end, 10);
+
+		if (end == str || val < 0)
+			return -1;
+		switch (*end) {
+		case 'd':
+			val *= 24;
+			/* fall through */
+		case 'h':
+			val *= 60;
+			/* fall through */
+		case 'm':
+			val *= 60;
+			/* fall through */
+		case 's':
+			++end;
+			/* fall through */
+		case '\0':
+			break;
+		default:
+			return -1;
+		}
+		total += val;
+		str = end;
+	}
+	return total;
+}
+
+double sched_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void sched_print_time(char *buf, double seconds)
+{
+	long sec = seconds > 0 ? (long)seconds : 0;
+
+	sprintf(buf, "%ld:%02ld:%02ld", sec / 3600, sec / 60 % 60, sec % 60);
+}
+
+int sched_init(struct scheduler *sched, int nr_groups, double deadline)
+{
+	sched->groups = calloc(nr_groups + 1, sizeof(*sched->groups));
+	if (!sched->groups)
+		return -1;
+	sched->nr_groups = nr_groups;
+	sched->deadline = deadline;
+	return 0;
+}
+
+void sched_exit(struct scheduler *sched)
+{
+	free(sched->groups);
+	sched->groups = NULL;
+}
+
+int sched_add_group(struct scheduler *sched, int index,
+		struct environment *env, struct list_head *plugins)
+{
+	struct sched_group *grp = &sched->groups[index];
+	struct group_history hist;
+	struct plugin *plg;
+	char sha256[65];
+	int ret;
+
+	if (!plugins || list_empty(plugins))
+		return 0;
+
+	grp->active = 1;
+	grp->nr_ind_values = 1;
+	list_for_each_entry(plg, plugins, plugin_grp) {
+		if (plg->version->nr_independent_values > grp->nr_ind_values)
+			grp->nr_ind_values = plg->version->nr_independent_values;
+	}
+
+	plugins_calc_sha256(plugins, sha256);
+	ret = storage_group_history(&env->storage, sha256, &hist);
+	if (ret)
+		return ret;
+
+	if (hist.nr_runs) {
+		grp->run_cost = hist.duration_mean;
+		if (grp->run_cost < 1e-3)
+			grp->run_cost = 1e-3;
+		grp->rel_std_dev = hist.rel_std_dev;
+	}
+	return 0;
+}
+
+/*
+ * Runs necessary for a standard error of percent_stderr percent of the mean,
+ * n = (rel_std_dev * 100 / percent)^2, within the configured run bounds.
+ * This is the inverse of plugin_generic_stderr_check(), which stops at
+ * std_dev / sqrt(n) <= mean * percent / 100 with the sample std_dev.
+ */
+static int sched_runs_needed(const struct sched_group *grp,
+		const struct run_settings *defaults)
+{
+	double runs;
+
+	if (grp->rel_std_dev < 0 || defaults->percent_stderr <= 0)
+		return defaults->runs_min > 0 ? defaults->runs_min : 1;
+
+	runs = ceil(pow(grp->rel_std_dev * 100 / defaults->percent_stderr, 2));
+	if (runs < defaults->runs_min)
+		runs = defaults->runs_min;
+	if (runs > defaults->runs_max)
+		runs = defaults->runs_max;
+	if (runs < 1)
+		runs = 1;
+	return runs;
+}
+
+static void sched_group_settings(struct sched_group *grp,
+		const struct run_settings *defaults)
+{
+	struct run_settings *s = &grp->settings;
+	double measured = grp->planned;
+	int runtime;
+
+	*s = *defaults;
+
+	if (grp->run_cost) {
+		measured -= grp->run_cost * defaults->warmup_runs;
+		if (measured < grp->run_cost) {
+			measured = grp->run_cost;
+			s->warmup_runs = 0;
+		}
+		s->runs_max = measured / grp->run_cost;
+		if (s->runs_max > defaults->runs_max)
+			s->runs_max = defaults->runs_max;
+		if (s->runs_max < 1)
+			s->runs_max = 1;
+		if (s->runs_min > s->runs_max)
+			s->runs_min = s->runs_max;
+	}
+
+	runtime = measured / grp->nr_ind_values;
+	if (runtime < 1)
+		runtime = 1;
+	if (runtime < s->runtime_max)
+		s->runtime_max = runtime;
+	if (s->runtime_min > s->runtime_max)
+		s->runtime_min = s->runtime_max;
+}
+
+void sched_plan(struct scheduler *sched, const struct run_settings *defaults,
+		int first)
+{
+	double left = sched->deadline - sched_now();
+	double known = 0;
+	double unknown_share;
+	double scale;
+	double expected = 0;
+	int nr_known = 0;
+	int nr_unknown = 0;
+	char buf_left[32];
+	char buf_expected[32];
+	char eta[32];
+	time_t end;
+	int i;
+
+	if (left < 0)
+		left = 0;
+
+	for (i = first; i < sched->nr_groups; ++i) {
+		struct sched_group *grp = &sched->groups[i];
+
+		if (!grp->active)
+			continue;
+		if (grp->run_cost) {
+			grp->runs_needed = sched_runs_needed(grp, defaults);
+			grp->planned = grp->run_cost *
+				(grp->runs_needed + defaults->warmup_runs);
+			known += grp->planned;
+			++nr_known;
+		} else {
+			++nr_unknown;
+		}
+	}
+	if (!nr_known && !nr_unknown)
+		return;
+
+	/*
+	 * Groups without history are assumed to cost as much as the average
+	 * known group, or share whatever the known groups leave.
+	 */
+	if (nr_known && known / nr_known > (left - known) / (nr_unknown ? nr_unknown : 1))
+		unknown_share = known / nr_known;
+	else
+		unknown_share = (left - known) / (nr_unknown ? nr_unknown : 1);
+	if (unknown_share < 0)
+		unknown_share = 0;
+
+	scale = known + unknown_share * nr_unknown;
+	scale = scale > 0 ? left / scale : 0;
+
+	for (i = first; i < sched->nr_groups; ++i) {
+		struct sched_group *grp = &sched->groups[i];
+		double need;
+
+		if (!grp->active)
+			continue;
+		need = grp->run_cost ? grp->planned : unknown_share;
+		grp->planned = need * scale;
+		sched_group_settings(grp, defaults);
+		expected += grp->planned < need ? grp->planned : need;
+	}
+
+	if (scale < 1)
+		printk(KERN_WARNING "The time budget is too small to reach the standard error target of all groups, run limits are reduced\n");
+
+	sched_print_time(buf_left, left);
+	sched_print_time(buf_expected, expected);
+	end = time(NULL) + (time_t)expected;
+	strftime(eta, sizeof(eta), "%Y-%m-%d %H:%M", localtime(&end));
+	printk(KERN_INFO "Time budget left %s for %d groups (%d without history), estimated %s, ETA %s\n",
+			buf_left, nr_known + nr_unknown, nr_unknown,
+			buf_expected, eta);
+}
+
+void sched_apply(struct scheduler *sched, int index,
+		struct run_settings *settings)
+{
+	struct sched_group *grp = &sched->groups[index];
+
+	if (!grp->active)
+		return;
+	*settings = grp->settings;
+	printk(KERN_INFO "\tScheduled %d to %d runs within %d seconds per independent value\n",
+			settings->runs_min, settings->runs_max,
+			settings->runtime_max);
+}
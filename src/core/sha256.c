@@ -19,7 +19,120 @@
 
 #include <cbench/sha256.h>
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+
+#define SHA256_HAVE_SHANI
+
+static const uint32_t sha256_k[64] = {
+	0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5,
+	0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+	0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3,
+	0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+	0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC,
+	0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+	0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7,
+	0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+	0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13,
+	0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+	0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3,
+	0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+	0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5,
+	0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+	0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208,
+	0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+/*
+ * Process nr_blocks 64 byte blocks with the SHA-NI instructions. Each loop
+ * iteration calculates 4 rounds, the message schedule is kept in msg[] as a
+ * ring of 4 registers.
+ */
+__attribute__((target("sha,sse4.1,ssse3")))
+static void sha256_process_shani(uint32_t state[8], const uint8_t *data,
+		size_t nr_blocks)
+{
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+			0x0405060700010203ULL);
+	__m128i state0, state1, save0, save1;
+	__m128i msg[4];
+	__m128i m, tmp;
+	int i;
+
+	tmp = _mm_loadu_si128((const __m128i *)&state[0]);
+	state1 = _mm_loadu_si128((const __m128i *)&state[4]);
+	tmp = _mm_shuffle_epi32(tmp, 0xB1);		/* CDAB */
+	state1 = _mm_shuffle_epi32(state1, 0x1B);	/* EFGH */
+	state0 = _mm_alignr_epi8(tmp, state1, 8);	/* ABEF */
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);	/* CDGH */
+
+	for (; nr_blocks; --nr_blocks, data += 64) {
+		save0 = state0;
+		save1 = state1;
+
+		for (i = 0; i != 4; ++i) {
+			msg[i] = _mm_loadu_si128((const __m128i *)(data + 16 * i));
+			msg[i] = _mm_shuffle_epi8(msg[i], mask);
+		}
+
+		for (i = 0; i != 16; ++i) {
+			__m128i *cur = &msg[i % 4];
+			__m128i *next = &msg[(i + 1) % 4];
+			__m128i *prev = &msg[(i + 3) % 4];
+
+			m = _mm_add_epi32(*cur,
+				_mm_loadu_si128((const __m128i *)&sha256_k[4 * i]));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, m);
+			if (i >= 3 && i <= 14) {
+				tmp = _mm_alignr_epi8(*cur, *prev, 4);
+				*next = _mm_add_epi32(*next, tmp);
+				*next = _mm_sha256msg2_epu32(*next, *cur);
+			}
+			m = _mm_shuffle_epi32(m, 0x0E);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, m);
+			if (i >= 1 && i <= 12)
+				*prev = _mm_sha256msg1_epu32(*prev, *cur);
+		}
+
+		state0 = _mm_add_epi32(state0, save0);
+		state1 = _mm_add_epi32(state1, save1);
+	}
+
+	tmp = _mm_shuffle_epi32(state0, 0x1B);		/* FEBA */
+	state1 = _mm_shuffle_epi32(state1, 0xB1);	/* DCHG */
+	state0 = _mm_blend_epi16(tmp, state1, 0xF0);	/* DCBA */
+	state1 = _mm_alignr_epi8(state1, tmp, 8);	/* ABEF */
+
+	_mm_storeu_si128((__m128i *)&state[0], state0);
+	_mm_storeu_si128((__m128i *)&state[4], state1);
+}
+
+static int sha256_cpu_has_shani(void)
+{
+	static int has_shani = -1;
+	unsigned int eax, ebx, ecx, edx;
+
+	if (has_shani != -1)
+		return has_shani;
+
+	has_shani = 0;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return has_shani;
+	if (!(ecx & bit_SSSE3) || !(ecx & bit_SSE4_1))
+		return has_shani;
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return has_shani;
+	has_shani = !!(ebx & bit_SHA);
+	return has_shani;
+}
+#endif
 
 void sha256_finish_str(sha256_context *ctx, char *buf)
 {
@@ -31,3 +144,91 @@ void sha256_finish_str(sha256_context *ctx, char *buf)
 		sprintf(&buf[i * 2], "%02x", digest[i]);
 	}
 }
+
+void sha256_update_fast(sha256_context *ctx, const uint8_t *input, size_t length)
+{
+#ifdef SHA256_HAVE_SHANI
+	size_t left = ctx->total[0] & 0x3F;
+	size_t blocks;
+	uint64_t total;
+	uint32_t state[8];
+	int i;
+
+	if (!sha256_cpu_has_shani())
+		goto generic;
+
+	/* Fill up a partial block with the generic implementation */
+	if (left) {
+		size_t fill = 64 - left;
+
+		if (fill > length)
+			fill = length;
+		sha256_update(ctx, (uint8_t *)input, fill);
+		input += fill;
+		length -= fill;
+	}
+
+	blocks = length / 64;
+	if (blocks) {
+		size_t bytes = blocks * 64;
+
+		for (i = 0; i != 8; ++i)
+			state[i] = ctx->state[i];
+		sha256_process_shani(state, input, blocks);
+		for (i = 0; i != 8; ++i)
+			ctx->state[i] = state[i];
+
+		total = (uint64_t)(ctx->total[0] & 0xFFFFFFFF) + bytes;
+		ctx->total[0] = total & 0xFFFFFFFF;
+		ctx->total[1] += total >> 32;
+
+		input += bytes;
+		length -= bytes;
+	}
+
+generic:
+#endif
+	while (length) {
+		uint32 chunk = length > 0x40000000 ? 0x40000000 : length;
+
+		sha256_update(ctx, (uint8_t *)input, chunk);
+		input += chunk;
+		length -= chunk;
+	}
+}
+
+int sha256_file_str(const char *path, char *buf)
+{
+	sha256_context ctx;
+	size_t buf_len = 1 << 20;
+	uint8_t *data;
+	ssize_t len;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	data = malloc(buf_len);
+	if (!data) {
+		close(fd);
+		return -1;
+	}
+
+	sha256_starts(&ctx);
+	while ((len = read(fd, data, buf_len))) {
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			free(data);
+			close(fd);
+			return -1;
+		}
+		sha256_update_fast(&ctx, data, len);
+	}
+	sha256_finish_str(&ctx, buf);
+
+	free(data);
+	close(fd);
+	return 0;
+}
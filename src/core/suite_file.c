@@ -0,0 +1,412 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cbench/core/suite_file.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <ctype.h>
+#include <linux/limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <klib/list.h>
+#include <klib/printk.h>
+
+#include <cbench/benchsuite.h>
+#include <cbench/environment.h>
+
+static const char *suite_file_ext = ".suite";
+
+struct suite_file {
+	char *path;
+
+	/* File content, all strings of the suite point into it */
+	char *buf;
+	char *default_name;
+
+	struct benchsuite_id id;
+	struct run_settings settings;
+	int nr_grps;
+
+	struct list_head suite_files;
+};
+
+/* A plugin line, group -1 are common plugins added to every group */
+struct suite_file_link {
+	int group;
+	char *str;
+};
+
+static char *suite_file_strip(char *str)
+{
+	char *end;
+
+	while (isspace(*str))
+		++str;
+	end = str + strlen(str);
+	while (end != str && isspace(end[-1]))
+		--end;
+	*end = '\0';
+	return str;
+}
+
+static int suite_file_int(const char *val, int *out)
+{
+	char *end;
+	long v = strtol(val, &end, 10);
+
+	if (end == val || *end != '\0')
+		return -1;
+	*out = v;
+	return 0;
+}
+
+static int suite_file_setting(struct suite_file *sf, const char *key,
+		const char *val)
+{
+	struct run_settings *s = &sf->settings;
+	char *end;
+
+	if (!strcmp(key, "name"))
+		sf->id.name = val;
+	else if (!strcmp(key, "version"))
+		sf->id.version.version = (char *)val;
+	else if (!strcmp(key, "description"))
+		sf->id.description = val;
+	else if (!strcmp(key, "warmup_runs"))
+		return suite_file_int(val, &s->warmup_runs);
+	else if (!strcmp(key, "min_runs"))
+		return suite_file_int(val, &s->runs_min);
+	else if (!strcmp(key, "max_runs"))
+		return suite_file_int(val, &s->runs_max);
+	else if (!strcmp(key, "min_runtime"))
+		return suite_file_int(val, &s->runtime_min);
+	else if (!strcmp(key, "max_runtime"))
+		return suite_file_int(val, &s->runtime_max);
+	else if (!strcmp(key, "stderr")) {
+		s->percent_stderr = strtod(val, &end);
+		if (end == val || *end != '\0')
+			return -1;
+	} else
+		return -1;
+	return 0;
+}
+
+static void suite_file_free(struct suite_file *sf)
+{
+	int i, j;
+
+	for (i = 0; sf->id.plugin_grps && i != sf->nr_grps; ++i) {
+		struct plugin_link *grp = sf->id.plugin_grps[i];
+
+		for (j = 0; grp && grp[j].name != NULL; ++j) {
+			put_plugin_link(&grp[j]);
+			free((char *)grp[j].name);
+		}
+		free(grp);
+	}
+	free(sf->id.plugin_grps);
+	free(sf->buf);
+	free(sf->default_name);
+	free(sf->path);
+	free(sf);
+}
+
+static int suite_file_build_groups(struct suite_file *sf,
+		struct suite_file_link *links, int nr_links)
+{
+	int i, j;
+
+	sf->id.plugin_grps = calloc(sf->nr_grps + 1,
+			sizeof(*sf->id.plugin_grps));
+	if (!sf->id.plugin_grps)
+		return -1;
+
+	for (i = 0; i != sf->nr_grps; ++i) {
+		struct plugin_link *grp;
+		int nr = 0;
+		int k = 0;
+		int pass;
+
+		for (j = 0; j != nr_links; ++j) {
+			if (links[j].group == i || links[j].group == -1)
+				++nr;
+		}
+
+		grp = calloc(nr + 1, sizeof(*grp));
+		if (!grp)
+			return -1;
+		sf->id.plugin_grps[i] = grp;
+
+		/* Plugins of the group first, followed by the common ones */
+		for (pass = 0; pass != 2; ++pass) {
+			for (j = 0; j != nr_links; ++j) {
+				char *str;
+
+				if (links[j].group != (pass ? -1 : i))
+					continue;
+				str = strdup(links[j].str);
+				if (!str)
+					return -1;
+				if (create_plugin_link(&grp[k], str)) {
+					grp[k].name = NULL;
+					free(str);
+					return -1;
+				}
+				++k;
+			}
+		}
+	}
+	return 0;
+}
+
+static int suite_file_parse(struct suite_file *sf)
+{
+	enum {
+		SECTION_NONE,
+		SECTION_SUITE,
+		SECTION_COMMON,
+		SECTION_GROUP,
+	} section = SECTION_NONE;
+	struct suite_file_link *links = NULL;
+	int nr_links = 0;
+	int lineno = 0;
+	char *line, *next;
+	int ret = -1;
+
+	for (line = sf->buf; line; line = next) {
+		char *key, *val, *eq;
+
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+		++lineno;
+
+		line = suite_file_strip(line);
+		if (line[0] == '\0' || line[0] == '#')
+			continue;
+
+		if (line[0] == '[') {
+			if (!strcmp(line, "[suite]")) {
+				section = SECTION_SUITE;
+			} else if (!strcmp(line, "[common]")) {
+				section = SECTION_COMMON;
+			} else if (!strcmp(line, "[group]")) {
+				section = SECTION_GROUP;
+				++sf->nr_grps;
+			} else {
+				printk(KERN_ERR "%s:%d: Unknown section %s\n",
+						sf->path, lineno, line);
+				goto out;
+			}
+			continue;
+		}
+
+		eq = strchr(line, '=');
+		if (!eq) {
+			printk(KERN_ERR "%s:%d: Expected 'key = value'\n",
+					sf->path, lineno);
+			goto out;
+		}
+		*eq = '\0';
+		key = suite_file_strip(line);
+		val = suite_file_strip(eq + 1);
+
+		switch (section) {
+		case SECTION_SUITE:
+			if (suite_file_setting(sf, key, val)) {
+				printk(KERN_ERR "%s:%d: Invalid setting %s = %s\n",
+						sf->path, lineno, key, val);
+				goto out;
+			}
+			break;
+		case SECTION_COMMON:
+		case SECTION_GROUP:
+		{
+			struct suite_file_link *tmp;
+
+			if (strcmp(key, "plugin") || val[0] == '\0') {
+				printk(KERN_ERR "%s:%d: Expected 'plugin = PLUGIN_ID:OPTIONS'\n",
+						sf->path, lineno);
+				goto out;
+			}
+			tmp = realloc(links, sizeof(*links) * (nr_links + 1));
+			if (!tmp)
+				goto out;
+			links = tmp;
+			links[nr_links].group = section == SECTION_COMMON ?
+					-1 : sf->nr_grps - 1;
+			links[nr_links].str = val;
+			++nr_links;
+			break;
+		}
+		default:
+			printk(KERN_ERR "%s:%d: Setting outside of a section\n",
+					sf->path, lineno);
+			goto out;
+		}
+	}
+
+	/* The name defaults to the file name without extension */
+	if (!sf->id.name) {
+		const char *base = strrchr(sf->path, '/');
+		char *ext;
+
+		sf->default_name = strdup(base ? base + 1 : sf->path);
+		if (!sf->default_name)
+			goto out;
+		ext = strstr(sf->default_name, suite_file_ext);
+		if (ext && ext[strlen(suite_file_ext)] == '\0')
+			*ext = '\0';
+		sf->id.name = sf->default_name;
+	}
+
+	if (strchr(sf->id.name, '.')) {
+		printk(KERN_ERR "%s: Suite needs a name without '.'\n", sf->path);
+		goto out;
+	}
+	if (!sf->nr_grps) {
+		printk(KERN_ERR "%s: Suite has no groups\n", sf->path);
+		goto out;
+	}
+
+	ret = suite_file_build_groups(sf, links, nr_links);
+	if (ret)
+		printk(KERN_ERR "%s: Failed to create plugin groups\n", sf->path);
+out:
+	free(links);
+	return ret;
+}
+
+static char *suite_file_read(const char *path, off_t size)
+{
+	FILE *f;
+	char *buf;
+
+	f = fopen(path, "r");
+	if (!f)
+		return NULL;
+
+	buf = malloc(size + 1);
+	if (buf && fread(buf, 1, size, f) != size) {
+		free(buf);
+		buf = NULL;
+	}
+	if (buf)
+		buf[size] = '\0';
+	fclose(f);
+	return buf;
+}
+
+const struct benchsuite_id *suite_file_load(struct list_head *files,
+		const char *path)
+{
+	struct suite_file *sf;
+	struct stat st;
+	char real[PATH_MAX];
+
+	if (!realpath(path, real) || stat(real, &st)) {
+		printk(KERN_ERR "Failed to open suite file %s: %s\n", path,
+				strerror(errno));
+		return NULL;
+	}
+
+	sf = calloc(1, sizeof(*sf));
+	if (!sf)
+		return NULL;
+	sf->settings = (struct run_settings) {
+		.warmup_runs = -1,
+		.runtime_min = -1,
+		.runtime_max = -1,
+		.runs_min = -1,
+		.runs_max = -1,
+		.percent_stderr = -1,
+	};
+	sf->id.settings = &sf->settings;
+	sf->id.version.version = "0";
+
+	sf->path = strdup(real);
+	if (!sf->path)
+		goto error;
+
+	sf->buf = suite_file_read(real, st.st_size);
+	if (!sf->buf) {
+		printk(KERN_ERR "Failed to read suite file %s\n", real);
+		goto error;
+	}
+
+	if (suite_file_parse(sf))
+		goto error;
+
+	list_add(&sf->suite_files, files);
+	return &sf->id;
+error:
+	suite_file_free(sf);
+	return NULL;
+}
+
+void suite_files_free(struct list_head *files)
+{
+	struct suite_file *sf, *nsf;
+
+	list_for_each_entry_safe(sf, nsf, files, suite_files) {
+		list_del(&sf->suite_files);
+		suite_file_free(sf);
+	}
+}
+
+void suite_files_print(const char *dir, int verbose)
+{
+	struct list_head files;
+	struct dirent *de;
+	DIR *d;
+	int header = 0;
+
+	d = opendir(dir);
+	if (!d)
+		return;
+
+	INIT_LIST_HEAD(&files);
+	while ((de = readdir(d))) {
+		const struct benchsuite_id *id;
+		char path[PATH_MAX];
+		size_t len = strlen(de->d_name);
+		size_t ext_len = strlen(suite_file_ext);
+
+		if (len <= ext_len || strcmp(de->d_name + len - ext_len,
+					suite_file_ext))
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+		id = suite_file_load(&files, path);
+		if (!id)
+			continue;
+
+		if (!header) {
+			printf("Suite files in %s\n  Benchsuites:\n", dir);
+			header = 1;
+		}
+		benchsuite_id_print(id, verbose);
+	}
+	closedir(d);
+	suite_files_free(&files);
+}
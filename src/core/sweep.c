@@ -0,0 +1,399 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cbench/core/sweep.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <klib/list.h>
+#include <klib/printk.h>
+
+#include <cbench/benchsuite.h>
+#include <cbench/core/module_manager.h>
+#include <cbench/environment.h>
+#include <cbench/option.h>
+#include <cbench/plugin.h>
+#include <cbench/storage.h>
+
+/* Upper limit of measured points without a time budget */
+#define SWEEP_MAX_POINTS 32
+
+/* Minimum change of the log-log slope between segments worth refining */
+#define SWEEP_SLOPE_CHANGE 0.15
+
+/* The knee is where the marginal speedup drops below this part of the first */
+#define SWEEP_KNEE_FRACTION 0.5
+
+struct sweep_point {
+	long long val;
+	/* Throughput, more is better */
+	double tput;
+	double std_err;
+	int valid;
+	/* Checksum of the plugin group measured at this point */
+	char group_sha[65];
+};
+
+struct sweep {
+	struct mod_mgr *mm;
+	struct environment *env;
+	struct plugin_link *grp;
+	int link;
+	struct option_adaptive ad;
+	const char *status_prefix;
+	int (*exec)(void *priv, struct list_head *plugins,
+			const char *status_prefix);
+	void *priv;
+
+	const char *metric;
+	int inverted;
+
+	struct sweep_point *points;
+	int nr_points;
+};
+
+static double sweep_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int sweep_insert(struct sweep *sw, struct sweep_point *pt)
+{
+	struct sweep_point *tmp;
+	int i;
+
+	tmp = realloc(sw->points, sizeof(*tmp) * (sw->nr_points + 1));
+	if (!tmp)
+		return -1;
+	sw->points = tmp;
+
+	for (i = sw->nr_points; i > 0 && sw->points[i - 1].val > pt->val; --i)
+		sw->points[i] = sw->points[i - 1];
+	sw->points[i] = *pt;
+	++sw->nr_points;
+	return 0;
+}
+
+/* Execute the group once with the swept option at val */
+static int sweep_measure(struct sweep *sw, long long val)
+{
+	struct list_head plugins;
+	struct plugin *plg, *nplg;
+	struct plugin *primary = NULL;
+	struct sweep_point pt = { .val = val, };
+	char status[256];
+	int ret = 0;
+	int i;
+
+	INIT_LIST_HEAD(&plugins);
+
+	for (i = 0; sw->grp[i].name != NULL; ++i) {
+		char *opts = NULL;
+
+		if (i == sw->link) {
+			opts = option_adaptive_set(sw->grp[i].options, &sw->ad,
+					val);
+			if (!opts) {
+				ret = -1;
+				goto out;
+			}
+		}
+		plg = plugin_link_create(sw->mm, &sw->grp[i],
+				opts ? opts : sw->grp[i].options, &plugins);
+		free(opts);
+		if (!plg) {
+			ret = -1;
+			goto out;
+		}
+		if (i == sw->link)
+			primary = plg;
+	}
+
+	snprintf(status, sizeof(status), "%s adaptive %.*s=%lld",
+			sw->status_prefix, sw->ad.key_len, sw->ad.key, val);
+	printk(KERN_INFO "Adaptive sweep point %.*s=%lld\n", sw->ad.key_len,
+			sw->ad.key, val);
+	plugins_calc_sha256(&plugins, pt.group_sha);
+	ret = sw->exec(sw->priv, &plugins, status);
+	if (ret)
+		goto out;
+
+	if (primary->result.nr_values) {
+		if (!sw->metric) {
+			sw->metric = primary->result.name;
+			sw->inverted = primary->result.cmp == DATA_LESS_IS_BETTER;
+		}
+		pt.tput = primary->result.mean;
+		pt.std_err = primary->result.std_err;
+		pt.valid = 1;
+		if (sw->inverted) {
+			if (pt.tput > 0) {
+				pt.std_err = pt.std_err / (pt.tput * pt.tput);
+				pt.tput = 1 / pt.tput;
+			} else {
+				pt.valid = 0;
+			}
+		}
+	}
+	if (!pt.valid)
+		printk(KERN_WARNING "No usable result for %.*s=%lld\n",
+				sw->ad.key_len, sw->ad.key, val);
+	ret = sweep_insert(sw, &pt);
+
+out:
+	list_for_each_entry_safe(plg, nplg, &plugins, plugin_grp) {
+		list_del(&plg->plugin_grp);
+		mod_mgr_plugin_free(sw->mm, plg);
+	}
+	return ret;
+}
+
+/* Log-log slope of the segment between point i and i + 1 */
+static double sweep_slope(struct sweep *sw, int i)
+{
+	struct sweep_point *a = &sw->points[i];
+	struct sweep_point *b = &sw->points[i + 1];
+
+	if (!a->valid || !b->valid || a->tput <= 0 || b->tput <= 0)
+		return 0;
+	return log(b->tput / a->tput) / log((double)b->val / a->val);
+}
+
+/* Whether the 95% confidence intervals of point i and i + 1 overlap */
+static int sweep_overlap(struct sweep *sw, int i)
+{
+	struct sweep_point *a = &sw->points[i];
+	struct sweep_point *b = &sw->points[i + 1];
+
+	return fabs(b->tput - a->tput) <= 1.96 * (a->std_err + b->std_err);
+}
+
+static double sweep_interval_score(struct sweep *sw, int i)
+{
+	int last = sw->nr_points - 2;
+	double slope = sweep_slope(sw, i);
+	double score = 0;
+
+	if (i > 0)
+		score = fabs(slope - sweep_slope(sw, i - 1));
+	if (i < last)
+		score = fmax(score, fabs(sweep_slope(sw, i + 1) - slope));
+	if (score < SWEEP_SLOPE_CHANGE)
+		score = 0;
+
+	/* The edge of a region where results can't be told apart */
+	if (!score && sweep_overlap(sw, i)
+			&& ((i > 0 && !sweep_overlap(sw, i - 1))
+				|| (i < last && !sweep_overlap(sw, i + 1))))
+		score = SWEEP_SLOPE_CHANGE;
+	return score;
+}
+
+/* Returns the interval to bisect next or -1 if there is none */
+static int sweep_next_interval(struct sweep *sw)
+{
+	double best_score = 0;
+	int best = -1;
+	int i;
+
+	for (i = 0; i < sw->nr_points - 1; ++i) {
+		double score;
+
+		if (sw->points[i + 1].val - sw->points[i].val < 2)
+			continue;
+		score = sweep_interval_score(sw, i);
+		if (score > best_score) {
+			best_score = score;
+			best = i;
+		}
+	}
+	return best;
+}
+
+static int sweep_report(struct sweep *sw)
+{
+	struct sweep_summary summary;
+	char option[128];
+	double first_slope = 0;
+	int knee = -1;
+	int peak = -1;
+	int i;
+
+	for (i = 0; i != sw->nr_points; ++i) {
+		if (sw->points[i].valid && (peak == -1
+				|| sw->points[i].tput > sw->points[peak].tput))
+			peak = i;
+	}
+	if (peak == -1) {
+		printk(KERN_ERR "Adaptive sweep produced no usable results\n");
+		return 0;
+	}
+
+	for (i = 0; i < sw->nr_points - 1; ++i) {
+		double slope = sweep_slope(sw, i);
+
+		if (i == 0)
+			first_slope = slope;
+		if (first_slope <= 0 || slope < first_slope * SWEEP_KNEE_FRACTION) {
+			knee = i;
+			break;
+		}
+	}
+	if (knee == -1)
+		knee = sw->nr_points - 1;
+
+	printk(KERN_INFO "Adaptive sweep over %.*s, %d points, %s%s%s:\n",
+			sw->ad.key_len, sw->ad.key, sw->nr_points,
+			sw->inverted ? "1/" : "", sw->metric,
+			sw->inverted ? " (inverted, less is better)" : "");
+	for (i = 0; i != sw->nr_points; ++i) {
+		struct sweep_point *pt = &sw->points[i];
+
+		if (!pt->valid) {
+			printk(KERN_INFO "\t%8lld\t-\n", pt->val);
+			continue;
+		}
+		printk(KERN_INFO "\t%8lld\t%14g +- %-12g%s%s\n", pt->val,
+				pt->tput, pt->std_err,
+				i == knee ? " knee" : "",
+				i == peak ? " peak" : "");
+	}
+	printk(KERN_INFO "Knee at %.*s=%lld, peak at %.*s=%lld\n",
+			sw->ad.key_len, sw->ad.key, sw->points[knee].val,
+			sw->ad.key_len, sw->ad.key, sw->points[peak].val);
+
+	snprintf(option, sizeof(option), "%.*s", sw->ad.key_len, sw->ad.key);
+	summary = (struct sweep_summary) {
+		.option = option,
+		.metric = sw->metric,
+		.inverted = sw->inverted,
+		.nr_points = sw->nr_points,
+		.knee = sw->points[knee].val,
+		.knee_group_sha = sw->points[knee].group_sha,
+		.peak = sw->points[peak].val,
+		.peak_group_sha = sw->points[peak].group_sha,
+	};
+	return storage_add_sweep(&sw->env->storage, &summary);
+}
+
+/* Points of a geometric grid with factor after val up to and including end */
+static int sweep_grid_points(long long val, long long end, long long factor)
+{
+	int nr = 0;
+
+	while (val < end) {
+		val = val > end / factor ? end : val * factor;
+		++nr;
+	}
+	return nr;
+}
+
+int sweep_adaptive_execute(struct mod_mgr *mm, struct environment *env,
+		struct plugin_link *grp, double budget, const char *status_prefix,
+		int (*exec)(void *priv, struct list_head *plugins,
+			const char *status_prefix),
+		void *priv)
+{
+	struct sweep sw = {
+		.mm = mm,
+		.env = env,
+		.grp = grp,
+		.link = -1,
+		.status_prefix = status_prefix,
+		.exec = exec,
+		.priv = priv,
+	};
+	double started = sweep_now();
+	long long factor = 2;
+	long long val;
+	int ret = 0;
+	int i;
+
+	for (i = 0; grp[i].name != NULL; ++i) {
+		if (option_adaptive_find(grp[i].options, &sw.ad) == 1) {
+			sw.link = i;
+			break;
+		}
+	}
+	if (sw.link == -1)
+		return -1;
+
+	/*
+	 * Coarse geometric grid including both ends. With a time budget the
+	 * grid is widened as far as necessary for the remaining points to
+	 * fit, if not even the end fits the sweep stops.
+	 */
+	for (val = sw.ad.start; ; ) {
+		ret = sweep_measure(&sw, val);
+		if (ret || val == sw.ad.end)
+			break;
+
+		if (budget) {
+			double elapsed = sweep_now() - started;
+			double per_point = elapsed / sw.nr_points;
+			double left = budget - elapsed;
+
+			if (per_point > left) {
+				printk(KERN_INFO "Adaptive sweep time budget reached\n");
+				break;
+			}
+			while (sweep_grid_points(val, sw.ad.end, factor)
+					* per_point > left)
+				factor *= 2;
+		}
+		val = val > sw.ad.end / factor ? sw.ad.end : val * factor;
+	}
+
+	while (!ret) {
+		double elapsed = sweep_now() - started;
+		double per_point = elapsed / sw.nr_points;
+		int next;
+
+		if (budget && elapsed + per_point > budget) {
+			printk(KERN_INFO "Adaptive sweep time budget reached\n");
+			break;
+		}
+		if (!budget && sw.nr_points >= SWEEP_MAX_POINTS)
+			break;
+
+		next = sweep_next_interval(&sw);
+		if (next == -1)
+			break;
+
+		val = llround(sqrt((double)sw.points[next].val
+					* sw.points[next + 1].val));
+		if (val <= sw.points[next].val)
+			val = sw.points[next].val + 1;
+		if (val >= sw.points[next + 1].val)
+			val = sw.points[next + 1].val - 1;
+		ret = sweep_measure(&sw, val);
+	}
+
+	if (sw.nr_points && sweep_report(&sw))
+		ret = -1;
+	free(sw.points);
+	return ret;
+}
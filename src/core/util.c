@@ -19,6 +19,7 @@
 
 #include <cbench/util.h>
 
+#include <ftw.h>
 #include <sched.h>
 #include <sys/resource.h>
 #include <unistd.h>
@@ -66,15 +67,35 @@ char *file_read_complete(const char *path)
 }
 
 int mem_grow(void **ptr, size_t *len, size_t req_len) {
-	if (!*ptr || *len < req_len) {
-		*ptr = malloc(req_len);
-		if (!*ptr)
-			return -1;
-		*len = req_len;
-	}
+	void *new;
+
+	if (*ptr && *len >= req_len)
+		return 0;
+
+	new = realloc(*ptr, req_len);
+	if (!new)
+		return -1;
+	*ptr = new;
+	*len = req_len;
 	return 0;
 }
 
+static unsigned long long disk_usage_sum;
+
+static int disk_usage_add(const char *path, const struct stat *st, int flag,
+		struct FTW *ftw)
+{
+	disk_usage_sum += (unsigned long long)st->st_blocks * 512;
+	return 0;
+}
+
+unsigned long long dir_disk_usage(const char *path)
+{
+	disk_usage_sum = 0;
+	nftw(path, disk_usage_add, 32, FTW_PHYS | FTW_MOUNT);
+	return disk_usage_sum;
+}
+
 void str_strip(char *buf)
 {
 	int i;
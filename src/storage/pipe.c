@@ -0,0 +1,629 @@
+/*
+ * Cbench - A C benchmarking suite for Linux benchmarking.
+ * Copyright (C) 2013  Markus Pargmann <mpargmann@allfex.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cbench/storage/pipe.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <klib/list.h>
+#include <klib/printk.h>
+
+#include <cbench/data.h>
+#include <cbench/plugin.h>
+#include <cbench/util.h>
+
+enum pipe_msg_type {
+	PIPE_INIT_PLUGIN_GRP,
+	PIPE_INIT_RUN,
+	PIPE_ADD_DATA,
+	PIPE_ADD_RUN_PHASES,
+	PIPE_ADD_MONITOR_OVERHEAD,
+	PIPE_EXIT_RUN,
+	PIPE_EXIT_PLUGIN_GRP,
+	PIPE_RESULTS,
+};
+
+struct pipe_msg_hdr {
+	enum pipe_msg_type type;
+	uint32_t len;
+};
+
+struct pipe_data {
+	int fd;
+	/* Plugins of the current group, they are sent as index in it */
+	struct list_head *plugins;
+	char *buf;
+	size_t buf_size;
+	size_t len;
+};
+
+static int32_t pipe_nr_plugins(struct list_head *plugins)
+{
+	struct plugin *plg;
+	int32_t nr = 0;
+
+	list_for_each_entry(plg, plugins, plugin_grp)
+		++nr;
+	return nr;
+}
+
+static int pipe_put(struct pipe_data *p, const void *src, size_t len)
+{
+	size_t req = p->len + len;
+
+	if (req > p->buf_size && mem_grow((void**)&p->buf, &p->buf_size,
+				req > 2 * p->buf_size ? req : 2 * p->buf_size))
+		return -1;
+	memcpy(p->buf + p->len, src, len);
+	p->len += len;
+	return 0;
+}
+
+static int pipe_put_str(struct pipe_data *p, const char *str)
+{
+	uint32_t len = str ? strlen(str) + 1 : 0;
+	int ret;
+
+	ret = pipe_put(p, &len, sizeof(len));
+	if (!ret && len)
+		ret = pipe_put(p, str, len);
+	return ret;
+}
+
+static int pipe_put_plugin(struct pipe_data *p, struct plugin *plug)
+{
+	struct plugin *plg;
+	int32_t index = 0;
+
+	if (!p->plugins)
+		return -1;
+	list_for_each_entry(plg, p->plugins, plugin_grp) {
+		if (plg == plug)
+			return pipe_put(p, &index, sizeof(index));
+		++index;
+	}
+	return -1;
+}
+
+static void pipe_start(struct pipe_data *p, enum pipe_msg_type type)
+{
+	struct pipe_msg_hdr hdr = {
+		.type = type,
+	};
+
+	p->len = 0;
+	pipe_put(p, &hdr, sizeof(hdr));
+}
+
+static int pipe_send(struct pipe_data *p, int ret)
+{
+	size_t off = 0;
+
+	if (ret) {
+		printk(KERN_ERR "Failed to encode storage message\n");
+		return -1;
+	}
+	((struct pipe_msg_hdr *)p->buf)->len = p->len - sizeof(struct pipe_msg_hdr);
+
+	while (off != p->len) {
+		ssize_t written = write(p->fd, p->buf + off, p->len - off);
+
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			printk(KERN_ERR "Failed to write to storage pipe: %s\n",
+					strerror(errno));
+			return -1;
+		}
+		off += written;
+	}
+	return 0;
+}
+
+static int pipe_init_plugin_grp(void *storage, struct list_head *plugins,
+		const char *sha256)
+{
+	struct pipe_data *p = storage;
+	int32_t nr_plugins = pipe_nr_plugins(plugins);
+	int ret;
+
+	p->plugins = plugins;
+
+	pipe_start(p, PIPE_INIT_PLUGIN_GRP);
+	ret = pipe_put(p, &nr_plugins, sizeof(nr_plugins));
+	ret |= pipe_put_str(p, sha256);
+	return pipe_send(p, ret);
+}
+
+static int pipe_init_run(void *storage, const char *group_sha,
+		const char *uuid, int nr_run)
+{
+	struct pipe_data *p = storage;
+	int ret;
+
+	pipe_start(p, PIPE_INIT_RUN);
+	ret = pipe_put_str(p, group_sha);
+	ret |= pipe_put_str(p, uuid);
+	ret |= pipe_put(p, &nr_run, sizeof(nr_run));
+	return pipe_send(p, ret);
+}
+
+static int pipe_add_data(void *storage, struct plugin *plug,
+		struct list_head *data_list)
+{
+	struct pipe_data *p = storage;
+	struct data *data;
+	uint32_t nr_data = 0;
+	int ret;
+
+	list_for_each_entry(data, data_list, run_data)
+		++nr_data;
+
+	pipe_start(p, PIPE_ADD_DATA);
+	ret = pipe_put_plugin(p, plug);
+	ret |= pipe_put(p, &nr_data, sizeof(nr_data));
+	list_for_each_entry(data, data_list, run_data) {
+		uint32_t nr_values;
+
+		for (nr_values = 0; data->data[nr_values].type != VALUE_SENTINEL;
+				++nr_values)
+			;
+		ret |= pipe_put(p, &data->type, sizeof(data->type));
+		ret |= pipe_put(p, &data->run, sizeof(data->run));
+		ret |= pipe_put(p, &data->instance, sizeof(data->instance));
+		ret |= pipe_put(p, &nr_values, sizeof(nr_values));
+		ret |= pipe_put(p, data->data, sizeof(*data->data) * nr_values);
+		for (nr_values = 0; data->data[nr_values].type != VALUE_SENTINEL;
+				++nr_values) {
+			if (data->data[nr_values].type == VALUE_STRING)
+				ret |= pipe_put_str(p, data->data[nr_values].v_str);
+		}
+	}
+	return pipe_send(p, ret);
+}
+
+static int pipe_add_run_phases(void *storage, struct plugin *plug,
+		const struct run_phase *phases, int nr_phases)
+{
+	struct pipe_data *p = storage;
+	int ret;
+	int i;
+
+	pipe_start(p, PIPE_ADD_RUN_PHASES);
+	ret = pipe_put_plugin(p, plug);
+	ret |= pipe_put(p, &nr_phases, sizeof(nr_phases));
+	for (i = 0; i != nr_phases; ++i) {
+		ret |= pipe_put(p, &phases[i], sizeof(phases[i]));
+		ret |= pipe_put_str(p, phases[i].name);
+	}
+	return pipe_send(p, ret);
+}
+
+static int pipe_add_monitor_overhead(void *storage, struct plugin *plug,
+		const struct monitor_overhead *overhead)
+{
+	struct pipe_data *p = storage;
+	int ret;
+
+	pipe_start(p, PIPE_ADD_MONITOR_OVERHEAD);
+	ret = pipe_put_plugin(p, plug);
+	ret |= pipe_put(p, overhead, sizeof(*overhead));
+	return pipe_send(p, ret);
+}
+
+static int pipe_exit_run(void *storage, const struct run_summary *summary)
+{
+	struct pipe_data *p = storage;
+	int has_order = summary->order != NULL;
+	int ret;
+
+	pipe_start(p, PIPE_EXIT_RUN);
+	ret = pipe_put(p, summary, sizeof(*summary));
+	ret |= pipe_put(p, &has_order, sizeof(has_order));
+	if (has_order)
+		ret |= pipe_put(p, summary->order, sizeof(*summary->order));
+	return pipe_send(p, ret);
+}
+
+static int pipe_exit_plugin_grp(void *storage)
+{
+	struct pipe_data *p = storage;
+
+	p->plugins = NULL;
+	pipe_start(p, PIPE_EXIT_PLUGIN_GRP);
+	return pipe_send(p, 0);
+}
+
+static void pipe_exit(void *storage)
+{
+	struct pipe_data *p = storage;
+
+	close(p->fd);
+	free(p->buf);
+	free(p);
+}
+
+static const struct storage_ops storage_pipe = {
+	.init_plugin_grp = pipe_init_plugin_grp,
+	.init_run = pipe_init_run,
+	.add_data = pipe_add_data,
+	.add_run_phases = pipe_add_run_phases,
+	.add_monitor_overhead = pipe_add_monitor_overhead,
+	.exit_run = pipe_exit_run,
+	.exit_plugin_grp = pipe_exit_plugin_grp,
+	.exit = pipe_exit,
+};
+
+int storage_pipe_send_results(struct storage *storage,
+		struct list_head *plugins)
+{
+	struct pipe_data *p = storage->data;
+	int32_t nr_plugins = pipe_nr_plugins(plugins);
+	struct plugin *plg;
+	int ret;
+
+	pipe_start(p, PIPE_RESULTS);
+	ret = pipe_put(p, &nr_plugins, sizeof(nr_plugins));
+	list_for_each_entry(plg, plugins, plugin_grp) {
+		ret |= pipe_put_str(p, plg->result.name);
+		ret |= pipe_put(p, &plg->result.nr_values,
+				sizeof(plg->result.nr_values));
+		ret |= pipe_put(p, &plg->result.mean, sizeof(plg->result.mean));
+		ret |= pipe_put(p, &plg->result.std_err,
+				sizeof(plg->result.std_err));
+	}
+	return pipe_send(p, ret);
+}
+
+int storage_pipe_init(struct storage *storage, int fd)
+{
+	struct pipe_data *p = calloc(1, sizeof(*p));
+
+	if (!p)
+		return -1;
+	p->fd = fd;
+	storage->ops = &storage_pipe;
+	storage->data = p;
+	return 0;
+}
+
+/*
+ * Receiving side. Messages are decoded from a buffer holding exactly one
+ * message, reads past its end fail. Storage backends may keep the group
+ * checksum and run uuid until the group or run ends, so these are copied.
+ */
+struct pipe_msg {
+	/* Plugins of the group in the parent, in the order of the child */
+	struct list_head *plugins;
+	const char *buf;
+	size_t len;
+	size_t off;
+	char group_sha[65];
+	char run_sha[65];
+	char run_uuid[37];
+	int group_open;
+};
+
+static int msg_copy_str(char *dst, size_t size, const char *src)
+{
+	if (!src || strlen(src) >= size)
+		return -1;
+	strcpy(dst, src);
+	return 0;
+}
+
+static int msg_get(struct pipe_msg *m, void *dst, size_t len)
+{
+	if (m->len - m->off < len)
+		return -1;
+	memcpy(dst, m->buf + m->off, len);
+	m->off += len;
+	return 0;
+}
+
+/* Strings point into the message buffer */
+static int msg_get_str(struct pipe_msg *m, const char **str)
+{
+	uint32_t len;
+
+	if (msg_get(m, &len, sizeof(len)))
+		return -1;
+	if (!len) {
+		*str = NULL;
+		return 0;
+	}
+	if (m->len - m->off < len || m->buf[m->off + len - 1] != '\0')
+		return -1;
+	*str = m->buf + m->off;
+	m->off += len;
+	return 0;
+}
+
+static int msg_get_plugin(struct pipe_msg *m, struct plugin **plug)
+{
+	struct plugin *plg;
+	int32_t index;
+
+	if (msg_get(m, &index, sizeof(index)))
+		return -1;
+	list_for_each_entry(plg, m->plugins, plugin_grp) {
+		if (!index--) {
+			*plug = plg;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+static int pipe_read_full(int fd, void *dst, size_t len)
+{
+	size_t off = 0;
+
+	while (off != len) {
+		ssize_t ret = read(fd, (char *)dst + off, len - off);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (ret == 0)
+			return off ? -1 : 1;
+		off += ret;
+	}
+	return 0;
+}
+
+static int forward_add_data(struct pipe_msg *m, struct storage *target)
+{
+	struct list_head data_list;
+	struct data *data, *ndata;
+	struct plugin *plug;
+	uint32_t nr_data;
+	uint32_t i;
+	int ret = 0;
+
+	INIT_LIST_HEAD(&data_list);
+	if (msg_get_plugin(m, &plug) || msg_get(m, &nr_data, sizeof(nr_data)))
+		return -1;
+
+	for (i = 0; i != nr_data && !ret; ++i) {
+		enum data_type type;
+		unsigned int run;
+		int instance;
+		uint32_t nr_values;
+		uint32_t j;
+
+		if (msg_get(m, &type, sizeof(type)) || msg_get(m, &run, sizeof(run))
+				|| msg_get(m, &instance, sizeof(instance))
+				|| msg_get(m, &nr_values, sizeof(nr_values))
+				|| nr_values > m->len / sizeof(struct value)) {
+			ret = -1;
+			break;
+		}
+		data = data_alloc(type, nr_values);
+		if (!data) {
+			ret = -1;
+			break;
+		}
+		data->run = run;
+		data->instance = instance;
+		list_add_tail(&data->run_data, &data_list);
+		if (msg_get(m, data->data, sizeof(*data->data) * nr_values)) {
+			ret = -1;
+			break;
+		}
+		/* String pointers are the child's, data_put must not free them */
+		for (j = 0; j != nr_values; ++j) {
+			if (data->data[j].type == VALUE_STRING)
+				data->data[j].v_str = NULL;
+		}
+		for (j = 0; j != nr_values && !ret; ++j) {
+			const char *str;
+
+			if (data->data[j].type != VALUE_STRING)
+				continue;
+			if (msg_get_str(m, &str)) {
+				ret = -1;
+				break;
+			}
+			if (str) {
+				data->data[j].v_str = strdup(str);
+				if (!data->data[j].v_str)
+					ret = -1;
+			}
+		}
+	}
+
+	if (!ret)
+		ret = storage_add_data(target, plug, &data_list);
+
+	list_for_each_entry_safe(data, ndata, &data_list, run_data) {
+		list_del(&data->run_data);
+		data_put(data);
+	}
+	return ret;
+}
+
+static int forward_add_run_phases(struct pipe_msg *m, struct storage *target)
+{
+	struct run_phase *phases;
+	struct plugin *plug;
+	int nr_phases;
+	int ret = 0;
+	int i;
+
+	if (msg_get_plugin(m, &plug)
+			|| msg_get(m, &nr_phases, sizeof(nr_phases))
+			|| nr_phases < 0 || nr_phases > m->len / sizeof(*phases))
+		return -1;
+
+	phases = malloc(sizeof(*phases) * nr_phases);
+	if (!phases)
+		return -1;
+	for (i = 0; i != nr_phases && !ret; ++i) {
+		ret = msg_get(m, &phases[i], sizeof(phases[i]));
+		ret |= msg_get_str(m, &phases[i].name);
+	}
+	if (!ret)
+		ret = storage_add_run_phases(target, plug, phases, nr_phases);
+	free(phases);
+	return ret;
+}
+
+/* Result summaries refer to the data header of the parent's plugins */
+static int forward_results(struct pipe_msg *m)
+{
+	struct plugin *plg;
+	int32_t nr_plugins;
+
+	if (msg_get(m, &nr_plugins, sizeof(nr_plugins))
+			|| nr_plugins != pipe_nr_plugins(m->plugins))
+		return -1;
+
+	list_for_each_entry(plg, m->plugins, plugin_grp) {
+		const struct header *hdr = plugin_data_hdr(plg);
+		const char *name;
+
+		memset(&plg->result, 0, sizeof(plg->result));
+		if (msg_get_str(m, &name)
+				|| msg_get(m, &plg->result.nr_values,
+					sizeof(plg->result.nr_values))
+				|| msg_get(m, &plg->result.mean,
+					sizeof(plg->result.mean))
+				|| msg_get(m, &plg->result.std_err,
+					sizeof(plg->result.std_err)))
+			return -1;
+
+		for (; name && hdr && hdr->name; ++hdr) {
+			if (!strcmp(hdr->name, name)) {
+				plg->result.name = hdr->name;
+				plg->result.cmp = hdr->data_type;
+				break;
+			}
+		}
+		if (!plg->result.name)
+			plg->result.nr_values = 0;
+	}
+	return 0;
+}
+
+static int forward_msg(struct pipe_msg *m, enum pipe_msg_type type,
+		struct storage *target)
+{
+	struct monitor_overhead overhead;
+	struct run_summary summary;
+	struct run_order order;
+	struct plugin *plug;
+	const char *sha256;
+	const char *uuid;
+	int32_t nr_plugins;
+	int has_order;
+	int nr_run;
+
+	switch (type) {
+	case PIPE_INIT_PLUGIN_GRP:
+		if (msg_get(m, &nr_plugins, sizeof(nr_plugins))
+				|| nr_plugins != pipe_nr_plugins(m->plugins)
+				|| msg_get_str(m, &sha256)
+				|| msg_copy_str(m->group_sha, sizeof(m->group_sha), sha256))
+			return -1;
+		m->group_open = 1;
+		return storage_init_plg_grp(target, m->plugins, m->group_sha);
+	case PIPE_INIT_RUN:
+		if (msg_get_str(m, &sha256) || msg_get_str(m, &uuid)
+				|| msg_get(m, &nr_run, sizeof(nr_run))
+				|| msg_copy_str(m->run_sha, sizeof(m->run_sha), sha256)
+				|| msg_copy_str(m->run_uuid, sizeof(m->run_uuid), uuid))
+			return -1;
+		return storage_init_run(target, m->run_sha, m->run_uuid, nr_run);
+	case PIPE_ADD_DATA:
+		return forward_add_data(m, target);
+	case PIPE_ADD_RUN_PHASES:
+		return forward_add_run_phases(m, target);
+	case PIPE_ADD_MONITOR_OVERHEAD:
+		if (msg_get_plugin(m, &plug)
+				|| msg_get(m, &overhead, sizeof(overhead)))
+			return -1;
+		return storage_add_monitor_overhead(target, plug, &overhead);
+	case PIPE_EXIT_RUN:
+		if (msg_get(m, &summary, sizeof(summary))
+				|| msg_get(m, &has_order, sizeof(has_order)))
+			return -1;
+		summary.order = NULL;
+		if (has_order) {
+			if (msg_get(m, &order, sizeof(order)))
+				return -1;
+			summary.order = &order;
+		}
+		return storage_exit_run(target, &summary);
+	case PIPE_EXIT_PLUGIN_GRP:
+		m->group_open = 0;
+		storage_exit_plg_grp(target);
+		return 0;
+	case PIPE_RESULTS:
+		return forward_results(m);
+	}
+	return -1;
+}
+
+int storage_pipe_forward(int fd, struct storage *target,
+		struct list_head *plugins)
+{
+	struct pipe_msg_hdr hdr;
+	struct pipe_msg m = {
+		.plugins = plugins,
+		.group_open = 0,
+	};
+	char *buf = NULL;
+	size_t buf_size = 0;
+	int error = 0;
+	int ret;
+
+	while (1) {
+		ret = pipe_read_full(fd, &hdr, sizeof(hdr));
+		if (ret == 1)
+			break;
+		if (ret || mem_grow((void**)&buf, &buf_size, hdr.len + 1)
+				|| pipe_read_full(fd, buf, hdr.len)) {
+			printk(KERN_ERR "Storage pipe of the group broke off\n");
+			error = 1;
+			break;
+		}
+
+		m.buf = buf;
+		m.len = hdr.len;
+		m.off = 0;
+		if (forward_msg(&m, hdr.type, target)) {
+			printk(KERN_ERR "Failed to store data of the group\n");
+			error = 1;
+		}
+	}
+	/* The child ended within a group */
+	if (m.group_open) {
+		storage_exit_plg_grp(target);
+		error = 1;
+	}
+	free(buf);
+	return error ? -1 : 0;
+}
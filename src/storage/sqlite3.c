@@ -19,6 +19,7 @@
 
 #include <cbench/storage/sqlite3.h>
 
+#include <math.h>
 #include <stddef.h>
 #include <stdio.h>
 
@@ -102,6 +103,65 @@ static int sqlite3_alter_by_hdr_cb(void *ctx, int nr_col, char **cols,
 	return 0;
 }
 
+struct column_present {
+	const char *name;
+	int present;
+};
+
+static int sqlite3_column_present_cb(void *ctx, int nr_col, char **cols,
+					char **names)
+{
+	struct column_present *cp = ctx;
+
+	if (!strcmp(cp->name, cols[1]))
+		cp->present = 1;
+	return 0;
+}
+
+/*
+ * Add column to table if it is missing, tables created by older versions lack
+ * columns that were added later.
+ * WARNING: This internal function uses the stmt buffer.
+ */
+static int sqlite3_add_missing_column(const char *table, struct sqlite3_data *d,
+				const char *column, const char *definition)
+{
+	struct column_present cp = {
+		.name = column,
+	};
+	char **stmt = &d->stmt;
+	size_t *stmt_size = &d->stmt_size;
+	char *errmsg;
+	int ret;
+
+	ret = mem_grow((void**)stmt, stmt_size, strlen(table) + strlen(column)
+			+ strlen(definition) + 128);
+	if (ret)
+		return -1;
+
+	sprintf(*stmt, "PRAGMA table_info('%s');", table);
+	ret = sqlite3_exec(d->db, *stmt, sqlite3_column_present_cb, &cp, &errmsg);
+	if (ret != SQLITE_OK) {
+		printk(KERN_ERR "Failed getting table info (%s): %s\n", *stmt,
+				errmsg);
+		sqlite3_free(errmsg);
+		return -1;
+	}
+	if (cp.present)
+		return 0;
+
+	sprintf(*stmt, "ALTER TABLE '%s' ADD COLUMN '%s' %s;", table, column,
+			definition);
+	ret = sqlite3_exec(d->db, *stmt, NULL, NULL, &errmsg);
+	if (ret != SQLITE_OK) {
+		printk(KERN_ERR "Failed to add column (%s): %s\n", *stmt,
+				errmsg);
+		sqlite3_free(errmsg);
+		return -1;
+	}
+	return 0;
+}
+
 /*
  * WARNING: This internal function uses buf2 and stmt buffers.
  */
@@ -294,7 +354,10 @@ static void *sqlite3_init(const char *path)
 	d->buf1 = NULL;
 	d->buf2 = NULL;
 
-	ret = mem_grow((void**)&d->buf1, &d->buf1_size, strlen(path) + 64);
+	/* Large enough that the buffers rarely grow while a benchmark runs */
+	ret = mem_grow((void**)&d->buf1, &d->buf1_size, strlen(path) + 4096);
+	ret |= mem_grow((void**)&d->buf2, &d->buf2_size, 4096);
+	ret |= mem_grow((void**)&d->stmt, &d->stmt_size, 4096);
 	if (ret) {
 		goto error;
 	}
@@ -350,7 +413,11 @@ static void *sqlite3_init(const char *path)
 					"run_uuid UNIQUE PRIMARY KEY,"
 					"plugin_group_sha,"
 					"prev_runs,"
-					"system_sha);",
+					"system_sha,"
+					"duration,"
+					"rel_std_dev,"
+					"order_seed,"
+					"order_position);",
 				NULL, NULL, &errmsg);
 	if (ret != SQLITE_OK) {
 		printk(KERN_ERR "Failed to create unique_runs table: %s\n",
@@ -359,6 +426,69 @@ static void *sqlite3_init(const char *path)
 		goto error_sqldb;
 	}
 
+	ret = sqlite3_exec(d->db, "CREATE TABLE IF NOT EXISTS run_phase("
+					"run_uuid,"
+					"plugin_sha,"
+					"phase,"
+					"duration,"
+					"cpu_time,"
+					"barrier_wait,"
+					"persist_time);",
+				NULL, NULL, &errmsg);
+	if (ret != SQLITE_OK) {
+		printk(KERN_ERR "Failed to create run_phase table: %s\n",
+				errmsg);
+		sqlite3_free(errmsg);
+		goto error_sqldb;
+	}
+
+	ret = sqlite3_exec(d->db, "CREATE TABLE IF NOT EXISTS monitor_overhead("
+					"run_uuid,"
+					"plugin_sha,"
+					"period,"
+					"offset,"
+					"calls,"
+					"missed,"
+					"duration,"
+					"cpu_time,"
+					"max_duration,"
+					"max_lag);",
+				NULL, NULL, &errmsg);
+	if (ret != SQLITE_OK) {
+		printk(KERN_ERR "Failed to create monitor_overhead table: %s\n",
+				errmsg);
+		sqlite3_free(errmsg);
+		goto error_sqldb;
+	}
+
+	ret = sqlite3_exec(d->db, "CREATE TABLE IF NOT EXISTS adaptive_sweep("
+					"system_sha,"
+					"option,"
+					"metric,"
+					"inverted,"
+					"nr_points,"
+					"knee,"
+					"knee_group_sha,"
+					"peak,"
+					"peak_group_sha);",
+				NULL, NULL, &errmsg);
+	if (ret != SQLITE_OK) {
+		printk(KERN_ERR "Failed to create adaptive_sweep table: %s\n",
+				errmsg);
+		sqlite3_free(errmsg);
+		goto error_sqldb;
+	}
+
+	/* Databases of older versions lack the run summary columns */
+	sqlite3_exec(d->db, "ALTER TABLE unique_run ADD COLUMN duration;",
+			NULL, NULL, NULL);
+	sqlite3_exec(d->db, "ALTER TABLE unique_run ADD COLUMN rel_std_dev;",
+			NULL, NULL, NULL);
+	sqlite3_exec(d->db, "ALTER TABLE unique_run ADD COLUMN order_seed;",
+			NULL, NULL, NULL);
+	sqlite3_exec(d->db, "ALTER TABLE unique_run ADD COLUMN order_position;",
+			NULL, NULL, NULL);
+
 	ret = sqlite3_exec(d->db, "CREATE TABLE IF NOT EXISTS plugin_option_meta("
 					"plugin_option_meta_sha UNIQUE PRIMARY KEY,"
 					"plugin_sha,"
@@ -840,6 +970,9 @@ static int sqlite3_init_plugin_grp(void *storage, struct list_head *plugins,
 					plug->id->name,
 					plug->version->version);
 			ret = sqlite3_alter_by_hdr(*buf1, d, hdr, "run_uuid,type_monitor");
+			if (!ret)
+				ret = sqlite3_add_missing_column(*buf1, d, "instance",
+						"INTEGER DEFAULT 0");
 			if (ret) {
 				printk(KERN_ERR "Failed to update plugin table %s\n",
 						buf1);
@@ -944,7 +1077,8 @@ static int sqlite3_init_plugin_grp(void *storage, struct list_head *plugins,
 	return 0;
 }
 
-static int sqlite3_init_run(void *storage, const char *uuid, int nr_run)
+static int sqlite3_init_run(void *storage, const char *group_sha,
+		const char *uuid, int nr_run)
 {
 	struct sqlite3_data *d = storage;
 	char **stmt = &d->stmt;
@@ -953,6 +1087,7 @@ static int sqlite3_init_run(void *storage, const char *uuid, int nr_run)
 	char *errmsg;
 
 	d->run_uuid = uuid;
+	d->group_sha = group_sha;
 
 	ret = mem_grow((void**)stmt, stmt_size, strlen(uuid) + strlen(d->group_sha)
 				+ strlen(d->sys_sha) + 128);
@@ -981,6 +1116,222 @@ static int sqlite3_init_run(void *storage, const char *uuid, int nr_run)
 	return 0;
 }
 
+static int sqlite3_add_run_phases(void *storage, struct plugin *plug,
+		const struct run_phase *phases, int nr_phases)
+{
+	struct sqlite3_data *d = storage;
+	sqlite3_stmt *sqstmt;
+	int ret;
+	int i;
+
+	ret = sqlite3_prepare_v2(d->db, "INSERT INTO run_phase(run_uuid,"
+				"plugin_sha,phase,duration,cpu_time,barrier_wait,"
+				"persist_time) VALUES(?,?,?,?,?,?,?);",
+			-1, &sqstmt, NULL);
+	if (ret != SQLITE_OK) {
+		printk(KERN_ERR "Failed to prepare run phase statement: %s\n",
+				sqlite3_errmsg(d->db));
+		return -1;
+	}
+
+	sqlite3_exec(d->db, "BEGIN TRANSACTION;", NULL, NULL, NULL);
+	for (i = 0; i != nr_phases; ++i) {
+		ret = sqlite3_bind_text(sqstmt, 1, d->run_uuid, -1, SQLITE_STATIC);
+		ret |= sqlite3_bind_text(sqstmt, 2, plug->sha256, -1, SQLITE_STATIC);
+		ret |= sqlite3_bind_text(sqstmt, 3, phases[i].name, -1, SQLITE_STATIC);
+		ret |= sqlite3_bind_double(sqstmt, 4, phases[i].duration);
+		ret |= sqlite3_bind_double(sqstmt, 5, phases[i].cpu_time);
+		ret |= sqlite3_bind_double(sqstmt, 6, phases[i].barrier_wait);
+		ret |= sqlite3_bind_double(sqstmt, 7, phases[i].persist);
+		if (ret != SQLITE_OK || sqlite3_step(sqstmt) != SQLITE_DONE) {
+			printk(KERN_ERR "Failed to insert run phase of %s: %s\n",
+					plug->id->name, sqlite3_errmsg(d->db));
+			break;
+		}
+		sqlite3_reset(sqstmt);
+	}
+	sqlite3_finalize(sqstmt);
+	sqlite3_exec(d->db, "END TRANSACTION;", NULL, NULL, NULL);
+	return i == nr_phases ? 0 : -1;
+}
+
+static int sqlite3_add_monitor_overhead(void *storage, struct plugin *plug,
+		const struct monitor_overhead *overhead)
+{
+	struct sqlite3_data *d = storage;
+	sqlite3_stmt *sqstmt;
+	int ret;
+
+	ret = sqlite3_prepare_v2(d->db, "INSERT INTO monitor_overhead(run_uuid,"
+				"plugin_sha,period,offset,calls,missed,duration,"
+				"cpu_time,max_duration,max_lag) "
+				"VALUES(?,?,?,?,?,?,?,?,?,?);",
+			-1, &sqstmt, NULL);
+	if (ret != SQLITE_OK) {
+		printk(KERN_ERR "Failed to prepare monitor overhead statement: %s\n",
+				sqlite3_errmsg(d->db));
+		return -1;
+	}
+
+	ret = sqlite3_bind_text(sqstmt, 1, d->run_uuid, -1, SQLITE_STATIC);
+	ret |= sqlite3_bind_text(sqstmt, 2, plug->sha256, -1, SQLITE_STATIC);
+	ret |= sqlite3_bind_double(sqstmt, 3, overhead->period);
+	ret |= sqlite3_bind_double(sqstmt, 4, overhead->offset);
+	ret |= sqlite3_bind_int(sqstmt, 5, overhead->calls);
+	ret |= sqlite3_bind_int(sqstmt, 6, overhead->missed);
+	ret |= sqlite3_bind_double(sqstmt, 7, overhead->duration);
+	ret |= sqlite3_bind_double(sqstmt, 8, overhead->cpu_time);
+	ret |= sqlite3_bind_double(sqstmt, 9, overhead->max_duration);
+	ret |= sqlite3_bind_double(sqstmt, 10, overhead->max_lag);
+	if (ret != SQLITE_OK || sqlite3_step(sqstmt) != SQLITE_DONE) {
+		printk(KERN_ERR "Failed to insert monitor overhead of %s: %s\n",
+				plug->id->name, sqlite3_errmsg(d->db));
+		sqlite3_finalize(sqstmt);
+		return -1;
+	}
+	sqlite3_finalize(sqstmt);
+	return 0;
+}
+
+static int sqlite3_add_sweep(void *storage, const struct sweep_summary *sweep)
+{
+	struct sqlite3_data *d = storage;
+	sqlite3_stmt *sqstmt;
+	int ret;
+
+	ret = sqlite3_prepare_v2(d->db, "INSERT INTO adaptive_sweep(system_sha,"
+				"option,metric,inverted,nr_points,knee,"
+				"knee_group_sha,peak,peak_group_sha) "
+				"VALUES(?,?,?,?,?,?,?,?,?);",
+			-1, &sqstmt, NULL);
+	if (ret != SQLITE_OK) {
+		printk(KERN_ERR "Failed to prepare adaptive sweep statement: %s\n",
+				sqlite3_errmsg(d->db));
+		return -1;
+	}
+
+	ret = sqlite3_bind_text(sqstmt, 1, d->sys_sha, -1, SQLITE_STATIC);
+	ret |= sqlite3_bind_text(sqstmt, 2, sweep->option, -1, SQLITE_STATIC);
+	ret |= sqlite3_bind_text(sqstmt, 3, sweep->metric, -1, SQLITE_STATIC);
+	ret |= sqlite3_bind_int(sqstmt, 4, sweep->inverted);
+	ret |= sqlite3_bind_int(sqstmt, 5, sweep->nr_points);
+	ret |= sqlite3_bind_int64(sqstmt, 6, sweep->knee);
+	ret |= sqlite3_bind_text(sqstmt, 7, sweep->knee_group_sha, -1,
+			SQLITE_STATIC);
+	ret |= sqlite3_bind_int64(sqstmt, 8, sweep->peak);
+	ret |= sqlite3_bind_text(sqstmt, 9, sweep->peak_group_sha, -1,
+			SQLITE_STATIC);
+	if (ret != SQLITE_OK || sqlite3_step(sqstmt) != SQLITE_DONE) {
+		printk(KERN_ERR "Failed to insert adaptive sweep over %s: %s\n",
+				sweep->option, sqlite3_errmsg(d->db));
+		sqlite3_finalize(sqstmt);
+		return -1;
+	}
+	sqlite3_finalize(sqstmt);
+	return 0;
+}
+
+static int sqlite3_exit_run(void *storage, const struct run_summary *summary)
+{
+	struct sqlite3_data *d = storage;
+	sqlite3_stmt *sqstmt;
+	int ret;
+
+	ret = sqlite3_prepare_v2(d->db, "UPDATE unique_run SET duration = ?,"
+				" rel_std_dev = ?, order_seed = ?, order_position = ?"
+				" WHERE run_uuid = ?;",
+			-1, &sqstmt, NULL);
+	if (ret != SQLITE_OK) {
+		printk(KERN_ERR "Failed to prepare run summary statement: %s\n",
+				sqlite3_errmsg(d->db));
+		return -1;
+	}
+
+	ret = sqlite3_bind_double(sqstmt, 1, summary->duration);
+	if (summary->rel_std_dev < 0)
+		ret |= sqlite3_bind_null(sqstmt, 2);
+	else
+		ret |= sqlite3_bind_double(sqstmt, 2, summary->rel_std_dev);
+	if (summary->order) {
+		char seed[32];
+
+		/* As text, sqlite3 integers are signed */
+		sprintf(seed, "%lu", summary->order->seed);
+		ret |= sqlite3_bind_text(sqstmt, 3, seed, -1, SQLITE_TRANSIENT);
+		ret |= sqlite3_bind_int(sqstmt, 4, summary->order->position);
+	} else {
+		ret |= sqlite3_bind_null(sqstmt, 3);
+		ret |= sqlite3_bind_null(sqstmt, 4);
+	}
+	ret |= sqlite3_bind_text(sqstmt, 5, d->run_uuid, -1, SQLITE_STATIC);
+	if (ret == SQLITE_OK)
+		ret = sqlite3_step(sqstmt);
+	sqlite3_finalize(sqstmt);
+	if (ret != SQLITE_DONE) {
+		printk(KERN_ERR "Failed to store run summary: %s\n",
+				sqlite3_errmsg(d->db));
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Runs of this system are preferred, the group is only looked up on other
+ * systems if it never ran on this one.
+ */
+static int sqlite3_group_history(void *storage, const char *sha256,
+		struct group_history *hist)
+{
+	struct sqlite3_data *d = storage;
+	sqlite3_stmt *sqstmt;
+	int any_system;
+	int ret;
+
+	for (any_system = 0; any_system != 2; ++any_system) {
+		ret = sqlite3_prepare_v2(d->db, "SELECT count(duration),"
+					" avg(duration), avg(duration * duration),"
+					" (SELECT rel_std_dev FROM unique_run"
+					"  WHERE plugin_group_sha = ?1"
+					"  AND (?3 OR system_sha = ?2)"
+					"  AND rel_std_dev IS NOT NULL"
+					"  ORDER BY rowid DESC LIMIT 1)"
+					" FROM unique_run WHERE plugin_group_sha = ?1"
+					" AND (?3 OR system_sha = ?2)"
+					" AND duration IS NOT NULL;",
+				-1, &sqstmt, NULL);
+		if (ret != SQLITE_OK) {
+			printk(KERN_ERR "Failed to prepare group history statement: %s\n",
+					sqlite3_errmsg(d->db));
+			return -1;
+		}
+
+		ret = sqlite3_bind_text(sqstmt, 1, sha256, -1, SQLITE_STATIC);
+		ret |= sqlite3_bind_text(sqstmt, 2, d->sys_sha, -1, SQLITE_STATIC);
+		ret |= sqlite3_bind_int(sqstmt, 3, any_system);
+		if (ret != SQLITE_OK || sqlite3_step(sqstmt) != SQLITE_ROW) {
+			printk(KERN_ERR "Failed to query group history: %s\n",
+					sqlite3_errmsg(d->db));
+			sqlite3_finalize(sqstmt);
+			return -1;
+		}
+
+		hist->nr_runs = sqlite3_column_int(sqstmt, 0);
+		if (hist->nr_runs) {
+			double mean = sqlite3_column_double(sqstmt, 1);
+			double var = sqlite3_column_double(sqstmt, 2) - mean * mean;
+
+			hist->duration_mean = mean;
+			hist->duration_std_dev = var > 0 ? sqrt(var) : 0;
+			if (sqlite3_column_type(sqstmt, 3) != SQLITE_NULL)
+				hist->rel_std_dev = sqlite3_column_double(sqstmt, 3);
+		}
+		sqlite3_finalize(sqstmt);
+		if (hist->nr_runs)
+			break;
+	}
+	return 0;
+}
+
 static int sqlite3_add_data(void *storage, struct plugin *plug,
 		struct list_head *data_list)
 {
@@ -1018,7 +1369,7 @@ static int sqlite3_add_data(void *storage, struct plugin *plug,
 			plug->version->version);
 
 	ret = sqlite3_prepare_insert_stmt(d->db, &sqstmt, stmt, stmt_size,
-			buf1, buf1_size, *buf2, hdr, "run_uuid,type_monitor", 2);
+			buf1, buf1_size, *buf2, hdr, "run_uuid,type_monitor,instance", 3);
 	if (ret != SQLITE_OK)
 		return -1;
 
@@ -1026,7 +1377,8 @@ static int sqlite3_add_data(void *storage, struct plugin *plug,
 
 		ret = sqlite3_bind_text(sqstmt, 1, d->run_uuid, -1, SQLITE_STATIC);
 		ret |= sqlite3_bind_int(sqstmt, 2, data->type == DATA_TYPE_MONITOR);
-		ret |= sqlite3_bind_data(sqstmt, 3, data);
+		ret |= sqlite3_bind_int(sqstmt, 3, data->instance);
+		ret |= sqlite3_bind_data(sqstmt, 4, data);
 		if (ret != SQLITE_OK)
 			goto error;
 
@@ -1078,5 +1430,10 @@ const struct storage_ops storage_sqlite3 = {
 	.add_sysinfo = sqlite3_add_sysinfo,
 	.init_run = sqlite3_init_run,
 	.add_data = sqlite3_add_data,
+	.add_run_phases = sqlite3_add_run_phases,
+	.add_monitor_overhead = sqlite3_add_monitor_overhead,
+	.exit_run = sqlite3_exit_run,
+	.add_sweep = sqlite3_add_sweep,
+	.group_history = sqlite3_group_history,
 	.exit = sqlite3_exit,
 };